@@ -29,6 +29,10 @@
 #include <errno.h>
 #include <linux/dvb/ca.h>
 #include "dvbca.h"
+#include "dvbvirtual.h"
+
+// messages up to this size are assembled on the stack
+#define DVBCA_STACK_BUFFER_SIZE 1024
 
 
 int dvbca_open(int adapter, int cadevice)
@@ -36,6 +40,12 @@ int dvbca_open(int adapter, int cadevice)
 	char filename[PATH_MAX+1];
 	int fd;
 
+	// CAMs are not emulated on virtual adapters
+	if (dvbvirtual_is_virtual(adapter)) {
+		errno = ENODEV;
+		return -1;
+	}
+
 	sprintf(filename, "/dev/dvb/adapter%i/ca%i", adapter, cadevice);
 	if ((fd = open(filename, O_RDWR)) < 0) {
 		// if that failed, try a flat /dev structure
@@ -88,50 +98,110 @@ int dvbca_get_cam_state(int fd, uint8_t slot)
 int dvbca_link_write(int fd, uint8_t slot, uint8_t connection_id,
 		     uint8_t *data, uint16_t data_length)
 {
-	uint8_t *buf = malloc(data_length + 2);
-	if (buf == NULL)
-		return -1;
+	struct iovec iov;
+
+	iov.iov_base = data;
+	iov.iov_len = data_length;
+	return dvbca_link_writev(fd, slot, connection_id, &iov, 1);
+}
 
+int dvbca_link_write_inplace(int fd, uint8_t slot, uint8_t connection_id,
+			     uint8_t *buf, uint16_t data_length)
+{
 	buf[0] = slot;
 	buf[1] = connection_id;
-	memcpy(buf+2, data, data_length);
 
-	int result = write(fd, buf, data_length+2);
-	free(buf);
+	return write(fd, buf, data_length + DVBCA_LINK_HEADER_SIZE);
+}
+
+int dvbca_link_writev(int fd, uint8_t slot, uint8_t connection_id,
+		      struct iovec *vector, int iov_count)
+{
+	uint8_t stack_buf[DVBCA_STACK_BUFFER_SIZE];
+	uint8_t *buf = stack_buf;
+	uint32_t data_length = 0;
+	uint32_t pos;
+	int i;
+
+	for(i=0; i < iov_count; i++)
+		data_length += vector[i].iov_len;
+	if (data_length > 0xffff)
+		return -1;
+
+	if ((data_length + DVBCA_LINK_HEADER_SIZE) > sizeof(stack_buf)) {
+		buf = malloc(data_length + DVBCA_LINK_HEADER_SIZE);
+		if (buf == NULL)
+			return -1;
+	}
+
+	pos = DVBCA_LINK_HEADER_SIZE;
+	for(i=0; i < iov_count; i++) {
+		memcpy(buf + pos, vector[i].iov_base, vector[i].iov_len);
+		pos += vector[i].iov_len;
+	}
+
+	int result = dvbca_link_write_inplace(fd, slot, connection_id, buf, data_length);
+	if (buf != stack_buf)
+		free(buf);
 	return result;
 }
 
 int dvbca_link_read(int fd, uint8_t *slot, uint8_t *connection_id,
 		     uint8_t *data, uint16_t data_length)
 {
+	uint8_t stack_buf[DVBCA_STACK_BUFFER_SIZE];
+	uint8_t *buf = stack_buf;
 	int size;
 
-	uint8_t *buf = malloc(data_length + 2);
-	if (buf == NULL)
-		return -1;
+	if ((data_length + DVBCA_LINK_HEADER_SIZE) > (int) sizeof(stack_buf)) {
+		buf = malloc(data_length + DVBCA_LINK_HEADER_SIZE);
+		if (buf == NULL)
+			return -1;
+	}
 
-	if ((size = read(fd, buf, data_length+2)) < 2)
+	if ((size = read(fd, buf, data_length + DVBCA_LINK_HEADER_SIZE)) < DVBCA_LINK_HEADER_SIZE) {
+		if (buf != stack_buf)
+			free(buf);
 		return -1;
+	}
 
 	*slot = buf[0];
 	*connection_id = buf[1];
-	memcpy(data, buf+2, size-2);
-	free(buf);
+	memcpy(data, buf + DVBCA_LINK_HEADER_SIZE, size - DVBCA_LINK_HEADER_SIZE);
+	if (buf != stack_buf)
+		free(buf);
 
-	return size - 2;
+	return size - DVBCA_LINK_HEADER_SIZE;
 }
 
 int dvbca_hlci_write(int fd, uint8_t *data, uint16_t data_length)
+{
+	struct iovec iov;
+
+	iov.iov_base = data;
+	iov.iov_len = data_length;
+	return dvbca_hlci_writev(fd, &iov, 1);
+}
+
+int dvbca_hlci_writev(int fd, struct iovec *vector, int iov_count)
 {
 	struct ca_msg msg;
+	uint32_t data_length = 0;
+	int i;
 
-	if (data_length > 256) {
+	for(i=0; i < iov_count; i++)
+		data_length += vector[i].iov_len;
+	if (data_length > sizeof(msg.msg)) {
 		return -1;
 	}
 	memset(&msg, 0, sizeof(msg));
 	msg.length = data_length;
 
-	memcpy(msg.msg, data, data_length);
+	data_length = 0;
+	for(i=0; i < iov_count; i++) {
+		memcpy(msg.msg + data_length, vector[i].iov_base, vector[i].iov_len);
+		data_length += vector[i].iov_len;
+	}
 
 	return ioctl(fd, CA_SEND_MSG, &msg);
 }
@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <sys/uio.h>
 
 /**
  * The types of CA interface we support.
@@ -34,6 +35,11 @@ extern "C"
 #define DVBCA_INTERFACE_LINK 0
 #define DVBCA_INTERFACE_HLCI 1
 
+/**
+ * Size of the header prepended to each link-layer message.
+ */
+#define DVBCA_LINK_HEADER_SIZE 2
+
 /**
  * States a CAM in a slot can be in.
  */
@@ -86,11 +92,45 @@ extern int dvbca_get_cam_state(int fd, uint8_t slot);
  * @param connection_id Connection ID of the message.
  * @param data Data to write.
  * @param data_length Number of bytes to write.
- * @return 0 on success, or -1 on failure.
+ * @return Number of bytes written, including the link-layer header, on
+ * success, or -1 on failure.
  */
 extern int dvbca_link_write(int fd, uint8_t slot, uint8_t connection_id,
 			    uint8_t *data, uint16_t data_length);
 
+/**
+ * Write a message to a CAM using a link-layer interface, where the caller has
+ * left room for the link-layer header in front of the data. No copy is made.
+ *
+ * @param fd File handle opened with dvbca_open.
+ * @param slot Slot where the requested CAM is in.
+ * @param connection_id Connection ID of the message.
+ * @param buf Buffer of DVBCA_LINK_HEADER_SIZE + data_length bytes. The first
+ * DVBCA_LINK_HEADER_SIZE bytes are overwritten, and the data follows them.
+ * @param data_length Number of bytes of data to write.
+ * @return Number of bytes written, including the link-layer header, on
+ * success, or -1 on failure.
+ */
+extern int dvbca_link_write_inplace(int fd, uint8_t slot, uint8_t connection_id,
+				    uint8_t *buf, uint16_t data_length);
+
+/**
+ * Write a message gathered from several buffers to a CAM using a link-layer
+ * interface. The CA device treats every write as a separate message, so the
+ * pieces are still gathered into one buffer, but on the stack for all but
+ * very large messages.
+ *
+ * @param fd File handle opened with dvbca_open.
+ * @param slot Slot where the requested CAM is in.
+ * @param connection_id Connection ID of the message.
+ * @param vector iov to write.
+ * @param iov_count Number of elements in vector.
+ * @return Number of bytes written, including the link-layer header, on
+ * success, or -1 on failure.
+ */
+extern int dvbca_link_writev(int fd, uint8_t slot, uint8_t connection_id,
+			     struct iovec *vector, int iov_count);
+
 /**
  * Read a message from a CAM using a link-layer interface.
  *
@@ -115,6 +155,16 @@ extern int dvbca_link_read(int fd, uint8_t *slot, uint8_t *connection_id,
  */
 extern int dvbca_hlci_write(int fd, uint8_t *data, uint16_t data_length);
 
+/**
+ * Write a message gathered from several buffers to a CAM using an HLCI interface.
+ *
+ * @param fd File handle opened with dvbca_open.
+ * @param vector iov to write.
+ * @param iov_count Number of elements in vector.
+ * @return 0 on success, or -1 on failure.
+ */
+extern int dvbca_hlci_writev(int fd, struct iovec *vector, int iov_count);
+
 // FIXME how do we determine which CAM slot of a CA is meant?
 /**
  * Read a message from a CAM using an HLCI interface.
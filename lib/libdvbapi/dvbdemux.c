@@ -29,6 +29,9 @@
 #include <errno.h>
 #include <linux/dvb/dmx.h>
 #include "dvbdemux.h"
+#include "dvbvirtual.h"
+
+static int dvbdemux_ioctl(int fd, unsigned long request, void *arg);
 
 
 int dvbdemux_open_demux(int adapter, int demuxdevice, int nonblocking)
@@ -40,6 +43,9 @@ int dvbdemux_open_demux(int adapter, int demuxdevice, int nonblocking)
 	if (nonblocking)
 		flags |= O_NONBLOCK;
 
+	if (dvbvirtual_is_virtual(adapter))
+		return dvbvirtual_open_demux(adapter, nonblocking);
+
 	sprintf(filename, "/dev/dvb/adapter%i/demux%i", adapter, demuxdevice);
 	if ((fd = open(filename, flags)) < 0) {
 		// if that failed, try a flat /dev structure
@@ -61,6 +67,9 @@ int dvbdemux_open_dvr(int adapter, int dvrdevice, int readonly, int nonblocking)
 	if (nonblocking)
 		flags |= O_NONBLOCK;
 
+	if (dvbvirtual_is_virtual(adapter))
+		return dvbvirtual_open_dvr(adapter, nonblocking);
+
 	sprintf(filename, "/dev/dvb/adapter%i/dvr%i", adapter, dvrdevice);
 	if ((fd = open(filename, flags)) < 0) {
 		// if that failed, try a flat /dev structure
@@ -89,7 +98,7 @@ int dvbdemux_set_section_filter(int fd, int pid,
 	if (checkcrc)
 		sctfilter.flags |= DMX_CHECK_CRC;
 
-	return ioctl(fd, DMX_SET_FILTER, &sctfilter);
+	return dvbdemux_ioctl(fd, DMX_SET_FILTER, &sctfilter);
 }
 
 int dvbdemux_set_pes_filter(int fd, int pid,
@@ -166,7 +175,7 @@ int dvbdemux_set_pes_filter(int fd, int pid,
 	if (start)
 		filter.flags |= DMX_IMMEDIATE_START;
 
-	return ioctl(fd, DMX_SET_PES_FILTER, &filter);
+	return dvbdemux_ioctl(fd, DMX_SET_PES_FILTER, &filter);
 }
 
 int dvbdemux_set_pid_filter(int fd, int pid,
@@ -222,17 +231,17 @@ int dvbdemux_set_pid_filter(int fd, int pid,
 	if (start)
 		filter.flags |= DMX_IMMEDIATE_START;
 
-	return ioctl(fd, DMX_SET_PES_FILTER, &filter);
+	return dvbdemux_ioctl(fd, DMX_SET_PES_FILTER, &filter);
 }
 
 int dvbdemux_start(int fd)
 {
-	return ioctl(fd, DMX_START);
+	return dvbdemux_ioctl(fd, DMX_START, NULL);
 }
 
 int dvbdemux_stop(int fd)
 {
-	return ioctl(fd, DMX_STOP);
+	return dvbdemux_ioctl(fd, DMX_STOP, NULL);
 }
 
 int dvbdemux_get_stc(int fd, uint64_t *stc)
@@ -240,8 +249,8 @@ int dvbdemux_get_stc(int fd, uint64_t *stc)
 	struct dmx_stc _stc;
 	int result;
 
-	memset(stc, 0, sizeof(_stc));
-	if ((result = ioctl(fd, DMX_GET_STC, &_stc)) != 0) {
+	memset(&_stc, 0, sizeof(_stc));
+	if ((result = dvbdemux_ioctl(fd, DMX_GET_STC, &_stc)) != 0) {
 		return result;
 	}
 
@@ -251,5 +260,15 @@ int dvbdemux_get_stc(int fd, uint64_t *stc)
 
 int dvbdemux_set_buffer(int fd, int bufsize)
 {
-	return ioctl(fd, DMX_SET_BUFFER_SIZE, bufsize);
+	return dvbdemux_ioctl(fd, DMX_SET_BUFFER_SIZE, (void *) (long) bufsize);
+}
+
+static int dvbdemux_ioctl(int fd, unsigned long request, void *arg)
+{
+	int result;
+
+	if (dvbvirtual_ioctl(fd, request, arg, &result))
+		return result;
+
+	return ioctl(fd, request, arg);
 }
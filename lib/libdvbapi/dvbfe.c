@@ -35,6 +35,7 @@
 #include <linux/dvb/frontend.h>
 #include <libdvbmisc/dvbmisc.h>
 #include "dvbfe.h"
+#include "dvbvirtual.h"
 
 int verbose = 0;
 
@@ -132,6 +133,16 @@ static int dvbfe_dvbt_hierarchy_to_kapi[][2] =
 };
 
 
+static int dvbfe_ioctl(int fd, unsigned long request, void *arg)
+{
+	int result;
+
+	if (dvbvirtual_ioctl(fd, request, arg, &result))
+		return result;
+
+	return ioctl(fd, request, arg);
+}
+
 static int lookupval(int val, int reverse, int table[][2])
 {
 	int i =0;
@@ -173,17 +184,24 @@ struct dvbfe_handle *dvbfe_open(int adapter, int frontend, int readonly)
 	}
 
 	// open it (try normal /dev structure first)
-	sprintf(filename, "/dev/dvb/adapter%i/frontend%i", adapter, frontend);
-	if ((fd = open(filename, flags)) < 0) {
-		// if that failed, try a flat /dev structure
-		sprintf(filename, "/dev/dvb%i.frontend%i", adapter, frontend);
-		if ((fd = open(filename, flags)) < 0) {
+	if (dvbvirtual_is_virtual(adapter)) {
+		if ((fd = dvbvirtual_open_frontend(adapter)) < 0) {
 			return NULL;
 		}
+	} else {
+		sprintf(filename, "/dev/dvb/adapter%i/frontend%i", adapter, frontend);
+		if ((fd = open(filename, flags)) < 0) {
+			// if that failed, try a flat /dev structure
+			sprintf(filename, "/dev/dvb%i.frontend%i", adapter, frontend);
+			if ((fd = open(filename, flags)) < 0) {
+				return NULL;
+			}
+		}
 	}
 
 	// determine fe type
-	if (ioctl(fd, FE_GET_INFO, &info)) {
+	if (dvbfe_ioctl(fd, FE_GET_INFO, &info)) {
+		dvbvirtual_close(fd);
 		close(fd);
 		return NULL;
 	}
@@ -217,6 +235,7 @@ struct dvbfe_handle *dvbfe_open(int adapter, int frontend, int readonly)
 
 void dvbfe_close(struct dvbfe_handle *fehandle)
 {
+	dvbvirtual_close(fehandle->fd);
 	close(fehandle->fd);
 	free(fehandle->name);
 	free(fehandle);
@@ -238,12 +257,12 @@ extern int dvbfe_get_info(struct dvbfe_handle *fehandle,
 	switch(querytype) {
 	case DVBFE_INFO_QUERYTYPE_IMMEDIATE:
 		if (querymask & DVBFE_INFO_LOCKSTATUS) {
-			if (!ioctl(fehandle->fd, FE_READ_STATUS, &kevent.status)) {
+			if (!dvbfe_ioctl(fehandle->fd, FE_READ_STATUS, &kevent.status)) {
 				returnval |= DVBFE_INFO_LOCKSTATUS;
 			}
 		}
 		if (querymask & DVBFE_INFO_FEPARAMS) {
-			if (!ioctl(fehandle->fd, FE_GET_FRONTEND, &kevent.parameters)) {
+			if (!dvbfe_ioctl(fehandle->fd, FE_GET_FRONTEND, &kevent.parameters)) {
 				returnval |= DVBFE_INFO_FEPARAMS;
 			}
 		}
@@ -267,7 +286,7 @@ extern int dvbfe_get_info(struct dvbfe_handle *fehandle,
 		if (ok &&
 		    ((querymask & DVBFE_INFO_LOCKSTATUS) ||
 		     (querymask & DVBFE_INFO_FEPARAMS))) {
-			if (!ioctl(fehandle->fd, FE_GET_EVENT, &kevent)) {
+			if (!dvbfe_ioctl(fehandle->fd, FE_GET_EVENT, &kevent)) {
 				if (querymask & DVBFE_INFO_LOCKSTATUS)
 					returnval |= DVBFE_INFO_LOCKSTATUS;
 				if (querymask & DVBFE_INFO_FEPARAMS)
@@ -328,19 +347,19 @@ extern int dvbfe_get_info(struct dvbfe_handle *fehandle,
 	}
 
 	if (querymask & DVBFE_INFO_BER) {
-		if (!ioctl(fehandle->fd, FE_READ_BER, &result->ber))
+		if (!dvbfe_ioctl(fehandle->fd, FE_READ_BER, &result->ber))
 			returnval |= DVBFE_INFO_BER;
 	}
 	if (querymask & DVBFE_INFO_SIGNAL_STRENGTH) {
-		if (!ioctl(fehandle->fd, FE_READ_SIGNAL_STRENGTH, &result->signal_strength))
+		if (!dvbfe_ioctl(fehandle->fd, FE_READ_SIGNAL_STRENGTH, &result->signal_strength))
 			returnval |= DVBFE_INFO_SIGNAL_STRENGTH;
 	}
 	if (querymask & DVBFE_INFO_SNR) {
-		if (!ioctl(fehandle->fd, FE_READ_SNR, &result->snr))
+		if (!dvbfe_ioctl(fehandle->fd, FE_READ_SNR, &result->snr))
 			returnval |= DVBFE_INFO_SNR;
 	}
 	if (querymask & DVBFE_INFO_UNCORRECTED_BLOCKS) {
-		if (!ioctl(fehandle->fd, FE_READ_UNCORRECTED_BLOCKS, &result->ucblocks))
+		if (!dvbfe_ioctl(fehandle->fd, FE_READ_UNCORRECTED_BLOCKS, &result->ucblocks))
 			returnval |= DVBFE_INFO_UNCORRECTED_BLOCKS;
 	}
 
@@ -393,7 +412,7 @@ int dvbfe_set(struct dvbfe_handle *fehandle,
 	}
 
 	// set it and check for error
-	res = ioctl(fehandle->fd, FE_SET_FRONTEND, &kparams);
+	res = dvbfe_ioctl(fehandle->fd, FE_SET_FRONTEND, &kparams);
 	if (res)
 		return res;
 
@@ -413,7 +432,7 @@ int dvbfe_set(struct dvbfe_handle *fehandle,
 	/* wait for a lock */
 	while(1) {
 		/* has it locked? */
-		if (!ioctl(fehandle->fd, FE_READ_STATUS, &status)) {
+		if (!dvbfe_ioctl(fehandle->fd, FE_READ_STATUS, &status)) {
 			if (status & FE_HAS_LOCK) {
 				break;
 			}
@@ -450,10 +469,10 @@ int dvbfe_set_22k_tone(struct dvbfe_handle *fehandle, enum dvbfe_sec_tone_mode t
 
 	switch (tone) {
 	case DVBFE_SEC_TONE_OFF:
-		ret = ioctl(fehandle->fd, FE_SET_TONE, SEC_TONE_OFF);
+		ret = dvbfe_ioctl(fehandle->fd, FE_SET_TONE, (void *) (long) SEC_TONE_OFF);
 		break;
 	case DVBFE_SEC_TONE_ON:
-		ret = ioctl(fehandle->fd, FE_SET_TONE, SEC_TONE_ON);
+		ret = dvbfe_ioctl(fehandle->fd, FE_SET_TONE, (void *) (long) SEC_TONE_ON);
 		break;
 	default:
 		print(verbose, ERROR, 1, "Invalid command !");
@@ -471,10 +490,10 @@ int dvbfe_set_tone_data_burst(struct dvbfe_handle *fehandle, enum dvbfe_sec_mini
 
 	switch (minicmd) {
 	case DVBFE_SEC_MINI_A:
-		ret = ioctl(fehandle->fd, FE_DISEQC_SEND_BURST, SEC_MINI_A);
+		ret = dvbfe_ioctl(fehandle->fd, FE_DISEQC_SEND_BURST, (void *) (long) SEC_MINI_A);
 		break;
 	case DVBFE_SEC_MINI_B:
-		ret = ioctl(fehandle->fd, FE_DISEQC_SEND_BURST, SEC_MINI_B);
+		ret = dvbfe_ioctl(fehandle->fd, FE_DISEQC_SEND_BURST, (void *) (long) SEC_MINI_B);
 		break;
 	default:
 		print(verbose, ERROR, 1, "Invalid command");
@@ -492,13 +511,13 @@ int dvbfe_set_voltage(struct dvbfe_handle *fehandle, enum dvbfe_sec_voltage volt
 
 	switch (voltage) {
 	case DVBFE_SEC_VOLTAGE_OFF:
-		ret = ioctl(fehandle->fd, FE_SET_VOLTAGE, SEC_VOLTAGE_OFF);
+		ret = dvbfe_ioctl(fehandle->fd, FE_SET_VOLTAGE, (void *) (long) SEC_VOLTAGE_OFF);
 		break;
 	case DVBFE_SEC_VOLTAGE_13:
-		ret = ioctl(fehandle->fd, FE_SET_VOLTAGE, SEC_VOLTAGE_13);
+		ret = dvbfe_ioctl(fehandle->fd, FE_SET_VOLTAGE, (void *) (long) SEC_VOLTAGE_13);
 		break;
 	case DVBFE_SEC_VOLTAGE_18:
-		ret = ioctl(fehandle->fd, FE_SET_VOLTAGE, SEC_VOLTAGE_18);
+		ret = dvbfe_ioctl(fehandle->fd, FE_SET_VOLTAGE, (void *) (long) SEC_VOLTAGE_18);
 		break;
 	default:
 		print(verbose, ERROR, 1, "Invalid command");
@@ -514,10 +533,10 @@ int dvbfe_set_high_lnb_voltage(struct dvbfe_handle *fehandle, int on)
 {
 	switch (on) {
 	case 0:
-		ioctl(fehandle->fd, FE_ENABLE_HIGH_LNB_VOLTAGE, 0);
+		dvbfe_ioctl(fehandle->fd, FE_ENABLE_HIGH_LNB_VOLTAGE, (void *) (long) 0);
 		break;
 	default:
-		ioctl(fehandle->fd, FE_ENABLE_HIGH_LNB_VOLTAGE, 1);
+		dvbfe_ioctl(fehandle->fd, FE_ENABLE_HIGH_LNB_VOLTAGE, (void *) (long) 1);
 		break;
 	}
 	return 0;
@@ -527,7 +546,7 @@ int dvbfe_do_dishnetworks_legacy_command(struct dvbfe_handle *fehandle, unsigned
 {
 	int ret = 0;
 
-	ret = ioctl(fehandle->fd, FE_DISHNETWORK_SEND_LEGACY_CMD, cmd);
+	ret = dvbfe_ioctl(fehandle->fd, FE_DISHNETWORK_SEND_LEGACY_CMD, (void *) (long) cmd);
 	if (ret == -1)
 		print(verbose, ERROR, 1, "IOCTL failed");
 
@@ -545,7 +564,7 @@ int dvbfe_do_diseqc_command(struct dvbfe_handle *fehandle, uint8_t *data, uint8_
 	diseqc_message.msg_len = len;
 	memcpy(diseqc_message.msg, data, len);
 
-	ret = ioctl(fehandle->fd, FE_DISEQC_SEND_MASTER_CMD, &diseqc_message);
+	ret = dvbfe_ioctl(fehandle->fd, FE_DISEQC_SEND_MASTER_CMD, &diseqc_message);
 	if (ret == -1)
 		print(verbose, ERROR, 1, "IOCTL failed");
 
@@ -563,7 +582,7 @@ int dvbfe_diseqc_read(struct dvbfe_handle *fehandle, int timeout, unsigned char
 	reply.timeout = timeout;
 	reply.msg_len = len;
 
-	if ((result = ioctl(fehandle->fd, FE_DISEQC_RECV_SLAVE_REPLY, reply)) != 0)
+	if ((result = dvbfe_ioctl(fehandle->fd, FE_DISEQC_RECV_SLAVE_REPLY, &reply)) != 0)
 		return result;
 
 	if (reply.msg_len < len)
@@ -0,0 +1,1362 @@
+/*
+ * libdvbapi - virtual DVB adapters
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <linux/dvb/dmx.h>
+#include <linux/dvb/frontend.h>
+#include "dvbvirtual.h"
+
+#define VIRTUAL_PACKET_SIZE 188
+#define VIRTUAL_PACKET_SYNC 0x47
+#define VIRTUAL_PID_ALL 0x2000
+
+// packets read from the file at once
+#define VIRTUAL_READ_PACKETS 512
+
+// per-handle buffer: holds a batch of TS/PES data, or a partial section
+#define VIRTUAL_BATCH_PACKETS 64
+#define VIRTUAL_HANDLE_BUFFER_SIZE (VIRTUAL_BATCH_PACKETS * VIRTUAL_PACKET_SIZE)
+
+// PCRs are 33 bits of 90kHz base plus a 9 bit 27MHz extension
+#define VIRTUAL_PCR_WRAP ((1ULL << 33) * 300)
+#define VIRTUAL_PCR_HZ 27000000ULL
+
+// PCR jumps larger than this are treated as discontinuities
+#define VIRTUAL_PCR_MAX_JUMP (VIRTUAL_PCR_HZ * 2)
+
+// if playback falls further behind than this, it restarts its timing
+#define VIRTUAL_MAX_LAG_US 1000000ULL
+
+#define VIRTUAL_DEFAULT_SIGNAL_STRENGTH 0xc000
+#define VIRTUAL_DEFAULT_SNR 0xa000
+
+enum virtual_kind {
+	VIRTUAL_DEMUX,
+	VIRTUAL_DVR,
+};
+
+enum virtual_filter {
+	VIRTUAL_FILTER_NONE,
+	VIRTUAL_FILTER_SECTION,		// sections to the demux fd
+	VIRTUAL_FILTER_PES,		// PES payload to the demux fd
+	VIRTUAL_FILTER_TS,		// TS packets to the demux fd
+	VIRTUAL_FILTER_DVR,		// TS packets to the DVR fd
+	VIRTUAL_FILTER_DECODER,		// no output
+};
+
+struct virtual_handle {
+	struct virtual_handle *next;
+	enum virtual_kind kind;
+	int dead;
+
+	// the application's end of the socket, and ours
+	int app_fd;
+	ino_t app_ino;
+	int fd;
+	int sndbuf;
+	int max_chunk;
+
+	enum virtual_filter filter_type;
+	int pid;
+	int started;
+	uint8_t filter[16];
+	uint8_t mask[16];
+	int check_crc;
+
+	int cc;
+	int synced;
+	uint8_t *buf;
+	int buf_len;
+};
+
+struct virtual_adapter {
+	struct virtual_adapter *next;
+	int adapter;
+	struct dvbvirtual_config config;
+	int file_fd;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread;
+	int thread_started;
+	int shutdown;
+
+	struct virtual_handle *handles;
+	struct dvbvirtual_stats stats;
+
+	// frontend state
+	int fe_fd;
+	int fe_tuned;
+	uint64_t fe_lock_time;
+	struct dvb_frontend_parameters fe_params;
+
+	// pacing state
+	int pcr_pid;
+	int pcr_anchored;
+	uint64_t pcr_anchor;
+	uint64_t pcr_last;
+	uint64_t wall_anchor;
+	int have_stc;
+	uint64_t stc;
+	uint64_t fixed_packets;
+};
+
+static struct virtual_adapter *virtual_adapters = NULL;
+static pthread_mutex_t virtual_adapters_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t virtual_env_once = PTHREAD_ONCE_INIT;
+static pthread_once_t virtual_crc_once = PTHREAD_ONCE_INIT;
+static uint32_t virtual_crc_table[256];
+
+static int virtual_attach(int adapter, struct dvbvirtual_config *config);
+static void virtual_env_init(void);
+static void virtual_crc_init(void);
+static uint32_t virtual_crc32(uint8_t *buf, int len);
+static uint64_t virtual_now_us(void);
+static struct virtual_adapter *virtual_find_adapter(int adapter);
+static struct virtual_handle *virtual_find_handle(int fd, struct virtual_adapter **va_out);
+static int virtual_open_handle(int adapter, enum virtual_kind kind, int socktype, int nonblocking);
+static int virtual_set_socktype(struct virtual_handle *h, int socktype);
+static void virtual_update_max_chunk(struct virtual_handle *h);
+static void virtual_discard(struct virtual_handle *h);
+static int virtual_demux_ioctl(struct virtual_adapter *va, struct virtual_handle *h,
+			       unsigned long request, void *arg);
+static int virtual_frontend_ioctl(struct virtual_adapter *va, unsigned long request, void *arg);
+static fe_status_t virtual_fe_status(struct virtual_adapter *va);
+static void *virtual_thread(void *arg);
+static int virtual_wants_data(struct virtual_adapter *va);
+static void virtual_reap_handles(struct virtual_adapter *va);
+static void virtual_pace(struct virtual_adapter *va, uint8_t *pkt);
+static void virtual_sleep_until(struct virtual_adapter *va, uint64_t when);
+static void virtual_deliver(struct virtual_adapter *va, uint8_t *pkt);
+static void virtual_section_packet(struct virtual_adapter *va, struct virtual_handle *h, uint8_t *pkt);
+static void virtual_section_data(struct virtual_adapter *va, struct virtual_handle *h,
+				 uint8_t *data, int len);
+static void virtual_section(struct virtual_adapter *va, struct virtual_handle *h,
+			    uint8_t *section, int len);
+static void virtual_pes_packet(struct virtual_adapter *va, struct virtual_handle *h, uint8_t *pkt);
+static void virtual_append(struct virtual_adapter *va, struct virtual_handle *h,
+			   uint8_t *data, int len);
+static void virtual_flush(struct virtual_adapter *va);
+static void virtual_flush_handle(struct virtual_adapter *va, struct virtual_handle *h);
+static int virtual_wait_writable(struct virtual_adapter *va, struct virtual_handle *h);
+
+
+int dvbvirtual_attach(int adapter, struct dvbvirtual_config *config)
+{
+	pthread_once(&virtual_env_once, virtual_env_init);
+
+	return virtual_attach(adapter, config);
+}
+
+void dvbvirtual_detach(int adapter)
+{
+	struct virtual_adapter *va;
+	struct virtual_adapter **pva;
+	struct virtual_handle *h;
+
+	// unlink it
+	pthread_mutex_lock(&virtual_adapters_lock);
+	pva = &virtual_adapters;
+	while(*pva && ((*pva)->adapter != adapter))
+		pva = &(*pva)->next;
+	va = *pva;
+	if (va)
+		*pva = va->next;
+	pthread_mutex_unlock(&virtual_adapters_lock);
+	if (va == NULL)
+		return;
+
+	// stop the playback thread
+	pthread_mutex_lock(&va->lock);
+	va->shutdown = 1;
+	pthread_cond_broadcast(&va->cond);
+	pthread_mutex_unlock(&va->lock);
+	if (va->thread_started)
+		pthread_join(va->thread, NULL);
+
+	// closing our ends gives any readers EOF. The frontend fd belongs to
+	// its dvbfe_handle, so that is left for dvbfe_close().
+	while(va->handles) {
+		h = va->handles;
+		va->handles = h->next;
+		close(h->fd);
+		free(h->buf);
+		free(h);
+	}
+	close(va->file_fd);
+	pthread_cond_destroy(&va->cond);
+	pthread_mutex_destroy(&va->lock);
+	free(va->config.filename);
+	free(va);
+}
+
+int dvbvirtual_get_stats(int adapter, struct dvbvirtual_stats *stats)
+{
+	struct virtual_adapter *va;
+
+	pthread_mutex_lock(&virtual_adapters_lock);
+	va = virtual_find_adapter(adapter);
+	if (va) {
+		pthread_mutex_lock(&va->lock);
+		memcpy(stats, &va->stats, sizeof(struct dvbvirtual_stats));
+		pthread_mutex_unlock(&va->lock);
+	}
+	pthread_mutex_unlock(&virtual_adapters_lock);
+
+	return va ? 0 : -1;
+}
+
+int dvbvirtual_is_virtual(int adapter)
+{
+	int result;
+
+	pthread_once(&virtual_env_once, virtual_env_init);
+	if (virtual_adapters == NULL)
+		return 0;
+
+	pthread_mutex_lock(&virtual_adapters_lock);
+	result = virtual_find_adapter(adapter) != NULL;
+	pthread_mutex_unlock(&virtual_adapters_lock);
+
+	return result;
+}
+
+int dvbvirtual_open_frontend(int adapter)
+{
+	struct virtual_adapter *va;
+	int fd = -1;
+
+	pthread_mutex_lock(&virtual_adapters_lock);
+	va = virtual_find_adapter(adapter);
+	if (va == NULL) {
+		errno = ENODEV;
+		goto exit;
+	}
+
+	// the timerfd becomes readable when the frontend locks, which is
+	// exactly when the kernel would have queued a frontend event
+	pthread_mutex_lock(&va->lock);
+	if (va->fe_fd != -1) {
+		errno = EBUSY;
+	} else if ((fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)) >= 0) {
+		va->fe_fd = fd;
+		va->fe_tuned = 0;
+	}
+	pthread_mutex_unlock(&va->lock);
+
+exit:
+	pthread_mutex_unlock(&virtual_adapters_lock);
+	return fd;
+}
+
+int dvbvirtual_open_demux(int adapter, int nonblocking)
+{
+	return virtual_open_handle(adapter, VIRTUAL_DEMUX, SOCK_SEQPACKET, nonblocking);
+}
+
+int dvbvirtual_open_dvr(int adapter, int nonblocking)
+{
+	return virtual_open_handle(adapter, VIRTUAL_DVR, SOCK_STREAM, nonblocking);
+}
+
+void dvbvirtual_close(int fd)
+{
+	struct virtual_adapter *va;
+	struct virtual_handle *h;
+
+	if (virtual_adapters == NULL)
+		return;
+
+	pthread_mutex_lock(&virtual_adapters_lock);
+	for(va = virtual_adapters; va; va = va->next) {
+		pthread_mutex_lock(&va->lock);
+		if (va->fe_fd == fd) {
+			va->fe_fd = -1;
+			va->fe_tuned = 0;
+		}
+		pthread_mutex_unlock(&va->lock);
+	}
+	pthread_mutex_unlock(&virtual_adapters_lock);
+
+	if ((h = virtual_find_handle(fd, &va)) != NULL) {
+		h->dead = 1;
+		pthread_mutex_unlock(&va->lock);
+	}
+}
+
+int dvbvirtual_ioctl(int fd, unsigned long request, void *arg, int *result)
+{
+	struct virtual_adapter *va;
+	struct virtual_handle *h;
+
+	if (virtual_adapters == NULL)
+		return 0;
+
+	// frontend?
+	pthread_mutex_lock(&virtual_adapters_lock);
+	for(va = virtual_adapters; va; va = va->next) {
+		pthread_mutex_lock(&va->lock);
+		if (va->fe_fd == fd) {
+			*result = virtual_frontend_ioctl(va, request, arg);
+			pthread_mutex_unlock(&va->lock);
+			pthread_mutex_unlock(&virtual_adapters_lock);
+			return 1;
+		}
+		pthread_mutex_unlock(&va->lock);
+	}
+	pthread_mutex_unlock(&virtual_adapters_lock);
+
+	// demux/dvr?
+	if ((h = virtual_find_handle(fd, &va)) == NULL)
+		return 0;
+	*result = virtual_demux_ioctl(va, h, request, arg);
+	pthread_mutex_unlock(&va->lock);
+	return 1;
+}
+
+static int virtual_attach(int adapter, struct dvbvirtual_config *config)
+{
+	struct virtual_adapter *va;
+	pthread_condattr_t condattr;
+
+	pthread_once(&virtual_crc_once, virtual_crc_init);
+
+	if ((config->filename == NULL) ||
+	    ((config->rate == DVBVIRTUAL_RATE_FIXED) && (config->bitrate == 0)))
+		return -EINVAL;
+
+	va = malloc(sizeof(struct virtual_adapter));
+	if (va == NULL)
+		return -ENOMEM;
+	memset(va, 0, sizeof(struct virtual_adapter));
+	va->adapter = adapter;
+	memcpy(&va->config, config, sizeof(struct dvbvirtual_config));
+	va->fe_fd = -1;
+	va->pcr_pid = -1;
+
+	if ((va->config.filename = strdup(config->filename)) == NULL) {
+		free(va);
+		return -ENOMEM;
+	}
+	if ((va->file_fd = open(config->filename, O_RDONLY)) < 0) {
+		free(va->config.filename);
+		free(va);
+		return -1;
+	}
+
+	pthread_mutex_init(&va->lock, NULL);
+	pthread_condattr_init(&condattr);
+	pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&va->cond, &condattr);
+	pthread_condattr_destroy(&condattr);
+
+	pthread_mutex_lock(&virtual_adapters_lock);
+	if (virtual_find_adapter(adapter)) {
+		pthread_mutex_unlock(&virtual_adapters_lock);
+		close(va->file_fd);
+		pthread_cond_destroy(&va->cond);
+		pthread_mutex_destroy(&va->lock);
+		free(va->config.filename);
+		free(va);
+		return -EEXIST;
+	}
+	va->next = virtual_adapters;
+	virtual_adapters = va;
+	pthread_mutex_unlock(&virtual_adapters_lock);
+
+	return 0;
+}
+
+static void virtual_env_init(void)
+{
+	struct dvbvirtual_config config;
+	char *env;
+	char *spec;
+	char *entry;
+	char *option;
+	char *end;
+	char *saveptr1;
+	char *saveptr2;
+	int adapter;
+
+	if ((env = getenv("DVB_VIRTUAL_ADAPTER")) == NULL)
+		return;
+	if ((spec = strdup(env)) == NULL)
+		return;
+
+	for(entry = strtok_r(spec, ";", &saveptr1); entry; entry = strtok_r(NULL, ";", &saveptr1)) {
+		adapter = strtol(entry, &end, 10);
+		if ((end == entry) || (*end != ':')) {
+			fprintf(stderr, "dvbvirtual: bad adapter specification \"%s\"\n", entry);
+			continue;
+		}
+
+		memset(&config, 0, sizeof(config));
+		config.rate = DVBVIRTUAL_RATE_PCR;
+		config.fe_type = DVBFE_TYPE_DVBT;
+		config.signal_strength = VIRTUAL_DEFAULT_SIGNAL_STRENGTH;
+		config.snr = VIRTUAL_DEFAULT_SNR;
+		config.filename = strtok_r(end + 1, ",", &saveptr2);
+
+		while((option = strtok_r(NULL, ",", &saveptr2)) != NULL) {
+			if (!strcmp(option, "rate=pcr")) {
+				config.rate = DVBVIRTUAL_RATE_PCR;
+			} else if (!strcmp(option, "rate=max")) {
+				config.rate = DVBVIRTUAL_RATE_UNTHROTTLED;
+			} else if (!strncmp(option, "rate=", 5)) {
+				config.rate = DVBVIRTUAL_RATE_FIXED;
+				config.bitrate = strtoul(option + 5, NULL, 10);
+			} else if (!strncmp(option, "lockdelay=", 10)) {
+				config.lock_delay_ms = atoi(option + 10);
+			} else if (!strcmp(option, "loop")) {
+				config.loop = 1;
+			} else if (!strcmp(option, "type=dvbs")) {
+				config.fe_type = DVBFE_TYPE_DVBS;
+			} else if (!strcmp(option, "type=dvbc")) {
+				config.fe_type = DVBFE_TYPE_DVBC;
+			} else if (!strcmp(option, "type=dvbt")) {
+				config.fe_type = DVBFE_TYPE_DVBT;
+			} else if (!strcmp(option, "type=atsc")) {
+				config.fe_type = DVBFE_TYPE_ATSC;
+			} else {
+				fprintf(stderr, "dvbvirtual: unknown option \"%s\"\n", option);
+			}
+		}
+
+		if (virtual_attach(adapter, &config))
+			fprintf(stderr, "dvbvirtual: failed to attach adapter %i\n", adapter);
+	}
+
+	free(spec);
+}
+
+static void virtual_crc_init(void)
+{
+	uint32_t crc;
+	int i;
+	int j;
+
+	for(i=0; i < 256; i++) {
+		crc = (uint32_t) i << 24;
+		for(j=0; j < 8; j++)
+			crc = (crc << 1) ^ ((crc & 0x80000000) ? 0x04c11db7 : 0);
+		virtual_crc_table[i] = crc;
+	}
+}
+
+static uint32_t virtual_crc32(uint8_t *buf, int len)
+{
+	uint32_t crc = 0xffffffff;
+
+	while(len--)
+		crc = (crc << 8) ^ virtual_crc_table[((crc >> 24) ^ *buf++) & 0xff];
+
+	return crc;
+}
+
+static uint64_t virtual_now_us(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec * 1000000ULL) + (now.tv_nsec / 1000);
+}
+
+// must be called with virtual_adapters_lock held
+static struct virtual_adapter *virtual_find_adapter(int adapter)
+{
+	struct virtual_adapter *va;
+
+	for(va = virtual_adapters; va; va = va->next) {
+		if (va->adapter == adapter)
+			return va;
+	}
+
+	return NULL;
+}
+
+// returns with the adapter's lock held if the handle was found
+static struct virtual_handle *virtual_find_handle(int fd, struct virtual_adapter **va_out)
+{
+	struct virtual_adapter *va;
+	struct virtual_handle *h;
+	struct stat st;
+
+	// the application closes demux fds itself, so check that the fd still
+	// refers to the socket we handed out and hasn't been reused
+	if (fstat(fd, &st))
+		return NULL;
+
+	pthread_mutex_lock(&virtual_adapters_lock);
+	for(va = virtual_adapters; va; va = va->next) {
+		pthread_mutex_lock(&va->lock);
+		for(h = va->handles; h; h = h->next) {
+			if (h->dead || (h->app_fd != fd))
+				continue;
+			if (h->app_ino != st.st_ino) {
+				h->dead = 1;
+				continue;
+			}
+
+			pthread_mutex_unlock(&virtual_adapters_lock);
+			*va_out = va;
+			return h;
+		}
+		pthread_mutex_unlock(&va->lock);
+	}
+	pthread_mutex_unlock(&virtual_adapters_lock);
+
+	return NULL;
+}
+
+static int virtual_open_handle(int adapter, enum virtual_kind kind, int socktype, int nonblocking)
+{
+	struct virtual_adapter *va;
+	struct virtual_handle *h = NULL;
+	struct stat st;
+	int sv[2];
+
+	pthread_mutex_lock(&virtual_adapters_lock);
+	if ((va = virtual_find_adapter(adapter)) == NULL) {
+		pthread_mutex_unlock(&virtual_adapters_lock);
+		errno = ENODEV;
+		return -1;
+	}
+
+	// setup the handle
+	h = malloc(sizeof(struct virtual_handle));
+	if (h == NULL)
+		goto error_exit;
+	memset(h, 0, sizeof(struct virtual_handle));
+	h->kind = kind;
+	h->cc = -1;
+	if ((h->buf = malloc(VIRTUAL_HANDLE_BUFFER_SIZE)) == NULL)
+		goto error_exit;
+	if (socketpair(AF_UNIX, socktype, 0, sv))
+		goto error_exit;
+	h->app_fd = sv[0];
+	h->fd = sv[1];
+	fcntl(h->fd, F_SETFL, O_NONBLOCK);
+	if (nonblocking)
+		fcntl(h->app_fd, F_SETFL, O_NONBLOCK);
+	fstat(h->app_fd, &st);
+	h->app_ino = st.st_ino;
+	virtual_update_max_chunk(h);
+
+	// add it, starting playback if this is the first
+	pthread_mutex_lock(&va->lock);
+	h->next = va->handles;
+	va->handles = h;
+	if (!va->thread_started) {
+		if (pthread_create(&va->thread, NULL, virtual_thread, va)) {
+			va->handles = h->next;
+			pthread_mutex_unlock(&va->lock);
+			close(h->app_fd);
+			close(h->fd);
+			goto error_exit;
+		}
+		va->thread_started = 1;
+	}
+	pthread_mutex_unlock(&va->lock);
+	pthread_mutex_unlock(&virtual_adapters_lock);
+
+	return h->app_fd;
+
+error_exit:
+	pthread_mutex_unlock(&virtual_adapters_lock);
+	if (h) {
+		free(h->buf);
+		free(h);
+	}
+	return -1;
+}
+
+// must be called with the adapter's lock held
+static int virtual_set_socktype(struct virtual_handle *h, int socktype)
+{
+	struct stat st;
+	socklen_t len = sizeof(int);
+	int cur;
+	int flags;
+	int sv[2];
+
+	if (getsockopt(h->fd, SOL_SOCKET, SO_TYPE, &cur, &len))
+		return -1;
+	if (cur == socktype)
+		return 0;
+
+	// sections need message boundaries, but TS/PES data is a byte stream
+	// which may be read in any size of chunk. Swap in a new socket under
+	// the application's fd number.
+	if (socketpair(AF_UNIX, socktype, 0, sv))
+		return -1;
+	flags = fcntl(h->app_fd, F_GETFL);
+	fcntl(sv[0], F_SETFL, flags & O_NONBLOCK);
+	fcntl(sv[1], F_SETFL, O_NONBLOCK);
+	if (h->sndbuf)
+		setsockopt(sv[1], SOL_SOCKET, SO_SNDBUF, &h->sndbuf, sizeof(int));
+	if (dup2(sv[0], h->app_fd) < 0) {
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+	close(sv[0]);
+	close(h->fd);
+	h->fd = sv[1];
+	fstat(h->app_fd, &st);
+	h->app_ino = st.st_ino;
+	virtual_update_max_chunk(h);
+
+	return 0;
+}
+
+static void virtual_update_max_chunk(struct virtual_handle *h)
+{
+	socklen_t len = sizeof(int);
+	int sndbuf;
+
+	// a unix stream socket accepts a write of up to half its buffer in a
+	// single piece, and only if it isn't already full - so such a write
+	// goes through either completely or not at all
+	h->max_chunk = VIRTUAL_PACKET_SIZE;
+	if (getsockopt(h->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len))
+		return;
+	sndbuf = ((sndbuf / 2) - 64) / VIRTUAL_PACKET_SIZE;
+	if (sndbuf > 1)
+		h->max_chunk = sndbuf * VIRTUAL_PACKET_SIZE;
+}
+
+// must be called with the adapter's lock held
+static void virtual_discard(struct virtual_handle *h)
+{
+	uint8_t buf[4096];
+
+	while(recv(h->app_fd, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+		;
+}
+
+// must be called with the adapter's lock held
+static int virtual_demux_ioctl(struct virtual_adapter *va, struct virtual_handle *h,
+			       unsigned long request, void *arg)
+{
+	struct dmx_sct_filter_params *sctfilter;
+	struct dmx_pes_filter_params *pesfilter;
+	struct dmx_stc *stc;
+	enum virtual_filter filter_type;
+
+	if ((h->kind == VIRTUAL_DVR) && (request != (unsigned long) DMX_SET_BUFFER_SIZE)) {
+		errno = ENOTTY;
+		return -1;
+	}
+
+	switch(request) {
+	case DMX_SET_FILTER:
+		sctfilter = (struct dmx_sct_filter_params *) arg;
+		if (sctfilter->pid >= VIRTUAL_PID_ALL)
+			goto invalid;
+		if (virtual_set_socktype(h, SOCK_SEQPACKET))
+			return -1;
+		h->filter_type = VIRTUAL_FILTER_SECTION;
+		h->pid = sctfilter->pid;
+		memcpy(h->filter, sctfilter->filter.filter, 16);
+		memcpy(h->mask, sctfilter->filter.mask, 16);
+		h->check_crc = (sctfilter->flags & DMX_CHECK_CRC) ? 1 : 0;
+		h->started = (sctfilter->flags & DMX_IMMEDIATE_START) ? 1 : 0;
+		break;
+
+	case DMX_SET_PES_FILTER:
+		pesfilter = (struct dmx_pes_filter_params *) arg;
+		if ((pesfilter->input != DMX_IN_FRONTEND) || (pesfilter->pid > VIRTUAL_PID_ALL))
+			goto invalid;
+		switch(pesfilter->output) {
+		case DMX_OUT_DECODER:
+			filter_type = VIRTUAL_FILTER_DECODER;
+			break;
+		case DMX_OUT_TAP:
+			filter_type = VIRTUAL_FILTER_PES;
+			break;
+		case DMX_OUT_TS_TAP:
+			filter_type = VIRTUAL_FILTER_DVR;
+			break;
+#ifdef DMX_OUT_TSDEMUX_TAP
+		case DMX_OUT_TSDEMUX_TAP:
+			filter_type = VIRTUAL_FILTER_TS;
+			break;
+#endif
+		default:
+			goto invalid;
+		}
+		if ((pesfilter->pid == VIRTUAL_PID_ALL) && (filter_type == VIRTUAL_FILTER_PES))
+			goto invalid;
+		if (virtual_set_socktype(h, SOCK_STREAM))
+			return -1;
+		h->filter_type = filter_type;
+		h->pid = pesfilter->pid;
+		h->started = (pesfilter->flags & DMX_IMMEDIATE_START) ? 1 : 0;
+		break;
+
+	case DMX_START:
+		if (h->filter_type == VIRTUAL_FILTER_NONE)
+			goto invalid;
+		h->started = 1;
+		break;
+
+	case DMX_STOP:
+		h->started = 0;
+		break;
+
+	case DMX_GET_STC:
+		stc = (struct dmx_stc *) arg;
+		if (!va->have_stc)
+			goto invalid;
+		stc->base = 1;
+		stc->stc = va->stc / 300;
+		return 0;
+
+	case DMX_SET_BUFFER_SIZE:
+		h->sndbuf = (int) (long) arg;
+		if (setsockopt(h->fd, SOL_SOCKET, SO_SNDBUF, &h->sndbuf, sizeof(int)))
+			return -1;
+		virtual_update_max_chunk(h);
+		return 0;
+
+	default:
+		errno = ENOTTY;
+		return -1;
+	}
+
+	// filter state has changed, so discard any partial data - and, as the
+	// kernel flushes its buffer when a filter starts, anything unread
+	h->cc = -1;
+	h->synced = 0;
+	h->buf_len = 0;
+	if (h->started)
+		virtual_discard(h);
+	pthread_cond_broadcast(&va->cond);
+	return 0;
+
+invalid:
+	errno = EINVAL;
+	return -1;
+}
+
+// must be called with the adapter's lock held
+static int virtual_frontend_ioctl(struct virtual_adapter *va, unsigned long request, void *arg)
+{
+	struct dvb_frontend_info *info;
+	struct dvb_frontend_event *event;
+	struct itimerspec timer;
+	uint64_t expirations;
+	fe_status_t status = virtual_fe_status(va);
+	int locked = (status & FE_HAS_LOCK) ? 1 : 0;
+
+	switch(request) {
+	case FE_GET_INFO:
+		info = (struct dvb_frontend_info *) arg;
+		memset(info, 0, sizeof(struct dvb_frontend_info));
+		snprintf(info->name, sizeof(info->name), "dvbapi virtual frontend");
+		switch(va->config.fe_type) {
+		case DVBFE_TYPE_DVBS:
+			info->type = FE_QPSK;
+			break;
+		case DVBFE_TYPE_DVBC:
+			info->type = FE_QAM;
+			break;
+		case DVBFE_TYPE_DVBT:
+			info->type = FE_OFDM;
+			break;
+		case DVBFE_TYPE_ATSC:
+			info->type = FE_ATSC;
+			break;
+		}
+		info->frequency_max = 0xffffffff;
+		info->symbol_rate_max = 0xffffffff;
+		info->caps = FE_CAN_INVERSION_AUTO | FE_CAN_FEC_AUTO | FE_CAN_QAM_AUTO |
+			     FE_CAN_TRANSMISSION_MODE_AUTO | FE_CAN_GUARD_INTERVAL_AUTO |
+			     FE_CAN_HIERARCHY_AUTO;
+		return 0;
+
+	case FE_SET_FRONTEND:
+		memcpy(&va->fe_params, arg, sizeof(struct dvb_frontend_parameters));
+		va->fe_tuned = 1;
+		va->fe_lock_time = virtual_now_us() + (va->config.lock_delay_ms * 1000ULL);
+
+		// arm the lock event (a zero timer would disarm it)
+		memset(&timer, 0, sizeof(timer));
+		timer.it_value.tv_sec = va->config.lock_delay_ms / 1000;
+		timer.it_value.tv_nsec = (va->config.lock_delay_ms % 1000) * 1000000;
+		if (va->config.lock_delay_ms == 0)
+			timer.it_value.tv_nsec = 1;
+		timerfd_settime(va->fe_fd, 0, &timer, NULL);
+		pthread_cond_broadcast(&va->cond);
+		return 0;
+
+	case FE_GET_FRONTEND:
+		if (!va->fe_tuned)
+			break;
+		memcpy(arg, &va->fe_params, sizeof(struct dvb_frontend_parameters));
+		return 0;
+
+	case FE_GET_EVENT:
+		if (read(va->fe_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+			errno = EWOULDBLOCK;
+			return -1;
+		}
+		event = (struct dvb_frontend_event *) arg;
+		event->status = status;
+		memcpy(&event->parameters, &va->fe_params, sizeof(struct dvb_frontend_parameters));
+		return 0;
+
+	case FE_READ_STATUS:
+		*((fe_status_t *) arg) = status;
+		return 0;
+
+	case FE_READ_BER:
+		*((uint32_t *) arg) = locked ? va->config.ber : 0;
+		return 0;
+
+	case FE_READ_SIGNAL_STRENGTH:
+		*((uint16_t *) arg) = locked ? va->config.signal_strength : 0;
+		return 0;
+
+	case FE_READ_SNR:
+		*((uint16_t *) arg) = locked ? va->config.snr : 0;
+		return 0;
+
+	case FE_READ_UNCORRECTED_BLOCKS:
+		*((uint32_t *) arg) = 0;
+		return 0;
+
+	case FE_SET_TONE:
+	case FE_SET_VOLTAGE:
+	case FE_ENABLE_HIGH_LNB_VOLTAGE:
+	case FE_DISEQC_SEND_BURST:
+	case FE_DISEQC_SEND_MASTER_CMD:
+	case FE_DISHNETWORK_SEND_LEGACY_CMD:
+		// there is no LNB to control
+		return 0;
+
+	default:
+		errno = ENOTTY;
+		return -1;
+	}
+
+	errno = EINVAL;
+	return -1;
+}
+
+static fe_status_t virtual_fe_status(struct virtual_adapter *va)
+{
+	if (!va->fe_tuned)
+		return 0;
+	if (virtual_now_us() < va->fe_lock_time)
+		return FE_HAS_SIGNAL;
+
+	return FE_HAS_SIGNAL | FE_HAS_CARRIER | FE_HAS_VITERBI | FE_HAS_SYNC | FE_HAS_LOCK;
+}
+
+static void *virtual_thread(void *arg)
+{
+	struct virtual_adapter *va = (struct virtual_adapter *) arg;
+	struct timespec wait;
+	uint8_t *buf;
+	int buf_size = VIRTUAL_READ_PACKETS * VIRTUAL_PACKET_SIZE;
+	int buf_len = 0;
+	int pos;
+	int count;
+	uint64_t now;
+
+	if ((buf = malloc(buf_size)) == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&va->lock);
+	while(!va->shutdown) {
+		virtual_reap_handles(va);
+
+		// wait until data is wanted - nothing flows once the file has ended
+		if (va->stats.eof || !virtual_wants_data(va)) {
+			pthread_cond_wait(&va->cond, &va->lock);
+			va->pcr_anchored = 0;
+			continue;
+		}
+
+		// and until the frontend has locked, if it has been tuned
+		now = virtual_now_us();
+		if ((va->fe_fd != -1) && va->fe_tuned && (now < va->fe_lock_time)) {
+			wait.tv_sec = va->fe_lock_time / 1000000;
+			wait.tv_nsec = (va->fe_lock_time % 1000000) * 1000;
+			pthread_cond_timedwait(&va->cond, &va->lock, &wait);
+			va->pcr_anchored = 0;
+			continue;
+		}
+
+		// read some more of the file
+		pthread_mutex_unlock(&va->lock);
+		count = read(va->file_fd, buf + buf_len, buf_size - buf_len);
+		pthread_mutex_lock(&va->lock);
+		if ((count < 0) && (errno == EINTR))
+			continue;
+		if (count <= 0) {
+			if (va->config.loop && (lseek(va->file_fd, 0, SEEK_SET) == 0)) {
+				va->stats.loops++;
+				va->pcr_anchored = 0;
+				va->fixed_packets = 0;
+				buf_len = 0;
+				continue;
+			}
+			va->stats.eof = 1;
+			virtual_flush(va);
+			continue;
+		}
+		buf_len += count;
+
+		// process all the complete packets in it
+		pos = 0;
+		while((buf_len - pos) >= VIRTUAL_PACKET_SIZE) {
+			if (buf[pos] != VIRTUAL_PACKET_SYNC) {
+				va->stats.skipped_bytes++;
+				pos++;
+				continue;
+			}
+
+			virtual_pace(va, buf + pos);
+			if (va->shutdown)
+				break;
+			virtual_deliver(va, buf + pos);
+			pos += VIRTUAL_PACKET_SIZE;
+		}
+		memmove(buf, buf + pos, buf_len - pos);
+		buf_len -= pos;
+
+		virtual_flush(va);
+	}
+	pthread_mutex_unlock(&va->lock);
+
+	free(buf);
+	return NULL;
+}
+
+// must be called with the adapter's lock held
+static int virtual_wants_data(struct virtual_adapter *va)
+{
+	struct virtual_handle *h;
+
+	for(h = va->handles; h; h = h->next) {
+		if ((h->kind == VIRTUAL_DEMUX) && !h->dead && h->started &&
+		    (h->filter_type != VIRTUAL_FILTER_DECODER))
+			return 1;
+	}
+
+	return 0;
+}
+
+// must be called with the adapter's lock held. Handles are only ever freed
+// here, so the playback thread may safely drop the lock while using them.
+static void virtual_reap_handles(struct virtual_adapter *va)
+{
+	struct virtual_handle **ph = &va->handles;
+	struct virtual_handle *h;
+	struct pollfd pollfd;
+
+	while((h = *ph) != NULL) {
+		// has the application closed its end?
+		pollfd.fd = h->fd;
+		pollfd.events = 0;
+		if ((poll(&pollfd, 1, 0) == 1) && (pollfd.revents & (POLLHUP | POLLERR)))
+			h->dead = 1;
+
+		if (!h->dead) {
+			ph = &h->next;
+			continue;
+		}
+
+		*ph = h->next;
+		close(h->fd);
+		free(h->buf);
+		free(h);
+	}
+}
+
+// must be called with the adapter's lock held
+static void virtual_pace(struct virtual_adapter *va, uint8_t *pkt)
+{
+	uint64_t pcr;
+	uint64_t target;
+	uint64_t now;
+	int pid;
+	int have_pcr = 0;
+
+	// track the PCR of the first PID carrying one, which also provides the STC
+	if ((pkt[3] & 0x20) && (pkt[4] >= 7) && (pkt[5] & 0x10)) {
+		pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+		if (va->pcr_pid == -1)
+			va->pcr_pid = pid;
+		if (pid == va->pcr_pid) {
+			pcr = ((uint64_t) pkt[6] << 25) | (pkt[7] << 17) | (pkt[8] << 9) | (pkt[9] << 1) | (pkt[10] >> 7);
+			pcr = (pcr * 300) + (((pkt[10] & 0x01) << 8) | pkt[11]);
+			va->stc = pcr;
+			va->have_stc = 1;
+			have_pcr = 1;
+		}
+	}
+
+	switch(va->config.rate) {
+	case DVBVIRTUAL_RATE_UNTHROTTLED:
+		break;
+
+	case DVBVIRTUAL_RATE_FIXED:
+		now = virtual_now_us();
+		if (!va->pcr_anchored) {
+			va->wall_anchor = now;
+			va->fixed_packets = 0;
+			va->pcr_anchored = 1;
+		}
+		target = va->wall_anchor +
+			((va->fixed_packets++ * VIRTUAL_PACKET_SIZE * 8 * 1000000ULL) / va->config.bitrate);
+		if (target > (now + 1000))
+			virtual_sleep_until(va, target);
+		else if ((now > target) && ((now - target) > VIRTUAL_MAX_LAG_US))
+			va->pcr_anchored = 0;
+		break;
+
+	case DVBVIRTUAL_RATE_PCR:
+		if (!have_pcr)
+			break;
+
+		// (re)start timing on the first PCR, or after a discontinuity
+		now = virtual_now_us();
+		if (!va->pcr_anchored ||
+		    (((va->stc + VIRTUAL_PCR_WRAP - va->pcr_last) % VIRTUAL_PCR_WRAP) > VIRTUAL_PCR_MAX_JUMP)) {
+			va->pcr_anchor = va->stc;
+			va->wall_anchor = now;
+			va->pcr_anchored = 1;
+		}
+		va->pcr_last = va->stc;
+
+		target = va->wall_anchor +
+			((((va->stc + VIRTUAL_PCR_WRAP - va->pcr_anchor) % VIRTUAL_PCR_WRAP) * 1000000ULL) / VIRTUAL_PCR_HZ);
+		if (target > now)
+			virtual_sleep_until(va, target);
+		else if ((now - target) > VIRTUAL_MAX_LAG_US)
+			va->pcr_anchored = 0;
+		break;
+	}
+}
+
+// must be called with the adapter's lock held
+static void virtual_sleep_until(struct virtual_adapter *va, uint64_t when)
+{
+	struct timespec wait;
+
+	// readers shouldn't have to wait for data while we sleep
+	virtual_flush(va);
+
+	wait.tv_sec = when / 1000000;
+	wait.tv_nsec = (when % 1000000) * 1000;
+	pthread_mutex_unlock(&va->lock);
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wait, NULL) == EINTR);
+	pthread_mutex_lock(&va->lock);
+}
+
+// must be called with the adapter's lock held
+static void virtual_deliver(struct virtual_adapter *va, uint8_t *pkt)
+{
+	struct virtual_handle *h;
+	int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+	int to_dvr = 0;
+
+	va->stats.packets++;
+
+	for(h = va->handles; h; h = h->next) {
+		if ((h->kind != VIRTUAL_DEMUX) || h->dead || !h->started)
+			continue;
+		if ((h->pid != pid) && (h->pid != VIRTUAL_PID_ALL))
+			continue;
+
+		switch(h->filter_type) {
+		case VIRTUAL_FILTER_SECTION:
+			virtual_section_packet(va, h, pkt);
+			break;
+		case VIRTUAL_FILTER_PES:
+			virtual_pes_packet(va, h, pkt);
+			break;
+		case VIRTUAL_FILTER_TS:
+			virtual_append(va, h, pkt, VIRTUAL_PACKET_SIZE);
+			break;
+		case VIRTUAL_FILTER_DVR:
+			to_dvr = 1;
+			break;
+		default:
+			break;
+		}
+	}
+
+	// all the DVR filters of an adapter share its DVR device
+	if (to_dvr) {
+		for(h = va->handles; h; h = h->next) {
+			if ((h->kind == VIRTUAL_DVR) && !h->dead)
+				virtual_append(va, h, pkt, VIRTUAL_PACKET_SIZE);
+		}
+	}
+}
+
+// must be called with the adapter's lock held
+static void virtual_section_packet(struct virtual_adapter *va, struct virtual_handle *h, uint8_t *pkt)
+{
+	uint8_t *payload = pkt + 4;
+	int len = VIRTUAL_PACKET_SIZE - 4;
+	int cc = pkt[3] & 0x0f;
+	int pointer;
+
+	// skip errored packets and any adaptation field
+	if (pkt[1] & 0x80)
+		return;
+	if (pkt[3] & 0x20) {
+		len -= pkt[4] + 1;
+		payload += pkt[4] + 1;
+	}
+	if (!(pkt[3] & 0x10) || (len <= 0))
+		return;
+
+	// a gap in the continuity counter loses any partial section
+	if (h->cc != -1) {
+		if (cc == h->cc)
+			return;
+		if (cc != ((h->cc + 1) & 0x0f))
+			h->synced = 0;
+	}
+	h->cc = cc;
+
+	if (pkt[1] & 0x40) {
+		pointer = payload[0];
+		payload++;
+		len--;
+		if (pointer > len) {
+			h->synced = 0;
+			return;
+		}
+
+		// finish off the previous section, then start afresh
+		if (h->synced)
+			virtual_section_data(va, h, payload, pointer);
+		payload += pointer;
+		len -= pointer;
+		h->buf_len = 0;
+		h->synced = 1;
+	}
+
+	if (h->synced)
+		virtual_section_data(va, h, payload, len);
+}
+
+// must be called with the adapter's lock held
+static void virtual_section_data(struct virtual_adapter *va, struct virtual_handle *h,
+				 uint8_t *data, int len)
+{
+	int section_len;
+
+	if ((h->buf_len + len) > VIRTUAL_HANDLE_BUFFER_SIZE) {
+		h->synced = 0;
+		h->buf_len = 0;
+		return;
+	}
+	memcpy(h->buf + h->buf_len, data, len);
+	h->buf_len += len;
+
+	while(h->buf_len >= 3) {
+		// stuffing means there are no more sections in this packet
+		if (h->buf[0] == 0xff) {
+			h->synced = 0;
+			h->buf_len = 0;
+			return;
+		}
+
+		section_len = 3 + (((h->buf[1] & 0x0f) << 8) | h->buf[2]);
+		if (h->buf_len < section_len)
+			return;
+
+		virtual_section(va, h, h->buf, section_len);
+		memmove(h->buf, h->buf + section_len, h->buf_len - section_len);
+		h->buf_len -= section_len;
+	}
+}
+
+// must be called with the adapter's lock held
+static void virtual_section(struct virtual_adapter *va, struct virtual_handle *h,
+			    uint8_t *section, int len)
+{
+	int pos;
+	int i;
+
+	// the filter skips the two length bytes
+	for(i=0; i < 16; i++) {
+		pos = i ? i + 2 : 0;
+		if (pos >= len)
+			break;
+		if ((section[pos] ^ h->filter[i]) & h->mask[i])
+			return;
+	}
+	if (h->check_crc && (section[1] & 0x80) && virtual_crc32(section, len))
+		return;
+
+	// sections are never waited for, just as the kernel would drop them
+	if (send(h->fd, section, len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == ENOBUFS))
+			va->stats.overflows++;
+		else if (errno != EINTR)
+			h->dead = 1;
+		return;
+	}
+	va->stats.sections++;
+}
+
+// must be called with the adapter's lock held
+static void virtual_pes_packet(struct virtual_adapter *va, struct virtual_handle *h, uint8_t *pkt)
+{
+	uint8_t *payload = pkt + 4;
+	int len = VIRTUAL_PACKET_SIZE - 4;
+	int cc = pkt[3] & 0x0f;
+
+	if (pkt[1] & 0x80)
+		return;
+	if (pkt[3] & 0x20) {
+		len -= pkt[4] + 1;
+		payload += pkt[4] + 1;
+	}
+	if (!(pkt[3] & 0x10) || (len <= 0))
+		return;
+
+	if (h->cc != -1) {
+		if (cc == h->cc)
+			return;
+		if (cc != ((h->cc + 1) & 0x0f))
+			h->synced = 0;
+	}
+	h->cc = cc;
+
+	// output starts at the beginning of a PES packet
+	if (pkt[1] & 0x40)
+		h->synced = 1;
+	if (h->synced)
+		virtual_append(va, h, payload, len);
+}
+
+// must be called with the adapter's lock held
+static void virtual_append(struct virtual_adapter *va, struct virtual_handle *h,
+			   uint8_t *data, int len)
+{
+	if ((h->buf_len + len) > VIRTUAL_HANDLE_BUFFER_SIZE)
+		virtual_flush_handle(va, h);
+
+	memcpy(h->buf + h->buf_len, data, len);
+	h->buf_len += len;
+}
+
+// must be called with the adapter's lock held
+static void virtual_flush(struct virtual_adapter *va)
+{
+	struct virtual_handle *h;
+
+	for(h = va->handles; h; h = h->next) {
+		if ((h->kind == VIRTUAL_DVR) ||
+		    (h->filter_type == VIRTUAL_FILTER_PES) ||
+		    (h->filter_type == VIRTUAL_FILTER_TS))
+			virtual_flush_handle(va, h);
+	}
+}
+
+// must be called with the adapter's lock held
+static void virtual_flush_handle(struct virtual_adapter *va, struct virtual_handle *h)
+{
+	int paced = va->config.rate != DVBVIRTUAL_RATE_UNTHROTTLED;
+	int len = h->buf_len;
+	int done = 0;
+	int count;
+	int end;
+
+	while(!h->dead && (done < len)) {
+		// when paced, a full buffer must lose whole packets just as the
+		// kernel would, rather than hold up playback
+		count = len - done;
+		if (paced && (count > h->max_chunk))
+			count = h->max_chunk;
+
+		count = send(h->fd, h->buf + done, count, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (count >= 0) {
+			done += count;
+			continue;
+		}
+
+		if (errno == EINTR)
+			continue;
+		if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+			h->dead = 1;
+			break;
+		}
+
+		if (paced) {
+			// finish off any partially sent packet so the reader
+			// stays aligned, then drop the rest
+			end = ((done + VIRTUAL_PACKET_SIZE - 1) / VIRTUAL_PACKET_SIZE) * VIRTUAL_PACKET_SIZE;
+			if (end > len)
+				end = len;
+			if (done == end) {
+				va->stats.overflows++;
+				break;
+			}
+			len = end;
+		}
+		if (virtual_wait_writable(va, h))
+			break;
+	}
+
+	va->stats.bytes += done;
+	h->buf_len = 0;
+}
+
+// must be called with the adapter's lock held. Returns nonzero if the write
+// should be abandoned.
+static int virtual_wait_writable(struct virtual_adapter *va, struct virtual_handle *h)
+{
+	struct pollfd pollfd;
+	int fd = h->fd;
+
+	pollfd.fd = fd;
+	pollfd.events = POLLOUT;
+
+	pthread_mutex_unlock(&va->lock);
+	poll(&pollfd, 1, 100);
+	pthread_mutex_lock(&va->lock);
+
+	// the filter may have been changed while we weren't looking
+	return va->shutdown || h->dead || (h->fd != fd) ||
+		((h->kind == VIRTUAL_DEMUX) && !h->started);
+}
@@ -0,0 +1,152 @@
+/*
+ * libdvbapi - virtual DVB adapters
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBVIRTUAL_H
+#define LIBDVBVIRTUAL_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include "dvbfe.h"
+
+/**
+ * A virtual adapter replaces /dev/dvb/adapterN with a frontend, demux and DVR
+ * emulated in userspace and fed from a transport stream file. Once an adapter
+ * number is attached, dvbfe_open(), dvbdemux_open_demux() and
+ * dvbdemux_open_dvr() for that adapter return virtual devices, and the rest of
+ * libdvbapi operates on them transparently. This allows the tools to be run,
+ * benchmarked and soak tested without any hardware.
+ *
+ * Virtual adapters may also be configured from the DVB_VIRTUAL_ADAPTER
+ * environment variable, which is read the first time any adapter is opened.
+ * It contains one or more semicolon separated entries of the form:
+ *
+ *   <adapter>:<filename>[,rate=pcr|max|<bits/s>][,lockdelay=<ms>][,loop]
+ *                       [,type=dvbs|dvbc|dvbt|atsc]
+ *
+ * e.g. DVB_VIRTUAL_ADAPTER="0:/tmp/mux.ts,rate=pcr,lockdelay=500,loop"
+ *
+ * Demux and DVR devices are unix sockets, so read() and poll() on them behave
+ * as usual. Section filters return one section per read(). When a buffer
+ * overflows the data is dropped and counted in the adapter statistics; unlike
+ * the kernel, read() does not return EOVERFLOW. CA devices are not emulated.
+ */
+
+/**
+ * How the transport stream file is paced.
+ */
+enum dvbvirtual_rate {
+	DVBVIRTUAL_RATE_PCR,		/* real-time, paced by the PCRs in the stream */
+	DVBVIRTUAL_RATE_UNTHROTTLED,	/* as fast as the readers consume it */
+	DVBVIRTUAL_RATE_FIXED,		/* at a constant bitrate */
+};
+
+/**
+ * Configuration of a virtual adapter.
+ */
+struct dvbvirtual_config {
+	char *filename;			/* transport stream to replay */
+	enum dvbvirtual_rate rate;
+	uint32_t bitrate;		/* bits/s, for DVBVIRTUAL_RATE_FIXED */
+	int loop;			/* if 1, restart at the end of the file */
+	enum dvbfe_type fe_type;	/* type of the emulated frontend */
+	int lock_delay_ms;		/* delay between tuning and lock */
+	uint16_t signal_strength;	/* reported once locked */
+	uint16_t snr;			/* reported once locked */
+	uint32_t ber;			/* reported once locked */
+};
+
+/**
+ * Statistics for a virtual adapter.
+ */
+struct dvbvirtual_stats {
+	uint64_t packets;		/* packets read from the file */
+	uint64_t skipped_bytes;		/* bytes discarded while searching for sync */
+	uint64_t sections;		/* sections delivered */
+	uint64_t bytes;			/* bytes delivered to TS/PES readers */
+	uint64_t overflows;		/* sections/packet batches dropped on full buffers */
+	uint32_t loops;			/* number of times the file restarted */
+	int eof;			/* 1 if the end of the file has been reached */
+};
+
+/**
+ * Attach a virtual adapter. Data starts flowing when the first demux or DVR
+ * device is opened (and, if the frontend has been tuned, once it has locked).
+ *
+ * @param adapter Adapter number to emulate.
+ * @param config The configuration. It is copied.
+ * @return 0 on success, nonzero on failure.
+ */
+extern int dvbvirtual_attach(int adapter, struct dvbvirtual_config *config);
+
+/**
+ * Detach a virtual adapter, stopping playback. Any devices still open on it
+ * will see end-of-file.
+ *
+ * @param adapter Adapter number.
+ */
+extern void dvbvirtual_detach(int adapter);
+
+/**
+ * Retrieve the statistics of a virtual adapter.
+ *
+ * @param adapter Adapter number.
+ * @param stats Will be filled in.
+ * @return 0 on success, -1 if the adapter is not virtual.
+ */
+extern int dvbvirtual_get_stats(int adapter, struct dvbvirtual_stats *stats);
+
+/**
+ * Determine whether an adapter is virtual.
+ *
+ * @param adapter Adapter number.
+ * @return 1 if so, 0 if not.
+ */
+extern int dvbvirtual_is_virtual(int adapter);
+
+/*
+ * The following are used by the rest of libdvbapi to redirect operations on
+ * virtual adapters. Applications should normally use the dvbfe and dvbdemux
+ * functions instead; dvbvirtual_ioctl() is only needed by those which issue
+ * raw ioctls on the device file descriptors themselves.
+ */
+
+extern int dvbvirtual_open_frontend(int adapter);
+extern int dvbvirtual_open_demux(int adapter, int nonblocking);
+extern int dvbvirtual_open_dvr(int adapter, int nonblocking);
+extern void dvbvirtual_close(int fd);
+
+/**
+ * Emulate an ioctl on a virtual device.
+ *
+ * @param fd The file descriptor.
+ * @param request The ioctl request (FE_* or DMX_*).
+ * @param arg The ioctl argument.
+ * @param result Set to the ioctl return value if the fd was virtual.
+ * @return 1 if the fd was virtual and the ioctl handled, 0 otherwise.
+ */
+extern int dvbvirtual_ioctl(int fd, unsigned long request, void *arg, int *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBDVBVIRTUAL_H
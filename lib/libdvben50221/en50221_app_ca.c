@@ -53,6 +53,31 @@ struct ca_pmt_descriptor {
 	struct ca_pmt_descriptor *next;
 };
 
+#define CA_PMT_PROGRAM_SENT	0x00
+#define CA_PMT_PROGRAM_ADDED	0x01
+#define CA_PMT_PROGRAM_UPDATED	0x02
+
+struct ca_pmt_program {
+	uint16_t program_number;
+	uint8_t version_number;
+	uint8_t current_next_indicator;
+	uint8_t ca_pmt_cmd_id;
+	uint32_t crc;
+	int state;		// one of CA_PMT_PROGRAM_*
+
+	uint8_t *ca_pmt;	// formatted CA PMT; ca_pmt_list_management is filled in when sent
+	uint32_t ca_pmt_length;
+
+	struct ca_pmt_program *next;
+};
+
+struct en50221_ca_pmt_list {
+	int move_ca_descriptors;
+	int resend_all;
+
+	struct ca_pmt_program *programs;
+};
+
 struct ca_pmt_stream {
 	uint8_t stream_type;
 	uint16_t pid;
@@ -65,6 +90,10 @@ struct ca_pmt_stream {
 
 static int en50221_ca_extract_pmt_descriptors(struct mpeg_pmt_section *pmt,
 					      struct ca_pmt_descriptor **outdescriptors);
+static int en50221_ca_pmt_list_send_program(struct en50221_app_ca *ca,
+					    uint16_t session_number,
+					    struct ca_pmt_program *program,
+					    uint8_t ca_pmt_list_management);
 static int en50221_ca_extract_streams(struct mpeg_pmt_section *pmt,
 				      struct ca_pmt_stream **outstreams);
 static void en50221_ca_try_move_pmt_descriptors(struct ca_pmt_descriptor **pmt_descriptors,
@@ -313,6 +342,186 @@ int en50221_ca_format_pmt(struct mpeg_pmt_section *pmt, uint8_t * data,
 
 
 
+struct en50221_ca_pmt_list *en50221_ca_pmt_list_create(int move_ca_descriptors)
+{
+	struct en50221_ca_pmt_list *list = NULL;
+
+	list = malloc(sizeof(struct en50221_ca_pmt_list));
+	if (list == NULL)
+		return NULL;
+
+	list->move_ca_descriptors = move_ca_descriptors;
+	list->resend_all = 1;
+	list->programs = NULL;
+	return list;
+}
+
+void en50221_ca_pmt_list_destroy(struct en50221_ca_pmt_list *list)
+{
+	struct ca_pmt_program *cur_p = list->programs;
+
+	while (cur_p) {
+		struct ca_pmt_program *next_p = cur_p->next;
+		free(cur_p->ca_pmt);
+		free(cur_p);
+		cur_p = next_p;
+	}
+	free(list);
+}
+
+int en50221_ca_pmt_list_set(struct en50221_ca_pmt_list *list,
+			    struct mpeg_pmt_section *pmt,
+			    uint8_t ca_pmt_cmd_id)
+{
+	struct ca_pmt_program *program;
+	struct ca_pmt_program *last_p = NULL;
+	uint16_t program_number = mpeg_pmt_section_program_number(pmt);
+	uint8_t *crc_buf = (uint8_t *) pmt + section_ext_length(&pmt->head);
+	uint32_t crc = (crc_buf[0] << 24) | (crc_buf[1] << 16) | (crc_buf[2] << 8) | crc_buf[3];
+
+	// find the program
+	program = list->programs;
+	while (program) {
+		if (program->program_number == program_number)
+			break;
+		last_p = program;
+		program = program->next;
+	}
+
+	// nothing to do if it hasn't changed
+	if (program &&
+	    (program->version_number == pmt->head.version_number) &&
+	    (program->current_next_indicator == pmt->head.current_next_indicator) &&
+	    (program->ca_pmt_cmd_id == ca_pmt_cmd_id) &&
+	    (program->crc == crc))
+		return 0;
+
+	// format it - the CA PMT is never much bigger than the PMT: it gains one
+	// ca_pmt_cmd_id per descriptor loop, but loses the PMT's PCR_PID and CRC
+	uint32_t max_length = section_ext_length(&pmt->head) + 8 +
+		(section_ext_length(&pmt->head) / 5);
+	uint8_t *ca_pmt = malloc(max_length);
+	if (ca_pmt == NULL)
+		return -1;
+	int size = en50221_ca_format_pmt(pmt, ca_pmt, max_length,
+					 list->move_ca_descriptors,
+					 CA_LIST_MANAGEMENT_ONLY, ca_pmt_cmd_id);
+	if (size < 0) {
+		free(ca_pmt);
+		return -1;
+	}
+
+	if (program == NULL) {
+		program = malloc(sizeof(struct ca_pmt_program));
+		if (program == NULL) {
+			free(ca_pmt);
+			return -1;
+		}
+		program->program_number = program_number;
+		program->ca_pmt = NULL;
+		program->state = CA_PMT_PROGRAM_ADDED;
+		program->next = NULL;
+
+		if (last_p)
+			last_p->next = program;
+		else
+			list->programs = program;
+	} else if (program->state == CA_PMT_PROGRAM_SENT) {
+		program->state = CA_PMT_PROGRAM_UPDATED;
+	}
+
+	free(program->ca_pmt);
+	program->ca_pmt = ca_pmt;
+	program->ca_pmt_length = size;
+	program->version_number = pmt->head.version_number;
+	program->current_next_indicator = pmt->head.current_next_indicator;
+	program->ca_pmt_cmd_id = ca_pmt_cmd_id;
+	program->crc = crc;
+	return 1;
+}
+
+int en50221_ca_pmt_list_remove(struct en50221_ca_pmt_list *list,
+			       uint16_t program_number)
+{
+	struct ca_pmt_program *cur_p = list->programs;
+	struct ca_pmt_program *prev_p = NULL;
+
+	while (cur_p) {
+		if (cur_p->program_number == program_number) {
+			if (prev_p)
+				prev_p->next = cur_p->next;
+			else
+				list->programs = cur_p->next;
+			free(cur_p->ca_pmt);
+			free(cur_p);
+
+			list->resend_all = 1;
+			return 0;
+		}
+		prev_p = cur_p;
+		cur_p = cur_p->next;
+	}
+
+	return -1;
+}
+
+void en50221_ca_pmt_list_reset(struct en50221_ca_pmt_list *list)
+{
+	list->resend_all = 1;
+}
+
+int en50221_ca_pmt_list_send(struct en50221_ca_pmt_list *list,
+			     struct en50221_app_ca *ca,
+			     uint16_t session_number)
+{
+	struct ca_pmt_program *cur_p;
+	uint8_t ca_pmt_list_management;
+	int count = 0;
+
+	if (list->resend_all) {
+		// the whole list, in order
+		for (cur_p = list->programs; cur_p; cur_p = cur_p->next) {
+			if (cur_p == list->programs) {
+				if (cur_p->next == NULL)
+					ca_pmt_list_management = CA_LIST_MANAGEMENT_ONLY;
+				else
+					ca_pmt_list_management = CA_LIST_MANAGEMENT_FIRST;
+			} else if (cur_p->next == NULL) {
+				ca_pmt_list_management = CA_LIST_MANAGEMENT_LAST;
+			} else {
+				ca_pmt_list_management = CA_LIST_MANAGEMENT_MORE;
+			}
+
+			if (en50221_ca_pmt_list_send_program(ca, session_number, cur_p,
+							     ca_pmt_list_management))
+				return -1;
+			count++;
+		}
+		list->resend_all = 0;
+		return count;
+	}
+
+	// just the changes
+	for (cur_p = list->programs; cur_p; cur_p = cur_p->next) {
+		switch(cur_p->state) {
+		case CA_PMT_PROGRAM_ADDED:
+			ca_pmt_list_management = CA_LIST_MANAGEMENT_ADD;
+			break;
+		case CA_PMT_PROGRAM_UPDATED:
+			ca_pmt_list_management = CA_LIST_MANAGEMENT_UPDATE;
+			break;
+		default:
+			continue;
+		}
+
+		if (en50221_ca_pmt_list_send_program(ca, session_number, cur_p,
+						     ca_pmt_list_management))
+			return -1;
+		count++;
+	}
+	return count;
+}
+
 static int en50221_ca_extract_pmt_descriptors(struct mpeg_pmt_section *pmt,
 					      struct ca_pmt_descriptor **outdescriptors)
 {
@@ -629,3 +838,16 @@ static int en50221_app_ca_parse_reply(struct en50221_app_ca *ca,
 	}
 	return 0;
 }
+
+static int en50221_ca_pmt_list_send_program(struct en50221_app_ca *ca,
+					    uint16_t session_number,
+					    struct ca_pmt_program *program,
+					    uint8_t ca_pmt_list_management)
+{
+	program->ca_pmt[0] = ca_pmt_list_management;
+	if (en50221_app_ca_pmt(ca, session_number, program->ca_pmt, program->ca_pmt_length))
+		return -1;
+
+	program->state = CA_PMT_PROGRAM_SENT;
+	return 0;
+}
@@ -208,6 +208,81 @@ extern int en50221_ca_format_pmt(struct mpeg_pmt_section *pmt,
 				 uint8_t ca_pmt_list_management,
 				 uint8_t ca_pmt_cmd_id);
 
+/**
+ * Opaque type representing the list of programs to be descrambled by a CAM,
+ * with each program's CA PMT kept formatted.
+ */
+struct en50221_ca_pmt_list;
+
+/**
+ * Create a CA PMT list. The list itself is not thread safe.
+ *
+ * @param move_ca_descriptors If non-zero, will attempt to move CA descriptors
+ * in order to reduce the size of the formatted CAPMTs.
+ * @return The list, or NULL on error.
+ */
+extern struct en50221_ca_pmt_list *en50221_ca_pmt_list_create(int move_ca_descriptors);
+
+/**
+ * Destroy a CA PMT list.
+ *
+ * @param list The list.
+ */
+extern void en50221_ca_pmt_list_destroy(struct en50221_ca_pmt_list *list);
+
+/**
+ * Add a program to the list, or update it. The PMT is only formatted if it
+ * differs from the one the program was last set with - i.e. its version,
+ * current_next_indicator or CRC, or the ca_pmt_cmd_id have changed.
+ *
+ * @param list The list.
+ * @param pmt The program's PMT.
+ * @param ca_pmt_cmd_id One of the CA_PMT_CMD_ID_*.
+ * @return 1 if the program was added or changed, 0 if there was no change, or
+ * -1 on error.
+ */
+extern int en50221_ca_pmt_list_set(struct en50221_ca_pmt_list *list,
+				   struct mpeg_pmt_section *pmt,
+				   uint8_t ca_pmt_cmd_id);
+
+/**
+ * Remove a program from the list. The whole list will be resent to the CAM
+ * on the next call to en50221_ca_pmt_list_send(), as that is how a program is
+ * removed. To stop descrambling the only program in the list, set it again with
+ * CA_PMT_CMD_ID_NOT_SELECTED instead.
+ *
+ * @param list The list.
+ * @param program_number The program to remove.
+ * @return 0 on success, or -1 if the program was not in the list.
+ */
+extern int en50221_ca_pmt_list_remove(struct en50221_ca_pmt_list *list,
+				      uint16_t program_number);
+
+/**
+ * Force the whole list to be resent on the next call to
+ * en50221_ca_pmt_list_send() - e.g. after the CA session is reconnected.
+ *
+ * @param list The list.
+ */
+extern void en50221_ca_pmt_list_reset(struct en50221_ca_pmt_list *list);
+
+/**
+ * Send any changes to the list to a CAM. The first time, or after a program
+ * has been removed, the whole list is sent (CA_LIST_MANAGEMENT_ONLY, or
+ * FIRST/MORE/LAST). Otherwise only new programs are sent with
+ * CA_LIST_MANAGEMENT_ADD and changed ones with CA_LIST_MANAGEMENT_UPDATE.
+ * The cached CA PMTs are sent as they are, with only their
+ * ca_pmt_list_management field filled in.
+ *
+ * @param list The list.
+ * @param ca ca resource instance.
+ * @param session_number Session number to send it on.
+ * @return Number of CA PMTs sent (0 if there were no changes), or -1 on failure.
+ */
+extern int en50221_ca_pmt_list_send(struct en50221_ca_pmt_list *list,
+				    struct en50221_app_ca *ca,
+				    uint16_t session_number);
+
 /**
  * Pass data received for this resource into it for parsing.
  *
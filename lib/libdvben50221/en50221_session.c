@@ -87,6 +87,10 @@ struct en50221_session_layer {
 	int error;
 
 	struct en50221_session *sessions;
+
+	// stack of idle session numbers, protected by global_lock
+	uint16_t *free_sessions;
+	uint32_t free_session_count;
 };
 
 static void en50221_sl_transport_callback(void *arg, int reason,
@@ -100,6 +104,8 @@ static int en50221_sl_alloc_new_session(struct en50221_session_layer *sl,
 					uint8_t connection_id,
 					en50221_sl_resource_callback
 					callback, void *arg);
+static void en50221_sl_session_idle(struct en50221_session_layer *sl,
+				    uint16_t session_number);
 
 
 
@@ -120,6 +126,9 @@ struct en50221_session_layer *en50221_sl_create(struct en50221_transport_layer *
 	sl->session = NULL;
 	sl->tl = tl;
 	sl->error = 0;
+	sl->sessions = NULL;
+	sl->free_sessions = NULL;
+	sl->free_session_count = 0;
 
 	// init the mutex
 	pthread_mutex_init(&sl->global_lock, NULL);
@@ -138,6 +147,15 @@ struct en50221_session_layer *en50221_sl_create(struct en50221_transport_layer *
 		pthread_mutex_init(&sl->sessions[i].session_lock, NULL);
 	}
 
+	// all sessions apart from 0 (which is not a valid session number) start
+	// off free, with the lowest numbers handed out first
+	sl->free_sessions = malloc(sizeof(uint16_t) * max_sessions);
+	if (sl->free_sessions == NULL)
+		goto error_exit;
+	for (i = max_sessions - 1; i >= 1; i--) {
+		sl->free_sessions[sl->free_session_count++] = i;
+	}
+
 	// register ourselves with the transport layer
 	en50221_tl_register_callback(tl, en50221_sl_transport_callback, sl);
 
@@ -159,6 +177,9 @@ void en50221_sl_destroy(struct en50221_session_layer *sl)
 			}
 			free(sl->sessions);
 		}
+		if (sl->free_sessions) {
+			free(sl->free_sessions);
+		}
 
 		pthread_mutex_destroy(&sl->setcallback_lock);
 		pthread_mutex_destroy(&sl->global_lock);
@@ -198,16 +219,13 @@ int en50221_sl_create_session(struct en50221_session_layer *sl,
 			      en50221_sl_resource_callback callback,
 			      void *arg)
 {
-	// lookup next free session_id:
-	pthread_mutex_lock(&sl->global_lock);
+	// get a free session_id
 	int session_number =
 	    en50221_sl_alloc_new_session(sl, resource_id, slot_id,
 					 connection_id, callback, arg);
 	if (session_number == -1) {
-		pthread_mutex_unlock(&sl->global_lock);
 		return -1;
 	}
-	pthread_mutex_unlock(&sl->global_lock);
 
 	// make up the header
 	uint8_t hdr[8];
@@ -224,7 +242,7 @@ int en50221_sl_create_session(struct en50221_session_layer *sl,
 	if (en50221_tl_send_data(sl->tl, slot_id, connection_id, hdr, 8)) {
 		pthread_mutex_lock(&sl->sessions[session_number].session_lock);
 		if (sl->sessions[session_number].state == S_STATE_IN_CREATION) {
-			sl->sessions[session_number].state = S_STATE_IDLE;
+			en50221_sl_session_idle(sl, session_number);
 		}
 		pthread_mutex_unlock(&sl->sessions[session_number].session_lock);
 
@@ -266,7 +284,7 @@ int en50221_sl_destroy_session(struct en50221_session_layer *sl,
 	if (en50221_tl_send_data(sl->tl, slot_id, connection_id, hdr, 4)) {
 		pthread_mutex_lock(&sl->sessions[session_number].session_lock);
 		if (sl->sessions[session_number].state == S_STATE_IN_DELETION) {
-			sl->sessions[session_number].state = S_STATE_IDLE;
+			en50221_sl_session_idle(sl, session_number);
 		}
 		pthread_mutex_unlock(&sl->sessions[session_number].session_lock);
 
@@ -455,14 +473,12 @@ static void en50221_sl_handle_open_session_request(struct en50221_session_layer
 	// if we found it, get a new session for it
 	int session_number = -1;
 	if (status == S_STATUS_OPEN) {
-		// lookup next free session_id:
-		pthread_mutex_lock(&sl->global_lock);
+		// get a free session_id
 		session_number =
 		    en50221_sl_alloc_new_session(sl, connected_resource_id,
 						 slot_id, connection_id,
 						 resource_callback,
 						 resource_arg);
-		pthread_mutex_unlock(&sl->global_lock);
 
 		if (session_number == -1) {
 			status = S_STATUS_CLOSE_NO_RES;
@@ -506,7 +522,7 @@ static void en50221_sl_handle_open_session_request(struct en50221_session_layer
 		// setup session state apppropriately from upper layer response
 		pthread_mutex_lock(&sl->sessions[session_number].session_lock);
 		if (status != S_STATUS_OPEN) {
-			sl->sessions[session_number].state = S_STATE_IDLE;
+			en50221_sl_session_idle(sl, session_number);
 		} else {
 			sl->sessions[session_number].state = S_STATE_ACTIVE;
 		}
@@ -526,8 +542,7 @@ static void en50221_sl_handle_open_session_request(struct en50221_session_layer
 					   slot_id, session_number,
 					   connected_resource_id);
 			} else {
-				sl->sessions[session_number].state =
-				    S_STATE_IDLE;
+				en50221_sl_session_idle(sl, session_number);
 				if (cb)
 					cb(cb_arg,
 					   S_SCALLBACK_REASON_CAMCONNECTFAIL,
@@ -590,7 +605,7 @@ static void en50221_sl_handle_close_session_request(struct en50221_session_layer
 		}
 
 		if (code == 0x00) {
-			sl->sessions[session_number].state = S_STATE_IDLE;
+			en50221_sl_session_idle(sl, session_number);
 			code = 0x00;	// close ok
 		}
 		resource_id = sl->sessions[session_number].resource_id;
@@ -679,7 +694,7 @@ static void en50221_sl_handle_create_session_response(struct en50221_session_lay
 	if (data[1] != S_STATUS_OPEN) {
 		print(LOG_LEVEL, ERROR, 1,
 		      "Session creation failed 0x%02x\n", data[1]);
-		sl->sessions[session_number].state = S_STATE_IDLE;
+		en50221_sl_session_idle(sl, session_number);
 		pthread_mutex_unlock(&sl->sessions[session_number].session_lock);
 
 		// inform upper layers
@@ -764,7 +779,7 @@ static void en50221_sl_handle_close_session_response(struct en50221_session_laye
 		// just fallthrough anyway
 	}
 	// completed
-	sl->sessions[session_number].state = S_STATE_IDLE;
+	en50221_sl_session_idle(sl, session_number);
 	pthread_mutex_unlock(&sl->sessions[session_number].session_lock);
 }
 
@@ -928,7 +943,7 @@ static void en50221_sl_transport_callback(void *arg, int reason,
 				continue;
 			}
 
-			sl->sessions[i].state = S_STATE_IDLE;
+			en50221_sl_session_idle(sl, i);
 
 			uint8_t _slot_id = sl->sessions[i].slot_id;
 			uint32_t resource_id = sl->sessions[i].resource_id;
@@ -958,7 +973,7 @@ static void en50221_sl_transport_callback(void *arg, int reason,
 				pthread_mutex_unlock(&sl->sessions[i].session_lock);
 				continue;
 			}
-			sl->sessions[i].state = S_STATE_IDLE;
+			en50221_sl_session_idle(sl, i);
 
 			uint32_t resource_id = sl->sessions[i].resource_id;
 			pthread_mutex_unlock(&sl->sessions[i].session_lock);
@@ -1030,26 +1045,41 @@ static int en50221_sl_alloc_new_session(struct en50221_session_layer *sl,
 					en50221_sl_resource_callback
 					callback, void *arg)
 {
-	int session_number = -1;
-	uint32_t i;
-	for (i = 1; i < sl->max_sessions; i++) {
-		if (sl->sessions[i].state == S_STATE_IDLE) {
-			session_number = i;
-			break;
-		}
-	}
-	if (session_number == -1) {
+	int session_number;
+
+	pthread_mutex_lock(&sl->global_lock);
+	if (sl->free_session_count == 0) {
+		pthread_mutex_unlock(&sl->global_lock);
 		sl->error = EN50221ERR_OUTOFSESSIONS;
 		return -1;
 	}
-	// setup the session
+	session_number = sl->free_sessions[--sl->free_session_count];
+	pthread_mutex_unlock(&sl->global_lock);
+
+	// setup the session - the lock is taken since the previous owner may
+	// still be finishing up with it after returning it to the free list
+	pthread_mutex_lock(&sl->sessions[session_number].session_lock);
 	sl->sessions[session_number].state = S_STATE_IN_CREATION;
 	sl->sessions[session_number].resource_id = resource_id;
 	sl->sessions[session_number].slot_id = slot_id;
 	sl->sessions[session_number].connection_id = connection_id;
 	sl->sessions[session_number].callback = callback;
 	sl->sessions[session_number].callback_arg = arg;
+	pthread_mutex_unlock(&sl->sessions[session_number].session_lock);
 
 	// ok
 	return session_number;
 }
+
+// mark a session idle, and return it to the free list if it wasn't already
+static void en50221_sl_session_idle(struct en50221_session_layer *sl,
+				    uint16_t session_number)
+{
+	if (sl->sessions[session_number].state == S_STATE_IDLE)
+		return;
+	sl->sessions[session_number].state = S_STATE_IDLE;
+
+	pthread_mutex_lock(&sl->global_lock);
+	sl->free_sessions[sl->free_session_count++] = session_number;
+	pthread_mutex_unlock(&sl->global_lock);
+}
@@ -24,6 +24,7 @@
 #include <limits.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/poll.h>
 #include <libdvbapi/dvbca.h>
 #include "en50221_stdcam.h"
 
@@ -52,3 +53,24 @@ struct en50221_stdcam *en50221_stdcam_create(int adapter, int slotnum,
 		close(cafd);
 	return result;
 }
+
+#define STDCAM_MAX_POLLFDS 32
+
+enum en50221_stdcam_status en50221_stdcam_wait(struct en50221_stdcam *stdcam, int max_wait)
+{
+	struct pollfd fds[STDCAM_MAX_POLLFDS];
+	int timeout;
+	int count;
+
+	count = stdcam->get_pollfds(stdcam, fds, STDCAM_MAX_POLLFDS, &timeout);
+	if ((timeout < 0) || (timeout > max_wait))
+		timeout = max_wait;
+
+	if (poll(fds, count, timeout) < 0) {
+		if (errno != EINTR)
+			return EN50221_STDCAM_CAM_BAD;
+		count = 0;
+	}
+
+	return stdcam->process(stdcam, fds, count);
+}
@@ -58,6 +58,14 @@ struct en50221_stdcam {
 
 	/* destroy the stdcam instance */
 	void (*destroy)(struct en50221_stdcam *stdcam, int closefd);
+
+	/* event driven alternative to poll: get the fds to wait on, returning how
+	 * many were filled out, and the timeout in ms until process must be called
+	 * even if nothing happens on them. */
+	int (*get_pollfds)(struct en50221_stdcam *stdcam, struct pollfd *fds, int max_fds, int *timeout);
+
+	/* process the events on the fds from get_pollfds, and any expired timers */
+	enum en50221_stdcam_status (*process)(struct en50221_stdcam *stdcam, struct pollfd *fds, int count);
 };
 
 /**
@@ -95,6 +103,16 @@ extern struct en50221_stdcam *en50221_stdcam_create(int adapter, int slotnum,
 						    struct en50221_transport_layer *tl,
 						    struct en50221_session_layer *sl);
 
+/**
+ * Convenience method to wait for and process events on a STDCAM using its
+ * get_pollfds and process methods, rather than busy polling it.
+ *
+ * @param stdcam The en50221_stdcam instance.
+ * @param max_wait Maximum time to wait in ms, e.g. so the caller can check a shutdown flag.
+ * @return One of the EN50221_STDCAM_CAM_* values.
+ */
+extern enum en50221_stdcam_status en50221_stdcam_wait(struct en50221_stdcam *stdcam, int max_wait);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,6 +29,7 @@
 #include "en50221_app_tags.h"
 #include "en50221_stdcam.h"
 
+#define HLCI_CAMSTATE_INTERVAL_MS 250
 
 struct en50221_stdcam_hlci {
 	struct en50221_stdcam stdcam;
@@ -41,6 +42,9 @@ struct en50221_stdcam_hlci {
 
 static void en50221_stdcam_hlci_destroy(struct en50221_stdcam *stdcam, int closefd);
 static enum en50221_stdcam_status en50221_stdcam_hlci_poll(struct en50221_stdcam *stdcam);
+static int en50221_stdcam_hlci_get_pollfds(struct en50221_stdcam *stdcam, struct pollfd *fds, int max_fds, int *timeout);
+static enum en50221_stdcam_status en50221_stdcam_hlci_process(struct en50221_stdcam *stdcam, struct pollfd *fds, int count);
+static void hlci_check_cam(struct en50221_stdcam_hlci *hlci);
 static int hlci_cam_added(struct en50221_stdcam_hlci *hlci);
 static int hlci_send_data(void *arg, uint16_t session_number,
 			  uint8_t * data, uint16_t data_length);
@@ -76,6 +80,8 @@ struct en50221_stdcam *en50221_stdcam_hlci_create(int cafd, int slotnum)
 	// done
 	hlci->stdcam.destroy = en50221_stdcam_hlci_destroy;
 	hlci->stdcam.poll = en50221_stdcam_hlci_poll;
+	hlci->stdcam.get_pollfds = en50221_stdcam_hlci_get_pollfds;
+	hlci->stdcam.process = en50221_stdcam_hlci_process;
 	hlci->slotnum = slotnum;
 	hlci->cafd = cafd;
 	return &hlci->stdcam;
@@ -102,6 +108,44 @@ static enum en50221_stdcam_status en50221_stdcam_hlci_poll(struct en50221_stdcam
 {
 	struct en50221_stdcam_hlci *hlci = (struct en50221_stdcam_hlci *) stdcam;
 
+	hlci_check_cam(hlci);
+
+	// delay to prevent busy loop
+	usleep(10);
+
+	if (!hlci->initialised) {
+		return EN50221_STDCAM_CAM_NONE;
+	}
+	return EN50221_STDCAM_CAM_OK;
+}
+
+static int en50221_stdcam_hlci_get_pollfds(struct en50221_stdcam *stdcam, struct pollfd *fds, int max_fds, int *timeout)
+{
+	(void) stdcam;
+	(void) fds;
+	(void) max_fds;
+
+	// HLCI messages are read synchronously, so there is only the CAM state to watch
+	*timeout = HLCI_CAMSTATE_INTERVAL_MS;
+	return 0;
+}
+
+static enum en50221_stdcam_status en50221_stdcam_hlci_process(struct en50221_stdcam *stdcam, struct pollfd *fds, int count)
+{
+	struct en50221_stdcam_hlci *hlci = (struct en50221_stdcam_hlci *) stdcam;
+	(void) fds;
+	(void) count;
+
+	hlci_check_cam(hlci);
+
+	if (!hlci->initialised) {
+		return EN50221_STDCAM_CAM_NONE;
+	}
+	return EN50221_STDCAM_CAM_OK;
+}
+
+static void hlci_check_cam(struct en50221_stdcam_hlci *hlci)
+{
 	switch(dvbca_get_cam_state(hlci->cafd, hlci->slotnum)) {
 	case DVBCA_CAMSTATE_MISSING:
 		hlci->initialised = 0;
@@ -113,14 +157,6 @@ static enum en50221_stdcam_status en50221_stdcam_hlci_poll(struct en50221_stdcam
 			hlci_cam_added(hlci);
 		break;
 	}
-
-	// delay to prevent busy loop
-	usleep(10);
-
-	if (!hlci->initialised) {
-		return EN50221_STDCAM_CAM_NONE;
-	}
-	return EN50221_STDCAM_CAM_OK;
 }
 
 
@@ -190,27 +226,5 @@ static int hlci_send_datav(void *arg, uint16_t session_number,
 	(void) session_number;
 	struct en50221_stdcam_hlci *hlci = arg;
 
-	// calculate the total length of the data to send
-	uint32_t data_size = 0;
-	int i;
-	for (i = 0; i < iov_count; i++) {
-		data_size += vector[i].iov_len;
-	}
-
-	// allocate memory for it
-	uint8_t *buf = malloc(data_size);
-	if (buf == NULL) {
-		return -1;
-	}
-	// merge the iovecs
-	uint32_t pos = 0;
-	for (i = 0; i < iov_count; i++) {
-		memcpy(buf + pos, vector[i].iov_base, vector[i].iov_len);
-		pos += vector[i].iov_len;
-	}
-
-	// sendit and cleanup
-	int status = dvbca_hlci_write(hlci->cafd, buf, data_size);
-	free(buf);
-	return status;
+	return dvbca_hlci_writev(hlci->cafd, vector, iov_count);
 }
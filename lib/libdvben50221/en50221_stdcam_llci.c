@@ -34,6 +34,7 @@
 
 #define LLCI_RESPONSE_TIMEOUT_MS 1000
 #define LLCI_POLL_DELAY_MS 100
+#define LLCI_CAMSTATE_INTERVAL_MS 250
 
 /* resource IDs we support */
 static uint32_t resource_ids[] =
@@ -45,6 +46,15 @@ static uint32_t resource_ids[] =
 };
 #define RESOURCE_IDS_COUNT sizeof(resource_ids)/4
 
+/* indexes of the above in llci->resources[] */
+#define RESOURCE_IDX_RM		0
+#define RESOURCE_IDX_CA		1
+#define RESOURCE_IDX_AI		2
+#define RESOURCE_IDX_MMI	3
+#define RESOURCE_IDX_DATETIME	4
+
+#define RESOURCE_VERSION_MASK 0x3f
+
 struct llci_resource {
 	struct en50221_app_public_resource_id resid;
 	uint32_t binary_resource_id;
@@ -73,14 +83,20 @@ struct en50221_stdcam_llci {
 	uint8_t datetime_response_interval;
 	time_t datetime_next_send;
 	time_t datetime_dvbtime;
+
+	uint64_t camstate_next_check;
 };
 
 static enum en50221_stdcam_status en50221_stdcam_llci_poll(struct en50221_stdcam *stdcam);
+static int en50221_stdcam_llci_get_pollfds(struct en50221_stdcam *stdcam, struct pollfd *fds, int max_fds, int *timeout);
+static enum en50221_stdcam_status en50221_stdcam_llci_process(struct en50221_stdcam *stdcam, struct pollfd *fds, int count);
 static void en50221_stdcam_llci_dvbtime(struct en50221_stdcam *stdcam, time_t dvbtime);
 static void en50221_stdcam_llci_destroy(struct en50221_stdcam *stdcam, int closefd);
 static void llci_cam_added(struct en50221_stdcam_llci *llci);
 static void llci_cam_in_reset(struct en50221_stdcam_llci *llci);
 static void llci_cam_removed(struct en50221_stdcam_llci *llci);
+static void llci_check_cam(struct en50221_stdcam_llci *llci);
+static void llci_send_datetime(struct en50221_stdcam_llci *llci);
 
 
 static int llci_lookup_callback(void *arg, uint8_t _slot_id, uint32_t requested_resource_id,
@@ -112,25 +128,22 @@ struct en50221_stdcam *en50221_stdcam_llci_create(int cafd, int slotnum,
 	llci->sendfuncs.send_datav = (en50221_send_datav) en50221_sl_send_datav;
 
 	// create the resource manager resource
-	int resource_idx = 0;
 	llci->rm_resource = en50221_app_rm_create(&llci->sendfuncs);
-	en50221_app_decode_public_resource_id(&llci->resources[resource_idx].resid, EN50221_APP_RM_RESOURCEID);
-	llci->resources[resource_idx].binary_resource_id = EN50221_APP_RM_RESOURCEID;
-	llci->resources[resource_idx].callback = (en50221_sl_resource_callback) en50221_app_rm_message;
-	llci->resources[resource_idx].arg = llci->rm_resource;
+	en50221_app_decode_public_resource_id(&llci->resources[RESOURCE_IDX_RM].resid, EN50221_APP_RM_RESOURCEID);
+	llci->resources[RESOURCE_IDX_RM].binary_resource_id = EN50221_APP_RM_RESOURCEID;
+	llci->resources[RESOURCE_IDX_RM].callback = (en50221_sl_resource_callback) en50221_app_rm_message;
+	llci->resources[RESOURCE_IDX_RM].arg = llci->rm_resource;
 	en50221_app_rm_register_enq_callback(llci->rm_resource, llci_rm_enq_callback, llci);
 	en50221_app_rm_register_reply_callback(llci->rm_resource, llci_rm_reply_callback, llci);
 	en50221_app_rm_register_changed_callback(llci->rm_resource, llci_rm_changed_callback, llci);
-	resource_idx++;
 
 	// create the datetime resource
 	llci->datetime_resource = en50221_app_datetime_create(&llci->sendfuncs);
-	en50221_app_decode_public_resource_id(&llci->resources[resource_idx].resid, EN50221_APP_DATETIME_RESOURCEID);
-	llci->resources[resource_idx].binary_resource_id = EN50221_APP_DATETIME_RESOURCEID;
-	llci->resources[resource_idx].callback = (en50221_sl_resource_callback) en50221_app_datetime_message;
-	llci->resources[resource_idx].arg = llci->datetime_resource;
+	en50221_app_decode_public_resource_id(&llci->resources[RESOURCE_IDX_DATETIME].resid, EN50221_APP_DATETIME_RESOURCEID);
+	llci->resources[RESOURCE_IDX_DATETIME].binary_resource_id = EN50221_APP_DATETIME_RESOURCEID;
+	llci->resources[RESOURCE_IDX_DATETIME].callback = (en50221_sl_resource_callback) en50221_app_datetime_message;
+	llci->resources[RESOURCE_IDX_DATETIME].arg = llci->datetime_resource;
 	en50221_app_datetime_register_enquiry_callback(llci->datetime_resource, llci_datetime_enquiry_callback, llci);
-	resource_idx++;
 	llci->datetime_session_number = -1;
 	llci->datetime_response_interval = 0;
 	llci->datetime_next_send = 0;
@@ -138,30 +151,27 @@ struct en50221_stdcam *en50221_stdcam_llci_create(int cafd, int slotnum,
 
 	// create the application information resource
 	llci->stdcam.ai_resource = en50221_app_ai_create(&llci->sendfuncs);
-	en50221_app_decode_public_resource_id(&llci->resources[resource_idx].resid, EN50221_APP_AI_RESOURCEID);
-	llci->resources[resource_idx].binary_resource_id = EN50221_APP_AI_RESOURCEID;
-	llci->resources[resource_idx].callback = (en50221_sl_resource_callback) en50221_app_ai_message;
-	llci->resources[resource_idx].arg = llci->stdcam.ai_resource;
+	en50221_app_decode_public_resource_id(&llci->resources[RESOURCE_IDX_AI].resid, EN50221_APP_AI_RESOURCEID);
+	llci->resources[RESOURCE_IDX_AI].binary_resource_id = EN50221_APP_AI_RESOURCEID;
+	llci->resources[RESOURCE_IDX_AI].callback = (en50221_sl_resource_callback) en50221_app_ai_message;
+	llci->resources[RESOURCE_IDX_AI].arg = llci->stdcam.ai_resource;
 	llci->stdcam.ai_session_number = -1;
-	resource_idx++;
 
 	// create the CA resource
 	llci->stdcam.ca_resource = en50221_app_ca_create(&llci->sendfuncs);
-	en50221_app_decode_public_resource_id(&llci->resources[resource_idx].resid, EN50221_APP_CA_RESOURCEID);
-	llci->resources[resource_idx].binary_resource_id = EN50221_APP_CA_RESOURCEID;
-	llci->resources[resource_idx].callback = (en50221_sl_resource_callback) en50221_app_ca_message;
-	llci->resources[resource_idx].arg = llci->stdcam.ca_resource;
+	en50221_app_decode_public_resource_id(&llci->resources[RESOURCE_IDX_CA].resid, EN50221_APP_CA_RESOURCEID);
+	llci->resources[RESOURCE_IDX_CA].binary_resource_id = EN50221_APP_CA_RESOURCEID;
+	llci->resources[RESOURCE_IDX_CA].callback = (en50221_sl_resource_callback) en50221_app_ca_message;
+	llci->resources[RESOURCE_IDX_CA].arg = llci->stdcam.ca_resource;
 	llci->stdcam.ca_session_number = -1;
-	resource_idx++;
 
 	// create the MMI resource
 	llci->stdcam.mmi_resource = en50221_app_mmi_create(&llci->sendfuncs);
-	en50221_app_decode_public_resource_id(&llci->resources[resource_idx].resid, EN50221_APP_MMI_RESOURCEID);
-	llci->resources[resource_idx].binary_resource_id = EN50221_APP_MMI_RESOURCEID;
-	llci->resources[resource_idx].callback = (en50221_sl_resource_callback) en50221_app_mmi_message;
-	llci->resources[resource_idx].arg = llci->stdcam.mmi_resource;
+	en50221_app_decode_public_resource_id(&llci->resources[RESOURCE_IDX_MMI].resid, EN50221_APP_MMI_RESOURCEID);
+	llci->resources[RESOURCE_IDX_MMI].binary_resource_id = EN50221_APP_MMI_RESOURCEID;
+	llci->resources[RESOURCE_IDX_MMI].callback = (en50221_sl_resource_callback) en50221_app_mmi_message;
+	llci->resources[RESOURCE_IDX_MMI].arg = llci->stdcam.mmi_resource;
 	llci->stdcam.mmi_session_number = -1;
-	resource_idx++;
 
 	// register session layer callbacks
 	en50221_sl_register_lookup_callback(sl, llci_lookup_callback, llci);
@@ -170,6 +180,8 @@ struct en50221_stdcam *en50221_stdcam_llci_create(int cafd, int slotnum,
 	// done
 	llci->stdcam.destroy = en50221_stdcam_llci_destroy;
 	llci->stdcam.poll = en50221_stdcam_llci_poll;
+	llci->stdcam.get_pollfds = en50221_stdcam_llci_get_pollfds;
+	llci->stdcam.process = en50221_stdcam_llci_process;
 	llci->stdcam.dvbtime = en50221_stdcam_llci_dvbtime;
 	llci->cafd = cafd;
 	llci->slotnum = slotnum;
@@ -219,6 +231,76 @@ static enum en50221_stdcam_status en50221_stdcam_llci_poll(struct en50221_stdcam
 {
 	struct en50221_stdcam_llci *llci = (struct en50221_stdcam_llci *) stdcam;
 
+	llci_check_cam(llci);
+
+	// poll the stack
+	int error;
+	if ((error = en50221_tl_poll(llci->tl)) != 0) {
+		print(LOG_LEVEL, ERROR, 1, "Error reported by stack:%i\n", en50221_tl_get_error(llci->tl));
+	}
+
+	llci_send_datetime(llci);
+
+	return llci->state;
+}
+
+static int en50221_stdcam_llci_get_pollfds(struct en50221_stdcam *stdcam, struct pollfd *fds, int max_fds, int *timeout)
+{
+	struct en50221_stdcam_llci *llci = (struct en50221_stdcam_llci *) stdcam;
+	uint64_t now = time_now_ms();
+	int next;
+
+	// when the CAM state next needs checking
+	next = 0;
+	if (llci->camstate_next_check > now)
+		next = llci->camstate_next_check - now;
+
+	// when the stack next needs to poll a module or check for a timeout
+	int tl_timeout = en50221_tl_get_timeout(llci->tl);
+	if ((tl_timeout >= 0) && (tl_timeout < next))
+		next = tl_timeout;
+
+	// when the next date/time response is due
+	if ((llci->datetime_session_number != -1) && llci->datetime_response_interval) {
+		time_t cur_time = time(NULL);
+		int datetime_timeout = 0;
+		if (cur_time <= llci->datetime_next_send)
+			datetime_timeout = (llci->datetime_next_send - cur_time + 1) * 1000;
+		if (datetime_timeout < next)
+			next = datetime_timeout;
+	}
+
+	*timeout = next;
+	return en50221_tl_get_pollfds(llci->tl, fds, max_fds);
+}
+
+static enum en50221_stdcam_status en50221_stdcam_llci_process(struct en50221_stdcam *stdcam, struct pollfd *fds, int count)
+{
+	struct en50221_stdcam_llci *llci = (struct en50221_stdcam_llci *) stdcam;
+	uint64_t now = time_now_ms();
+
+	if (now >= llci->camstate_next_check) {
+		llci_check_cam(llci);
+
+		if (llci->state == EN50221_STDCAM_CAM_INRESET)
+			llci->camstate_next_check = now + LLCI_POLL_DELAY_MS;
+		else
+			llci->camstate_next_check = now + LLCI_CAMSTATE_INTERVAL_MS;
+	}
+
+	// process the stack
+	int error;
+	if ((error = en50221_tl_process(llci->tl, fds, count)) != 0) {
+		print(LOG_LEVEL, ERROR, 1, "Error reported by stack:%i\n", en50221_tl_get_error(llci->tl));
+	}
+
+	llci_send_datetime(llci);
+
+	return llci->state;
+}
+
+static void llci_check_cam(struct en50221_stdcam_llci *llci)
+{
 	switch(dvbca_get_cam_state(llci->cafd, llci->slotnum)) {
 	case DVBCA_CAMSTATE_MISSING:
 		if (llci->state != EN50221_STDCAM_CAM_NONE)
@@ -232,13 +314,10 @@ static enum en50221_stdcam_status en50221_stdcam_llci_poll(struct en50221_stdcam
 			llci_cam_in_reset(llci);
 		break;
 	}
+}
 
-	// poll the stack
-	int error;
-	if ((error = en50221_tl_poll(llci->tl)) != 0) {
-		print(LOG_LEVEL, ERROR, 1, "Error reported by stack:%i\n", en50221_tl_get_error(llci->tl));
-	}
-
+static void llci_send_datetime(struct en50221_stdcam_llci *llci)
+{
 	// send date/time response
 	if (llci->datetime_session_number != -1) {
 		time_t cur_time = time(NULL);
@@ -249,8 +328,6 @@ static enum en50221_stdcam_status en50221_stdcam_llci_poll(struct en50221_stdcam
 			llci->datetime_next_send = cur_time + llci->datetime_response_interval;
 		}
 	}
-
-	return llci->state;
 }
 
 static void llci_cam_added(struct en50221_stdcam_llci *llci)
@@ -317,41 +394,42 @@ static int llci_lookup_callback(void *arg, uint8_t _slot_id, uint32_t requested_
 		return -1;
 	}
 
-	// try and find an instance of the resource
-	uint32_t i;
-	for(i=0; i<RESOURCE_IDS_COUNT; i++) {
-		if ((resid.resource_class == llci->resources[i].resid.resource_class) &&
-		    (resid.resource_type == llci->resources[i].resid.resource_type)) {
-
-			// limit sessions to certain resources
-			switch(requested_resource_id) {
-			case EN50221_APP_DATETIME_RESOURCEID:
-				if (llci->datetime_session_number != -1)
-					return -3;
-				break;
-			case EN50221_APP_AI_RESOURCEID:
-				if (llci->stdcam.ai_session_number != -1)
-					return -3;
-				break;
-			case EN50221_APP_CA_RESOURCEID:
-				if (llci->stdcam.ca_session_number != -1)
-					return -3;
-				break;
-			case EN50221_APP_MMI_RESOURCEID:
-				if (llci->stdcam.mmi_session_number != -1)
-					return -3;
-				break;
-			}
-
-			// resource is ok.
-			*callback_out = llci->resources[i].callback;
-			*arg_out = llci->resources[i].arg;
-			*connected_resource_id = llci->resources[i].binary_resource_id;
-			return 0;
-		}
+	// find the resource directly from its class and type - the version
+	// is ignored since we'll connect to the version we support
+	int i;
+	switch(requested_resource_id & ~RESOURCE_VERSION_MASK) {
+	case EN50221_APP_RM_RESOURCEID & ~RESOURCE_VERSION_MASK:
+		i = RESOURCE_IDX_RM;
+		break;
+	case EN50221_APP_CA_RESOURCEID & ~RESOURCE_VERSION_MASK:
+		if (llci->stdcam.ca_session_number != -1)
+			return -3;
+		i = RESOURCE_IDX_CA;
+		break;
+	case EN50221_APP_AI_RESOURCEID & ~RESOURCE_VERSION_MASK:
+		if (llci->stdcam.ai_session_number != -1)
+			return -3;
+		i = RESOURCE_IDX_AI;
+		break;
+	case EN50221_APP_MMI_RESOURCEID & ~RESOURCE_VERSION_MASK:
+		if (llci->stdcam.mmi_session_number != -1)
+			return -3;
+		i = RESOURCE_IDX_MMI;
+		break;
+	case EN50221_APP_DATETIME_RESOURCEID & ~RESOURCE_VERSION_MASK:
+		if (llci->datetime_session_number != -1)
+			return -3;
+		i = RESOURCE_IDX_DATETIME;
+		break;
+	default:
+		return -1;
 	}
 
-	return -1;
+	// resource is ok.
+	*callback_out = llci->resources[i].callback;
+	*arg_out = llci->resources[i].arg;
+	*connected_resource_id = llci->resources[i].binary_resource_id;
+	return 0;
 }
 
 static int llci_session_callback(void *arg, int reason, uint8_t _slot_id, uint16_t session_number, uint32_t resource_id)
@@ -26,6 +26,7 @@
 #include <string.h>
 #include <pthread.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <sys/ioctl.h>
 #include <sys/poll.h>
 #include <time.h>
@@ -51,9 +52,15 @@
 #define T_DATA_MORE         0xA1	// convey data from higher      constructed h<->m
 				 // layers
 
+// messages with room for this much data are kept for reuse on each slot
+#define T_MESSAGE_POOL_DATA_SIZE 1024
+#define T_MESSAGE_POOL_MAX 8
+
 struct en50221_message {
 	struct en50221_message *next;
 	uint32_t length;
+	uint32_t size;		// space allocated for data
+	uint8_t link_header[DVBCA_LINK_HEADER_SIZE];	// so data can be written in-place
 	uint8_t data[0];
 };
 
@@ -77,6 +84,12 @@ struct en50221_slot {
 
 	uint32_t response_timeout;
 	uint32_t poll_delay;
+
+	uint64_t next_deadline;	// time in ms the slot next needs servicing at
+	int in_service;		// set while the slot is being serviced
+
+	struct en50221_message *message_pool;
+	int message_pool_count;
 };
 
 struct en50221_transport_layer {
@@ -85,6 +98,7 @@ struct en50221_transport_layer {
 	struct en50221_slot *slots;
 	struct pollfd *slot_pollfds;
 	int slots_changed;
+	int wakeup_pipe[2];	// written to when a slot needs servicing early
 
 	pthread_mutex_t global_lock;
 	pthread_mutex_t setcallback_lock;
@@ -99,6 +113,12 @@ struct en50221_transport_layer {
 static int en50221_tl_process_data(struct en50221_transport_layer *tl,
 				   uint8_t slot_id, uint8_t * data,
 				   uint32_t data_length);
+static int en50221_tl_service_slot(struct en50221_transport_layer *tl,
+				   uint8_t slot_id, short revents);
+static uint64_t en50221_tl_slot_deadline(struct en50221_transport_layer *tl,
+					 uint8_t slot_id);
+static void en50221_tl_clear_connection(struct en50221_transport_layer *tl,
+					uint8_t slot_id, uint8_t connection_id);
 static int en50221_tl_poll_tc(struct en50221_transport_layer *tl,
 			      uint8_t slot_id, uint8_t connection_id);
 static int en50221_tl_alloc_new_tc(struct en50221_transport_layer *tl,
@@ -106,6 +126,14 @@ static int en50221_tl_alloc_new_tc(struct en50221_transport_layer *tl,
 static void queue_message(struct en50221_transport_layer *tl,
 			  uint8_t slot_id, uint8_t connection_id,
 			  struct en50221_message *msg);
+static struct en50221_message *alloc_message(struct en50221_transport_layer *tl,
+					     uint8_t slot_id, uint32_t size);
+static void free_message(struct en50221_transport_layer *tl,
+			 uint8_t slot_id, struct en50221_message *msg);
+static void free_message_list(struct en50221_message *msg);
+static int send_or_queue_message(struct en50221_transport_layer *tl,
+				 uint8_t slot_id, uint8_t connection_id,
+				 struct en50221_message *msg);
 static int en50221_tl_handle_create_tc_reply(struct en50221_transport_layer
 					     *tl, uint8_t slot_id,
 					     uint8_t connection_id);
@@ -133,6 +161,28 @@ static int en50221_tl_handle_sb(struct en50221_transport_layer *tl,
 				uint8_t * data, uint32_t data_length);
 
 
+static inline uint64_t en50221_tl_timeval_ms(struct timeval tv)
+{
+	return ((uint64_t) tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+}
+
+static void en50221_tl_wakeup(struct en50221_transport_layer *tl)
+{
+	uint8_t c = 0;
+
+	// if the pipe is full, a wakeup is already pending
+	if (write(tl->wakeup_pipe[1], &c, 1) < 0)
+		return;
+}
+
+static void en50221_tl_drain_wakeup(struct en50221_transport_layer *tl)
+{
+	uint8_t buf[64];
+
+	while (read(tl->wakeup_pipe[0], buf, sizeof(buf)) == sizeof(buf));
+}
+
+
 struct en50221_transport_layer *en50221_tl_create(uint8_t max_slots,
 						  uint8_t
 						  max_connections_per_slot)
@@ -151,6 +201,8 @@ struct en50221_transport_layer *en50221_tl_create(uint8_t max_slots,
 	tl->slots = NULL;
 	tl->slot_pollfds = NULL;
 	tl->slots_changed = 1;
+	tl->wakeup_pipe[0] = -1;
+	tl->wakeup_pipe[1] = -1;
 	tl->callback = NULL;
 	tl->callback_arg = NULL;
 	tl->error_slot = 0;
@@ -166,6 +218,10 @@ struct en50221_transport_layer *en50221_tl_create(uint8_t max_slots,
 	// set them up
 	for (i = 0; i < max_slots; i++) {
 		tl->slots[i].ca_hndl = -1;
+		tl->slots[i].next_deadline = 0;
+		tl->slots[i].in_service = 0;
+		tl->slots[i].message_pool = NULL;
+		tl->slots[i].message_pool_count = 0;
 
 		// create the connections for this slot
 		tl->slots[i].connections =
@@ -196,6 +252,15 @@ struct en50221_transport_layer *en50221_tl_create(uint8_t max_slots,
 	}
 	memset(tl->slot_pollfds, 0, sizeof(struct pollfd) * max_slots);
 
+	// create the wakeup pipe
+	if (pipe(tl->wakeup_pipe)) {
+		tl->wakeup_pipe[0] = -1;
+		tl->wakeup_pipe[1] = -1;
+		goto error_exit;
+	}
+	fcntl(tl->wakeup_pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(tl->wakeup_pipe[1], F_SETFL, O_NONBLOCK);
+
 	return tl;
 
       error_exit:
@@ -217,17 +282,12 @@ void en50221_tl_destroy(struct en50221_transport_layer *tl)
 							free(tl->slots[i].connections[j].chain_buffer);
 						}
 
-						struct en50221_message *cur_msg =
-							tl->slots[i].connections[j].send_queue;
-						while (cur_msg) {
-							struct en50221_message *next_msg = cur_msg->next;
-							free(cur_msg);
-							cur_msg = next_msg;
-						}
+						free_message_list(tl->slots[i].connections[j].send_queue);
 						tl->slots[i].connections[j].send_queue = NULL;
 						tl->slots[i].connections[j].send_queue_tail = NULL;
 					}
 					free(tl->slots[i].connections);
+					free_message_list(tl->slots[i].message_pool);
 					pthread_mutex_destroy(&tl->slots[i].slot_lock);
 				}
 			}
@@ -236,6 +296,10 @@ void en50221_tl_destroy(struct en50221_transport_layer *tl)
 		if (tl->slot_pollfds) {
 			free(tl->slot_pollfds);
 		}
+		if (tl->wakeup_pipe[0] != -1) {
+			close(tl->wakeup_pipe[0]);
+			close(tl->wakeup_pipe[1]);
+		}
 		pthread_mutex_destroy(&tl->setcallback_lock);
 		pthread_mutex_destroy(&tl->global_lock);
 		free(tl);
@@ -273,6 +337,7 @@ int en50221_tl_register_slot(struct en50221_transport_layer *tl,
 	tl->slots[slot_id].slot = slot;
 	tl->slots[slot_id].response_timeout = response_timeout;
 	tl->slots[slot_id].poll_delay = poll_delay;
+	tl->slots[slot_id].next_deadline = 0;
 	pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
 
 	tl->slots_changed = 1;
@@ -295,26 +360,7 @@ void en50221_tl_destroy_slot(struct en50221_transport_layer *tl,
 	pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
 	tl->slots[slot_id].ca_hndl = -1;
 	for (i = 0; i < tl->max_connections_per_slot; i++) {
-		tl->slots[slot_id].connections[i].state = T_STATE_IDLE;
-		tl->slots[slot_id].connections[i].tx_time.tv_sec = 0;
-		tl->slots[slot_id].connections[i].last_poll_time.tv_sec = 0;
-		tl->slots[slot_id].connections[i].last_poll_time.tv_usec = 0;
-		if (tl->slots[slot_id].connections[i].chain_buffer) {
-			free(tl->slots[slot_id].connections[i].
-			     chain_buffer);
-		}
-		tl->slots[slot_id].connections[i].chain_buffer = NULL;
-		tl->slots[slot_id].connections[i].buffer_length = 0;
-
-		struct en50221_message *cur_msg =
-		    tl->slots[slot_id].connections[i].send_queue;
-		while (cur_msg) {
-			struct en50221_message *next_msg = cur_msg->next;
-			free(cur_msg);
-			cur_msg = next_msg;
-		}
-		tl->slots[slot_id].connections[i].send_queue = NULL;
-		tl->slots[slot_id].connections[i].send_queue_tail = NULL;
+		en50221_tl_clear_connection(tl, slot_id, i);
 	}
 	pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
 
@@ -332,9 +378,7 @@ void en50221_tl_destroy_slot(struct en50221_transport_layer *tl,
 
 int en50221_tl_poll(struct en50221_transport_layer *tl)
 {
-	uint8_t data[4096];
 	int slot_id;
-	int j;
 
 	// make up pollfds if the slots have changed
 	pthread_mutex_lock(&tl->global_lock);
@@ -360,149 +404,114 @@ int en50221_tl_poll(struct en50221_transport_layer *tl)
 		tl->error = EN50221ERR_CAREAD;
 		return -1;
 	}
-	// go through all slots (even though poll may not have reported any events
-	for (slot_id = 0; slot_id < tl->max_slots; slot_id++) {
+	en50221_tl_drain_wakeup(tl);
 
-		// check if this slot is still used and get its handle
-		pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
-		if (tl->slots[slot_id].ca_hndl == -1) {
-			pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+	// go through the slots with events or timers due
+	uint64_t now = time_now_ms();
+	for (slot_id = 0; slot_id < tl->max_slots; slot_id++) {
+		if (tl->slots[slot_id].ca_hndl == -1)
+			continue;
+		if ((tl->slot_pollfds[slot_id].revents == 0) &&
+		    (now < tl->slots[slot_id].next_deadline))
 			continue;
-		}
-		int ca_hndl = tl->slots[slot_id].ca_hndl;
 
-		if (tl->slot_pollfds[slot_id].revents & (POLLPRI | POLLIN)) {
-			// read data
-			uint8_t r_slot_id;
-			uint8_t connection_id;
-			int readcnt = dvbca_link_read(ca_hndl, &r_slot_id,
-						      &connection_id,
-						      data, sizeof(data));
-			if (readcnt < 0) {
-				tl->error_slot = slot_id;
-				tl->error = EN50221ERR_CAREAD;
-				pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-				return -1;
-			}
-			// process it if we got some
-			if (readcnt > 0) {
-				if (tl->slots[slot_id].slot != r_slot_id) {
-					// this message is for an other CAM of the same CA
-					int new_slot_id;
-					for (new_slot_id = 0; new_slot_id < tl->max_slots; new_slot_id++) {
-						if ((tl->slots[new_slot_id].ca_hndl == ca_hndl) &&
-						    (tl->slots[new_slot_id].slot == r_slot_id))
-							break;
-					}
-					if (new_slot_id != tl->max_slots) {
-						// we found the requested CAM
-						pthread_mutex_lock(&tl->slots[new_slot_id].slot_lock);
-						if (en50221_tl_process_data(tl, new_slot_id, data, readcnt)) {
-							pthread_mutex_unlock(&tl->slots[new_slot_id].slot_lock);
-							pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-							return -1;
-						}
-						pthread_mutex_unlock(&tl->slots[new_slot_id].slot_lock);
-					} else {
-						tl->error = EN50221ERR_BADSLOTID;
-						pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-						return -1;
-					}
-				} else
-				    if (en50221_tl_process_data(tl, slot_id, data, readcnt)) {
-					pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-					return -1;
-				}
-			}
-		} else if (tl->slot_pollfds[slot_id].revents & POLLERR) {
-			// an error was reported
-			tl->error_slot = slot_id;
-			tl->error = EN50221ERR_CAREAD;
-			pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+		if (en50221_tl_service_slot(tl, slot_id, tl->slot_pollfds[slot_id].revents))
 			return -1;
+	}
+
+	return 0;
+}
+
+int en50221_tl_get_pollfds(struct en50221_transport_layer *tl,
+			   struct pollfd *fds, int max_fds)
+{
+	int count = 0;
+	int slot_id;
+	int i;
+
+	if (max_fds <= 0)
+		return 0;
+
+	fds[count].fd = tl->wakeup_pipe[0];
+	fds[count].events = POLLIN;
+	fds[count].revents = 0;
+	count++;
+
+	pthread_mutex_lock(&tl->global_lock);
+	for (slot_id = 0; (slot_id < tl->max_slots) && (count < max_fds); slot_id++) {
+		int ca_hndl = tl->slots[slot_id].ca_hndl;
+		if (ca_hndl == -1)
+			continue;
+
+		// several CAMs of the same CA share its handle
+		for (i = 0; i < count; i++) {
+			if (fds[i].fd == ca_hndl)
+				break;
 		}
-		// poll the connections on this slot + check for timeouts
-		for (j = 0; j < tl->max_connections_per_slot; j++) {
-			// ignore connection if idle
-			if (tl->slots[slot_id].connections[j].state == T_STATE_IDLE) {
-				continue;
-			}
-			// send queued data
-			if (tl->slots[slot_id].connections[j].state &
-				(T_STATE_IN_CREATION | T_STATE_ACTIVE | T_STATE_ACTIVE_DELETEQUEUED)) {
-				// send data if there is some to go and we're not waiting for a response already
-				if (tl->slots[slot_id].connections[j].send_queue &&
-				    (tl->slots[slot_id].connections[j].tx_time.tv_sec == 0)) {
-
-					// get the message
-					struct en50221_message *msg =
-						tl->slots[slot_id].connections[j].send_queue;
-					if (msg->next != NULL) {
-						tl->slots[slot_id].connections[j].send_queue = msg->next;
-					} else {
-						tl->slots[slot_id].connections[j].send_queue = NULL;
-						tl->slots[slot_id].connections[j].send_queue_tail = NULL;
-					}
+		if (i != count)
+			continue;
 
-					// send the message
-					if (dvbca_link_write(tl->slots[slot_id].ca_hndl,
-					    		     tl->slots[slot_id].slot,
-							     j,
-							     msg->data, msg->length) < 0) {
-						free(msg);
-						pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-						tl->error_slot = slot_id;
-						tl->error = EN50221ERR_CAWRITE;
-						print(LOG_LEVEL, ERROR, 1, "CAWrite failed");
-						return -1;
-					}
-					gettimeofday(&tl->slots[slot_id].connections[j].tx_time, 0);
+		fds[count].fd = ca_hndl;
+		fds[count].events = POLLIN | POLLPRI | POLLERR;
+		fds[count].revents = 0;
+		count++;
+	}
+	pthread_mutex_unlock(&tl->global_lock);
 
-					// fixup connection state for T_DELETE_T_C
-					if (msg->length && (msg->data[0] == T_DELETE_T_C)) {
-						tl->slots[slot_id].connections[j].state = T_STATE_IN_DELETION;
-						if (tl->slots[slot_id].connections[j].chain_buffer) {
-							free(tl->slots[slot_id].connections[j].chain_buffer);
-						}
-						tl->slots[slot_id].connections[j].chain_buffer = NULL;
-						tl->slots[slot_id].connections[j].buffer_length = 0;
-					}
+	return count;
+}
 
-					free(msg);
-				}
-			}
-			// poll it if we're not expecting a reponse and the poll time has elapsed
-			if (tl->slots[slot_id].connections[j].state & T_STATE_ACTIVE) {
-				if ((tl->slots[slot_id].connections[j].tx_time.tv_sec == 0) &&
-				    (time_after(tl->slots[slot_id].connections[j].last_poll_time,
-				     		tl->slots[slot_id].poll_delay))) {
-
-					gettimeofday(&tl->slots[slot_id].connections[j].last_poll_time, 0);
-					if (en50221_tl_poll_tc(tl, slot_id, j)) {
-						pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-						return -1;
-					}
-				}
-			}
+int en50221_tl_get_timeout(struct en50221_transport_layer *tl)
+{
+	uint64_t next_deadline = UINT64_MAX;
+	int slot_id;
+
+	for (slot_id = 0; slot_id < tl->max_slots; slot_id++) {
+		if (tl->slots[slot_id].ca_hndl == -1)
+			continue;
+		if (tl->slots[slot_id].next_deadline < next_deadline)
+			next_deadline = tl->slots[slot_id].next_deadline;
+	}
+	if (next_deadline == UINT64_MAX)
+		return -1;
 
-			// check for timeouts - in any state
-			if (tl->slots[slot_id].connections[j].tx_time.tv_sec &&
-			    (time_after(tl->slots[slot_id].connections[j].tx_time,
-			     		tl->slots[slot_id].response_timeout))) {
+	uint64_t now = time_now_ms();
+	if (next_deadline <= now)
+		return 0;
+	if ((next_deadline - now) > INT_MAX)
+		return INT_MAX;
+	return next_deadline - now;
+}
 
-				if (tl->slots[slot_id].connections[j].state &
-				    (T_STATE_IN_CREATION |T_STATE_IN_DELETION)) {
-					tl->slots[slot_id].connections[j].state = T_STATE_IDLE;
-				} else if (tl->slots[slot_id].connections[j].state &
-					   (T_STATE_ACTIVE | T_STATE_ACTIVE_DELETEQUEUED)) {
-					tl->error_slot = slot_id;
-					tl->error = EN50221ERR_TIMEOUT;
-					pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-					return -1;
-				}
+int en50221_tl_process(struct en50221_transport_layer *tl,
+		       struct pollfd *fds, int count)
+{
+	int slot_id;
+	int i;
+
+	en50221_tl_drain_wakeup(tl);
+
+	uint64_t now = time_now_ms();
+	for (slot_id = 0; slot_id < tl->max_slots; slot_id++) {
+		int ca_hndl = tl->slots[slot_id].ca_hndl;
+		if (ca_hndl == -1)
+			continue;
+
+		// events on a shared handle go to the first slot using it; the
+		// data read is routed to the right slot anyway
+		short revents = 0;
+		for (i = 0; i < count; i++) {
+			if (fds[i].fd == ca_hndl) {
+				revents = fds[i].revents;
+				fds[i].revents = 0;
+				break;
 			}
 		}
-		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+		if ((revents == 0) && (now < tl->slots[slot_id].next_deadline))
+			continue;
+
+		if (en50221_tl_service_slot(tl, slot_id, revents))
+			return -1;
 	}
 
 	return 0;
@@ -563,8 +572,7 @@ int en50221_tl_send_data(struct en50221_transport_layer *tl,
 		return -1;
 	}
 	// allocate msg structure
-	struct en50221_message *msg =
-	    malloc(sizeof(struct en50221_message) + data_size + 10);
+	struct en50221_message *msg = alloc_message(tl, slot_id, data_size + 10);
 	if (msg == NULL) {
 		tl->error_slot = slot_id;
 		tl->error = EN50221ERR_OUTOFMEMORY;
@@ -575,7 +583,7 @@ int en50221_tl_send_data(struct en50221_transport_layer *tl,
 	int length_field_len;
 	msg->data[0] = T_DATA_LAST;
 	if ((length_field_len = asn_1_encode(data_size + 1, msg->data + 1, 3)) < 0) {
-		free(msg);
+		free_message(tl, slot_id, msg);
 		tl->error_slot = slot_id;
 		tl->error = EN50221ERR_ASNENCODE;
 		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
@@ -585,11 +593,11 @@ int en50221_tl_send_data(struct en50221_transport_layer *tl,
 	memcpy(msg->data + 1 + length_field_len + 1, data, data_size);
 	msg->length = 1 + length_field_len + 1 + data_size;
 
-	// queue it for transmission
-	queue_message(tl, slot_id, connection_id, msg);
+	// send it straight away if the connection is idle, or queue it for transmission
+	int status = send_or_queue_message(tl, slot_id, connection_id, msg);
 
 	pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-	return 0;
+	return status;
 }
 
 int en50221_tl_send_datav(struct en50221_transport_layer *tl,
@@ -641,8 +649,7 @@ int en50221_tl_send_datav(struct en50221_transport_layer *tl,
 	}
 
 	// allocate msg structure
-	struct en50221_message *msg =
-	    malloc(sizeof(struct en50221_message) + data_size + 10);
+	struct en50221_message *msg = alloc_message(tl, slot_id, data_size + 10);
 	if (msg == NULL) {
 		tl->error_slot = slot_id;
 		tl->error = EN50221ERR_OUTOFMEMORY;
@@ -653,7 +660,7 @@ int en50221_tl_send_datav(struct en50221_transport_layer *tl,
 	int length_field_len;
 	msg->data[0] = T_DATA_LAST;
 	if ((length_field_len = asn_1_encode(data_size + 1, msg->data + 1, 3)) < 0) {
-		free(msg);
+		free_message(tl, slot_id, msg);
 		tl->error_slot = slot_id;
 		tl->error = EN50221ERR_ASNENCODE;
 		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
@@ -671,11 +678,11 @@ int en50221_tl_send_datav(struct en50221_transport_layer *tl,
 		pos += vector[i].iov_len;
 	}
 
-	// queue it for transmission
-	queue_message(tl, slot_id, connection_id, msg);
+	// send it straight away if the connection is idle, or queue it for transmission
+	int status = send_or_queue_message(tl, slot_id, connection_id, msg);
 
 	pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-	return 0;
+	return status;
 }
 
 int en50221_tl_new_tc(struct en50221_transport_layer *tl, uint8_t slot_id)
@@ -701,8 +708,7 @@ int en50221_tl_new_tc(struct en50221_transport_layer *tl, uint8_t slot_id)
 		return -1;
 	}
 	// allocate msg structure
-	struct en50221_message *msg =
-	    malloc(sizeof(struct en50221_message) + 3);
+	struct en50221_message *msg = alloc_message(tl, slot_id, 3);
 	if (msg == NULL) {
 		tl->error_slot = slot_id;
 		tl->error = EN50221ERR_OUTOFMEMORY;
@@ -753,8 +759,7 @@ int en50221_tl_del_tc(struct en50221_transport_layer *tl, uint8_t slot_id,
 		return -1;
 	}
 	// allocate msg structure
-	struct en50221_message *msg =
-	    malloc(sizeof(struct en50221_message) + 3);
+	struct en50221_message *msg = alloc_message(tl, slot_id, 3);
 	if (msg == NULL) {
 		tl->error_slot = slot_id;
 		tl->error = EN50221ERR_OUTOFMEMORY;
@@ -805,6 +810,252 @@ int en50221_tl_get_connection_state(struct en50221_transport_layer *tl,
 
 
 
+// read any data for a slot, send queued data, poll the connections, and
+// check for timeouts, then work out when the slot needs looking at next
+static int en50221_tl_service_slot(struct en50221_transport_layer *tl,
+				   uint8_t slot_id, short revents)
+{
+	int j;
+
+	// check if this slot is still used and get its handle
+	pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
+	if (tl->slots[slot_id].ca_hndl == -1) {
+		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+		return 0;
+	}
+	int ca_hndl = tl->slots[slot_id].ca_hndl;
+
+	// anything failing below leaves the slot until the next poll is due,
+	// rather than having it retried straight away
+	tl->slots[slot_id].next_deadline = time_now_ms() + tl->slots[slot_id].poll_delay;
+	tl->slots[slot_id].in_service = 1;
+
+	if (revents & (POLLPRI | POLLIN)) {
+		// read data
+		uint8_t data[4096];
+		uint8_t r_slot_id;
+		uint8_t connection_id;
+		int readcnt = dvbca_link_read(ca_hndl, &r_slot_id,
+					      &connection_id,
+					      data, sizeof(data));
+		if (readcnt < 0) {
+			tl->error_slot = slot_id;
+			tl->error = EN50221ERR_CAREAD;
+			tl->slots[slot_id].in_service = 0;
+			pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+			return -1;
+		}
+		// process it if we got some
+		if (readcnt > 0) {
+			if (tl->slots[slot_id].slot != r_slot_id) {
+				// this message is for an other CAM of the same CA
+				int new_slot_id;
+				for (new_slot_id = 0; new_slot_id < tl->max_slots; new_slot_id++) {
+					if ((tl->slots[new_slot_id].ca_hndl == ca_hndl) &&
+					    (tl->slots[new_slot_id].slot == r_slot_id))
+						break;
+				}
+				if (new_slot_id != tl->max_slots) {
+					// we found the requested CAM
+					pthread_mutex_lock(&tl->slots[new_slot_id].slot_lock);
+					if (en50221_tl_process_data(tl, new_slot_id, data, readcnt)) {
+						pthread_mutex_unlock(&tl->slots[new_slot_id].slot_lock);
+						tl->slots[slot_id].in_service = 0;
+						pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+						return -1;
+					}
+					tl->slots[new_slot_id].next_deadline = 0;
+					pthread_mutex_unlock(&tl->slots[new_slot_id].slot_lock);
+				} else {
+					tl->error = EN50221ERR_BADSLOTID;
+					tl->slots[slot_id].in_service = 0;
+					pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+					return -1;
+				}
+			} else
+			    if (en50221_tl_process_data(tl, slot_id, data, readcnt)) {
+				tl->slots[slot_id].in_service = 0;
+				pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+				return -1;
+			}
+		}
+	} else if (revents & POLLERR) {
+		// an error was reported
+		tl->error_slot = slot_id;
+		tl->error = EN50221ERR_CAREAD;
+		tl->slots[slot_id].in_service = 0;
+		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+		return -1;
+	}
+	// poll the connections on this slot + check for timeouts
+	for (j = 0; j < tl->max_connections_per_slot; j++) {
+		// ignore connection if idle
+		if (tl->slots[slot_id].connections[j].state == T_STATE_IDLE) {
+			continue;
+		}
+		// send queued data
+		if (tl->slots[slot_id].connections[j].state &
+			(T_STATE_IN_CREATION | T_STATE_ACTIVE | T_STATE_ACTIVE_DELETEQUEUED)) {
+			// send data if there is some to go and we're not waiting for a response already
+			if (tl->slots[slot_id].connections[j].send_queue &&
+			    (tl->slots[slot_id].connections[j].tx_time.tv_sec == 0)) {
+
+				// get the message
+				struct en50221_message *msg =
+					tl->slots[slot_id].connections[j].send_queue;
+				if (msg->next != NULL) {
+					tl->slots[slot_id].connections[j].send_queue = msg->next;
+				} else {
+					tl->slots[slot_id].connections[j].send_queue = NULL;
+					tl->slots[slot_id].connections[j].send_queue_tail = NULL;
+				}
+
+				// send the message
+				if (dvbca_link_write_inplace(tl->slots[slot_id].ca_hndl,
+							     tl->slots[slot_id].slot,
+							     j,
+							     msg->link_header, msg->length) < 0) {
+					free_message(tl, slot_id, msg);
+					tl->slots[slot_id].in_service = 0;
+					pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+					tl->error_slot = slot_id;
+					tl->error = EN50221ERR_CAWRITE;
+					print(LOG_LEVEL, ERROR, 1, "CAWrite failed");
+					return -1;
+				}
+				gettimeofday(&tl->slots[slot_id].connections[j].tx_time, 0);
+
+				// fixup connection state for T_DELETE_T_C
+				if (msg->length && (msg->data[0] == T_DELETE_T_C)) {
+					tl->slots[slot_id].connections[j].state = T_STATE_IN_DELETION;
+					if (tl->slots[slot_id].connections[j].chain_buffer) {
+						free(tl->slots[slot_id].connections[j].chain_buffer);
+					}
+					tl->slots[slot_id].connections[j].chain_buffer = NULL;
+					tl->slots[slot_id].connections[j].buffer_length = 0;
+				}
+
+				free_message(tl, slot_id, msg);
+			}
+		}
+		// poll it if we're not expecting a reponse and the poll time has elapsed
+		if (tl->slots[slot_id].connections[j].state & T_STATE_ACTIVE) {
+			if ((tl->slots[slot_id].connections[j].tx_time.tv_sec == 0) &&
+			    (time_after(tl->slots[slot_id].connections[j].last_poll_time,
+			     		tl->slots[slot_id].poll_delay))) {
+
+				gettimeofday(&tl->slots[slot_id].connections[j].last_poll_time, 0);
+				if (en50221_tl_poll_tc(tl, slot_id, j)) {
+					tl->slots[slot_id].in_service = 0;
+					pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+					return -1;
+				}
+			}
+		}
+
+		// check for timeouts - in any state
+		if (tl->slots[slot_id].connections[j].tx_time.tv_sec &&
+		    (time_after(tl->slots[slot_id].connections[j].tx_time,
+		     		tl->slots[slot_id].response_timeout))) {
+
+			if (tl->slots[slot_id].connections[j].state &
+			    (T_STATE_IN_CREATION |T_STATE_IN_DELETION)) {
+				tl->slots[slot_id].connections[j].state = T_STATE_IDLE;
+				tl->slots[slot_id].connections[j].tx_time.tv_sec = 0;
+			} else if (tl->slots[slot_id].connections[j].state &
+				   (T_STATE_ACTIVE | T_STATE_ACTIVE_DELETEQUEUED)) {
+				// the module has stopped answering on this
+				// connection, so clear it down rather than
+				// report the same timeout on every pass
+				en50221_tl_clear_connection(tl, slot_id, j);
+
+				// tell upper layers
+				pthread_mutex_lock(&tl->setcallback_lock);
+				en50221_tl_callback cb = tl->callback;
+				void *cb_arg = tl->callback_arg;
+				pthread_mutex_unlock(&tl->setcallback_lock);
+				if (cb)
+					cb(cb_arg, T_CALLBACK_REASON_CONNECTIONCLOSE, NULL, 0, slot_id, j);
+
+				tl->error_slot = slot_id;
+				tl->error = EN50221ERR_TIMEOUT;
+				tl->slots[slot_id].in_service = 0;
+				pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+				return -1;
+			}
+		}
+	}
+
+	tl->slots[slot_id].next_deadline = en50221_tl_slot_deadline(tl, slot_id);
+	tl->slots[slot_id].in_service = 0;
+	pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+	return 0;
+}
+
+// work out when a slot next needs servicing, called with the slot_lock held
+static uint64_t en50221_tl_slot_deadline(struct en50221_transport_layer *tl,
+					 uint8_t slot_id)
+{
+	struct en50221_slot *slot = &tl->slots[slot_id];
+	uint64_t next_deadline = UINT64_MAX;
+	uint64_t deadline;
+	int j;
+
+	for (j = 0; j < tl->max_connections_per_slot; j++) {
+		struct en50221_connection *conn = &slot->connections[j];
+
+		if (conn->state == T_STATE_IDLE)
+			continue;
+
+		if (conn->tx_time.tv_sec) {
+			// waiting for a response
+			deadline = en50221_tl_timeval_ms(conn->tx_time) +
+				slot->response_timeout + 1;
+		} else if (conn->send_queue &&
+			   (conn->state & (T_STATE_IN_CREATION | T_STATE_ACTIVE | T_STATE_ACTIVE_DELETEQUEUED))) {
+			// data to go
+			return 0;
+		} else if (conn->state & T_STATE_ACTIVE) {
+			// next poll
+			deadline = en50221_tl_timeval_ms(conn->last_poll_time) +
+				slot->poll_delay + 1;
+		} else {
+			continue;
+		}
+
+		if (deadline < next_deadline)
+			next_deadline = deadline;
+	}
+
+	return next_deadline;
+}
+
+// return a connection to idle, dropping anything queued on it. Called with
+// the slot_lock held
+static void en50221_tl_clear_connection(struct en50221_transport_layer *tl,
+					uint8_t slot_id, uint8_t connection_id)
+{
+	struct en50221_connection *conn = &tl->slots[slot_id].connections[connection_id];
+
+	conn->state = T_STATE_IDLE;
+	conn->tx_time.tv_sec = 0;
+	conn->last_poll_time.tv_sec = 0;
+	conn->last_poll_time.tv_usec = 0;
+	if (conn->chain_buffer) {
+		free(conn->chain_buffer);
+	}
+	conn->chain_buffer = NULL;
+	conn->buffer_length = 0;
+
+	struct en50221_message *cur_msg = conn->send_queue;
+	while (cur_msg) {
+		struct en50221_message *next_msg = cur_msg->next;
+		free_message(tl, slot_id, cur_msg);
+		cur_msg = next_msg;
+	}
+	conn->send_queue = NULL;
+	conn->send_queue_tail = NULL;
+}
 
 // ask the module for new data
 static int en50221_tl_poll_tc(struct en50221_transport_layer *tl,
@@ -1293,4 +1544,89 @@ static void queue_message(struct en50221_transport_layer *tl,
 		tl->slots[slot_id].connections[connection_id].send_queue = msg;
 		tl->slots[slot_id].connections[connection_id].send_queue_tail = msg;
 	}
+
+	// get it sent without waiting for the next timer
+	tl->slots[slot_id].next_deadline = 0;
+	en50221_tl_wakeup(tl);
+}
+
+// called with the slot_lock held
+static int send_or_queue_message(struct en50221_transport_layer *tl,
+				 uint8_t slot_id, uint8_t connection_id,
+				 struct en50221_message *msg)
+{
+	struct en50221_connection *conn = &tl->slots[slot_id].connections[connection_id];
+
+	// anything else going on has to be finished first
+	if (tl->slots[slot_id].in_service || conn->send_queue || conn->tx_time.tv_sec) {
+		queue_message(tl, slot_id, connection_id, msg);
+		return 0;
+	}
+
+	// the connection is idle, so send it now rather than waiting to be polled
+	if (dvbca_link_write_inplace(tl->slots[slot_id].ca_hndl,
+				     tl->slots[slot_id].slot,
+				     connection_id,
+				     msg->link_header, msg->length) < 0) {
+		free_message(tl, slot_id, msg);
+		tl->error_slot = slot_id;
+		tl->error = EN50221ERR_CAWRITE;
+		return -1;
+	}
+	gettimeofday(&conn->tx_time, 0);
+	free_message(tl, slot_id, msg);
+
+	tl->slots[slot_id].next_deadline = en50221_tl_slot_deadline(tl, slot_id);
+	return 0;
+}
+
+// called with the slot_lock held
+static struct en50221_message *alloc_message(struct en50221_transport_layer *tl,
+					     uint8_t slot_id, uint32_t size)
+{
+	struct en50221_slot *slot = &tl->slots[slot_id];
+	struct en50221_message *msg;
+
+	if ((size <= T_MESSAGE_POOL_DATA_SIZE) && slot->message_pool) {
+		msg = slot->message_pool;
+		slot->message_pool = msg->next;
+		slot->message_pool_count--;
+	} else {
+		if (size < T_MESSAGE_POOL_DATA_SIZE)
+			size = T_MESSAGE_POOL_DATA_SIZE;
+		msg = malloc(sizeof(struct en50221_message) + size);
+		if (msg == NULL)
+			return NULL;
+		msg->size = size;
+	}
+
+	msg->next = NULL;
+	msg->length = 0;
+	return msg;
+}
+
+// called with the slot_lock held
+static void free_message(struct en50221_transport_layer *tl,
+			 uint8_t slot_id, struct en50221_message *msg)
+{
+	struct en50221_slot *slot = &tl->slots[slot_id];
+
+	if ((msg->size == T_MESSAGE_POOL_DATA_SIZE) &&
+	    (slot->message_pool_count < T_MESSAGE_POOL_MAX)) {
+		msg->next = slot->message_pool;
+		slot->message_pool = msg;
+		slot->message_pool_count++;
+		return;
+	}
+
+	free(msg);
+}
+
+static void free_message_list(struct en50221_message *msg)
+{
+	while (msg) {
+		struct en50221_message *next_msg = msg->next;
+		free(msg);
+		msg = next_msg;
+	}
 }
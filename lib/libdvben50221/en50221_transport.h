@@ -32,6 +32,7 @@ extern "C" {
 #include <stdlib.h>
 #include <stdint.h>
 #include <sys/uio.h>
+#include <sys/poll.h>
 
 /**
  * Callback reasons.
@@ -131,6 +132,46 @@ extern void en50221_tl_destroy_slot(struct en50221_transport_layer *tl, uint8_t
  */
 extern int en50221_tl_poll(struct en50221_transport_layer *tl);
 
+/**
+ * Get the file descriptors to wait on when driving the transport layer from
+ * an external event loop instead of calling en50221_tl_poll(). The first entry
+ * is an internal pipe which becomes readable when data has been queued for
+ * sending from another thread. Slots sharing a CA handle share one entry.
+ *
+ * The fds change when slots are registered or destroyed, so this should be
+ * called again before each wait.
+ *
+ * @param tl The en50221_transport_layer instance.
+ * @param fds Array to fill out.
+ * @param max_fds Number of entries in fds; max_slots + 1 is always enough.
+ * @return Number of entries filled out.
+ */
+extern int en50221_tl_get_pollfds(struct en50221_transport_layer *tl,
+				  struct pollfd *fds, int max_fds);
+
+/**
+ * Get the time until en50221_tl_process() must next be called even if no events
+ * occur - e.g. to send the next T_DATA_LAST poll to a module, or to check for a
+ * response timeout.
+ *
+ * @param tl The en50221_transport_layer instance.
+ * @return Timeout in ms, 0 if something is due now, or -1 if nothing is pending.
+ */
+extern int en50221_tl_get_timeout(struct en50221_transport_layer *tl);
+
+/**
+ * Process the events reported on the fds returned by en50221_tl_get_pollfds(),
+ * and any timers which have expired. Only slots with events or timers due are
+ * looked at.
+ *
+ * @param tl The en50221_transport_layer instance.
+ * @param fds The fds, with revents filled out by poll() or similar.
+ * @param count Number of entries in fds.
+ * @return 0 on succes, or -1 if there was an error of some sort.
+ */
+extern int en50221_tl_process(struct en50221_transport_layer *tl,
+			      struct pollfd *fds, int count);
+
 /**
  * Register the callback for data reception.
  *
@@ -69,4 +69,12 @@ static inline int time_after(struct timeval oldtime, uint32_t delta_ms)
 	return nowtime_ms > oldtime_ms;
 }
 
+static inline uint64_t time_now_ms(void)
+{
+	// the same clock as time_after() uses
+	struct timeval nowtime;
+	gettimeofday(&nowtime, 0);
+	return (nowtime.tv_sec * 1000ULL) + (nowtime.tv_usec / 1000);
+}
+
 #endif
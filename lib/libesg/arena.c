@@ -0,0 +1,145 @@
+/*
+ * ESG parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libesg/arena.h>
+
+#define ESG_ARENA_MIN_BLOCK 1024
+#define ESG_ARENA_ALIGN 8
+
+struct esg_arena_block {
+	struct esg_arena_block *next;
+	uint32_t size;
+	uint32_t used;
+	/* uint8_t data[] */
+} __attribute__((aligned(ESG_ARENA_ALIGN)));
+
+struct esg_arena {
+	struct esg_arena_block *blocks; // current block first
+	uint32_t total;
+};
+
+static struct esg_arena_block *esg_arena_block_new(uint32_t size) {
+	struct esg_arena_block *block;
+
+	block = (struct esg_arena_block *) malloc(sizeof(struct esg_arena_block) + size);
+	if (block == NULL) {
+		return NULL;
+	}
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+
+	return block;
+}
+
+struct esg_arena *esg_arena_create(uint32_t size) {
+	struct esg_arena *arena;
+
+	if (size < ESG_ARENA_MIN_BLOCK) {
+		size = ESG_ARENA_MIN_BLOCK;
+	}
+
+	arena = (struct esg_arena *) malloc(sizeof(struct esg_arena));
+	if (arena == NULL) {
+		return NULL;
+	}
+
+	arena->blocks = esg_arena_block_new(size);
+	if (arena->blocks == NULL) {
+		free(arena);
+		return NULL;
+	}
+	arena->total = size;
+
+	return arena;
+}
+
+void *esg_arena_alloc(struct esg_arena *arena, uint32_t size) {
+	struct esg_arena_block *block = arena->blocks;
+	uint32_t new_size;
+	uint8_t *ptr;
+
+	size = (size + ESG_ARENA_ALIGN - 1) & ~(ESG_ARENA_ALIGN - 1);
+
+	if (block->size - block->used < size) {
+		new_size = block->size * 2;
+		if (new_size < size) {
+			new_size = size;
+		}
+		block = esg_arena_block_new(new_size);
+		if (block == NULL) {
+			return NULL;
+		}
+		block->next = arena->blocks;
+		arena->blocks = block;
+		arena->total += new_size;
+	}
+
+	ptr = (uint8_t *) block + sizeof(struct esg_arena_block) + block->used;
+	block->used += size;
+	memset(ptr, 0, size);
+
+	return ptr;
+}
+
+void esg_arena_reset(struct esg_arena *arena) {
+	struct esg_arena_block *merged;
+	struct esg_arena_block *block;
+	struct esg_arena_block *next_block;
+
+	if (arena->blocks->next == NULL) {
+		arena->blocks->used = 0;
+		return;
+	}
+
+	merged = esg_arena_block_new(arena->total);
+	if (merged == NULL) {
+		// keep the newest block, which is the largest
+		merged = arena->blocks;
+		arena->blocks = merged->next;
+		merged->next = NULL;
+		merged->used = 0;
+		arena->total = merged->size;
+	}
+
+	for(block = arena->blocks; block; block = next_block) {
+		next_block = block->next;
+		free(block);
+	}
+
+	arena->blocks = merged;
+}
+
+void esg_arena_destroy(struct esg_arena *arena) {
+	struct esg_arena_block *block;
+	struct esg_arena_block *next_block;
+
+	if (arena == NULL) {
+		return;
+	}
+
+	for(block = arena->blocks; block; block = next_block) {
+		next_block = block->next;
+		free(block);
+	}
+
+	free(arena);
+}
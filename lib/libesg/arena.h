@@ -0,0 +1,90 @@
+/*
+ * ESG parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _ESG_ARENA_H
+#define _ESG_ARENA_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Opaque structure representing an arena: a bump allocator from which a whole
+ * decoded structure tree is allocated, and released again in one go.
+ */
+struct esg_arena;
+
+/**
+ * Create an arena.
+ *
+ * @param size Size of the initial block. A decoded container needs roughly
+ * twice the size of its binary form.
+ * @return The arena, or NULL on failure.
+ */
+extern struct esg_arena *esg_arena_create(uint32_t size);
+
+/**
+ * Allocate zeroed memory from an arena. If the current block is full another
+ * is added.
+ *
+ * @param arena The arena.
+ * @param size Number of bytes required.
+ * @return Pointer to the memory, or NULL on failure.
+ */
+extern void *esg_arena_alloc(struct esg_arena *arena, uint32_t size);
+
+/**
+ * Release everything allocated from an arena, keeping its memory for reuse. If
+ * more than one block was needed they are merged into one, so the next decode
+ * of similar data fits a single contiguous block.
+ *
+ * @param arena The arena.
+ */
+extern void esg_arena_reset(struct esg_arena *arena);
+
+/**
+ * Destroy an arena, releasing everything allocated from it.
+ *
+ * @param arena The arena.
+ */
+extern void esg_arena_destroy(struct esg_arena *arena);
+
+/**
+ * Allocate zeroed memory from an arena, or from the heap if arena is NULL.
+ *
+ * @param arena The arena, or NULL.
+ * @param size Number of bytes required.
+ * @return Pointer to the memory, or NULL on failure.
+ */
+static inline void *esg_alloc(struct esg_arena *arena, uint32_t size)
+{
+	if (arena == NULL) {
+		return calloc(1, size);
+	}
+	return esg_arena_alloc(arena, size);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
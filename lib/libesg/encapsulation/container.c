@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <libesg/arena.h>
 #include <libesg/encapsulation/container.h>
 #include <libesg/encapsulation/fragment_management_information.h>
 #include <libesg/encapsulation/data_repository.h>
@@ -28,7 +29,7 @@
 #include <libesg/representation/init_message.h>
 #include <libesg/transport/session_partition_declaration.h>
 
-struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
+struct esg_container *esg_container_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena) {
 	uint32_t pos;
 	struct esg_container *container;
 	struct esg_container_structure *structure;
@@ -41,25 +42,24 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 
 	pos = 0;
 
-	container = (struct esg_container *) malloc(sizeof(struct esg_container));
-	memset(container, 0, sizeof(struct esg_container));
+	container = (struct esg_container *) esg_alloc(arena, sizeof(struct esg_container));
 
 	// Container header
-	container->header = (struct esg_container_header *) malloc(sizeof(struct esg_container_header));
-	memset(container->header, 0, sizeof(struct esg_container_header));
+	container->header = (struct esg_container_header *) esg_alloc(arena, sizeof(struct esg_container_header));
 
 	container->header->num_structures = buffer[pos];
 	pos += 1;
 
 	if (size < pos + (container->header->num_structures * 8)) {
-		esg_container_free(container);
+		if (arena == NULL) {
+			esg_container_free(container);
+		}
 		return NULL;
 	}
 
 	last_structure = NULL;
 	for (structure_index = 0; structure_index < container->header->num_structures; structure_index++) {
-		structure = (struct esg_container_structure *) malloc(sizeof(struct esg_container_structure));
-		memset(structure, 0, sizeof(struct esg_container_structure));
+		structure = (struct esg_container_structure *) esg_alloc(arena, sizeof(struct esg_container_structure));
 		structure->_next = NULL;
 
 		if (last_structure == NULL) {
@@ -82,7 +82,9 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 		pos += 3;
 
 		if (size < (structure->ptr + structure->length)) {
-			esg_container_free(container);
+			if (arena == NULL) {
+				esg_container_free(container);
+			}
 			return NULL;
 		}
 
@@ -91,11 +93,13 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 			case 0x01: {
 				switch (structure->id) {
 					case 0x00: {
-						structure->data = (void *) esg_encapsulation_structure_decode(buffer + structure->ptr, structure->length);
+						structure->data = (void *) esg_encapsulation_structure_decode_arena(buffer + structure->ptr, structure->length, arena);
 						break;
 					}
 					default: {
-						esg_container_free(container);
+						if (arena == NULL) {
+							esg_container_free(container);
+						}
 						return NULL;
 					}
 				}
@@ -104,11 +108,13 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 			case 0x02: {
 				switch (structure->id) {
 					case 0x00: {
-						structure->data = (void *) esg_string_repository_decode(buffer + structure->ptr, structure->length);
+						structure->data = (void *) esg_string_repository_decode_arena(buffer + structure->ptr, structure->length, arena);
 						break;
 					}
 					default: {
-						esg_container_free(container);
+						if (arena == NULL) {
+							esg_container_free(container);
+						}
 						return NULL;
 					}
 				}
@@ -129,11 +135,13 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 			case 0xE0: {
 				switch (structure->id) {
 					case 0x00: {
-						structure->data = (void *) esg_data_repository_decode(buffer + structure->ptr, structure->length);
+						structure->data = (void *) esg_data_repository_decode_arena(buffer + structure->ptr, structure->length, arena);
 						break;
 					}
 					default: {
-						esg_container_free(container);
+						if (arena == NULL) {
+							esg_container_free(container);
+						}
 						return NULL;
 					}
 				}
@@ -142,11 +150,13 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 			case 0xE1: {
 				switch (structure->id) {
 					case 0xFF: {
-						structure->data = (void *) esg_session_partition_declaration_decode(buffer + structure->ptr, structure->length);
+						structure->data = (void *) esg_session_partition_declaration_decode_arena(buffer + structure->ptr, structure->length, arena);
 						break;
 					}
 					default: {
-						esg_container_free(container);
+						if (arena == NULL) {
+							esg_container_free(container);
+						}
 						return NULL;
 					}
 				}
@@ -155,18 +165,22 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 			case 0xE2: {
 				switch (structure->id) {
 					case 0x00: {
-						structure->data = (void *) esg_init_message_decode(buffer + structure->ptr, structure->length);
+						structure->data = (void *) esg_init_message_decode_arena(buffer + structure->ptr, structure->length, arena);
 						break;
 					}
 					default: {
-						esg_container_free(container);
+						if (arena == NULL) {
+							esg_container_free(container);
+						}
 						return NULL;
 					}
 				}
 				break;
 			}
 			default: {
-				esg_container_free(container);
+				if (arena == NULL) {
+					esg_container_free(container);
+				}
 				return NULL;
 			}
 		}
@@ -175,12 +189,16 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 	// Container structure body
 	container->structure_body_ptr = pos;
 	container->structure_body_length = size - pos;
-	container->structure_body = (uint8_t *) malloc(size - pos);
+	container->structure_body = (uint8_t *) esg_alloc(arena, size - pos);
 	memcpy(container->structure_body, buffer + pos, size - pos);
 
 	return container;
 }
 
+struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
+	return esg_container_decode_arena(buffer, size, NULL);
+}
+
 void esg_container_free(struct esg_container *container) {
 	struct esg_container_structure *structure;
 	struct esg_container_structure *next_structure;
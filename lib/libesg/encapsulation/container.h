@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <libesg/arena.h>
 
 /**
  * esg_container_structure structure.
@@ -69,6 +70,21 @@ struct esg_container {
  */
 extern struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size);
 
+/**
+ * Process an esg_container, allocating the container and all its decoded
+ * structures from an arena. With an arena of about twice the size of the
+ * buffer this is a single contiguous block. The result must not be passed to
+ * esg_container_free(); it is released with esg_arena_reset() or
+ * esg_arena_destroy(), which may also be used to discard a partial decode
+ * after an error.
+ *
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @param arena Arena to allocate from, or NULL to use the heap.
+ * @return Pointer to an esg_container structure, or NULL on error.
+ */
+extern struct esg_container *esg_container_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena);
+
 /**
  * Free an esg_container.
  *
@@ -21,25 +21,29 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <libesg/arena.h>
 #include <libesg/encapsulation/data_repository.h>
 
-struct esg_data_repository *esg_data_repository_decode(uint8_t *buffer, uint32_t size) {
+struct esg_data_repository *esg_data_repository_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena) {
 	struct esg_data_repository *data_repository;
 
 	if ((buffer == NULL) || (size <= 0)) {
 		return NULL;
 	}
 
-	data_repository = (struct esg_data_repository *) malloc(sizeof(struct esg_data_repository));
-	memset(data_repository, 0, sizeof(struct esg_data_repository));
+	data_repository = (struct esg_data_repository *) esg_alloc(arena, sizeof(struct esg_data_repository));
 
 	data_repository->length = size;
-	data_repository->data = (uint8_t *) malloc(size);
+	data_repository->data = (uint8_t *) esg_alloc(arena, size);
 	memcpy(data_repository->data, buffer, size);
 
 	return data_repository;
 }
 
+struct esg_data_repository *esg_data_repository_decode(uint8_t *buffer, uint32_t size) {
+	return esg_data_repository_decode_arena(buffer, size, NULL);
+}
+
 void esg_data_repository_free(struct esg_data_repository *data_repository) {
 	if (data_repository == NULL) {
 		return;
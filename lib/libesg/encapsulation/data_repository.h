@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <libesg/arena.h>
 
 /**
  * esg_data_repository structure.
@@ -45,6 +46,16 @@ struct esg_data_repository {
  */
 extern struct esg_data_repository *esg_data_repository_decode(uint8_t *buffer, uint32_t size);
 
+/**
+ * Process an esg_data_repository, allocating everything from an arena.
+ *
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @param arena Arena to allocate from, or NULL to use the heap.
+ * @return Pointer to an esg_data_repository structure, or NULL on error.
+ */
+extern struct esg_data_repository *esg_data_repository_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena);
+
 /**
  * Free an esg_data_repository.
  *
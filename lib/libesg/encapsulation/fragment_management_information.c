@@ -21,9 +21,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <libesg/arena.h>
 #include <libesg/encapsulation/fragment_management_information.h>
 
-struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *buffer, uint32_t size) {
+struct esg_encapsulation_structure *esg_encapsulation_structure_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena) {
 	uint32_t pos;
 	struct esg_encapsulation_structure *structure;
 	struct esg_encapsulation_entry *entry;
@@ -35,12 +36,11 @@ struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *
 
 	pos = 0;
 
-	structure = (struct esg_encapsulation_structure *) malloc(sizeof(struct esg_encapsulation_structure));
-	memset(structure, 0, sizeof(struct esg_encapsulation_structure));
+	structure = (struct esg_encapsulation_structure *) esg_alloc(arena, sizeof(struct esg_encapsulation_structure));
 	structure->entry_list = NULL;
 
 	// Encapsulation header
-	structure->header = (struct esg_encapsulation_header *) malloc(sizeof(struct esg_encapsulation_header));
+	structure->header = (struct esg_encapsulation_header *) esg_alloc(arena, sizeof(struct esg_encapsulation_header));
 	// buffer[pos] reserved
 	structure->header->fragment_reference_format = buffer[pos+1];
 	pos += 2;
@@ -48,8 +48,7 @@ struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *
 	// Encapsulation entry list
 	last_entry = NULL;
 	while (size > pos) {
-		entry = (struct esg_encapsulation_entry *) malloc(sizeof(struct esg_encapsulation_entry));
-		memset(entry, 0, sizeof(struct esg_encapsulation_entry));
+		entry = (struct esg_encapsulation_entry *) esg_alloc(arena, sizeof(struct esg_encapsulation_entry));
 		entry->_next = NULL;
 
 		if (last_entry == NULL) {
@@ -62,8 +61,7 @@ struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *
 		// Fragment reference
 		switch (structure->header->fragment_reference_format) {
 			case 0x21: {
-				entry->fragment_reference = (struct esg_fragment_reference *) malloc(sizeof(struct esg_fragment_reference));
-				memset(entry->fragment_reference, 0, sizeof(struct esg_fragment_reference));
+				entry->fragment_reference = (struct esg_fragment_reference *) esg_alloc(arena, sizeof(struct esg_fragment_reference));
 
 				entry->fragment_reference->fragment_type = buffer[pos];
 				pos += 1;
@@ -74,7 +72,9 @@ struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *
 				break;
 			}
 			default: {
-				esg_encapsulation_structure_free(structure);
+				if (arena == NULL) {
+					esg_encapsulation_structure_free(structure);
+				}
 				return NULL;
 			}
 		}
@@ -90,6 +90,10 @@ struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *
 	return structure;
 }
 
+struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *buffer, uint32_t size) {
+	return esg_encapsulation_structure_decode_arena(buffer, size, NULL);
+}
+
 void esg_encapsulation_structure_free(struct esg_encapsulation_structure *structure) {
 	struct esg_encapsulation_entry *entry;
 	struct esg_encapsulation_entry *next_entry;
@@ -110,8 +114,6 @@ void esg_encapsulation_structure_free(struct esg_encapsulation_structure *struct
 			}
 			free(entry);
 		}
-
-		free(structure->entry_list);
 	}
 
 	free(structure);
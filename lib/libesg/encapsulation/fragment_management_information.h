@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <libesg/arena.h>
 
 /**
  * esg_encapsulation_header structure.
@@ -71,6 +72,16 @@ struct esg_encapsulation_structure {
  */
 extern struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *buffer, uint32_t size);
 
+/**
+ * Process an esg_encapsulation_structure, allocating everything from an arena.
+ *
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @param arena Arena to allocate from, or NULL to use the heap.
+ * @return Pointer to an esg_encapsulation_structure structure, or NULL on error.
+ */
+extern struct esg_encapsulation_structure *esg_encapsulation_structure_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena);
+
 /**
  * Free an esg_encapsulation_structure.
  *
@@ -21,26 +21,30 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <libesg/arena.h>
 #include <libesg/encapsulation/string_repository.h>
 
-struct esg_string_repository *esg_string_repository_decode(uint8_t *buffer, uint32_t size) {
+struct esg_string_repository *esg_string_repository_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena) {
 	struct esg_string_repository *string_repository;
 
 	if ((buffer == NULL) || (size <= 1)) {
 		return NULL;
 	}
 
-	string_repository = (struct esg_string_repository *) malloc(sizeof(struct esg_string_repository));
-	memset(string_repository, 0, sizeof(struct esg_string_repository));
+	string_repository = (struct esg_string_repository *) esg_alloc(arena, sizeof(struct esg_string_repository));
 
 	string_repository->encoding_type = buffer[0];
 	string_repository->length = size-1;
-	string_repository->data = (uint8_t *) malloc(size-1);
+	string_repository->data = (uint8_t *) esg_alloc(arena, size-1);
 	memcpy(string_repository->data, buffer+1, size-1);
 
 	return string_repository;
 }
 
+struct esg_string_repository *esg_string_repository_decode(uint8_t *buffer, uint32_t size) {
+	return esg_string_repository_decode_arena(buffer, size, NULL);
+}
+
 void esg_string_repository_free(struct esg_string_repository *string_repository) {
 	if (string_repository == NULL) {
 		return;
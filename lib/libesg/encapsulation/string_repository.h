@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <libesg/arena.h>
 
 /**
  * esg_string_repository structure.
@@ -46,6 +47,16 @@ struct esg_string_repository {
  */
 extern struct esg_string_repository *esg_string_repository_decode(uint8_t *buffer, uint32_t size);
 
+/**
+ * Process an esg_string_repository, allocating everything from an arena.
+ *
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @param arena Arena to allocate from, or NULL to use the heap.
+ * @return Pointer to an esg_string_repository structure, or NULL on error.
+ */
+extern struct esg_string_repository *esg_string_repository_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena);
+
 /**
  * Free an esg_string_repository.
  *
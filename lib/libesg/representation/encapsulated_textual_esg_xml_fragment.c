@@ -18,6 +18,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
  */
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -39,9 +40,14 @@ struct esg_encapsulated_textual_esg_xml_fragment *esg_encapsulated_textual_esg_x
 	esg_xml_fragment = (struct esg_encapsulated_textual_esg_xml_fragment *) malloc(sizeof(struct esg_encapsulated_textual_esg_xml_fragment));
 	memset(esg_xml_fragment, 0, sizeof(struct esg_encapsulated_textual_esg_xml_fragment));
 
+	if (size-pos <= 2) {
+		esg_encapsulated_textual_esg_xml_fragment_free(esg_xml_fragment);
+		return NULL;
+	}
+
 	offset_pos = vluimsbf8(buffer+pos+2, size-pos-2, &length);
 
-	if (size-pos-2 < offset_pos+length) {
+	if ((offset_pos == 0) || (offset_pos > size-pos-2) || (length > size-pos-2-offset_pos)) {
 		esg_encapsulated_textual_esg_xml_fragment_free(esg_xml_fragment);
 		return NULL;
 	}
@@ -57,6 +63,38 @@ struct esg_encapsulated_textual_esg_xml_fragment *esg_encapsulated_textual_esg_x
 	return esg_xml_fragment;
 }
 
+int esg_encapsulated_textual_esg_xml_fragment_inflate(uint8_t *buffer, uint32_t size,
+						      struct esg_gzip *gzip,
+						      esg_gzip_callback callback, void *arg,
+						      uint16_t *esg_xml_fragment_type) {
+	uint32_t length;
+	uint8_t offset_pos;
+	uint8_t *data;
+
+	if ((buffer == NULL) || (size <= 2)) {
+		return -EINVAL;
+	}
+
+	offset_pos = vluimsbf8(buffer+2, size-2, &length);
+	if ((offset_pos == 0) || (offset_pos > size-2) || (length > size-2-offset_pos)) {
+		return -EINVAL;
+	}
+
+	if (esg_xml_fragment_type) {
+		*esg_xml_fragment_type = (buffer[0] << 8) | buffer[1];
+	}
+	data = buffer+2+offset_pos;
+
+	if (esg_gzip_detect(data, length)) {
+		return esg_gzip_inflate(gzip, data, length, callback, arg);
+	}
+
+	if (length && callback(arg, data, length)) {
+		return -ECANCELED;
+	}
+	return length;
+}
+
 void esg_encapsulated_textual_esg_xml_fragment_free(struct esg_encapsulated_textual_esg_xml_fragment *esg_xml_fragment) {
 	if (esg_xml_fragment == NULL) {
 		return;
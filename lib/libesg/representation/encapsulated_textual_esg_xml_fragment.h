@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <libesg/representation/gzip.h>
 
 /**
  * esg_encapsulated_textual_esg_xml_fragment structure.
@@ -46,6 +47,24 @@ struct esg_encapsulated_textual_esg_xml_fragment {
  */
 extern struct esg_encapsulated_textual_esg_xml_fragment *esg_encapsulated_textual_esg_xml_fragment_decode(uint8_t *buffer, uint32_t size);
 
+/**
+ * Process an esg_encapsulated_textual_esg_xml_fragment in place, passing its
+ * data to a callback without copying the fragment. GZIP encoded data is
+ * detected and decompressed as it is passed on; other data is passed on as is.
+ *
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @param gzip GZIP decompressor to use.
+ * @param callback Callback for the (decompressed) data.
+ * @param arg Private argument passed to callback.
+ * @param esg_xml_fragment_type Set to the esg_xml_fragment_type, if not NULL.
+ * @return Length of the (decompressed) data, or < 0 on error.
+ */
+extern int esg_encapsulated_textual_esg_xml_fragment_inflate(uint8_t *buffer, uint32_t size,
+							     struct esg_gzip *gzip,
+							     esg_gzip_callback callback, void *arg,
+							     uint16_t *esg_xml_fragment_type);
+
 /**
  * Free an esg_encapsulated_textual_esg_xml_fragment.
  *
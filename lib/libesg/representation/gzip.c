@@ -0,0 +1,165 @@
+/*
+ * ESG parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <libesg/representation/gzip.h>
+
+struct esg_gzip {
+	z_stream stream;
+	uint32_t max_size;
+
+	uint8_t chunk[ESG_GZIP_CHUNK_SIZE];
+
+	// for esg_gzip_inflate_buffer()
+	uint8_t *buffer;
+	uint32_t buffer_size;
+	uint32_t buffer_length;
+};
+
+struct esg_gzip *esg_gzip_create(uint32_t max_size) {
+	struct esg_gzip *gzip;
+
+	gzip = (struct esg_gzip *) malloc(sizeof(struct esg_gzip));
+	if (gzip == NULL) {
+		return NULL;
+	}
+	memset(gzip, 0, sizeof(struct esg_gzip));
+	gzip->max_size = max_size;
+
+	// 16 + window bits: expect a gzip rather than zlib header
+	if (inflateInit2(&gzip->stream, 16 + MAX_WBITS) != Z_OK) {
+		free(gzip);
+		return NULL;
+	}
+
+	return gzip;
+}
+
+void esg_gzip_destroy(struct esg_gzip *gzip) {
+	if (gzip == NULL) {
+		return;
+	}
+
+	inflateEnd(&gzip->stream);
+	if (gzip->buffer) {
+		free(gzip->buffer);
+	}
+	free(gzip);
+}
+
+int esg_gzip_inflate(struct esg_gzip *gzip, uint8_t *buffer, uint32_t size,
+		     esg_gzip_callback callback, void *arg) {
+	z_stream *stream = &gzip->stream;
+	uint32_t total = 0;
+	uint32_t length;
+	int ret;
+
+	if ((buffer == NULL) || (size == 0)) {
+		return -EINVAL;
+	}
+
+	// keeps the window and state allocated by the previous fragment
+	inflateReset(stream);
+	stream->next_in = buffer;
+	stream->avail_in = size;
+
+	do {
+		stream->next_out = gzip->chunk;
+		stream->avail_out = ESG_GZIP_CHUNK_SIZE;
+
+		ret = inflate(stream, Z_NO_FLUSH);
+		if ((ret != Z_OK) && (ret != Z_STREAM_END)) {
+			return -EINVAL;
+		}
+
+		length = ESG_GZIP_CHUNK_SIZE - stream->avail_out;
+		if (length > gzip->max_size - total) {
+			return -EFBIG;
+		}
+		total += length;
+
+		if (length && callback(arg, gzip->chunk, length)) {
+			return -ECANCELED;
+		}
+
+		// out of input before the end of the stream: truncated
+		if ((ret == Z_OK) && (stream->avail_in == 0) && (stream->avail_out != 0)) {
+			return -EINVAL;
+		}
+	} while (ret != Z_STREAM_END);
+
+	return total;
+}
+
+int esg_gzip_inflate_buffer(struct esg_gzip *gzip, uint8_t *buffer, uint32_t size,
+			    uint8_t **data, uint32_t *length) {
+	z_stream *stream = &gzip->stream;
+	uint32_t new_size;
+	uint8_t *new_buffer;
+	int ret;
+
+	if ((buffer == NULL) || (size == 0)) {
+		return -EINVAL;
+	}
+
+	inflateReset(stream);
+	stream->next_in = buffer;
+	stream->avail_in = size;
+	gzip->buffer_length = 0;
+
+	// inflate straight into the buffer, growing it when full
+	do {
+		if (gzip->buffer_length == gzip->buffer_size) {
+			if (gzip->buffer_size >= gzip->max_size) {
+				return -EFBIG;
+			}
+			new_size = gzip->buffer_size ? gzip->buffer_size * 2 : ESG_GZIP_CHUNK_SIZE;
+			if (new_size > gzip->max_size) {
+				new_size = gzip->max_size;
+			}
+			new_buffer = (uint8_t *) realloc(gzip->buffer, new_size);
+			if (new_buffer == NULL) {
+				return -ENOMEM;
+			}
+			gzip->buffer = new_buffer;
+			gzip->buffer_size = new_size;
+		}
+
+		stream->next_out = gzip->buffer + gzip->buffer_length;
+		stream->avail_out = gzip->buffer_size - gzip->buffer_length;
+
+		ret = inflate(stream, Z_NO_FLUSH);
+		if ((ret != Z_OK) && (ret != Z_STREAM_END)) {
+			return -EINVAL;
+		}
+		gzip->buffer_length = gzip->buffer_size - stream->avail_out;
+
+		if ((ret == Z_OK) && (stream->avail_in == 0) && (stream->avail_out != 0)) {
+			return -EINVAL;
+		}
+	} while (ret != Z_STREAM_END);
+
+	*data = gzip->buffer;
+	*length = gzip->buffer_length;
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * ESG parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _ESG_REPRESENTATION_GZIP_H
+#define _ESG_REPRESENTATION_GZIP_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * Size of the chunks in which decompressed data is delivered.
+ */
+#define ESG_GZIP_CHUNK_SIZE 16384
+
+/**
+ * Opaque structure holding the inflate state and output buffers, which are
+ * reused for every fragment decompressed with it.
+ */
+struct esg_gzip;
+
+/**
+ * Callback receiving decompressed data. The data is only valid for the
+ * duration of the callback.
+ *
+ * @param arg Private argument.
+ * @param data Pointer to the data.
+ * @param length Number of bytes of data.
+ * @return 0 to continue, nonzero to abort decompression.
+ */
+typedef int (*esg_gzip_callback)(void *arg, uint8_t *data, uint32_t length);
+
+/**
+ * Create a GZIP decompressor.
+ *
+ * @param max_size Maximum number of bytes a single fragment may decompress
+ * to. Larger fragments are rejected, bounding the memory used.
+ * @return The decompressor, or NULL on failure.
+ */
+extern struct esg_gzip *esg_gzip_create(uint32_t max_size);
+
+/**
+ * Destroy a GZIP decompressor.
+ *
+ * @param gzip The decompressor.
+ */
+extern void esg_gzip_destroy(struct esg_gzip *gzip);
+
+/**
+ * Check whether data starts with the GZIP magic number.
+ *
+ * @param buffer Binary buffer.
+ * @param size Binary buffer size.
+ * @return 1 if the data is GZIP encoded, 0 if not.
+ */
+static inline int esg_gzip_detect(uint8_t *buffer, uint32_t size)
+{
+	return (size >= 2) && (buffer[0] == 0x1f) && (buffer[1] == 0x8b);
+}
+
+/**
+ * Decompress GZIP data, passing it to a callback in chunks of up to
+ * ESG_GZIP_CHUNK_SIZE bytes as it is inflated. The whole fragment is never
+ * held in memory.
+ *
+ * @param gzip The decompressor.
+ * @param buffer GZIP data.
+ * @param size Size of the GZIP data.
+ * @param callback Callback for decompressed data.
+ * @param arg Private argument passed to callback.
+ * @return Number of bytes decompressed, or < 0 on error (-EFBIG if the
+ * fragment exceeds max_size, -EINVAL if the data is corrupt, -ECANCELED if the
+ * callback aborted).
+ */
+extern int esg_gzip_inflate(struct esg_gzip *gzip, uint8_t *buffer, uint32_t size,
+			    esg_gzip_callback callback, void *arg);
+
+/**
+ * Decompress GZIP data into the decompressor's own buffer, which grows as
+ * needed up to max_size and is reused by later calls.
+ *
+ * @param gzip The decompressor.
+ * @param buffer GZIP data.
+ * @param size Size of the GZIP data.
+ * @param data Set to point to the decompressed data, valid until the next call.
+ * @param length Set to the length of the decompressed data.
+ * @return 0 on success, or < 0 on error as for esg_gzip_inflate() (or -ENOMEM).
+ */
+extern int esg_gzip_inflate_buffer(struct esg_gzip *gzip, uint8_t *buffer, uint32_t size,
+				   uint8_t **data, uint32_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,11 +21,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <libesg/arena.h>
 #include <libesg/representation/init_message.h>
 #include <libesg/representation/textual_decoder_init.h>
 #include <libesg/representation/bim_decoder_init.h>
 
-struct esg_init_message *esg_init_message_decode(uint8_t *buffer, uint32_t size) {
+struct esg_init_message *esg_init_message_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena) {
 	uint32_t pos;
 	struct esg_init_message *init_message;
 
@@ -35,8 +36,7 @@ struct esg_init_message *esg_init_message_decode(uint8_t *buffer, uint32_t size)
 
 	pos = 0;
 
-	init_message = (struct esg_init_message *) malloc(sizeof(struct esg_init_message));
-	memset(init_message, 0, sizeof(struct esg_init_message));
+	init_message = (struct esg_init_message *) esg_alloc(arena, sizeof(struct esg_init_message));
 
 	init_message->encoding_version = buffer[pos];
 	pos += 1;
@@ -54,8 +54,7 @@ struct esg_init_message *esg_init_message_decode(uint8_t *buffer, uint32_t size)
 
 	switch (init_message->encoding_version) {
 		case 0xF1: {
-			struct esg_bim_encoding_parameters *encoding_parameters = (struct esg_bim_encoding_parameters *) malloc(sizeof(struct esg_bim_encoding_parameters));
-			memset(encoding_parameters, 0, sizeof(struct esg_bim_encoding_parameters));
+			struct esg_bim_encoding_parameters *encoding_parameters = (struct esg_bim_encoding_parameters *) esg_alloc(arena, sizeof(struct esg_bim_encoding_parameters));
 			init_message->encoding_parameters = (void *) encoding_parameters;
 
 			encoding_parameters->buffer_size_flag = (buffer[pos] & 0x80) >> 7;
@@ -76,18 +75,19 @@ struct esg_init_message *esg_init_message_decode(uint8_t *buffer, uint32_t size)
 		}
 		case 0xF2:
 		case 0xF3: {
-			struct esg_textual_encoding_parameters *encoding_parameters = (struct esg_textual_encoding_parameters *) malloc(sizeof(struct esg_textual_encoding_parameters));
-			memset(encoding_parameters, 0, sizeof(struct esg_textual_encoding_parameters));
+			struct esg_textual_encoding_parameters *encoding_parameters = (struct esg_textual_encoding_parameters *) esg_alloc(arena, sizeof(struct esg_textual_encoding_parameters));
 			init_message->encoding_parameters = (void *) encoding_parameters;
 
 			encoding_parameters->character_encoding = buffer[pos];
 			pos += 1;
 
-			init_message->decoder_init = (void *) esg_textual_decoder_init_decode(buffer + init_message->decoder_init_ptr, size - init_message->decoder_init_ptr);
+			init_message->decoder_init = (void *) esg_textual_decoder_init_decode_arena(buffer + init_message->decoder_init_ptr, size - init_message->decoder_init_ptr, arena);
 			break;
 		}
 		default: {
-			esg_init_message_free(init_message);
+			if (arena == NULL) {
+				esg_init_message_free(init_message);
+			}
 			return NULL;
 		}
 	}
@@ -95,6 +95,10 @@ struct esg_init_message *esg_init_message_decode(uint8_t *buffer, uint32_t size)
 	return init_message;
 }
 
+struct esg_init_message *esg_init_message_decode(uint8_t *buffer, uint32_t size) {
+	return esg_init_message_decode_arena(buffer, size, NULL);
+}
+
 void esg_init_message_free(struct esg_init_message *init_message) {
 	if (init_message == NULL) {
 		return;
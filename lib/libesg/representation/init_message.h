@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <libesg/arena.h>
 
 /**
  * esg_textual_encoding_parameters structure.
@@ -66,6 +67,16 @@ struct esg_init_message {
  */
 extern struct esg_init_message *esg_init_message_decode(uint8_t *buffer, uint32_t size);
 
+/**
+ * Process an esg_init_message, allocating everything from an arena.
+ *
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @param arena Arena to allocate from, or NULL to use the heap.
+ * @return Pointer to an esg_init_message structure, or NULL on error.
+ */
+extern struct esg_init_message *esg_init_message_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena);
+
 /**
  * Free an esg_init_message.
  *
@@ -21,10 +21,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <libesg/arena.h>
 #include <libesg/types.h>
 #include <libesg/representation/textual_decoder_init.h>
 
-struct esg_textual_decoder_init *esg_textual_decoder_init_decode(uint8_t *buffer, uint32_t size) {
+struct esg_textual_decoder_init *esg_textual_decoder_init_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena) {
 	uint32_t pos;
 	struct esg_textual_decoder_init *decoder_init;
 	struct esg_namespace_prefix *namespace_prefix;
@@ -40,8 +41,7 @@ struct esg_textual_decoder_init *esg_textual_decoder_init_decode(uint8_t *buffer
 
 	pos = 0;
 
-	decoder_init = (struct esg_textual_decoder_init *) malloc(sizeof(struct esg_textual_decoder_init));
-	memset(decoder_init, 0, sizeof(struct esg_textual_decoder_init));
+	decoder_init = (struct esg_textual_decoder_init *) esg_alloc(arena, sizeof(struct esg_textual_decoder_init));
 	decoder_init->namespace_prefix_list = NULL;
 	decoder_init->xml_fragment_type_list = NULL;
 
@@ -51,7 +51,9 @@ struct esg_textual_decoder_init *esg_textual_decoder_init_decode(uint8_t *buffer
 	pos += vluimsbf8(buffer+pos, size-pos, &decoder_init_length);
 
 	if (size < pos + decoder_init_length) {
-		esg_textual_decoder_init_free(decoder_init);
+		if (arena == NULL) {
+			esg_textual_decoder_init_free(decoder_init);
+		}
 		return NULL;
 	}
 
@@ -60,8 +62,7 @@ struct esg_textual_decoder_init *esg_textual_decoder_init_decode(uint8_t *buffer
 
 	last_namespace_prefix = NULL;
 	for (num_index = 0; num_index < decoder_init->num_namespace_prefixes; num_index++) {
-		namespace_prefix = (struct esg_namespace_prefix *) malloc(sizeof(struct esg_namespace_prefix));
-		memset(namespace_prefix, 0, sizeof(struct esg_namespace_prefix));
+		namespace_prefix = (struct esg_namespace_prefix *) esg_alloc(arena, sizeof(struct esg_namespace_prefix));
 		namespace_prefix->_next = NULL;
 
 		if (last_namespace_prefix == NULL) {
@@ -83,8 +84,7 @@ struct esg_textual_decoder_init *esg_textual_decoder_init_decode(uint8_t *buffer
 
 	last_xml_fragment_type = NULL;
 	for (num_index = 0; num_index < decoder_init->num_fragment_types; num_index++) {
-		xml_fragment_type = (struct esg_xml_fragment_type *) malloc(sizeof(struct esg_xml_fragment_type));
-		memset(xml_fragment_type, 0, sizeof(struct esg_xml_fragment_type));
+		xml_fragment_type = (struct esg_xml_fragment_type *) esg_alloc(arena, sizeof(struct esg_xml_fragment_type));
 		xml_fragment_type->_next = NULL;
 
 		if (last_xml_fragment_type == NULL) {
@@ -104,6 +104,10 @@ struct esg_textual_decoder_init *esg_textual_decoder_init_decode(uint8_t *buffer
 	return decoder_init;
 }
 
+struct esg_textual_decoder_init *esg_textual_decoder_init_decode(uint8_t *buffer, uint32_t size) {
+	return esg_textual_decoder_init_decode_arena(buffer, size, NULL);
+}
+
 void esg_textual_decoder_init_free(struct esg_textual_decoder_init *decoder_init) {
 	struct esg_namespace_prefix *namespace_prefix;
 	struct esg_namespace_prefix *next_namespace_prefix;
@@ -0,0 +1,292 @@
+/*
+ * ESG parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libesg/encapsulation/fragment_management_information.h>
+#include <libesg/transport/fragment_index.h>
+
+#define FRAGMENT_INDEX_MIN_BITS 6
+#define FRAGMENT_INDEX_TOI_BITS 8
+
+struct esg_fragment_index_toi {
+	uint32_t transport_object_id;
+	struct esg_fragment_location *location_list;
+
+	struct esg_fragment_index_toi *_next;
+};
+
+struct esg_fragment_index {
+	uint32_t id_bits;
+	uint32_t count;
+	struct esg_fragment_location **id_buckets;
+	struct esg_fragment_index_toi *toi_buckets[1 << FRAGMENT_INDEX_TOI_BITS];
+};
+
+static inline uint32_t fragment_index_hash(uint32_t value, uint32_t bits) {
+	return (value * 2654435761U) >> (32 - bits);
+}
+
+static struct esg_fragment_index_toi *fragment_index_find_toi(struct esg_fragment_index *index, uint32_t transport_object_id) {
+	struct esg_fragment_index_toi *toi;
+
+	toi = index->toi_buckets[fragment_index_hash(transport_object_id, FRAGMENT_INDEX_TOI_BITS)];
+	while (toi) {
+		if (toi->transport_object_id == transport_object_id) {
+			return toi;
+		}
+		toi = toi->_next;
+	}
+
+	return NULL;
+}
+
+static void fragment_index_unlink_id(struct esg_fragment_index *index, struct esg_fragment_location *location) {
+	struct esg_fragment_location **prev;
+
+	prev = &index->id_buckets[fragment_index_hash(location->fragment_id, index->id_bits)];
+	while (*prev) {
+		if (*prev == location) {
+			*prev = location->_id_next;
+			index->count--;
+			return;
+		}
+		prev = &(*prev)->_id_next;
+	}
+}
+
+static void fragment_index_unlink_toi(struct esg_fragment_index *index, struct esg_fragment_location *location) {
+	struct esg_fragment_index_toi *toi;
+	struct esg_fragment_location **prev;
+
+	toi = fragment_index_find_toi(index, location->transport_object_id);
+	if (toi == NULL) {
+		return;
+	}
+
+	prev = &toi->location_list;
+	while (*prev) {
+		if (*prev == location) {
+			*prev = location->_toi_next;
+			return;
+		}
+		prev = &(*prev)->_toi_next;
+	}
+}
+
+static void fragment_index_grow(struct esg_fragment_index *index) {
+	struct esg_fragment_location **id_buckets;
+	struct esg_fragment_location *location;
+	struct esg_fragment_location *next;
+	uint32_t bucket;
+	uint32_t i;
+
+	id_buckets = (struct esg_fragment_location **) calloc(1 << (index->id_bits + 1), sizeof(struct esg_fragment_location *));
+	if (id_buckets == NULL) {
+		// keep going with longer chains
+		return;
+	}
+
+	for (i = 0; i < (1U << index->id_bits); i++) {
+		for (location = index->id_buckets[i]; location; location = next) {
+			next = location->_id_next;
+			bucket = fragment_index_hash(location->fragment_id, index->id_bits + 1);
+			location->_id_next = id_buckets[bucket];
+			id_buckets[bucket] = location;
+		}
+	}
+
+	free(index->id_buckets);
+	index->id_buckets = id_buckets;
+	index->id_bits++;
+}
+
+struct esg_fragment_index *esg_fragment_index_create(void) {
+	struct esg_fragment_index *index;
+
+	index = (struct esg_fragment_index *) calloc(1, sizeof(struct esg_fragment_index));
+	if (index == NULL) {
+		return NULL;
+	}
+
+	index->id_bits = FRAGMENT_INDEX_MIN_BITS;
+	index->id_buckets = (struct esg_fragment_location **) calloc(1 << index->id_bits, sizeof(struct esg_fragment_location *));
+	if (index->id_buckets == NULL) {
+		free(index);
+		return NULL;
+	}
+
+	return index;
+}
+
+void esg_fragment_index_destroy(struct esg_fragment_index *index) {
+	struct esg_fragment_index_toi *toi;
+	struct esg_fragment_index_toi *next_toi;
+	struct esg_fragment_location *location;
+	struct esg_fragment_location *next_location;
+	uint32_t i;
+
+	if (index == NULL) {
+		return;
+	}
+
+	for (i = 0; i < (1 << FRAGMENT_INDEX_TOI_BITS); i++) {
+		for (toi = index->toi_buckets[i]; toi; toi = next_toi) {
+			next_toi = toi->_next;
+			for (location = toi->location_list; location; location = next_location) {
+				next_location = location->_toi_next;
+				free(location);
+			}
+			free(toi);
+		}
+	}
+
+	free(index->id_buckets);
+	free(index);
+}
+
+void esg_fragment_index_remove_transport_object(struct esg_fragment_index *index, uint32_t transport_object_id) {
+	struct esg_fragment_index_toi **prev;
+	struct esg_fragment_index_toi *toi;
+	struct esg_fragment_location *location;
+	struct esg_fragment_location *next;
+
+	prev = &index->toi_buckets[fragment_index_hash(transport_object_id, FRAGMENT_INDEX_TOI_BITS)];
+	while (*prev) {
+		toi = *prev;
+		if (toi->transport_object_id == transport_object_id) {
+			*prev = toi->_next;
+			for (location = toi->location_list; location; location = next) {
+				next = location->_toi_next;
+				fragment_index_unlink_id(index, location);
+				free(location);
+			}
+			free(toi);
+			return;
+		}
+		prev = &toi->_next;
+	}
+}
+
+int esg_fragment_index_add_container(struct esg_fragment_index *index, uint32_t transport_object_id, struct esg_container *container) {
+	struct esg_container_structure *structure;
+	struct esg_encapsulation_structure *encapsulation;
+	struct esg_encapsulation_entry *entry;
+	struct esg_fragment_index_toi *toi;
+	struct esg_fragment_location *location;
+	uint32_t bucket;
+	int count;
+
+	if ((index == NULL) || (container == NULL) || (container->header == NULL)) {
+		return -1;
+	}
+
+	esg_fragment_index_remove_transport_object(index, transport_object_id);
+
+	toi = (struct esg_fragment_index_toi *) calloc(1, sizeof(struct esg_fragment_index_toi));
+	if (toi == NULL) {
+		return -1;
+	}
+	toi->transport_object_id = transport_object_id;
+	bucket = fragment_index_hash(transport_object_id, FRAGMENT_INDEX_TOI_BITS);
+	toi->_next = index->toi_buckets[bucket];
+	index->toi_buckets[bucket] = toi;
+
+	count = 0;
+	esg_container_header_structure_list_for_each(container->header, structure) {
+		if ((structure->type != 0x01) || (structure->id != 0x00) || (structure->data == NULL)) {
+			continue;
+		}
+		encapsulation = (struct esg_encapsulation_structure *) structure->data;
+
+		esg_encapsulation_structure_entry_list_for_each(encapsulation, entry) {
+			if (entry->fragment_reference == NULL) {
+				continue;
+			}
+
+			location = esg_fragment_index_find(index, entry->fragment_id);
+			if (location) {
+				// only a newer version (modulo 256) takes over from another container
+				if ((int8_t) (entry->fragment_version - location->fragment_version) < 0) {
+					continue;
+				}
+				if ((location->transport_object_id == transport_object_id) &&
+				    (location->fragment_version == entry->fragment_version)) {
+					continue;
+				}
+				fragment_index_unlink_id(index, location);
+				fragment_index_unlink_toi(index, location);
+				free(location);
+			}
+
+			location = (struct esg_fragment_location *) malloc(sizeof(struct esg_fragment_location));
+			if (location == NULL) {
+				return -1;
+			}
+			location->fragment_id = entry->fragment_id;
+			location->fragment_version = entry->fragment_version;
+			location->fragment_type = entry->fragment_reference->fragment_type;
+			location->transport_object_id = transport_object_id;
+			location->data_repository_offset = entry->fragment_reference->data_repository_offset;
+
+			location->_toi_next = toi->location_list;
+			toi->location_list = location;
+
+			if (index->count >= (2U << index->id_bits)) {
+				fragment_index_grow(index);
+			}
+			bucket = fragment_index_hash(location->fragment_id, index->id_bits);
+			location->_id_next = index->id_buckets[bucket];
+			index->id_buckets[bucket] = location;
+			index->count++;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+struct esg_fragment_location *esg_fragment_index_find(struct esg_fragment_index *index, uint32_t fragment_id) {
+	struct esg_fragment_location *location;
+
+	location = index->id_buckets[fragment_index_hash(fragment_id, index->id_bits)];
+	while (location) {
+		if (location->fragment_id == fragment_id) {
+			return location;
+		}
+		location = location->_id_next;
+	}
+
+	return NULL;
+}
+
+struct esg_fragment_location *esg_fragment_index_transport_object_first(struct esg_fragment_index *index, uint32_t transport_object_id) {
+	struct esg_fragment_index_toi *toi;
+
+	toi = fragment_index_find_toi(index, transport_object_id);
+	if (toi == NULL) {
+		return NULL;
+	}
+
+	return toi->location_list;
+}
+
+uint32_t esg_fragment_index_count(struct esg_fragment_index *index) {
+	return index->count;
+}
@@ -0,0 +1,127 @@
+/*
+ * ESG parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _ESG_TRANSPORT_FRAGMENT_INDEX_H
+#define _ESG_TRANSPORT_FRAGMENT_INDEX_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libesg/encapsulation/container.h>
+
+/**
+ * esg_fragment_location structure: where the current version of a fragment is
+ * carried.
+ */
+struct esg_fragment_location {
+	uint32_t fragment_id;
+	uint8_t fragment_version;
+	uint8_t fragment_type;
+	uint32_t transport_object_id; // TOI of the container carrying the fragment
+	uint32_t data_repository_offset;
+
+	struct esg_fragment_location *_id_next;
+	struct esg_fragment_location *_toi_next;
+};
+
+/**
+ * Opaque structure representing a fragment index.
+ */
+struct esg_fragment_index;
+
+/**
+ * Create an empty fragment index.
+ *
+ * @return Pointer to an esg_fragment_index, or NULL on error.
+ */
+extern struct esg_fragment_index *esg_fragment_index_create(void);
+
+/**
+ * Free a fragment index.
+ *
+ * @param index Pointer to an esg_fragment_index.
+ */
+extern void esg_fragment_index_destroy(struct esg_fragment_index *index);
+
+/**
+ * Index the fragments of a newly received container, replacing whatever was
+ * indexed before for the same transport object. Fragments moving between
+ * containers are only replaced by a version at least as new.
+ *
+ * @param index Pointer to an esg_fragment_index.
+ * @param transport_object_id TOI the container was received as.
+ * @param container The decoded container.
+ * @return Number of fragments indexed, or < 0 on error.
+ */
+extern int esg_fragment_index_add_container(struct esg_fragment_index *index, uint32_t transport_object_id, struct esg_container *container);
+
+/**
+ * Remove all fragments of a transport object from the index.
+ *
+ * @param index Pointer to an esg_fragment_index.
+ * @param transport_object_id The TOI.
+ */
+extern void esg_fragment_index_remove_transport_object(struct esg_fragment_index *index, uint32_t transport_object_id);
+
+/**
+ * Look up a fragment by fragment_id.
+ *
+ * @param index Pointer to an esg_fragment_index.
+ * @param fragment_id The fragment_id.
+ * @return Pointer to the fragment location, or NULL if not found. It stays valid
+ * until the transport object carrying it is replaced or removed.
+ */
+extern struct esg_fragment_location *esg_fragment_index_find(struct esg_fragment_index *index, uint32_t fragment_id);
+
+/**
+ * Get the first fragment indexed for a transport object.
+ *
+ * @param index Pointer to an esg_fragment_index.
+ * @param transport_object_id The TOI.
+ * @return Pointer to the fragment location, or NULL if there are none.
+ */
+extern struct esg_fragment_location *esg_fragment_index_transport_object_first(struct esg_fragment_index *index, uint32_t transport_object_id);
+
+/**
+ * Get the number of fragments in the index.
+ *
+ * @param index Pointer to an esg_fragment_index.
+ * @return The number of fragments.
+ */
+extern uint32_t esg_fragment_index_count(struct esg_fragment_index *index);
+
+/**
+ * Convenience iterator for the fragments of a transport object.
+ *
+ * @param index The esg_fragment_index pointer.
+ * @param transport_object_id The TOI.
+ * @param location Variable holding a pointer to the current esg_fragment_location.
+ */
+#define esg_fragment_index_transport_object_for_each(index, transport_object_id, location) \
+	for ((location) = esg_fragment_index_transport_object_first(index, transport_object_id); \
+	     (location); \
+	     (location) = (location)->_toi_next)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,9 +21,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <libesg/arena.h>
 #include <libesg/transport/session_partition_declaration.h>
 
-struct esg_session_partition_declaration *esg_session_partition_declaration_decode(uint8_t *buffer, uint32_t size) {
+struct esg_session_partition_declaration *esg_session_partition_declaration_decode_arena(uint8_t *buffer, uint32_t size, struct esg_arena *arena) {
 	uint32_t pos;
 	struct esg_session_partition_declaration *partition;
 	struct esg_session_field *field;
@@ -45,8 +46,7 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 
 	pos = 0;
 
-	partition = (struct esg_session_partition_declaration *) malloc(sizeof(struct esg_session_partition_declaration));
-	memset(partition, 0, sizeof(struct esg_session_partition_declaration));
+	partition = (struct esg_session_partition_declaration *) esg_alloc(arena, sizeof(struct esg_session_partition_declaration));
 	partition->field_list = NULL;
 	partition->ip_stream_list = NULL;
 
@@ -57,14 +57,15 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 	pos += 1;
 
 	if (size < (pos + 5*(partition->num_fields))) {
-		esg_session_partition_declaration_free(partition);
+		if (arena == NULL) {
+			esg_session_partition_declaration_free(partition);
+		}
 		return NULL;
 	}
 
 	last_field = NULL;
 	for (field_index = 0; field_index < partition->num_fields; field_index++) {
-		field = (struct esg_session_field *) malloc(sizeof(struct esg_session_field));
-		memset(field, 0, sizeof(struct esg_session_field));
+		field = (struct esg_session_field *) esg_alloc(arena, sizeof(struct esg_session_field));
 		field->_next = NULL;
 
 		if (last_field == NULL) {
@@ -92,8 +93,7 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 
 	last_ip_stream = NULL;
 	for (ip_stream_index = 0; ip_stream_index < partition->n_o_ip_streams; ip_stream_index++) {
-		ip_stream = (struct esg_session_ip_stream *) malloc(sizeof(struct esg_session_ip_stream));
-		memset(ip_stream, 0, sizeof(struct esg_session_ip_stream));
+		ip_stream = (struct esg_session_ip_stream *) esg_alloc(arena, sizeof(struct esg_session_ip_stream));
 		ip_stream->_next = NULL;
 
 		if (last_ip_stream == NULL) {
@@ -127,8 +127,7 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 
 		last_ip_stream_field = NULL;
 		esg_session_partition_declaration_field_list_for_each(partition, field) {
-			ip_stream_field = (struct esg_session_ip_stream_field *) malloc(sizeof(struct esg_session_ip_stream_field));
-			memset(ip_stream_field, 0, sizeof(struct esg_session_ip_stream_field));
+			ip_stream_field = (struct esg_session_ip_stream_field *) esg_alloc(arena, sizeof(struct esg_session_ip_stream_field));
 			ip_stream_field->_next = NULL;
 			ip_stream_field->start_field_value = NULL;
 			ip_stream_field->end_field_value = NULL;
@@ -150,23 +149,19 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 			switch (field->encoding) {
 				case 0x0000: {
 					if (partition->overlapping == 1) {
-						field_value = (union esg_session_ip_stream_field_value *) malloc(sizeof(union esg_session_ip_stream_field_value));
-						memset(field_value, 0, sizeof(union esg_session_ip_stream_field_value));
+						field_value = (union esg_session_ip_stream_field_value *) esg_alloc(arena, sizeof(union esg_session_ip_stream_field_value));
 						ip_stream_field->start_field_value = field_value;
 
-						field_buffer = (uint8_t *) malloc(field_length);
-						memset(field_buffer, 0, field_length);
+						field_buffer = (uint8_t *) esg_alloc(arena, field_length);
 						memcpy(field_buffer, buffer + pos, field_length);
 
 						ip_stream_field->start_field_value->string = field_buffer;
 						pos += field_length;
 					}
-					field_value = (union esg_session_ip_stream_field_value *) malloc(sizeof(union esg_session_ip_stream_field_value));
-					memset(field_value, 0, sizeof(union esg_session_ip_stream_field_value));
+					field_value = (union esg_session_ip_stream_field_value *) esg_alloc(arena, sizeof(union esg_session_ip_stream_field_value));
 					ip_stream_field->end_field_value = field_value;
 
-					field_buffer = (uint8_t *) malloc(field_length);
-					memset(field_buffer, 0, field_length);
+					field_buffer = (uint8_t *) esg_alloc(arena, field_length);
 					memcpy(field_buffer, buffer + pos, field_length);
 
 					ip_stream_field->end_field_value->string = field_buffer;
@@ -176,15 +171,13 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 				}
 				case 0x0101: {
 					if (partition->overlapping == 1) {
-						field_value = (union esg_session_ip_stream_field_value *) malloc(sizeof(union esg_session_ip_stream_field_value));
-						memset(field_value, 0, sizeof(union esg_session_ip_stream_field_value));
+						field_value = (union esg_session_ip_stream_field_value *) esg_alloc(arena, sizeof(union esg_session_ip_stream_field_value));
 						ip_stream_field->start_field_value = field_value;
 
 						ip_stream_field->start_field_value->unsigned_short = (buffer[pos] << 8) | buffer[pos+1];
 						pos += field_length;
 					}
-					field_value = (union esg_session_ip_stream_field_value *) malloc(sizeof(union esg_session_ip_stream_field_value));
-					memset(field_value, 0, sizeof(union esg_session_ip_stream_field_value));
+					field_value = (union esg_session_ip_stream_field_value *) esg_alloc(arena, sizeof(union esg_session_ip_stream_field_value));
 					ip_stream_field->end_field_value = field_value;
 
 					ip_stream_field->end_field_value->unsigned_short = (buffer[pos] << 8) | buffer[pos+1];
@@ -193,7 +186,9 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 					break;
 				}
 				default: {
-					esg_session_partition_declaration_free(partition);
+					if (arena == NULL) {
+						esg_session_partition_declaration_free(partition);
+					}
 					return NULL;
 				}
 			}
@@ -203,6 +198,10 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 	return partition;
 }
 
+struct esg_session_partition_declaration *esg_session_partition_declaration_decode(uint8_t *buffer, uint32_t size) {
+	return esg_session_partition_declaration_decode_arena(buffer, size, NULL);
+}
+
 void esg_session_partition_declaration_free(struct esg_session_partition_declaration *partition) {
 	struct esg_session_field *field;
 	struct esg_session_field *next_field;
@@ -219,7 +218,7 @@ void esg_session_partition_declaration_free(struct esg_session_partition_declara
 		next_ip_stream = ip_stream->_next;
 
 		field = partition->field_list;
-		for(ip_stream_field = next_ip_stream->field_list; ip_stream_field; ip_stream_field = next_ip_stream_field) {
+		for(ip_stream_field = ip_stream->field_list; ip_stream_field; ip_stream_field = next_ip_stream_field) {
 			next_ip_stream_field = ip_stream_field->_next;
 
 			switch (field->encoding) {
@@ -31,6 +31,18 @@
 
 #define DEST_ALLOC_DELTA 20
 
+/*
+ * Each tree also has a lookup table per context, indexed by the next
+ * HUFFTABLE_BITS bits of input. An entry holds the number of bits used in
+ * its low nibble, HUFFTABLE_LEAF if those bits complete a code, and either
+ * the decoded character or (for longer codes) the tree node reached in the
+ * upper byte.
+ */
+#define HUFFTABLE_BITS 8
+#define HUFFTABLE_SIZE (1 << HUFFTABLE_BITS)
+#define HUFFTABLE_LEN_MASK 0x0f
+#define HUFFTABLE_LEAF 0x10
+
 struct hufftree_entry {
 	uint8_t left_idx;
 	uint8_t right_idx;
@@ -532,6 +544,61 @@ static struct hufftree_entry program_title_hufftree[][128] = {
 	{ {0x9b, 0x9b}, },
 };
 
+static uint16_t program_description_hufftable[128][HUFFTABLE_SIZE];
+static uint16_t program_title_hufftable[128][HUFFTABLE_SIZE];
+
+static void hufftable_build(struct hufftree_entry hufftree[][128], int contexts,
+			    uint16_t hufftable[][HUFFTABLE_SIZE])
+{
+	int context;
+	int code;
+	int len;
+	uint8_t treeidx;
+	uint8_t treeval;
+
+	for(context=0; context < 128; context++) {
+		for(code=0; code < HUFFTABLE_SIZE; code++) {
+			// the trees have no entry for 0x7f; treat it like the
+			// other unused contexts, which only contain an escape
+			if (context >= contexts) {
+				hufftable[context][code] = (HUFFSTRING_ESCAPE << 8) |
+							   HUFFTABLE_LEAF | 1;
+				continue;
+			}
+
+			treeidx = 0;
+			for(len=1; len <= HUFFTABLE_BITS; len++) {
+				if (code & (1 << (HUFFTABLE_BITS - len)))
+					treeval = hufftree[context][treeidx].right_idx;
+				else
+					treeval = hufftree[context][treeidx].left_idx;
+
+				if (treeval & HUFFTREE_LITERAL_MASK)
+					break;
+				treeidx = treeval;
+			}
+
+			if (len <= HUFFTABLE_BITS)
+				hufftable[context][code] = ((treeval & ~HUFFTREE_LITERAL_MASK) << 8) |
+							   HUFFTABLE_LEAF | len;
+			else
+				hufftable[context][code] = (treeidx << 8) | HUFFTABLE_BITS;
+		}
+	}
+}
+
+/* the tables are built when the library is loaded so there are no races
+ * between threads decoding text */
+__attribute__((constructor))
+static void hufftable_init(void)
+{
+	hufftable_build(program_description_hufftree,
+			sizeof(program_description_hufftree) / sizeof(program_description_hufftree[0]),
+			program_description_hufftable);
+	hufftable_build(program_title_hufftree,
+			sizeof(program_title_hufftree) / sizeof(program_title_hufftree[0]),
+			program_title_hufftable);
+}
 
 
 static inline void huffbuff_init(struct huffbuff *hbuf, uint8_t *buf, uint32_t buf_len)
@@ -566,6 +633,29 @@ static inline int huffbuff_bits(struct huffbuff *hbuf, uint8_t nbits)
 	return result;
 }
 
+/* make sure at least extra more bytes fit after destbufpos */
+static inline int dest_reserve(uint8_t **destbuf, size_t *destbuflen, size_t destbufpos,
+			       size_t extra)
+{
+	size_t newlen;
+	uint8_t *new_dest;
+
+	if ((destbufpos + extra) <= *destbuflen)
+		return 0;
+
+	newlen = *destbuflen * 2;
+	if (newlen < (destbufpos + extra))
+		newlen = destbufpos + extra;
+
+	new_dest = realloc(*destbuf, newlen);
+	if (new_dest == NULL)
+		return -ENOMEM;
+	*destbuf = new_dest;
+	*destbuflen = newlen;
+
+	return 0;
+}
+
 static inline int append_unicode_char(uint8_t **destbuf, size_t *destbuflen, size_t *destbufpos,
 				      uint32_t c)
 {
@@ -611,6 +701,10 @@ static inline int unicode_decode(uint8_t *srcbuf, size_t srcbuflen, int mode,
 	size_t i;
 	uint32_t msb = mode << 8;
 
+	// at most 3 bytes of UTF-8 per character, plus room for a terminator
+	if (dest_reserve(destbuf, destbuflen, *destbufpos, (srcbuflen * 3) + 1))
+		return -1;
+
 	for(i=0; i< srcbuflen; i++) {
 		if (append_unicode_char(destbuf, destbuflen, destbufpos, msb + srcbuf[i]))
 			return -1;
@@ -655,56 +749,93 @@ static int huffman_decode_uncompressed(struct huffbuff *hbuf,
 
 static int huffman_decode(uint8_t *src, size_t srclen,
 			  uint8_t **destbuf, size_t *destbuflen, size_t *destbufpos,
-			  struct hufftree_entry hufftree[][128])
+			  struct hufftree_entry hufftree[][128],
+			  uint16_t hufftable[][HUFFTABLE_SIZE])
 {
 	struct huffbuff hbuf;
+	uint32_t bitpos = 0;
+	uint32_t bitlen = srclen * 8;
+	uint32_t bytepos;
+	uint32_t bits;
 	int bit;
-	struct hufftree_entry *tree = hufftree[0];
-	uint8_t treeidx = 0;
+	int context = 0;
+	uint16_t entry;
+	uint8_t treeidx;
 	uint8_t treeval;
 	int tmp;
 
-	huffbuff_init(&hbuf, src, srclen);
+	// every code is at least one bit and yields at most one byte, while
+	// escaped characters take 8 bits and yield at most two bytes of UTF-8
+	if (dest_reserve(destbuf, destbuflen, *destbufpos, (srclen * 8) + 1))
+		return -1;
 
-	while(hbuf.cur_byte < hbuf.buf_len) {
-		// get the next bit
-		if ((bit = huffbuff_bits(&hbuf, 1)) < 0)
-			return *destbufpos;
+	huffbuff_init(&hbuf, src, srclen);
 
-		if (!bit) {
-			treeval = tree[treeidx].left_idx;
+	while(bitpos < bitlen) {
+		// look up the next HUFFTABLE_BITS bits (zero padded at the end)
+		bytepos = bitpos >> 3;
+		bits = src[bytepos] << 8;
+		if ((bytepos + 1) < srclen)
+			bits |= src[bytepos + 1];
+		bits = (bits >> (16 - HUFFTABLE_BITS - (bitpos & 7))) & (HUFFTABLE_SIZE - 1);
+		entry = hufftable[context][bits];
+
+		if ((entry & HUFFTABLE_LEAF) &&
+		    ((bitpos + (entry & HUFFTABLE_LEN_MASK)) <= bitlen)) {
+			bitpos += entry & HUFFTABLE_LEN_MASK;
+			treeval = entry >> 8;
 		} else {
-			treeval = tree[treeidx].right_idx;
-		}
+			// codes longer than the table, or running into the end
+			// of the buffer, are finished off a bit at a time
+			treeidx = 0;
+			if ((bitpos + HUFFTABLE_BITS) <= bitlen) {
+				bitpos += HUFFTABLE_BITS;
+				treeidx = entry >> 8;
+			}
+			hbuf.cur_byte = bitpos >> 3;
+			hbuf.cur_bit = bitpos & 7;
 
-		if (treeval & HUFFTREE_LITERAL_MASK) {
-			switch(treeval & ~HUFFTREE_LITERAL_MASK) {
-			case HUFFSTRING_END:
-				return 0;
-
-			case HUFFSTRING_ESCAPE:
-				if ((tmp =
-					huffman_decode_uncompressed(&hbuf,
-							destbuf, destbuflen, destbufpos)) < 0)
-					return tmp;
-				if (tmp == 0)
+			while(1) {
+				if ((bit = huffbuff_bits(&hbuf, 1)) < 0)
 					return *destbufpos;
 
-				tree = hufftree[tmp];
-				treeidx = 0;
-				break;
-
-			default:
-				// stash it
-				if (append_unicode_char(destbuf, destbuflen, destbufpos,
-				    			treeval & ~HUFFTREE_LITERAL_MASK))
-					return -1;
-				tree = hufftree[treeval & ~HUFFTREE_LITERAL_MASK];
-				treeidx = 0;
-				break;
+				if (!bit) {
+					treeval = hufftree[context][treeidx].left_idx;
+				} else {
+					treeval = hufftree[context][treeidx].right_idx;
+				}
+
+				if (treeval & HUFFTREE_LITERAL_MASK)
+					break;
+				treeidx = treeval;
 			}
-		} else {
-			treeidx = treeval;
+			treeval &= ~HUFFTREE_LITERAL_MASK;
+			bitpos = (hbuf.cur_byte * 8) + hbuf.cur_bit;
+		}
+
+		switch(treeval) {
+		case HUFFSTRING_END:
+			return 0;
+
+		case HUFFSTRING_ESCAPE:
+			hbuf.cur_byte = bitpos >> 3;
+			hbuf.cur_bit = bitpos & 7;
+			if ((tmp =
+				huffman_decode_uncompressed(&hbuf,
+						destbuf, destbuflen, destbufpos)) < 0)
+				return tmp;
+			if (tmp == 0)
+				return *destbufpos;
+			bitpos = (hbuf.cur_byte * 8) + hbuf.cur_bit;
+
+			context = tmp;
+			break;
+
+		default:
+			// stash it - space was reserved above
+			(*destbuf)[(*destbufpos)++] = treeval;
+			context = treeval;
+			break;
 		}
 	}
 
@@ -731,12 +862,13 @@ int atsc_text_segment_decode(struct atsc_text_string_segment *segment,
 	case ATSC_TEXT_COMPRESS_PROGRAM_TITLE:
 		return huffman_decode(buf, segment->number_bytes,
 				      destbuf, destbufsize, destbufpos,
-				      program_title_hufftree);
+				      program_title_hufftree, program_title_hufftable);
 
 	case ATSC_TEXT_COMPRESS_PROGRAM_DESCRIPTION:
 		return huffman_decode(buf, segment->number_bytes,
 				      destbuf, destbufsize, destbufpos,
-				      program_description_hufftree);
+				      program_description_hufftree,
+				      program_description_hufftable);
 	}
 
 	return -1;
@@ -19,6 +19,17 @@
  */
 
 #include <stdint.h>
+#include <stddef.h>
+#include "crc32.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32_HAVE_CLMUL 1
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#define CRC32_POLY 0x04c11db7
 
 uint32_t crc32tbl[] =
 {
@@ -87,3 +98,190 @@ uint32_t crc32tbl[] =
 	0xafb010b1, 0xab710d06, 0xa6322bdf, 0xa2f33668,
 	0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
 };
+
+static uint32_t crc32_dispatch(uint32_t crc, uint8_t* buf, size_t len);
+
+uint32_t (*crc32_impl)(uint32_t crc, uint8_t* buf, size_t len) = crc32_dispatch;
+
+/* crc32tbl extended for slicing-by-8: crc32tbl8[n][i] is the CRC of byte i
+ * followed by n zero bytes. */
+static uint32_t crc32tbl8[8][256];
+
+static void crc32_init_tables(void)
+{
+	int i, n;
+
+	for(i=0; i < 256; i++)
+		crc32tbl8[0][i] = crc32tbl[i];
+	for(n=1; n < 8; n++) {
+		for(i=0; i < 256; i++) {
+			uint32_t prev = crc32tbl8[n-1][i];
+			crc32tbl8[n][i] = (prev << 8) ^ crc32tbl[prev >> 24];
+		}
+	}
+}
+
+uint32_t crc32_slice8(uint32_t crc, uint8_t* buf, size_t len)
+{
+	uint32_t hi;
+	uint32_t lo;
+
+	while(len >= 8) {
+		hi = crc ^ (((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) |
+			    ((uint32_t) buf[2] << 8) | buf[3]);
+		lo = ((uint32_t) buf[4] << 24) | ((uint32_t) buf[5] << 16) |
+		     ((uint32_t) buf[6] << 8) | buf[7];
+
+		crc = crc32tbl8[7][hi >> 24] ^
+		      crc32tbl8[6][(hi >> 16) & 0xff] ^
+		      crc32tbl8[5][(hi >> 8) & 0xff] ^
+		      crc32tbl8[4][hi & 0xff] ^
+		      crc32tbl8[3][lo >> 24] ^
+		      crc32tbl8[2][(lo >> 16) & 0xff] ^
+		      crc32tbl8[1][(lo >> 8) & 0xff] ^
+		      crc32tbl8[0][lo & 0xff];
+
+		buf += 8;
+		len -= 8;
+	}
+
+	return crc32_bytewise(crc, buf, len);
+}
+
+#ifdef CRC32_HAVE_CLMUL
+
+/* folding constants (x^n mod P) - set up by crc32_init_clmul() */
+static uint64_t crc32_k128;
+static uint64_t crc32_k192;
+static uint64_t crc32_k512;
+static uint64_t crc32_k576;
+
+static uint32_t crc32_xpow_mod(int n)
+{
+	uint32_t r = 1;
+
+	/* multiply by x n times, reducing mod P each time */
+	while(n--) {
+		if (r & 0x80000000)
+			r = (r << 1) ^ CRC32_POLY;
+		else
+			r <<= 1;
+	}
+	return r;
+}
+
+static void crc32_init_clmul(void)
+{
+	crc32_k128 = crc32_xpow_mod(128);
+	crc32_k192 = crc32_xpow_mod(192);
+	crc32_k512 = crc32_xpow_mod(512);
+	crc32_k576 = crc32_xpow_mod(576);
+}
+
+int crc32_clmul_supported(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+/* Fold x forward over 128 * n bits, where k holds x^(128n+64) mod P in its
+ * high qword and x^128n mod P in its low qword, then add in data. */
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i crc32_fold(__m128i x, __m128i k, __m128i data)
+{
+	__m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+	__m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+
+	return _mm_xor_si128(_mm_xor_si128(hi, lo), data);
+}
+
+__attribute__((target("pclmul,ssse3")))
+uint32_t crc32_clmul(uint32_t crc, uint8_t* buf, size_t len)
+{
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+					   8, 9, 10, 11, 12, 13, 14, 15);
+	__m128i k1, k4;
+	__m128i x0, x1, x2, x3;
+	uint8_t tmp[16];
+
+	/* not worth it for short buffers */
+	if (len < 64)
+		return crc32_slice8(crc, buf, len);
+
+	k1 = _mm_set_epi64x(crc32_k192, crc32_k128);
+	k4 = _mm_set_epi64x(crc32_k576, crc32_k512);
+
+	/* the data is treated as one big polynomial, most significant bit first,
+	 * so each 16 byte block is loaded byte-reversed. The incoming CRC is
+	 * added to the first 32 bits of the message. */
+	x0 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i*) (buf + 0)), bswap);
+	x1 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i*) (buf + 16)), bswap);
+	x2 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i*) (buf + 32)), bswap);
+	x3 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i*) (buf + 48)), bswap);
+	x0 = _mm_xor_si128(x0, _mm_set_epi32(crc, 0, 0, 0));
+	buf += 64;
+	len -= 64;
+
+	/* fold four blocks at a time */
+	while(len >= 64) {
+		x0 = crc32_fold(x0, k4, _mm_shuffle_epi8(_mm_loadu_si128((__m128i*) (buf + 0)), bswap));
+		x1 = crc32_fold(x1, k4, _mm_shuffle_epi8(_mm_loadu_si128((__m128i*) (buf + 16)), bswap));
+		x2 = crc32_fold(x2, k4, _mm_shuffle_epi8(_mm_loadu_si128((__m128i*) (buf + 32)), bswap));
+		x3 = crc32_fold(x3, k4, _mm_shuffle_epi8(_mm_loadu_si128((__m128i*) (buf + 48)), bswap));
+		buf += 64;
+		len -= 64;
+	}
+
+	/* combine the four accumulators */
+	x1 = crc32_fold(x0, k1, x1);
+	x2 = crc32_fold(x1, k1, x2);
+	x0 = crc32_fold(x2, k1, x3);
+
+	/* then any remaining whole blocks */
+	while(len >= 16) {
+		x0 = crc32_fold(x0, k1, _mm_shuffle_epi8(_mm_loadu_si128((__m128i*) buf), bswap));
+		buf += 16;
+		len -= 16;
+	}
+
+	/* reduce the remaining 128 bits by running them through the table
+	 * implementation, and finish off the tail the same way */
+	_mm_storeu_si128((__m128i*) tmp, _mm_shuffle_epi8(x0, bswap));
+	crc = crc32_slice8(0, tmp, 16);
+	return crc32_slice8(crc, buf, len);
+}
+
+#else
+
+int crc32_clmul_supported(void)
+{
+	return 0;
+}
+
+uint32_t crc32_clmul(uint32_t crc, uint8_t* buf, size_t len)
+{
+	return crc32_slice8(crc, buf, len);
+}
+
+#endif
+
+/* the tables are built when the library is loaded so there are no races
+ * between threads using crc32() */
+__attribute__((constructor))
+static void crc32_init(void)
+{
+	crc32_init_tables();
+#ifdef CRC32_HAVE_CLMUL
+	crc32_init_clmul();
+#endif
+}
+
+static uint32_t crc32_dispatch(uint32_t crc, uint8_t* buf, size_t len)
+{
+	if (crc32_clmul_supported())
+		crc32_impl = crc32_clmul;
+	else
+		crc32_impl = crc32_slice8;
+
+	return crc32_impl(crc, buf, len);
+}
@@ -22,6 +22,7 @@
 #define _UCSI_CRC32_H 1
 
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -33,14 +34,20 @@ extern "C"
 extern uint32_t crc32tbl[];
 
 /**
- * Calculate a CRC32 over a piece of data.
+ * The crc32 implementation in use. This starts out pointing to a routine which
+ * selects the fastest implementation supported by the CPU on first use.
+ */
+extern uint32_t (*crc32_impl)(uint32_t crc, uint8_t* buf, size_t len);
+
+/**
+ * Calculate a CRC32 over a piece of data, one byte at a time.
  *
  * @param crc Current CRC value (use CRC32_INIT for first call).
  * @param buf Buffer to calculate over.
  * @param len Number of bytes.
  * @return Calculated CRC.
  */
-static inline uint32_t crc32(uint32_t crc, uint8_t* buf, size_t len)
+static inline uint32_t crc32_bytewise(uint32_t crc, uint8_t* buf, size_t len)
 {
 	size_t i;
 
@@ -51,6 +58,48 @@ static inline uint32_t crc32(uint32_t crc, uint8_t* buf, size_t len)
 	return crc;
 }
 
+/**
+ * Calculate a CRC32 over a piece of data, eight bytes at a time using
+ * the slicing-by-8 algorithm.
+ *
+ * @param crc Current CRC value (use CRC32_INIT for first call).
+ * @param buf Buffer to calculate over.
+ * @param len Number of bytes.
+ * @return Calculated CRC.
+ */
+extern uint32_t crc32_slice8(uint32_t crc, uint8_t* buf, size_t len);
+
+/**
+ * Calculate a CRC32 over a piece of data using carry-less multiplication
+ * (PCLMULQDQ). Only call this if crc32_clmul_supported() returns nonzero.
+ *
+ * @param crc Current CRC value (use CRC32_INIT for first call).
+ * @param buf Buffer to calculate over.
+ * @param len Number of bytes.
+ * @return Calculated CRC.
+ */
+extern uint32_t crc32_clmul(uint32_t crc, uint8_t* buf, size_t len);
+
+/**
+ * Determine whether crc32_clmul() can be used on this CPU.
+ *
+ * @return Nonzero if it is supported.
+ */
+extern int crc32_clmul_supported(void);
+
+/**
+ * Calculate a CRC32 over a piece of data.
+ *
+ * @param crc Current CRC value (use CRC32_INIT for first call).
+ * @param buf Buffer to calculate over.
+ * @param len Number of bytes.
+ * @return Calculated CRC.
+ */
+static inline uint32_t crc32(uint32_t crc, uint8_t* buf, size_t len)
+{
+	return crc32_impl(crc, buf, len);
+}
+
 #ifdef __cplusplus
 }
 #endif
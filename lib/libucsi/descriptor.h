@@ -62,6 +62,30 @@ static inline struct descriptor *
 }
 
 
+/**
+ * Retreive pointer to the next descriptor structure, for use with read-only
+ * buffers.
+ *
+ * @param buf The buffer of descriptors.
+ * @param len Size of the buffer.
+ * @param pos Current descriptor.
+ * @return Pointer to next descriptor, or NULL if there are none.
+ */
+static inline const struct descriptor *
+	next_descriptor_ro(const uint8_t * buf, size_t len, const struct descriptor * pos)
+{
+	const uint8_t* next;
+
+	if (pos == NULL)
+		return NULL;
+
+	next = (const uint8_t*) pos + 2 + pos->len;
+	if (next >= buf + len)
+		return NULL;
+
+	return (const struct descriptor *) next;
+}
+
 /**
  * The unknown descriptor.
  */
@@ -105,7 +129,7 @@ static inline int
 
 
 /******************************** PRIVATE CODE ********************************/
-static inline int verify_descriptors(uint8_t * buf, size_t len)
+static inline int verify_descriptors(const uint8_t * buf, size_t len)
 {
 	size_t pos = 0;
 
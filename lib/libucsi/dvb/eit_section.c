@@ -61,3 +61,53 @@ struct dvb_eit_section *dvb_eit_section_codec(struct section_ext * ext)
 
 	return (struct dvb_eit_section *) ext;
 }
+
+int dvb_eit_section_event_times(struct dvb_eit_section *eit, time_t *start_times,
+				int *durations, int max)
+{
+	struct dvb_eit_event *event;
+	int count = 0;
+
+	dvb_eit_section_events_for_each(eit, event) {
+		if (count == max)
+			break;
+
+		start_times[count] = dvbdate_to_unixtime(event->start_time);
+		if (durations)
+			durations[count] = dvbduration_to_seconds(event->duration);
+		count++;
+	}
+
+	return count;
+}
+
+int dvb_eit_section_ro_validate(const uint8_t *section)
+{
+	size_t pos = sizeof(struct dvb_eit_section);
+	size_t len = section_ext_ro_length(section);
+	size_t loop_len;
+
+	if (len < sizeof(struct dvb_eit_section))
+		return -1;
+
+	while (pos < len) {
+		if ((pos + sizeof(struct dvb_eit_event)) > len)
+			return -1;
+
+		loop_len = dvb_eit_event_ro_descriptors_loop_length(section + pos);
+		pos += sizeof(struct dvb_eit_event);
+
+		if ((pos + loop_len) > len)
+			return -1;
+
+		if (verify_descriptors(section + pos, loop_len))
+			return -1;
+
+		pos += loop_len;
+	}
+
+	if (pos != len)
+		return -1;
+
+	return 0;
+}
@@ -98,6 +98,173 @@ static inline uint16_t dvb_eit_section_service_id(struct dvb_eit_section *eit)
 	     (pos); \
 	     (pos) = dvb_eit_event_descriptors_next(event, pos))
 
+/**
+ * Convert the start_time and duration of every event in a dvb_eit_section in
+ * one pass, in the same order as dvb_eit_section_events_for_each().
+ *
+ * @param eit dvb_eit_section pointer.
+ * @param start_times Array to receive the start times as unix time (-1 where undefined).
+ * @param durations Array to receive the durations in seconds, or NULL if not wanted.
+ * @param max Number of entries in the arrays.
+ * @return Number of events converted.
+ */
+extern int dvb_eit_section_event_times(struct dvb_eit_section *eit, time_t *start_times,
+				       int *durations, int max);
+
+
+/**
+ * Validate a raw dvb_eit_section without modifying it. The section must
+ * already have passed section_ext_ro_validate().
+ *
+ * @param section Pointer to the raw section.
+ * @return 0 if the section is valid, nonzero otherwise.
+ */
+extern int dvb_eit_section_ro_validate(const uint8_t *section);
+
+/**
+ * Accessor for the service_id field of a raw EIT.
+ *
+ * @param eit Pointer to the raw EIT.
+ * @return The service_id.
+ */
+static inline uint16_t dvb_eit_section_ro_service_id(const uint8_t *eit)
+{
+	return section_ext_ro_table_id_ext(eit);
+}
+
+/**
+ * Accessor for the transport_stream_id field of a raw EIT.
+ *
+ * @param eit Pointer to the raw EIT.
+ * @return The transport_stream_id.
+ */
+static inline uint16_t dvb_eit_section_ro_transport_stream_id(const uint8_t *eit)
+{
+	return ucsi_read16(eit + 8);
+}
+
+/**
+ * Accessor for the original_network_id field of a raw EIT.
+ *
+ * @param eit Pointer to the raw EIT.
+ * @return The original_network_id.
+ */
+static inline uint16_t dvb_eit_section_ro_original_network_id(const uint8_t *eit)
+{
+	return ucsi_read16(eit + 10);
+}
+
+/**
+ * Accessor for the segment_last_section_number field of a raw EIT.
+ *
+ * @param eit Pointer to the raw EIT.
+ * @return The segment_last_section_number.
+ */
+static inline uint8_t dvb_eit_section_ro_segment_last_section_number(const uint8_t *eit)
+{
+	return eit[12];
+}
+
+/**
+ * Accessor for the last_table_id field of a raw EIT.
+ *
+ * @param eit Pointer to the raw EIT.
+ * @return The last_table_id.
+ */
+static inline uint8_t dvb_eit_section_ro_last_table_id(const uint8_t *eit)
+{
+	return eit[13];
+}
+
+/**
+ * Iterator for the events field of a raw EIT.
+ *
+ * @param eit Pointer to the raw EIT.
+ * @param pos Variable holding a (const uint8_t *) pointer to the current event.
+ */
+#define dvb_eit_section_ro_events_for_each(eit, pos) \
+	for ((pos) = dvb_eit_section_ro_events_first(eit); \
+	     (pos); \
+	     (pos) = dvb_eit_section_ro_events_next(eit, pos))
+
+/**
+ * Accessor for the event_id field of a raw EIT event.
+ *
+ * @param event Pointer to the raw event.
+ * @return The event_id.
+ */
+static inline uint16_t dvb_eit_event_ro_event_id(const uint8_t *event)
+{
+	return ucsi_read16(event);
+}
+
+/**
+ * Accessor for the start_time field of a raw EIT event.
+ *
+ * @param event Pointer to the raw event.
+ * @return Pointer to the 5 byte dvbdate_t.
+ */
+static inline const uint8_t *dvb_eit_event_ro_start_time(const uint8_t *event)
+{
+	return event + 2;
+}
+
+/**
+ * Accessor for the duration field of a raw EIT event.
+ *
+ * @param event Pointer to the raw event.
+ * @return Pointer to the 3 byte dvbduration_t.
+ */
+static inline const uint8_t *dvb_eit_event_ro_duration(const uint8_t *event)
+{
+	return event + 7;
+}
+
+/**
+ * Accessor for the running_status field of a raw EIT event.
+ *
+ * @param event Pointer to the raw event.
+ * @return The running_status.
+ */
+static inline int dvb_eit_event_ro_running_status(const uint8_t *event)
+{
+	return event[10] >> 5;
+}
+
+/**
+ * Accessor for the free_ca_mode field of a raw EIT event.
+ *
+ * @param event Pointer to the raw event.
+ * @return The free_ca_mode.
+ */
+static inline int dvb_eit_event_ro_free_ca_mode(const uint8_t *event)
+{
+	return (event[10] >> 4) & 1;
+}
+
+/**
+ * Accessor for the descriptors_loop_length field of a raw EIT event.
+ *
+ * @param event Pointer to the raw event.
+ * @return The descriptors_loop_length.
+ */
+static inline uint16_t dvb_eit_event_ro_descriptors_loop_length(const uint8_t *event)
+{
+	return ucsi_read16(event + 10) & 0x0fff;
+}
+
+/**
+ * Iterator for the descriptors field of a raw EIT event.
+ *
+ * @param event Pointer to the raw event.
+ * @param pos Variable holding a (const struct descriptor *) pointer to the
+ * current descriptor.
+ */
+#define dvb_eit_event_ro_descriptors_for_each(event, pos) \
+	for ((pos) = dvb_eit_event_ro_descriptors_first(event); \
+	     (pos); \
+	     (pos) = dvb_eit_event_ro_descriptors_next(event, pos))
+
 
 
 
@@ -153,6 +320,48 @@ static inline struct descriptor *
 			       pos);
 }
 
+static inline const uint8_t *
+	dvb_eit_section_ro_events_first(const uint8_t *eit)
+{
+	size_t pos = sizeof(struct dvb_eit_section);
+
+	if (pos >= section_ext_ro_length(eit))
+		return NULL;
+
+	return eit + pos;
+}
+
+static inline const uint8_t *
+	dvb_eit_section_ro_events_next(const uint8_t *eit, const uint8_t *pos)
+{
+	const uint8_t *end = eit + section_ext_ro_length(eit);
+	const uint8_t *next = pos + sizeof(struct dvb_eit_event) +
+		dvb_eit_event_ro_descriptors_loop_length(pos);
+
+	if (next >= end)
+		return NULL;
+
+	return next;
+}
+
+static inline const struct descriptor *
+	dvb_eit_event_ro_descriptors_first(const uint8_t *event)
+{
+	if (dvb_eit_event_ro_descriptors_loop_length(event) == 0)
+		return NULL;
+
+	return (const struct descriptor *) (event + sizeof(struct dvb_eit_event));
+}
+
+static inline const struct descriptor *
+	dvb_eit_event_ro_descriptors_next(const uint8_t *event,
+					  const struct descriptor *pos)
+{
+	return next_descriptor_ro(event + sizeof(struct dvb_eit_event),
+				  dvb_eit_event_ro_descriptors_loop_length(event),
+				  pos);
+}
+
 #ifdef __cplusplus
 }
 #endif
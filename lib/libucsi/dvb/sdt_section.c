@@ -58,3 +58,34 @@ struct dvb_sdt_section * dvb_sdt_section_codec(struct section_ext * ext)
 
 	return (struct dvb_sdt_section *) ext;
 }
+
+int dvb_sdt_section_ro_validate(const uint8_t *section)
+{
+	size_t pos = sizeof(struct dvb_sdt_section);
+	size_t len = section_ext_ro_length(section);
+	size_t loop_len;
+
+	if (len < sizeof(struct dvb_sdt_section))
+		return -1;
+
+	while (pos < len) {
+		if ((pos + sizeof(struct dvb_sdt_service)) > len)
+			return -1;
+
+		loop_len = dvb_sdt_service_ro_descriptors_loop_length(section + pos);
+		pos += sizeof(struct dvb_sdt_service);
+
+		if ((pos + loop_len) > len)
+			return -1;
+
+		if (verify_descriptors(section + pos, loop_len))
+			return -1;
+
+		pos += loop_len;
+	}
+
+	if (pos != len)
+		return -1;
+
+	return 0;
+}
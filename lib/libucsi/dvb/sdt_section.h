@@ -97,6 +97,127 @@ static inline uint16_t dvb_sdt_section_transport_stream_id(struct dvb_sdt_sectio
 
 
 
+/**
+ * Validate a raw dvb_sdt_section without modifying it. The section must
+ * already have passed section_ext_ro_validate().
+ *
+ * @param section Pointer to the raw section.
+ * @return 0 if the section is valid, nonzero otherwise.
+ */
+extern int dvb_sdt_section_ro_validate(const uint8_t *section);
+
+/**
+ * Accessor for the transport_stream_id field of a raw SDT.
+ *
+ * @param sdt Pointer to the raw SDT.
+ * @return The transport_stream_id.
+ */
+static inline uint16_t dvb_sdt_section_ro_transport_stream_id(const uint8_t *sdt)
+{
+	return section_ext_ro_table_id_ext(sdt);
+}
+
+/**
+ * Accessor for the original_network_id field of a raw SDT.
+ *
+ * @param sdt Pointer to the raw SDT.
+ * @return The original_network_id.
+ */
+static inline uint16_t dvb_sdt_section_ro_original_network_id(const uint8_t *sdt)
+{
+	return ucsi_read16(sdt + 8);
+}
+
+/**
+ * Iterator for the services field of a raw SDT.
+ *
+ * @param sdt Pointer to the raw SDT.
+ * @param pos Variable holding a (const uint8_t *) pointer to the current service.
+ */
+#define dvb_sdt_section_ro_services_for_each(sdt, pos) \
+	for ((pos) = dvb_sdt_section_ro_services_first(sdt); \
+	     (pos); \
+	     (pos) = dvb_sdt_section_ro_services_next(sdt, pos))
+
+/**
+ * Accessor for the service_id field of a raw SDT service.
+ *
+ * @param service Pointer to the raw service.
+ * @return The service_id.
+ */
+static inline uint16_t dvb_sdt_service_ro_service_id(const uint8_t *service)
+{
+	return ucsi_read16(service);
+}
+
+/**
+ * Accessor for the eit_schedule_flag field of a raw SDT service.
+ *
+ * @param service Pointer to the raw service.
+ * @return The eit_schedule_flag.
+ */
+static inline int dvb_sdt_service_ro_eit_schedule_flag(const uint8_t *service)
+{
+	return (service[2] >> 1) & 1;
+}
+
+/**
+ * Accessor for the eit_present_following_flag field of a raw SDT service.
+ *
+ * @param service Pointer to the raw service.
+ * @return The eit_present_following_flag.
+ */
+static inline int dvb_sdt_service_ro_eit_present_following_flag(const uint8_t *service)
+{
+	return service[2] & 1;
+}
+
+/**
+ * Accessor for the running_status field of a raw SDT service.
+ *
+ * @param service Pointer to the raw service.
+ * @return The running_status.
+ */
+static inline int dvb_sdt_service_ro_running_status(const uint8_t *service)
+{
+	return service[3] >> 5;
+}
+
+/**
+ * Accessor for the free_ca_mode field of a raw SDT service.
+ *
+ * @param service Pointer to the raw service.
+ * @return The free_ca_mode.
+ */
+static inline int dvb_sdt_service_ro_free_ca_mode(const uint8_t *service)
+{
+	return (service[3] >> 4) & 1;
+}
+
+/**
+ * Accessor for the descriptors_loop_length field of a raw SDT service.
+ *
+ * @param service Pointer to the raw service.
+ * @return The descriptors_loop_length.
+ */
+static inline uint16_t dvb_sdt_service_ro_descriptors_loop_length(const uint8_t *service)
+{
+	return ucsi_read16(service + 3) & 0x0fff;
+}
+
+/**
+ * Iterator for the descriptors field of a raw SDT service.
+ *
+ * @param service Pointer to the raw service.
+ * @param pos Variable holding a (const struct descriptor *) pointer to the
+ * current descriptor.
+ */
+#define dvb_sdt_service_ro_descriptors_for_each(service, pos) \
+	for ((pos) = dvb_sdt_service_ro_descriptors_first(service); \
+	     (pos); \
+	     (pos) = dvb_sdt_service_ro_descriptors_next(service, pos))
+
+
 
 
 
@@ -150,6 +271,48 @@ static inline struct descriptor *
 			       pos);
 }
 
+static inline const uint8_t *
+	dvb_sdt_section_ro_services_first(const uint8_t *sdt)
+{
+	size_t pos = sizeof(struct dvb_sdt_section);
+
+	if (pos >= section_ext_ro_length(sdt))
+		return NULL;
+
+	return sdt + pos;
+}
+
+static inline const uint8_t *
+	dvb_sdt_section_ro_services_next(const uint8_t *sdt, const uint8_t *pos)
+{
+	const uint8_t *end = sdt + section_ext_ro_length(sdt);
+	const uint8_t *next = pos + sizeof(struct dvb_sdt_service) +
+		dvb_sdt_service_ro_descriptors_loop_length(pos);
+
+	if (next >= end)
+		return NULL;
+
+	return next;
+}
+
+static inline const struct descriptor *
+	dvb_sdt_service_ro_descriptors_first(const uint8_t *service)
+{
+	if (dvb_sdt_service_ro_descriptors_loop_length(service) == 0)
+		return NULL;
+
+	return (const struct descriptor *) (service + sizeof(struct dvb_sdt_service));
+}
+
+static inline const struct descriptor *
+	dvb_sdt_service_ro_descriptors_next(const uint8_t *service,
+					    const struct descriptor *pos)
+{
+	return next_descriptor_ro(service + sizeof(struct dvb_sdt_service),
+				  dvb_sdt_service_ro_descriptors_loop_length(service),
+				  pos);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,41 +21,52 @@
 #include <string.h>
 #include "types.h"
 
-time_t dvbdate_to_unixtime(dvbdate_t dvbdate)
+/* MJD of the unix epoch, 1970-01-01 */
+#define MJD_UNIX_EPOCH 40587
+
+static inline int bcd8_to_integer(uint8_t bcd)
 {
-	int k = 0;
-	struct tm tm;
-	double mjd;
+	return ((bcd >> 4) * 10) + (bcd & 0x0f);
+}
 
-	/* check for the undefined value */
-	if ((dvbdate[0] == 0xff) &&
-	    (dvbdate[1] == 0xff) &&
-	    (dvbdate[2] == 0xff) &&
-	    (dvbdate[3] == 0xff) &&
-	    (dvbdate[4] == 0xff)) {
-		return -1;
-	}
+static inline uint8_t integer_to_bcd8(int integer)
+{
+	return ((integer / 10) << 4) | (integer % 10);
+}
+
+/* DVB dates are UTC, so this is plain arithmetic - no mktime() or TZ lookups */
+static inline time_t dvbdate_decode(const uint8_t *dvbdate)
+{
+	int mjd = (dvbdate[0] << 8) | dvbdate[1];
 
-	memset(&tm, 0, sizeof(tm));
-	mjd = (dvbdate[0] << 8) | dvbdate[1];
+	return ((time_t) (mjd - MJD_UNIX_EPOCH) * 86400) +
+		(bcd8_to_integer(dvbdate[2]) * 3600) +
+		(bcd8_to_integer(dvbdate[3]) * 60) +
+		bcd8_to_integer(dvbdate[4]);
+}
+
+static inline int dvbdate_undefined(const uint8_t *dvbdate)
+{
+	return (dvbdate[0] == 0xff) &&
+	       (dvbdate[1] == 0xff) &&
+	       (dvbdate[2] == 0xff) &&
+	       (dvbdate[3] == 0xff) &&
+	       (dvbdate[4] == 0xff);
+}
 
-	tm.tm_year = (int) ((mjd - 15078.2) / 365.25);
-	tm.tm_mon = (int) (((mjd - 14956.1) - (int) (tm.tm_year * 365.25)) / 30.6001);
-	tm.tm_mday = (int) mjd - 14956 - (int) (tm.tm_year * 365.25) - (int) (tm.tm_mon * 30.6001);
-	if ((tm.tm_mon == 14) || (tm.tm_mon == 15)) k = 1;
-	tm.tm_year += k;
-	tm.tm_mon = tm.tm_mon - 2 - k * 12;
-	tm.tm_sec = bcd_to_integer(dvbdate[4]);
-	tm.tm_min = bcd_to_integer(dvbdate[3]);
-	tm.tm_hour = bcd_to_integer(dvbdate[2]);
+time_t dvbdate_to_unixtime(dvbdate_t dvbdate)
+{
+	/* check for the undefined value */
+	if (dvbdate_undefined(dvbdate))
+		return -1;
 
-	return mktime(&tm);
+	return dvbdate_decode(dvbdate);
 }
 
 void unixtime_to_dvbdate(time_t unixtime, dvbdate_t dvbdate)
 {
-	struct tm tm;
-	double l = 0;
+	time_t days;
+	int secs;
 	int mjd;
 
 	/* the undefined value */
@@ -64,27 +75,26 @@ void unixtime_to_dvbdate(time_t unixtime, dvbdate_t dvbdate)
 		return;
 	}
 
-	gmtime_r(&unixtime, &tm);
-	tm.tm_mon++;
-	if ((tm.tm_mon == 1) || (tm.tm_mon == 2)) l = 1;
-	mjd = 14956 + tm.tm_mday + (int) ((tm.tm_year - l) * 365.25) + (int) ((tm.tm_mon + 1 + l * 12) * 30.6001);
+	days = unixtime / 86400;
+	secs = unixtime % 86400;
+	if (secs < 0) {
+		days--;
+		secs += 86400;
+	}
+	mjd = days + MJD_UNIX_EPOCH;
 
 	dvbdate[0] = (mjd & 0xff00) >> 8;
 	dvbdate[1] = mjd & 0xff;
-	dvbdate[2] = integer_to_bcd(tm.tm_hour);
-	dvbdate[3] = integer_to_bcd(tm.tm_min);
-	dvbdate[4] = integer_to_bcd(tm.tm_sec);
+	dvbdate[2] = integer_to_bcd8(secs / 3600);
+	dvbdate[3] = integer_to_bcd8((secs / 60) % 60);
+	dvbdate[4] = integer_to_bcd8(secs % 60);
 }
 
 int dvbduration_to_seconds(dvbduration_t dvbduration)
 {
-	int seconds = 0;
-
-	seconds += (bcd_to_integer(dvbduration[0]) * 60 * 60);
-	seconds += (bcd_to_integer(dvbduration[1]) * 60);
-	seconds += bcd_to_integer(dvbduration[2]);
-
-	return seconds;
+	return (bcd8_to_integer(dvbduration[0]) * 60 * 60) +
+	       (bcd8_to_integer(dvbduration[1]) * 60) +
+	       bcd8_to_integer(dvbduration[2]);
 }
 
 void seconds_to_dvbduration(int seconds, dvbduration_t dvbduration)
@@ -97,18 +107,14 @@ void seconds_to_dvbduration(int seconds, dvbduration_t dvbduration)
 	seconds -= (mins * 60);
 
 	dvbduration[0] = integer_to_bcd(hours);
-	dvbduration[1] = integer_to_bcd(mins);
-	dvbduration[2] = integer_to_bcd(seconds);
+	dvbduration[1] = integer_to_bcd8(mins);
+	dvbduration[2] = integer_to_bcd8(seconds);
 }
 
 int dvbhhmm_to_seconds(dvbhhmm_t dvbhhmm)
 {
-	int seconds = 0;
-
-	seconds += (bcd_to_integer(dvbhhmm[0]) * 60 * 60);
-	seconds += (bcd_to_integer(dvbhhmm[1]) * 60);
-
-	return seconds;
+	return (bcd8_to_integer(dvbhhmm[0]) * 60 * 60) +
+	       (bcd8_to_integer(dvbhhmm[1]) * 60);
 }
 
 void seconds_to_dvbhhmm(int seconds, dvbhhmm_t dvbhhmm)
@@ -120,7 +126,7 @@ void seconds_to_dvbhhmm(int seconds, dvbhhmm_t dvbhhmm)
 	mins = seconds / 60;
 
 	dvbhhmm[0] = integer_to_bcd(hours);
-	dvbhhmm[1] = integer_to_bcd(mins);
+	dvbhhmm[1] = integer_to_bcd8(mins);
 }
 
 uint32_t integer_to_bcd(uint32_t intval)
@@ -128,7 +134,7 @@ uint32_t integer_to_bcd(uint32_t intval)
 	uint32_t val = 0;
 
 	int i;
-	for(i=0; i<=28;i+=4) {
+	for(i=0; (i<=28) && intval; i+=4) {
 		val |= ((intval % 10) << i);
 		intval /= 10;
 	}
@@ -138,15 +144,12 @@ uint32_t integer_to_bcd(uint32_t intval)
 
 uint32_t bcd_to_integer(uint32_t bcdval)
 {
-	uint32_t val = 0;
+	/* combine the digits pairwise: into bytes, then 16 bit halves, then the
+	 * whole word */
+	bcdval = ((bcdval >> 4) & 0x0f0f0f0f) * 10 + (bcdval & 0x0f0f0f0f);
+	bcdval = ((bcdval >> 8) & 0x00ff00ff) * 100 + (bcdval & 0x00ff00ff);
 
-	int i;
-	for(i=28; i>=0;i-=4) {
-		val += ((bcdval >> i) & 0x0f);
-		if (i != 0) val *= 10;
-	}
-
-	return val;
+	return (bcdval >> 16) * 10000 + (bcdval & 0xffff);
 }
 
 const char *dvb_charset(char *dvb_text, int dvb_text_length, int *consumed)
@@ -120,6 +120,24 @@ extern uint32_t integer_to_bcd(uint32_t integer);
  */
 extern const char *dvb_charset(char *dvb_text, int dvb_text_length, int *consumed);
 
+/**
+ * Convert a dvb string straight to UTF-8, without going through iconv. Code
+ * table 00 (ISO 6937 with its non-spacing diacritics), all ISO 8859 parts,
+ * UTF-16 and UTF-8 are supported. The CR/LF control code becomes a newline;
+ * other control codes, such as emphasis on/off, are dropped. Output which does
+ * not fit is truncated on a character boundary.
+ *
+ * @param dvb_text DVB text concerned, including any character set prefix.
+ * @param dvb_text_length Length of text.
+ * @param dest Destination buffer. This will always be NUL terminated on success.
+ * @param dest_length Size of dest in bytes. dvb_text_length * 3 + 1 is always
+ * enough.
+ * @return Number of bytes written to dest excluding the NUL, or -1 if the
+ * character set is not supported (the caller may then fall back to
+ * dvb_charset() and iconv).
+ */
+extern int dvb_text_to_utf8(uint8_t *dvb_text, int dvb_text_length, char *dest, int dest_length);
+
 #ifdef __cplusplus
 }
 #endif
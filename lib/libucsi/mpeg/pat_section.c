@@ -44,3 +44,16 @@ struct mpeg_pat_section *mpeg_pat_section_codec(struct section_ext * ext)
 
 	return (struct mpeg_pat_section *)ext;
 }
+
+int mpeg_pat_section_ro_validate(const uint8_t *section)
+{
+	size_t len = section_ext_ro_length(section);
+
+	if (len < sizeof(struct mpeg_pat_section))
+		return -1;
+
+	if ((len - sizeof(struct mpeg_pat_section)) % sizeof(struct mpeg_pat_program))
+		return -1;
+
+	return 0;
+}
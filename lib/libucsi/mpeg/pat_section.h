@@ -78,6 +78,60 @@ static inline uint16_t mpeg_pat_section_transport_stream_id(struct mpeg_pat_sect
 	     (pos) = mpeg_pat_section_programs_next(pat, pos))
 
 
+/**
+ * Validate a raw mpeg_pat_section without modifying it. The section must
+ * already have passed section_ext_ro_validate().
+ *
+ * @param section Pointer to the raw section.
+ * @return 0 if the section is valid, nonzero otherwise.
+ */
+extern int mpeg_pat_section_ro_validate(const uint8_t *section);
+
+/**
+ * Accessor for the transport_stream_id field of a raw PAT.
+ *
+ * @param pat Pointer to the raw PAT.
+ * @return The transport_stream_id.
+ */
+static inline uint16_t mpeg_pat_section_ro_transport_stream_id(const uint8_t *pat)
+{
+	return section_ext_ro_table_id_ext(pat);
+}
+
+/**
+ * Convenience iterator for the programs field of a raw PAT.
+ *
+ * @param pat Pointer to the raw PAT.
+ * @param pos Variable holding a (const uint8_t *) pointer to the current program.
+ */
+#define mpeg_pat_section_ro_programs_for_each(pat, pos) \
+	for ((pos) = mpeg_pat_section_ro_programs_first(pat); \
+	     (pos); \
+	     (pos) = mpeg_pat_section_ro_programs_next(pat, pos))
+
+/**
+ * Accessor for the program_number field of a raw PAT program.
+ *
+ * @param program Pointer to the raw program.
+ * @return The program_number.
+ */
+static inline uint16_t mpeg_pat_program_ro_program_number(const uint8_t *program)
+{
+	return ucsi_read16(program);
+}
+
+/**
+ * Accessor for the pid field of a raw PAT program.
+ *
+ * @param program Pointer to the raw program.
+ * @return The pid.
+ */
+static inline uint16_t mpeg_pat_program_ro_pid(const uint8_t *program)
+{
+	return ucsi_read16(program + 2) & 0x1fff;
+}
+
+
 
 
 
@@ -111,6 +165,29 @@ static inline
 	return (struct mpeg_pat_program *) next;
 }
 
+static inline const uint8_t *
+	mpeg_pat_section_ro_programs_first(const uint8_t *pat)
+{
+	size_t pos = sizeof(struct mpeg_pat_section);
+
+	if (pos >= section_ext_ro_length(pat))
+		return NULL;
+
+	return pat + pos;
+}
+
+static inline const uint8_t *
+	mpeg_pat_section_ro_programs_next(const uint8_t *pat, const uint8_t *pos)
+{
+	const uint8_t *end = pat + section_ext_ro_length(pat);
+	const uint8_t *next = pos + sizeof(struct mpeg_pat_program);
+
+	if (next >= end)
+		return NULL;
+
+	return next;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -69,3 +69,43 @@ struct mpeg_pmt_section * mpeg_pmt_section_codec(struct section_ext * ext)
 
 	return (struct mpeg_pmt_section *) ext;
 }
+
+int mpeg_pmt_section_ro_validate(const uint8_t *section)
+{
+	size_t pos = sizeof(struct mpeg_pmt_section);
+	size_t len = section_ext_ro_length(section);
+	size_t info_len;
+
+	if (len < sizeof(struct mpeg_pmt_section))
+		return -1;
+
+	info_len = mpeg_pmt_section_ro_program_info_length(section);
+	if ((pos + info_len) > len)
+		return -1;
+
+	if (verify_descriptors(section + pos, info_len))
+		return -1;
+
+	pos += info_len;
+
+	while (pos < len) {
+		if ((pos + sizeof(struct mpeg_pmt_stream)) > len)
+			return -1;
+
+		info_len = mpeg_pmt_stream_ro_es_info_length(section + pos);
+		pos += sizeof(struct mpeg_pmt_stream);
+
+		if ((pos + info_len) > len)
+			return -1;
+
+		if (verify_descriptors(section + pos, info_len))
+			return -1;
+
+		pos += info_len;
+	}
+
+	if (pos != len)
+		return -1;
+
+	return 0;
+}
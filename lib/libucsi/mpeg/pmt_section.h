@@ -109,6 +109,117 @@ static inline uint16_t mpeg_pmt_section_program_number(struct mpeg_pmt_section *
 	     (pos) = mpeg_pmt_stream_descriptors_next(stream, pos))
 
 
+/**
+ * Validate a raw mpeg_pmt_section without modifying it. The section must
+ * already have passed section_ext_ro_validate().
+ *
+ * @param section Pointer to the raw section.
+ * @return 0 if the section is valid, nonzero otherwise.
+ */
+extern int mpeg_pmt_section_ro_validate(const uint8_t *section);
+
+/**
+ * Accessor for the program_number field of a raw PMT.
+ *
+ * @param pmt Pointer to the raw PMT.
+ * @return The program_number.
+ */
+static inline uint16_t mpeg_pmt_section_ro_program_number(const uint8_t *pmt)
+{
+	return section_ext_ro_table_id_ext(pmt);
+}
+
+/**
+ * Accessor for the pcr_pid field of a raw PMT.
+ *
+ * @param pmt Pointer to the raw PMT.
+ * @return The pcr_pid.
+ */
+static inline uint16_t mpeg_pmt_section_ro_pcr_pid(const uint8_t *pmt)
+{
+	return ucsi_read16(pmt + 8) & 0x1fff;
+}
+
+/**
+ * Accessor for the program_info_length field of a raw PMT.
+ *
+ * @param pmt Pointer to the raw PMT.
+ * @return The program_info_length.
+ */
+static inline uint16_t mpeg_pmt_section_ro_program_info_length(const uint8_t *pmt)
+{
+	return ucsi_read16(pmt + 10) & 0x0fff;
+}
+
+/**
+ * Convenience iterator for the descriptors field of a raw PMT.
+ *
+ * @param pmt Pointer to the raw PMT.
+ * @param pos Variable holding a (const struct descriptor *) pointer to the
+ * current descriptor.
+ */
+#define mpeg_pmt_section_ro_descriptors_for_each(pmt, pos) \
+	for ((pos) = mpeg_pmt_section_ro_descriptors_first(pmt); \
+	     (pos); \
+	     (pos) = mpeg_pmt_section_ro_descriptors_next(pmt, pos))
+
+/**
+ * Convenience iterator for the streams field of a raw PMT.
+ *
+ * @param pmt Pointer to the raw PMT.
+ * @param pos Variable holding a (const uint8_t *) pointer to the current stream.
+ */
+#define mpeg_pmt_section_ro_streams_for_each(pmt, pos) \
+	for ((pos) = mpeg_pmt_section_ro_streams_first(pmt); \
+	     (pos); \
+	     (pos) = mpeg_pmt_section_ro_streams_next(pmt, pos))
+
+/**
+ * Accessor for the stream_type field of a raw PMT stream.
+ *
+ * @param stream Pointer to the raw stream.
+ * @return The stream_type.
+ */
+static inline uint8_t mpeg_pmt_stream_ro_stream_type(const uint8_t *stream)
+{
+	return stream[0];
+}
+
+/**
+ * Accessor for the pid field of a raw PMT stream.
+ *
+ * @param stream Pointer to the raw stream.
+ * @return The pid.
+ */
+static inline uint16_t mpeg_pmt_stream_ro_pid(const uint8_t *stream)
+{
+	return ucsi_read16(stream + 1) & 0x1fff;
+}
+
+/**
+ * Accessor for the es_info_length field of a raw PMT stream.
+ *
+ * @param stream Pointer to the raw stream.
+ * @return The es_info_length.
+ */
+static inline uint16_t mpeg_pmt_stream_ro_es_info_length(const uint8_t *stream)
+{
+	return ucsi_read16(stream + 3) & 0x0fff;
+}
+
+/**
+ * Convenience iterator for the descriptors field of a raw PMT stream.
+ *
+ * @param stream Pointer to the raw stream.
+ * @param pos Variable holding a (const struct descriptor *) pointer to the
+ * current descriptor.
+ */
+#define mpeg_pmt_stream_ro_descriptors_for_each(stream, pos) \
+	for ((pos) = mpeg_pmt_stream_ro_descriptors_first(stream); \
+	     (pos); \
+	     (pos) = mpeg_pmt_stream_ro_descriptors_next(stream, pos))
+
+
 
 
 
@@ -181,6 +292,67 @@ static inline struct descriptor *
 			       pos);
 }
 
+static inline const struct descriptor *
+	mpeg_pmt_section_ro_descriptors_first(const uint8_t *pmt)
+{
+	if (mpeg_pmt_section_ro_program_info_length(pmt) == 0)
+		return NULL;
+
+	return (const struct descriptor *) (pmt + sizeof(struct mpeg_pmt_section));
+}
+
+static inline const struct descriptor *
+	mpeg_pmt_section_ro_descriptors_next(const uint8_t *pmt,
+					     const struct descriptor *pos)
+{
+	return next_descriptor_ro(pmt + sizeof(struct mpeg_pmt_section),
+				  mpeg_pmt_section_ro_program_info_length(pmt),
+				  pos);
+}
+
+static inline const uint8_t *
+	mpeg_pmt_section_ro_streams_first(const uint8_t *pmt)
+{
+	size_t pos = sizeof(struct mpeg_pmt_section) +
+		mpeg_pmt_section_ro_program_info_length(pmt);
+
+	if (pos >= section_ext_ro_length(pmt))
+		return NULL;
+
+	return pmt + pos;
+}
+
+static inline const uint8_t *
+	mpeg_pmt_section_ro_streams_next(const uint8_t *pmt, const uint8_t *pos)
+{
+	const uint8_t *end = pmt + section_ext_ro_length(pmt);
+	const uint8_t *next = pos + sizeof(struct mpeg_pmt_stream) +
+		mpeg_pmt_stream_ro_es_info_length(pos);
+
+	if (next >= end)
+		return NULL;
+
+	return next;
+}
+
+static inline const struct descriptor *
+	mpeg_pmt_stream_ro_descriptors_first(const uint8_t *stream)
+{
+	if (mpeg_pmt_stream_ro_es_info_length(stream) == 0)
+		return NULL;
+
+	return (const struct descriptor *) (stream + sizeof(struct mpeg_pmt_stream));
+}
+
+static inline const struct descriptor *
+	mpeg_pmt_stream_ro_descriptors_next(const uint8_t *stream,
+					    const struct descriptor *pos)
+{
+	return next_descriptor_ro(stream + sizeof(struct mpeg_pmt_stream),
+				  mpeg_pmt_stream_ro_es_info_length(stream),
+				  pos);
+}
+
 #ifdef __cplusplus
 }
 #endif
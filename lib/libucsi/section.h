@@ -246,6 +246,211 @@ static inline int section_ext_useful(struct section_ext *section, struct psi_tab
 	return 1;
 }
 
+/*
+ * Read-only section access.
+ *
+ * The functions above decode sections in-place, byte swapping fields as they
+ * go, so a buffer can only be decoded once. The *_ro_* functions below instead
+ * validate the raw section and read big-endian fields on demand, leaving the
+ * buffer untouched. They may be used on read-only memory (e.g. an mmap()ed
+ * capture), or on buffers shared between threads.
+ */
+
+/**
+ * Validate the generic header of a raw section without modifying it.
+ *
+ * @param buf Pointer to the data.
+ * @param len Length of data.
+ * @return 0 if the section is valid, nonzero otherwise.
+ */
+static inline int section_ro_validate(const uint8_t * buf, size_t len)
+{
+	if (len < 3)
+		return -1;
+
+	if (len != (ucsi_read16(buf+1) & 0x0fffU) + 3U)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * Accessor for the table_id field of a raw section.
+ *
+ * @param section Pointer to the raw section.
+ * @return The table_id.
+ */
+static inline uint8_t section_ro_table_id(const uint8_t * section)
+{
+	return section[0];
+}
+
+/**
+ * Accessor for the syntax_indicator field of a raw section.
+ *
+ * @param section Pointer to the raw section.
+ * @return The syntax_indicator.
+ */
+static inline int section_ro_syntax_indicator(const uint8_t * section)
+{
+	return section[1] >> 7;
+}
+
+/**
+ * Determine the total length of a raw section, including the header.
+ *
+ * @param section Pointer to the raw section.
+ * @return The length.
+ */
+static inline size_t section_ro_length(const uint8_t * section)
+{
+	return (ucsi_read16(section+1) & 0x0fff) + sizeof(struct section);
+}
+
+/**
+ * Check the CRC of a raw section. Unlike section_check_crc(), this does not
+ * touch the buffer at all.
+ *
+ * @param section Pointer to the raw section.
+ * @return Nonzero on error, or 0 if the CRC was correct.
+ */
+static inline int section_ro_check_crc(const uint8_t * section)
+{
+	/* crc32() does not modify the buffer */
+	if (crc32(CRC32_INIT, (uint8_t *) section, section_ro_length(section)))
+		return -1;
+	return 0;
+}
+
+/**
+ * Validate a raw extended section without modifying it.
+ *
+ * @param buf Pointer to the data.
+ * @param len Length of data.
+ * @param check_crc If 1, the CRC of the section will also be checked.
+ * @return 0 if the section is valid, nonzero otherwise.
+ */
+static inline int section_ext_ro_validate(const uint8_t * buf, size_t len, int check_crc)
+{
+	if (section_ro_validate(buf, len))
+		return -1;
+
+	if (section_ro_syntax_indicator(buf) == 0)
+		return -1;
+
+	if (len < sizeof(struct section_ext) + CRC_SIZE)
+		return -1;
+
+	if (check_crc && section_ro_check_crc(buf))
+		return -1;
+
+	return 0;
+}
+
+/**
+ * Determine the length of a raw extended section, including the header,
+ * but omitting the CRC.
+ *
+ * @param section Pointer to the raw section.
+ * @return The length.
+ */
+static inline size_t section_ext_ro_length(const uint8_t * section)
+{
+	return section_ro_length(section) - CRC_SIZE;
+}
+
+/**
+ * Accessor for the table_id_ext field of a raw extended section.
+ *
+ * @param section Pointer to the raw section.
+ * @return The table_id_ext.
+ */
+static inline uint16_t section_ext_ro_table_id_ext(const uint8_t * section)
+{
+	return ucsi_read16(section+3);
+}
+
+/**
+ * Accessor for the version_number field of a raw extended section.
+ *
+ * @param section Pointer to the raw section.
+ * @return The version_number.
+ */
+static inline uint8_t section_ext_ro_version_number(const uint8_t * section)
+{
+	return (section[5] >> 1) & 0x1f;
+}
+
+/**
+ * Accessor for the current_next_indicator field of a raw extended section.
+ *
+ * @param section Pointer to the raw section.
+ * @return The current_next_indicator.
+ */
+static inline int section_ext_ro_current_next_indicator(const uint8_t * section)
+{
+	return section[5] & 1;
+}
+
+/**
+ * Accessor for the section_number field of a raw extended section.
+ *
+ * @param section Pointer to the raw section.
+ * @return The section_number.
+ */
+static inline uint8_t section_ext_ro_section_number(const uint8_t * section)
+{
+	return section[6];
+}
+
+/**
+ * Accessor for the last_section_number field of a raw extended section.
+ *
+ * @param section Pointer to the raw section.
+ * @return The last_section_number.
+ */
+static inline uint8_t section_ext_ro_last_section_number(const uint8_t * section)
+{
+	return section[7];
+}
+
+/**
+ * Check if a supplied raw extended section is something we want to process.
+ * This is the read-only equivalent of section_ext_useful().
+ *
+ * @param section Pointer to the raw section.
+ * @param tstate The state structure for this PSI table.
+ * @return 0=> not useful. nonzero => useful.
+ */
+static inline int section_ext_ro_useful(const uint8_t * section, struct psi_table_state *tstate)
+{
+	uint8_t version_number = section_ext_ro_version_number(section);
+	uint8_t section_number = section_ext_ro_section_number(section);
+
+	if ((version_number == tstate->version_number) && tstate->complete)
+		return 0;
+	if (version_number != tstate->version_number) {
+		if (section_number != 0)
+			return 0;
+
+		tstate->next_section_number = 0;
+		tstate->complete = 0;
+		tstate->version_number = version_number;
+		tstate->new_table = 1;
+	} else if (section_number == tstate->next_section_number) {
+		tstate->new_table = 0;
+	} else {
+		return 0;
+	}
+
+	tstate->next_section_number++;
+	if (section_ext_ro_last_section_number(section) < tstate->next_section_number) {
+		tstate->complete = 1;
+	}
+
+	return 1;
+}
+
 #ifdef __cplusplus
 }
 #endif
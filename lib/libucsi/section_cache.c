@@ -0,0 +1,320 @@
+/*
+ * section and descriptor parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "section.h"
+#include "section_cache.h"
+
+#define SECTION_CACHE_HASH_SIZE 4096
+
+/* identifies a saved cache file */
+#define SECTION_CACHE_MAGIC "UCSISC01"
+#define SECTION_CACHE_MAGIC_LEN 8
+
+/* EIT tables, whose segments need not be filled */
+#define TABLE_ID_EIT_FIRST 0x4e
+#define TABLE_ID_EIT_LAST 0x6f
+#define EIT_SEGMENT_LAST_SECTION_NUMBER 12
+
+struct section_cache {
+	section_cache_callback callback;
+	void *arg;
+
+	struct section_cache_table *hash[SECTION_CACHE_HASH_SIZE];
+};
+
+static inline unsigned int table_hash(int pid, uint8_t table_id, uint16_t table_id_ext)
+{
+	uint32_t key = (((uint32_t) pid << 8) | table_id) * 0x9e3779b1U;
+
+	return ((key >> 16) ^ table_id_ext ^ (table_id_ext >> 12)) & (SECTION_CACHE_HASH_SIZE - 1);
+}
+
+static inline int bit_test(uint32_t *map, int bit)
+{
+	return (map[bit >> 5] >> (bit & 31)) & 1;
+}
+
+static inline void bit_set(uint32_t *map, int bit)
+{
+	map[bit >> 5] |= 1U << (bit & 31);
+}
+
+static inline void bit_clear(uint32_t *map, int bit)
+{
+	map[bit >> 5] &= ~(1U << (bit & 31));
+}
+
+/*
+ * Drop all stored sections and begin a new version of the table.
+ */
+static int table_reset(struct section_cache_table *table, int version_number,
+		       int last_section_number)
+{
+	int i;
+
+	if (table->sections) {
+		for(i=0; i <= table->last_section_number; i++)
+			free(table->sections[i]);
+		free(table->sections);
+		table->sections = NULL;
+	}
+
+	table->version_number = version_number;
+	table->last_section_number = last_section_number;
+	table->complete = 0;
+	memset(table->received, 0, sizeof(table->received));
+	memset(table->expected, 0, sizeof(table->expected));
+	for(i=0; i <= last_section_number; i++)
+		bit_set(table->expected, i);
+
+	table->sections = calloc(last_section_number + 1, sizeof(uint8_t *));
+	if (table->sections == NULL) {
+		table->version_number = -1;
+		table->last_section_number = -1;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+struct section_cache *section_cache_create(section_cache_callback callback, void *arg)
+{
+	struct section_cache *cache;
+
+	cache = calloc(1, sizeof(struct section_cache));
+	if (cache == NULL)
+		return NULL;
+
+	cache->callback = callback;
+	cache->arg = arg;
+
+	return cache;
+}
+
+void section_cache_destroy(struct section_cache *cache)
+{
+	struct section_cache_table *table;
+	struct section_cache_table *next;
+	int i;
+	int k;
+
+	for(i=0; i < SECTION_CACHE_HASH_SIZE; i++) {
+		for(table = cache->hash[i]; table; table = next) {
+			next = table->hash_next;
+			if (table->sections) {
+				for(k=0; k <= table->last_section_number; k++)
+					free(table->sections[k]);
+				free(table->sections);
+			}
+			free(table);
+		}
+	}
+
+	free(cache);
+}
+
+struct section_cache_table *section_cache_find(struct section_cache *cache, int pid,
+					       uint8_t table_id, uint16_t table_id_ext)
+{
+	struct section_cache_table *table;
+
+	table = cache->hash[table_hash(pid, table_id, table_id_ext)];
+	for(; table; table = table->hash_next) {
+		if ((table->pid == pid) &&
+		    (table->table_id == table_id) &&
+		    (table->table_id_ext == table_id_ext))
+			return table;
+	}
+
+	return NULL;
+}
+
+int section_cache_add(struct section_cache *cache, int pid,
+		      const uint8_t *section, int len)
+{
+	struct section_cache_table *table;
+	uint8_t table_id;
+	uint16_t table_id_ext;
+	int version_number;
+	int section_number;
+	int last_section_number;
+	int segment_last;
+	unsigned int h;
+	int changed;
+	int i;
+
+	if (section_ext_ro_validate(section, len, 0))
+		return -EINVAL;
+	if (!section_ext_ro_current_next_indicator(section))
+		return 0;
+
+	table_id = section_ro_table_id(section);
+	table_id_ext = section_ext_ro_table_id_ext(section);
+	version_number = section_ext_ro_version_number(section);
+	section_number = section_ext_ro_section_number(section);
+	last_section_number = section_ext_ro_last_section_number(section);
+	if (section_number > last_section_number)
+		return -EINVAL;
+
+	/* a section we already hold: nothing to do */
+	table = section_cache_find(cache, pid, table_id, table_id_ext);
+	if (table &&
+	    (table->version_number == version_number) &&
+	    (table->last_section_number == last_section_number) &&
+	    bit_test(table->received, section_number))
+		return 0;
+
+	if (section_ro_check_crc(section))
+		return -EINVAL;
+
+	if (table == NULL) {
+		table = calloc(1, sizeof(struct section_cache_table));
+		if (table == NULL)
+			return -ENOMEM;
+		table->pid = pid;
+		table->table_id = table_id;
+		table->table_id_ext = table_id_ext;
+		table->version_number = -1;
+		table->last_section_number = -1;
+
+		h = table_hash(pid, table_id, table_id_ext);
+		table->hash_next = cache->hash[h];
+		cache->hash[h] = table;
+	}
+
+	if ((table->version_number != version_number) ||
+	    (table->last_section_number != last_section_number)) {
+		changed = (table->version_number != -1) &&
+			  (table->version_number != version_number);
+		if (table_reset(table, version_number, last_section_number))
+			return -ENOMEM;
+		if (changed && cache->callback)
+			cache->callback(cache->arg, table, section_cache_event_changed);
+	}
+
+	table->sections[section_number] = malloc(len);
+	if (table->sections[section_number] == NULL)
+		return -ENOMEM;
+	memcpy(table->sections[section_number], section, len);
+	bit_set(table->received, section_number);
+
+	/* EIT segments of 8 sections end at segment_last_section_number */
+	if ((table_id >= TABLE_ID_EIT_FIRST) && (table_id <= TABLE_ID_EIT_LAST) &&
+	    (len > EIT_SEGMENT_LAST_SECTION_NUMBER + CRC_SIZE)) {
+		segment_last = section[EIT_SEGMENT_LAST_SECTION_NUMBER];
+		if ((segment_last >> 3) == (section_number >> 3)) {
+			for(i = segment_last + 1;
+			    (i <= (section_number | 7)) && (i <= last_section_number); i++)
+				bit_clear(table->expected, i);
+		}
+	}
+
+	if (!table->complete) {
+		for(i=0; i < 8; i++) {
+			if ((table->received[i] & table->expected[i]) != table->expected[i])
+				break;
+		}
+		if (i == 8) {
+			table->complete = 1;
+			if (cache->callback)
+				cache->callback(cache->arg, table, section_cache_event_complete);
+		}
+	}
+
+	return 1;
+}
+
+int section_cache_save(struct section_cache *cache, const char *filename)
+{
+	struct section_cache_table *table;
+	const uint8_t *section;
+	uint8_t pid[2];
+	FILE *f;
+	int i;
+	int k;
+
+	f = fopen(filename, "wb");
+	if (f == NULL)
+		return -1;
+
+	if (fwrite(SECTION_CACHE_MAGIC, SECTION_CACHE_MAGIC_LEN, 1, f) != 1)
+		goto error;
+
+	/* each record is the pid followed by the raw section */
+	for(i=0; i < SECTION_CACHE_HASH_SIZE; i++) {
+		for(table = cache->hash[i]; table; table = table->hash_next) {
+			pid[0] = table->pid >> 8;
+			pid[1] = table->pid;
+			section_cache_table_sections_for_each(table, k, section) {
+				if ((fwrite(pid, 2, 1, f) != 1) ||
+				    (fwrite(section, section_ro_length(section), 1, f) != 1))
+					goto error;
+			}
+		}
+	}
+
+	if (fclose(f))
+		return -1;
+	return 0;
+
+error:
+	fclose(f);
+	return -1;
+}
+
+int section_cache_load(struct section_cache *cache, const char *filename)
+{
+	char magic[SECTION_CACHE_MAGIC_LEN];
+	uint8_t buf[2 + 4096 + sizeof(struct section)];
+	size_t len;
+	int count = 0;
+	int ret;
+	FILE *f;
+
+	f = fopen(filename, "rb");
+	if (f == NULL)
+		return -1;
+
+	if ((fread(magic, SECTION_CACHE_MAGIC_LEN, 1, f) != 1) ||
+	    memcmp(magic, SECTION_CACHE_MAGIC, SECTION_CACHE_MAGIC_LEN)) {
+		fclose(f);
+		return -EINVAL;
+	}
+
+	while(fread(buf, 2 + sizeof(struct section), 1, f) == 1) {
+		len = section_ro_length(buf + 2);
+		if (fread(buf + 2 + sizeof(struct section),
+			  len - sizeof(struct section), 1, f) != 1)
+			break;
+
+		ret = section_cache_add(cache, (buf[0] << 8) | buf[1], buf + 2, len);
+		if (ret == -ENOMEM) {
+			fclose(f);
+			return ret;
+		}
+		if (ret > 0)
+			count++;
+	}
+
+	fclose(f);
+	return count;
+}
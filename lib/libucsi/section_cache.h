@@ -0,0 +1,173 @@
+/*
+ * section and descriptor parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_SECTION_CACHE_H
+#define _UCSI_SECTION_CACHE_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * Events reported for a table by the cache.
+ */
+enum section_cache_event {
+	section_cache_event_changed	= 0x01, /* a new version of the table has started */
+	section_cache_event_complete	= 0x02, /* every section of the current version is present */
+};
+
+/**
+ * A cached table, identified by (pid, table_id, table_id_ext). All fields are
+ * read-only to the caller.
+ */
+struct section_cache_table {
+	struct section_cache_table *hash_next;
+
+	int pid;
+	uint8_t table_id;
+	uint16_t table_id_ext;
+
+	int version_number;		/* -1 until the first section arrives */
+	int last_section_number;
+	int complete;
+
+	uint32_t received[8];		/* bitmap of sections present */
+	uint32_t expected[8];		/* bitmap of sections which exist */
+	uint8_t **sections;		/* raw copy of each section present */
+};
+
+/**
+ * Callback for table events.
+ *
+ * @param arg Private argument supplied to section_cache_create().
+ * @param table The table concerned.
+ * @param event The event.
+ */
+typedef void (*section_cache_callback)(void *arg, struct section_cache_table *table,
+				       enum section_cache_event event);
+
+/**
+ * Opaque structure representing a cache.
+ */
+struct section_cache;
+
+/**
+ * Create a new, empty, cache. The cache does no locking of its own.
+ *
+ * @param callback Callback for table events, or NULL for none.
+ * @param arg Private argument passed to callback.
+ * @return The cache, or NULL on failure.
+ */
+extern struct section_cache *section_cache_create(section_cache_callback callback, void *arg);
+
+/**
+ * Destroy a cache and all the sections in it.
+ *
+ * @param cache The cache.
+ */
+extern void section_cache_destroy(struct section_cache *cache);
+
+/**
+ * Add a raw extended section to the cache. Sections may arrive in any order.
+ * A section with a new version_number discards the stored sections of the
+ * table and reports section_cache_event_changed; section_cache_event_complete
+ * is reported once all sections of a version are present. For EIT schedule
+ * tables the sections missing from each segment (after its
+ * segment_last_section_number) are not waited for. Sections with
+ * current_next_indicator clear are ignored.
+ *
+ * A section already present in the cache is recognised from its header alone,
+ * so that callers can skip reparsing it; new sections have their CRC checked.
+ *
+ * @param cache The cache.
+ * @param pid The PID the section arrived on.
+ * @param section The raw section. This is not modified.
+ * @param len Length of the section.
+ * @return 1 if the section was new and has been stored, 0 if it was already
+ * present or ignored, or < 0 on error (-EINVAL for an invalid section).
+ */
+extern int section_cache_add(struct section_cache *cache, int pid,
+			     const uint8_t *section, int len);
+
+/**
+ * Look up a table in the cache.
+ *
+ * @param cache The cache.
+ * @param pid The PID.
+ * @param table_id The table_id.
+ * @param table_id_ext The table_id_ext.
+ * @return The table, or NULL if no section of it has been seen.
+ */
+extern struct section_cache_table *section_cache_find(struct section_cache *cache, int pid,
+						      uint8_t table_id, uint16_t table_id_ext);
+
+/**
+ * Get a raw section of a cached table.
+ *
+ * @param table The table.
+ * @param section_number The section_number.
+ * @return Pointer to the raw section, or NULL if it is not present.
+ */
+static inline const uint8_t *section_cache_table_section(struct section_cache_table *table,
+							  int section_number)
+{
+	if ((table->sections == NULL) || (section_number > table->last_section_number))
+		return NULL;
+	return table->sections[section_number];
+}
+
+/**
+ * Iterator for the sections present in a cached table, in section_number order.
+ *
+ * @param table The table.
+ * @param num Integer variable holding the current section_number.
+ * @param pos Variable holding a (const uint8_t *) pointer to the current section.
+ */
+#define section_cache_table_sections_for_each(table, num, pos) \
+	for ((num) = 0; (num) <= (table)->last_section_number; (num)++) \
+		if (((pos) = section_cache_table_section(table, num)) != NULL)
+
+/**
+ * Save every section in the cache to a file, so the state can be restored with
+ * section_cache_load() after a restart.
+ *
+ * @param cache The cache.
+ * @param filename The file to write.
+ * @return 0 on success, nonzero on error.
+ */
+extern int section_cache_save(struct section_cache *cache, const char *filename);
+
+/**
+ * Add the sections saved in a file to the cache. They are passed through
+ * section_cache_add(), so the usual events are reported for them.
+ *
+ * @param cache The cache.
+ * @param filename The file to read.
+ * @return Number of sections loaded, or < 0 on error (e.g. if the file is not
+ * a saved cache).
+ */
+extern int section_cache_load(struct section_cache *cache, const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
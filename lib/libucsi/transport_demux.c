@@ -0,0 +1,539 @@
+/*
+ * section and descriptor parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "transport_demux.h"
+#include "section_buf.h"
+
+#define SECTION_HDR_SIZE 3
+#define SECTION_PAD 0xff
+#define PES_HDR_SIZE 6
+
+enum demux_pid_type {
+	demux_pid_type_section,
+	demux_pid_type_pes,
+	demux_pid_type_packet,
+};
+
+struct demux_pid {
+	enum demux_pid_type type;
+	unsigned char continuity;
+	void *arg;
+
+	/* section state */
+	transport_demux_section_callback section_callback;
+	struct section_buf *section;
+	int max_section_size;
+
+	/* PES state */
+	transport_demux_pes_callback pes_callback;
+	uint8_t *pes;
+	int pes_count;
+	int pes_len;
+	int pes_max;
+	int pes_wait_pdu;
+
+	/* packet state */
+	transport_demux_packet_callback packet_callback;
+	struct transport_packet *batch[TRANSPORT_DEMUX_BATCH];
+	int batch_count;
+	int queued;
+
+	/* cleared PIDs are only released once transport_demux_feed() returns */
+	struct demux_pid *next_free;
+};
+
+struct transport_demux {
+	struct demux_pid *pids[TRANSPORT_MAX_PIDS];
+
+	/* PIDs with packets queued in their batch */
+	uint16_t pending[TRANSPORT_MAX_PIDS];
+	int pending_count;
+
+	int feeding;
+	struct demux_pid *free_list;
+
+	transport_demux_error_callback error_callback;
+	void *error_arg;
+
+	struct transport_demux_stats stats;
+};
+
+static struct demux_pid *demux_pid_alloc(struct transport_demux *demux, int pid);
+static void demux_pid_free(struct demux_pid *p);
+static void demux_error(struct transport_demux *demux, int pid, enum transport_demux_error error);
+static void demux_section(struct transport_demux *demux, struct demux_pid *p, int pid,
+			  uint8_t *payload, int len, int pdu_start);
+static void demux_pes(struct transport_demux *demux, struct demux_pid *p, int pid,
+		      uint8_t *payload, int len, int pdu_start);
+static void demux_flush_batches(struct transport_demux *demux);
+static void demux_release_pids(struct transport_demux *demux);
+
+
+struct transport_demux *transport_demux_create(transport_demux_error_callback error_callback,
+					       void *arg)
+{
+	struct transport_demux *demux;
+
+	demux = (struct transport_demux *) malloc(sizeof(struct transport_demux));
+	if (demux == NULL)
+		return NULL;
+	memset(demux, 0, sizeof(struct transport_demux));
+
+	demux->error_callback = error_callback;
+	demux->error_arg = arg;
+
+	return demux;
+}
+
+void transport_demux_destroy(struct transport_demux *demux)
+{
+	int pid;
+
+	for(pid=0; pid < TRANSPORT_MAX_PIDS; pid++) {
+		if (demux->pids[pid])
+			demux_pid_free(demux->pids[pid]);
+	}
+	demux_release_pids(demux);
+	free(demux);
+}
+
+int transport_demux_set_section_pid(struct transport_demux *demux, int pid,
+				    int max_section_size,
+				    transport_demux_section_callback callback,
+				    void *arg)
+{
+	struct demux_pid *p;
+
+	if ((max_section_size < SECTION_HDR_SIZE) || (callback == NULL))
+		return -EINVAL;
+	if ((p = demux_pid_alloc(demux, pid)) == NULL)
+		return -ENOMEM;
+
+	p->type = demux_pid_type_section;
+	p->section_callback = callback;
+	p->max_section_size = max_section_size;
+	p->arg = arg;
+	return 0;
+}
+
+int transport_demux_set_pes_pid(struct transport_demux *demux, int pid,
+				int max_pes_size,
+				transport_demux_pes_callback callback,
+				void *arg)
+{
+	struct demux_pid *p;
+
+	if ((max_pes_size < PES_HDR_SIZE) || (callback == NULL))
+		return -EINVAL;
+	if ((p = demux_pid_alloc(demux, pid)) == NULL)
+		return -ENOMEM;
+
+	p->type = demux_pid_type_pes;
+	p->pes_callback = callback;
+	p->pes_max = max_pes_size;
+	p->pes_wait_pdu = 1;
+	p->arg = arg;
+	return 0;
+}
+
+int transport_demux_set_packet_pid(struct transport_demux *demux, int pid,
+				   transport_demux_packet_callback callback,
+				   void *arg)
+{
+	struct demux_pid *p;
+
+	if (callback == NULL)
+		return -EINVAL;
+	if ((p = demux_pid_alloc(demux, pid)) == NULL)
+		return -ENOMEM;
+
+	p->type = demux_pid_type_packet;
+	p->packet_callback = callback;
+	p->arg = arg;
+	return 0;
+}
+
+void transport_demux_clear_pid(struct transport_demux *demux, int pid)
+{
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS))
+		return;
+
+	if (demux->pids[pid] == NULL)
+		return;
+
+	/* callbacks may clear PIDs while we are still using them */
+	if (demux->feeding) {
+		demux->pids[pid]->next_free = demux->free_list;
+		demux->free_list = demux->pids[pid];
+	} else {
+		demux_pid_free(demux->pids[pid]);
+	}
+	demux->pids[pid] = NULL;
+}
+
+int transport_demux_feed(struct transport_demux *demux, uint8_t *buf, int len)
+{
+	int count = len / TRANSPORT_PACKET_LENGTH;
+
+	transport_demux_feed_packets(demux, buf, count, TRANSPORT_PACKET_LENGTH);
+
+	return count * TRANSPORT_PACKET_LENGTH;
+}
+
+void transport_demux_feed_packets(struct transport_demux *demux, uint8_t *packets,
+				  int count, int stride)
+{
+	int i;
+	int pid;
+	struct transport_packet *pkt;
+	struct transport_values tsvals;
+	struct demux_pid *p;
+
+	demux->feeding = 1;
+	for(i=0; i < count; i++) {
+		demux->stats.packets++;
+
+		if ((pkt = transport_packet_init(packets + i*stride)) == NULL) {
+			demux_error(demux, -1, transport_demux_error_sync);
+			continue;
+		}
+
+		/* the flat PID table makes discarding unwanted packets cheap */
+		pid = transport_packet_pid(pkt);
+		if ((p = demux->pids[pid]) == NULL)
+			continue;
+
+		if (p->type == demux_pid_type_packet) {
+			if (!p->queued) {
+				demux->pending[demux->pending_count++] = pid;
+				p->queued = 1;
+			}
+			p->batch[p->batch_count++] = pkt;
+			if (p->batch_count == TRANSPORT_DEMUX_BATCH) {
+				p->batch_count = 0;
+				p->packet_callback(p->arg, pid, p->batch, TRANSPORT_DEMUX_BATCH);
+			}
+			continue;
+		}
+
+		if (pkt->transport_error_indicator) {
+			demux_error(demux, pid, transport_demux_error_packet);
+			continue;
+		}
+		if (transport_packet_values_extract(pkt, &tsvals, 0) < 0) {
+			demux_error(demux, pid, transport_demux_error_packet);
+			continue;
+		}
+
+		if (transport_packet_continuity_check(pkt,
+		    tsvals.flags & transport_adaptation_flag_discontinuity,
+		    &p->continuity)) {
+			demux_error(demux, pid, transport_demux_error_continuity);
+			p->continuity = 0;
+			if (p->section) {
+				section_buf_reset(p->section);
+				p->section->wait_pdu = 1;
+			}
+			p->pes_count = 0;
+			p->pes_wait_pdu = 1;
+			continue;
+		}
+
+		if (tsvals.payload_length == 0)
+			continue;
+
+		if (p->type == demux_pid_type_section)
+			demux_section(demux, p, pid, tsvals.payload, tsvals.payload_length,
+				      pkt->payload_unit_start_indicator);
+		else
+			demux_pes(demux, p, pid, tsvals.payload, tsvals.payload_length,
+				  pkt->payload_unit_start_indicator);
+	}
+
+	demux_flush_batches(demux);
+	demux->feeding = 0;
+	demux_release_pids(demux);
+}
+
+struct transport_demux_stats *transport_demux_get_stats(struct transport_demux *demux)
+{
+	return &demux->stats;
+}
+
+static struct demux_pid *demux_pid_alloc(struct transport_demux *demux, int pid)
+{
+	struct demux_pid *p;
+
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS))
+		return NULL;
+
+	/* flush anything queued under the old registration first */
+	demux_flush_batches(demux);
+	transport_demux_clear_pid(demux, pid);
+
+	p = (struct demux_pid *) malloc(sizeof(struct demux_pid));
+	if (p == NULL)
+		return NULL;
+	memset(p, 0, sizeof(struct demux_pid));
+
+	demux->pids[pid] = p;
+	return p;
+}
+
+static void demux_pid_free(struct demux_pid *p)
+{
+	if (p->section)
+		free(p->section);
+	if (p->pes)
+		free(p->pes);
+	free(p);
+}
+
+static void demux_error(struct transport_demux *demux, int pid, enum transport_demux_error error)
+{
+	switch(error) {
+	case transport_demux_error_sync:
+		demux->stats.sync_errors++;
+		break;
+	case transport_demux_error_packet:
+		demux->stats.packet_errors++;
+		break;
+	case transport_demux_error_continuity:
+		demux->stats.continuity_errors++;
+		break;
+	case transport_demux_error_section:
+		demux->stats.section_errors++;
+		break;
+	case transport_demux_error_pes:
+		demux->stats.pes_errors++;
+		break;
+	}
+
+	if (demux->error_callback)
+		demux->error_callback(demux->error_arg, pid, error);
+}
+
+static void demux_section_complete(struct transport_demux *demux, struct demux_pid *p, int pid,
+				   uint8_t *section, int len)
+{
+	demux->stats.sections++;
+	p->section_callback(p->arg, pid, section, len);
+}
+
+static void demux_section(struct transport_demux *demux, struct demux_pid *p, int pid,
+			  uint8_t *payload, int len, int pdu_start)
+{
+	struct section_buf *sbuf = p->section;
+	int section_status;
+	int used;
+	int offset;
+	int seclen;
+
+	/* allocate the section buffer on first use */
+	if (sbuf == NULL) {
+		sbuf = (struct section_buf *) malloc(sizeof(struct section_buf) + p->max_section_size);
+		if (sbuf == NULL)
+			return;
+		section_buf_init(sbuf, p->max_section_size);
+		p->section = sbuf;
+	}
+
+	if (pdu_start) {
+		offset = payload[0];
+		if ((offset + 1) > len) {
+			demux_error(demux, pid, transport_demux_error_section);
+			section_buf_reset(sbuf);
+			sbuf->wait_pdu = 1;
+			return;
+		}
+
+		/* complete the section in progress (if any) */
+		if (sbuf->count) {
+			section_buf_add_transport_payload(sbuf, payload, len, 1, &section_status);
+			if (section_status == 1)
+				demux_section_complete(demux, p, pid,
+						       section_buf_data(sbuf), sbuf->len);
+			else
+				demux_error(demux, pid, transport_demux_error_section);
+			if (demux->pids[pid] != p)
+				return;
+			section_buf_reset(sbuf);
+		}
+		sbuf->wait_pdu = 0;
+		payload += offset + 1;
+		len -= offset + 1;
+
+		/* sections held entirely within this payload are passed
+		 * out in-place without being copied */
+		while((len >= SECTION_HDR_SIZE) && (*payload != SECTION_PAD)) {
+			seclen = SECTION_HDR_SIZE + (((payload[1] & 0x0f) << 8) | payload[2]);
+			if (seclen > p->max_section_size) {
+				demux_error(demux, pid, transport_demux_error_section);
+				sbuf->wait_pdu = 1;
+				return;
+			}
+			if (seclen > len)
+				break;
+
+			demux_section_complete(demux, p, pid, payload, seclen);
+			if (demux->pids[pid] != p)
+				return;
+			payload += seclen;
+			len -= seclen;
+		}
+	} else if (sbuf->wait_pdu) {
+		return;
+	}
+
+	/* accumulate whatever remains */
+	while(len) {
+		used = section_buf_add(sbuf, payload, len, &section_status);
+		payload += used;
+		len -= used;
+
+		if (section_status == 1) {
+			demux_section_complete(demux, p, pid, section_buf_data(sbuf), sbuf->len);
+			if (demux->pids[pid] != p)
+				return;
+			section_buf_reset(sbuf);
+		} else if (section_status < 0) {
+			demux_error(demux, pid, transport_demux_error_section);
+			section_buf_reset(sbuf);
+			sbuf->wait_pdu = 1;
+			return;
+		}
+	}
+}
+
+static void demux_pes_complete(struct transport_demux *demux, struct demux_pid *p, int pid,
+			       uint8_t *pes, int len)
+{
+	demux->stats.pes_packets++;
+	p->pes_callback(p->arg, pid, pes, len);
+}
+
+static void demux_pes(struct transport_demux *demux, struct demux_pid *p, int pid,
+		      uint8_t *payload, int len, int pdu_start)
+{
+	int copy;
+	int pes_len;
+	uint8_t *tmp;
+
+	if (pdu_start) {
+		/* unbounded PES packets are terminated by the next PDU */
+		if (p->pes_count && !p->pes_wait_pdu) {
+			if (p->pes_len == 0)
+				demux_pes_complete(demux, p, pid, p->pes, p->pes_count);
+			else
+				demux_error(demux, pid, transport_demux_error_pes);
+			if (demux->pids[pid] != p)
+				return;
+		}
+		p->pes_count = 0;
+		p->pes_wait_pdu = 0;
+
+		if ((len < PES_HDR_SIZE) ||
+		    (payload[0] != 0x00) || (payload[1] != 0x00) || (payload[2] != 0x01)) {
+			demux_error(demux, pid, transport_demux_error_pes);
+			p->pes_wait_pdu = 1;
+			return;
+		}
+
+		pes_len = (payload[4] << 8) | payload[5];
+		p->pes_len = pes_len ? pes_len + PES_HDR_SIZE : 0;
+		if (p->pes_len > p->pes_max) {
+			demux_error(demux, pid, transport_demux_error_pes);
+			p->pes_wait_pdu = 1;
+			return;
+		}
+
+		/* a PES packet held entirely within this payload is passed out in-place */
+		if (p->pes_len && (p->pes_len <= len)) {
+			demux_pes_complete(demux, p, pid, payload, p->pes_len);
+			p->pes_wait_pdu = 1;
+			return;
+		}
+	} else if (p->pes_wait_pdu) {
+		return;
+	}
+
+	/* clamp to the expected length */
+	copy = len;
+	if (p->pes_len && ((p->pes_count + copy) > p->pes_len))
+		copy = p->pes_len - p->pes_count;
+	if ((p->pes_count + copy) > p->pes_max) {
+		demux_error(demux, pid, transport_demux_error_pes);
+		p->pes_count = 0;
+		p->pes_wait_pdu = 1;
+		return;
+	}
+
+	/* grow the buffer lazily; it is kept for subsequent packets */
+	if (p->pes == NULL) {
+		if ((tmp = (uint8_t *) malloc(p->pes_max)) == NULL) {
+			p->pes_wait_pdu = 1;
+			return;
+		}
+		p->pes = tmp;
+	}
+
+	memcpy(p->pes + p->pes_count, payload, copy);
+	p->pes_count += copy;
+
+	if (p->pes_len && (p->pes_count == p->pes_len)) {
+		demux_pes_complete(demux, p, pid, p->pes, p->pes_count);
+		p->pes_count = 0;
+		p->pes_wait_pdu = 1;
+	}
+}
+
+static void demux_flush_batches(struct transport_demux *demux)
+{
+	int i;
+	int pid;
+	int count;
+	struct demux_pid *p;
+
+	for(i=0; i < demux->pending_count; i++) {
+		pid = demux->pending[i];
+		p = demux->pids[pid];
+		if ((p == NULL) || (p->type != demux_pid_type_packet))
+			continue;
+
+		p->queued = 0;
+		if (p->batch_count) {
+			count = p->batch_count;
+			p->batch_count = 0;
+			p->packet_callback(p->arg, pid, p->batch, count);
+		}
+	}
+	demux->pending_count = 0;
+}
+
+static void demux_release_pids(struct transport_demux *demux)
+{
+	struct demux_pid *p;
+
+	while((p = demux->free_list) != NULL) {
+		demux->free_list = p->next_free;
+		demux_pid_free(p);
+	}
+}
@@ -0,0 +1,226 @@
+/*
+ * section and descriptor parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_TRANSPORT_DEMUX_H
+#define _UCSI_TRANSPORT_DEMUX_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libucsi/transport_packet.h>
+
+/**
+ * Maximum number of packets queued for a packet handler before its callback
+ * is invoked. Queued packets are always flushed before transport_demux_feed()
+ * returns.
+ */
+#define TRANSPORT_DEMUX_BATCH 64
+
+/**
+ * Enumeration of errors reported by the demuxer.
+ */
+enum transport_demux_error {
+	transport_demux_error_sync		= 0x01,
+	transport_demux_error_packet		= 0x02,
+	transport_demux_error_continuity	= 0x03,
+	transport_demux_error_section		= 0x04,
+	transport_demux_error_pes		= 0x05,
+};
+
+/**
+ * Counters maintained by the demuxer.
+ */
+struct transport_demux_stats {
+	uint64_t packets;
+	uint64_t sync_errors;
+	uint64_t packet_errors;
+	uint64_t continuity_errors;
+	uint64_t sections;
+	uint64_t section_errors;
+	uint64_t pes_packets;
+	uint64_t pes_errors;
+};
+
+/**
+ * Callback for a completed section. Sections which are entirely contained
+ * within a single transport packet are passed pointing directly into the buffer
+ * supplied to transport_demux_feed(), so no copy is made. The callback may
+ * process the section in-place (e.g. with section_codec()).
+ *
+ * @param arg Private argument supplied when the PID was registered.
+ * @param pid The PID the section arrived on.
+ * @param section Pointer to the section data.
+ * @param len Length of the section data.
+ */
+typedef void (*transport_demux_section_callback)(void *arg, int pid,
+						 uint8_t *section, int len);
+
+/**
+ * Callback for a completed PES packet. As with sections, PES packets contained
+ * in a single transport packet are passed without being copied.
+ *
+ * @param arg Private argument supplied when the PID was registered.
+ * @param pid The PID the PES packet arrived on.
+ * @param pes Pointer to the PES packet (starting with the packet_start_code_prefix).
+ * @param len Length of the PES packet.
+ */
+typedef void (*transport_demux_pes_callback)(void *arg, int pid,
+					     uint8_t *pes, int len);
+
+/**
+ * Callback for a batch of raw transport packets on a PID. The packet pointers
+ * point into the buffer supplied to transport_demux_feed(), and are only valid
+ * for the duration of the callback.
+ *
+ * @param arg Private argument supplied when the PID was registered.
+ * @param pid The PID the packets arrived on.
+ * @param pkts Array of packets, in stream order.
+ * @param count Number of packets in the array.
+ */
+typedef void (*transport_demux_packet_callback)(void *arg, int pid,
+						struct transport_packet **pkts, int count);
+
+/**
+ * Callback for errors detected by the demuxer.
+ *
+ * @param arg Private argument supplied to transport_demux_create().
+ * @param pid The PID concerned, or -1 if unknown (sync errors).
+ * @param error The error.
+ */
+typedef void (*transport_demux_error_callback)(void *arg, int pid,
+					       enum transport_demux_error error);
+
+/**
+ * Opaque structure representing a demuxer.
+ */
+struct transport_demux;
+
+/**
+ * Create a new demuxer. Initially no PIDs are registered, so all packets are
+ * discarded.
+ *
+ * @param error_callback Callback for errors, or NULL for none.
+ * @param arg Private argument passed to error_callback.
+ * @return The demuxer, or NULL on failure.
+ */
+extern struct transport_demux *transport_demux_create(transport_demux_error_callback error_callback,
+						      void *arg);
+
+/**
+ * Destroy a demuxer and all its per-PID state.
+ *
+ * @param demux The demuxer.
+ */
+extern void transport_demux_destroy(struct transport_demux *demux);
+
+/**
+ * Reassemble sections on a PID. The section buffer is only allocated once
+ * data actually arrives on the PID, so registering a large number of PIDs is cheap.
+ *
+ * @param demux The demuxer.
+ * @param pid The PID.
+ * @param max_section_size Maximum section size (e.g. DVB_MAX_SECTION_BYTES).
+ * @param callback Callback for completed sections.
+ * @param arg Private argument passed to callback.
+ * @return 0 on success, nonzero on error.
+ */
+extern int transport_demux_set_section_pid(struct transport_demux *demux, int pid,
+					   int max_section_size,
+					   transport_demux_section_callback callback,
+					   void *arg);
+
+/**
+ * Reassemble PES packets on a PID. PES packets with a zero PES_packet_length
+ * are delivered when the next payload_unit_start_indicator arrives.
+ *
+ * @param demux The demuxer.
+ * @param pid The PID.
+ * @param max_pes_size Maximum PES packet size to accept.
+ * @param callback Callback for completed PES packets.
+ * @param arg Private argument passed to callback.
+ * @return 0 on success, nonzero on error.
+ */
+extern int transport_demux_set_pes_pid(struct transport_demux *demux, int pid,
+				       int max_pes_size,
+				       transport_demux_pes_callback callback,
+				       void *arg);
+
+/**
+ * Pass raw transport packets on a PID through to a callback, in batches of up
+ * to TRANSPORT_DEMUX_BATCH packets.
+ *
+ * @param demux The demuxer.
+ * @param pid The PID.
+ * @param callback Callback for batches of packets.
+ * @param arg Private argument passed to callback.
+ * @return 0 on success, nonzero on error.
+ */
+extern int transport_demux_set_packet_pid(struct transport_demux *demux, int pid,
+					  transport_demux_packet_callback callback,
+					  void *arg);
+
+/**
+ * Stop processing a PID, releasing any state associated with it.
+ *
+ * @param demux The demuxer.
+ * @param pid The PID.
+ */
+extern void transport_demux_clear_pid(struct transport_demux *demux, int pid);
+
+/**
+ * Feed a buffer of transport packets through the demuxer. Only complete
+ * packets are processed; the caller should keep any trailing partial packet
+ * and resubmit it with the next buffer.
+ *
+ * @param demux The demuxer.
+ * @param buf Buffer of transport packets.
+ * @param len Number of bytes in buf.
+ * @return Number of bytes consumed.
+ */
+extern int transport_demux_feed(struct transport_demux *demux, uint8_t *buf, int len);
+
+/**
+ * Feed a number of transport packets spaced at a fixed interval through the
+ * demuxer. This allows M2TS (192 byte) or FEC padded (204 byte) packets, such as
+ * the spans returned by transport_sync_process(), to be demuxed without first
+ * copying them.
+ *
+ * @param demux The demuxer.
+ * @param packets Pointer to the first packet.
+ * @param count Number of packets.
+ * @param stride Distance in bytes between the start of each packet.
+ */
+extern void transport_demux_feed_packets(struct transport_demux *demux, uint8_t *packets,
+					 int count, int stride);
+
+/**
+ * Retrieve the demuxer's counters.
+ *
+ * @param demux The demuxer.
+ * @return Pointer to the counters.
+ */
+extern struct transport_demux_stats *transport_demux_get_stats(struct transport_demux *demux);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
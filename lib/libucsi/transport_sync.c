@@ -0,0 +1,267 @@
+/*
+ * section and descriptor parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <string.h>
+#include "transport_sync.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TRANSPORT_SYNC_HAVE_SIMD 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+static int sync_scan_dispatch(const uint8_t *buf, int start, int end, int stride, int count);
+
+/* the scan implementation in use - selected on first use */
+static int (*sync_scan)(const uint8_t *buf, int start, int end, int stride, int count) =
+	sync_scan_dispatch;
+
+/* candidate packet sizes for autodetection, in order of preference */
+static const int sync_sizes[] = {
+	TRANSPORT_PACKET_LENGTH,
+	TRANSPORT_PACKET_LENGTH_M2TS,
+	TRANSPORT_PACKET_LENGTH_FEC,
+};
+
+static int sync_offset(int packet_size)
+{
+	if (packet_size == TRANSPORT_PACKET_LENGTH_M2TS)
+		return TRANSPORT_PACKET_LENGTH_M2TS - TRANSPORT_PACKET_LENGTH;
+	return 0;
+}
+
+/*
+ * The scan functions return the first position p in [start, end) for which
+ * buf[p + k*stride] == TRANSPORT_PACKET_SYNC for all k < count, or -1. The
+ * caller guarantees that buf[end - 1 + (count-1)*stride] is readable.
+ */
+static int sync_scan_scalar(const uint8_t *buf, int start, int end, int stride, int count)
+{
+	int p;
+	int k;
+
+	for(p = start; p < end; p++) {
+		for(k=0; k < count; k++) {
+			if (buf[p + k*stride] != TRANSPORT_PACKET_SYNC)
+				break;
+		}
+		if (k == count)
+			return p;
+	}
+
+	return -1;
+}
+
+#ifdef TRANSPORT_SYNC_HAVE_SIMD
+
+/* Each step compares 16 candidate positions at once against all count
+ * strides, and'ing the match masks together. */
+static int sync_scan_sse2(const uint8_t *buf, int start, int end, int stride, int count)
+{
+	const __m128i sync = _mm_set1_epi8(TRANSPORT_PACKET_SYNC);
+	unsigned int mask;
+	int p;
+	int k;
+
+	for(p = start; (p + 16) <= end; p += 16) {
+		mask = 0xffff;
+		for(k=0; (k < count) && mask; k++) {
+			__m128i v = _mm_loadu_si128((const __m128i *) (buf + p + k*stride));
+			mask &= _mm_movemask_epi8(_mm_cmpeq_epi8(v, sync));
+		}
+		if (mask)
+			return p + __builtin_ctz(mask);
+	}
+
+	return sync_scan_scalar(buf, p, end, stride, count);
+}
+
+__attribute__((target("avx2")))
+static int sync_scan_avx2(const uint8_t *buf, int start, int end, int stride, int count)
+{
+	const __m256i sync = _mm256_set1_epi8(TRANSPORT_PACKET_SYNC);
+	unsigned int mask;
+	int p;
+	int k;
+
+	for(p = start; (p + 32) <= end; p += 32) {
+		mask = 0xffffffff;
+		for(k=0; (k < count) && mask; k++) {
+			__m256i v = _mm256_loadu_si256((const __m256i *) (buf + p + k*stride));
+			mask &= _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, sync));
+		}
+		if (mask)
+			return p + __builtin_ctz(mask);
+	}
+
+	return sync_scan_sse2(buf, p, end, stride, count);
+}
+
+static int sync_scan_dispatch(const uint8_t *buf, int start, int end, int stride, int count)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		sync_scan = sync_scan_avx2;
+	else if (__builtin_cpu_supports("sse2"))
+		sync_scan = sync_scan_sse2;
+	else
+		sync_scan = sync_scan_scalar;
+
+	return sync_scan(buf, start, end, stride, count);
+}
+
+#else
+
+static int sync_scan_dispatch(const uint8_t *buf, int start, int end, int stride, int count)
+{
+	sync_scan = sync_scan_scalar;
+
+	return sync_scan(buf, start, end, stride, count);
+}
+
+#endif
+
+int transport_sync_init(struct transport_sync *sync, int packet_size)
+{
+	switch(packet_size) {
+	case 0:
+	case TRANSPORT_PACKET_LENGTH:
+	case TRANSPORT_PACKET_LENGTH_M2TS:
+	case TRANSPORT_PACKET_LENGTH_FEC:
+		break;
+
+	default:
+		return -EINVAL;
+	}
+
+	memset(sync, 0, sizeof(struct transport_sync));
+	sync->requested_size = packet_size;
+	sync->packet_size = packet_size ? packet_size : TRANSPORT_PACKET_LENGTH;
+	sync->sync_offset = sync_offset(sync->packet_size);
+
+	return 0;
+}
+
+int transport_sync_find(const uint8_t *buf, int len, int stride, int count)
+{
+	int end;
+
+	if ((stride <= 0) || (count <= 0))
+		return -1;
+
+	end = len - (count - 1) * stride;
+	if (end <= 0)
+		return -1;
+
+	return sync_scan(buf, 0, end, stride, count);
+}
+
+/*
+ * Search for lock, returning the offset of the first packet (not the first
+ * sync byte), or -1 if none was found.
+ */
+static int sync_lock(struct transport_sync *sync, uint8_t *buf, int len)
+{
+	int best = -1;
+	int best_size = 0;
+	int pos;
+	int off;
+	unsigned int i;
+
+	for(i=0; i < sizeof(sync_sizes) / sizeof(sync_sizes[0]); i++) {
+		if (sync->requested_size && (sync->requested_size != sync_sizes[i]))
+			continue;
+
+		/* the sync byte of an M2TS packet follows its 4 byte header, so
+		 * skip over that in the search */
+		off = sync_offset(sync_sizes[i]);
+		pos = transport_sync_find(buf + off, len - off, sync_sizes[i],
+					  TRANSPORT_SYNC_LOCK_COUNT);
+		if ((pos >= 0) && ((best < 0) || (pos < best))) {
+			best = pos;
+			best_size = sync_sizes[i];
+		}
+	}
+
+	if (best < 0)
+		return -1;
+
+	sync->packet_size = best_size;
+	sync->sync_offset = sync_offset(best_size);
+	return best;
+}
+
+int transport_sync_process(struct transport_sync *sync, uint8_t *buf, int len,
+			   struct transport_sync_span *span)
+{
+	int consumed = 0;
+	int count;
+	int pos;
+	int keep;
+
+	span->packets = NULL;
+	span->count = 0;
+	span->stride = sync->packet_size;
+
+	while(1) {
+		if (!sync->locked) {
+			pos = sync_lock(sync, buf + consumed, len - consumed);
+			if (pos < 0) {
+				/* discard everything apart from the tail, which
+				 * might contain the start of a lock */
+				keep = TRANSPORT_SYNC_MIN_BUFFER;
+				if ((len - consumed) > keep) {
+					sync->skipped_bytes += len - consumed - keep;
+					consumed = len - keep;
+				}
+				return consumed;
+			}
+
+			sync->skipped_bytes += pos;
+			consumed += pos;
+			sync->locked = 1;
+			span->stride = sync->packet_size;
+		}
+
+		/* count the run of packets with valid sync bytes */
+		count = 0;
+		while((consumed + (count+1) * sync->packet_size) <= len) {
+			if (buf[consumed + count * sync->packet_size + sync->sync_offset] !=
+			    TRANSPORT_PACKET_SYNC)
+				break;
+			count++;
+		}
+
+		if (count) {
+			span->packets = buf + consumed + sync->sync_offset;
+			span->count = count;
+			return consumed + count * sync->packet_size;
+		}
+
+		/* need more data to see the next packet? */
+		if ((consumed + sync->packet_size) > len)
+			return consumed;
+
+		/* lost lock - search again from the next byte */
+		sync->locked = 0;
+		sync->sync_losses++;
+		sync->skipped_bytes++;
+		consumed++;
+	}
+}
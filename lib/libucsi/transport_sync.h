@@ -0,0 +1,111 @@
+/*
+ * section and descriptor parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_TRANSPORT_SYNC_H
+#define _UCSI_TRANSPORT_SYNC_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libucsi/transport_packet.h>
+
+#define TRANSPORT_PACKET_LENGTH_M2TS 192
+#define TRANSPORT_PACKET_LENGTH_FEC  204
+
+/**
+ * Number of consecutive sync bytes which must be seen before we consider
+ * ourselves locked to the stream.
+ */
+#define TRANSPORT_SYNC_LOCK_COUNT 5
+
+/**
+ * Minimum amount of data which should be passed to transport_sync_process()
+ * to guarantee a lock can be found.
+ */
+#define TRANSPORT_SYNC_MIN_BUFFER (TRANSPORT_SYNC_LOCK_COUNT * TRANSPORT_PACKET_LENGTH_FEC)
+
+/**
+ * State for synchronising to a raw transport stream.
+ */
+struct transport_sync {
+	int requested_size;	/* packet size asked for, or 0 to autodetect */
+	int packet_size;	/* size of each packet (188, 192 or 204) */
+	int sync_offset;	/* offset of the sync byte within a packet (4 for M2TS) */
+	int locked;
+
+	uint64_t sync_losses;	/* number of times lock was lost */
+	uint64_t skipped_bytes;	/* bytes discarded while searching for lock */
+};
+
+/**
+ * A run of consecutive aligned transport packets.
+ */
+struct transport_sync_span {
+	uint8_t *packets;	/* first TS packet (i.e. its sync byte) */
+	int count;		/* number of packets */
+	int stride;		/* distance between packets */
+};
+
+/**
+ * Initialise a transport_sync structure.
+ *
+ * @param sync The structure to initialise.
+ * @param packet_size TRANSPORT_PACKET_LENGTH, TRANSPORT_PACKET_LENGTH_M2TS,
+ * TRANSPORT_PACKET_LENGTH_FEC, or 0 to autodetect.
+ * @return 0 on success, nonzero on error.
+ */
+extern int transport_sync_init(struct transport_sync *sync, int packet_size);
+
+/**
+ * Find the first position in a buffer which is followed by count sync bytes
+ * spaced stride bytes apart. This uses SSE2 or AVX2 if the CPU supports it.
+ *
+ * @param buf Buffer to search.
+ * @param len Length of buffer.
+ * @param stride Distance between sync bytes.
+ * @param count Number of sync bytes required.
+ * @return Offset of the first sync byte, or -1 if none was found.
+ */
+extern int transport_sync_find(const uint8_t *buf, int len, int stride, int count);
+
+/**
+ * Process a buffer of raw data, returning the next span of aligned packets.
+ * The caller should call this repeatedly, advancing through the buffer by the
+ * returned number of bytes each time. A return value of 0 means more data is
+ * needed; any unconsumed data should then be kept and prepended to the next
+ * buffer. Buffers of at least TRANSPORT_SYNC_MIN_BUFFER bytes should be
+ * supplied for lock to be acquired.
+ *
+ * @param sync The transport_sync structure.
+ * @param buf Buffer of raw data.
+ * @param len Length of buffer.
+ * @param span Will be filled out with the span of packets found. span->count will
+ * be 0 if bytes were only skipped.
+ * @return Number of bytes consumed.
+ */
+extern int transport_sync_process(struct transport_sync *sync, uint8_t *buf, int len,
+				  struct transport_sync_span *span);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -37,6 +37,7 @@
 #include <libesg/transport/session_partition_declaration.h>
 
 #define MAX_FILENAME 256
+#define MAX_FRAGMENT_SIZE (1024 * 1024)
 
 void usage(void) {
   static const char *_usage =
@@ -48,6 +49,13 @@ void usage(void) {
   exit(1);
 }
 
+int write_fragment(void *arg, uint8_t *data, uint32_t length) {
+	(void) arg;
+
+	fwrite(data, 1, length, stdout);
+	return 0;
+}
+
 void read_from_file(const char *filename, char **buffer, int *size) {
 	int fd;
 	struct stat fs;
@@ -198,6 +206,7 @@ int main(int argc, char *argv[]) {
 		struct esg_textual_decoder_init *textual_decoder_init = NULL;
 		struct esg_namespace_prefix *namespace_prefix = NULL;
 		struct esg_xml_fragment_type *xml_fragment_type = NULL;
+		struct esg_gzip *gzip = NULL;
 		struct esg_bim_encoding_parameters *bim_encoding_parameters = NULL;
 //		struct esg_bim_decoder_init *bim_decoder_init = NULL;
 		struct esg_session_partition_declaration *partition = NULL;
@@ -488,16 +497,28 @@ int main(int argc, char *argv[]) {
 				switch (entry->fragment_reference->fragment_type) {
 					case 0x00: {
 						if (data_repository) {
-							struct esg_encapsulated_textual_esg_xml_fragment *esg_xml_fragment = esg_encapsulated_textual_esg_xml_fragment_decode(data_repository->data + entry->fragment_reference->data_repository_offset, data_repository->length);
+							uint8_t *fragment = data_repository->data + entry->fragment_reference->data_repository_offset;
+							uint32_t fragment_size = data_repository->length - entry->fragment_reference->data_repository_offset;
+							struct esg_encapsulated_textual_esg_xml_fragment *esg_xml_fragment = esg_encapsulated_textual_esg_xml_fragment_decode(fragment, fragment_size);
 
 							fprintf(stdout, "ESG_XML_fragment_type %d\n", esg_xml_fragment->esg_xml_fragment_type);
 							fprintf(stdout, "data_length %d\n", esg_xml_fragment->data_length);
 							fprintf(stdout, "fragment_version %d\n", entry->fragment_version);
 							fprintf(stdout, "fragment_id %d\n\n", entry->fragment_id);
-							char *string = (char *) malloc(esg_xml_fragment->data_length + 1);
-							memcpy(string, esg_xml_fragment->data, esg_xml_fragment->data_length);
-							string[esg_xml_fragment->data_length] = 0;
-							fprintf(stdout, "%s\n", string);
+							esg_encapsulated_textual_esg_xml_fragment_free(esg_xml_fragment);
+
+							// decompresses GZIP encoded fragments on the way
+							if (gzip == NULL) {
+								gzip = esg_gzip_create(MAX_FRAGMENT_SIZE);
+								if (gzip == NULL) {
+									fprintf(stderr, "ESG GZIP decompressor allocation error\n");
+									exit(1);
+								}
+							}
+							if (esg_encapsulated_textual_esg_xml_fragment_inflate(fragment, fragment_size, gzip, write_fragment, NULL, NULL) < 0) {
+								fprintf(stderr, "ESG XML Fragment decode error\n");
+							}
+							fprintf(stdout, "\n");
 
 						} else {
 							fprintf(stderr, "ESG Data Repository not found");
@@ -557,6 +578,8 @@ int main(int argc, char *argv[]) {
 				}
 			}
 		}
+
+		esg_gzip_destroy(gzip);
 	}
 
 	return 0;
@@ -25,6 +25,7 @@
 #include <libucsi/atsc/descriptor.h>
 #include <libucsi/atsc/section.h>
 #include <libucsi/transport_packet.h>
+#include <libucsi/transport_demux.h>
 #include <libucsi/section_buf.h>
 #include <libucsi/dvb/types.h>
 #include <libdvbapi/dvbdemux.h>
@@ -39,6 +40,8 @@
 #include <fcntl.h>
 
 void receive_data(int dvrfd, int timeout, int data_type);
+void receive_section(void *arg, int pid, uint8_t *section, int len);
+void receive_error(void *arg, int pid, enum transport_demux_error error);
 void parse_section(uint8_t *buf, int len, int pid, int data_type);
 void parse_dvb_section(uint8_t *buf, int len, int pid, int data_type, struct section *section);
 void parse_atsc_section(uint8_t *buf, int len, int pid, int data_type, struct section *section);
@@ -195,22 +198,29 @@ void receive_data(int _dvrfd, int timeout, int data_type)
 	unsigned char databuf[TRANSPORT_PACKET_LENGTH*20];
 	int sz;
 	int pid;
-	int i;
 	int used;
-	int section_status;
+	int remaining = 0;
 	time_t starttime;
-	unsigned char continuities[TRANSPORT_MAX_PIDS];
-	struct section_buf *section_bufs[TRANSPORT_MAX_PIDS];
-	struct transport_packet *tspkt;
-	struct transport_values tsvals;
+	struct transport_demux *demux;
+
+	// setup the demuxer to reassemble sections on every PID
+	if ((demux = transport_demux_create(receive_error, NULL)) == NULL) {
+		fprintf(stderr, "Failed to create demuxer\n");
+		exit(1);
+	}
+	for(pid=0; pid < TRANSPORT_MAX_PIDS; pid++) {
+		if (transport_demux_set_section_pid(demux, pid, DVB_MAX_SECTION_BYTES,
+						    receive_section, (void*) (long) data_type)) {
+			fprintf(stderr, "Failed to setup demuxer (pid:%04x)\n", pid);
+			exit(1);
+		}
+	}
 
 	// process the data
 	starttime = time(NULL);
-	memset(continuities, 0, sizeof(continuities));
-	memset(section_bufs, 0, sizeof(section_bufs));
 	while((time(NULL) - starttime) < timeout) {
 		// got some!
-		if ((sz = read(_dvrfd, databuf, sizeof(databuf))) < 0) {
+		if ((sz = read(_dvrfd, databuf + remaining, sizeof(databuf) - remaining)) < 0) {
 			if (errno == EOVERFLOW) {
 				fprintf(stderr, "data overflow!\n");
 				continue;
@@ -222,67 +232,41 @@ void receive_data(int _dvrfd, int timeout, int data_type)
 				exit(1);
 			}
 		}
-		for(i=0; i < sz; i+=TRANSPORT_PACKET_LENGTH) {
-			// parse the transport packet
-			tspkt = transport_packet_init(databuf + i);
-			if (tspkt == NULL) {
-				fprintf(stderr, "XXXX Bad sync byte\n");
-				continue;
-			}
-			pid = transport_packet_pid(tspkt);
+		sz += remaining;
 
-			// extract all TS packet values even though we don't need them (to check for
-			// library segfaults etc)
-			if (transport_packet_values_extract(tspkt, &tsvals, 0xffff) < 0) {
-				fprintf(stderr, "XXXX Bad packet received (pid:%04x)\n", pid);
-				continue;
-			}
+		// keep any partial packet for next time
+		used = transport_demux_feed(demux, databuf, sz);
+		remaining = sz - used;
+		memmove(databuf, databuf + used, remaining);
+	}
 
-			// check continuity
-			if (transport_packet_continuity_check(tspkt,
-			    tsvals.flags & transport_adaptation_flag_discontinuity,
-			    continuities + pid)) {
-				fprintf(stderr, "XXXX Continuity error (pid:%04x)\n", pid);
-				continuities[pid] = 0;
-				if (section_bufs[pid] != NULL) {
-					section_buf_reset(section_bufs[pid]);
-				}
-				continue;
-			}
+	transport_demux_destroy(demux);
+}
 
-			// allocate section buf if we don't have one already
-			if (section_bufs[pid] == NULL) {
-				section_bufs[pid] = (struct section_buf*)
-					malloc(sizeof(struct section_buf) + DVB_MAX_SECTION_BYTES);
-				if (section_bufs[pid] == NULL) {
-					fprintf(stderr, "Failed to allocate section buf (pid:%04x)\n", pid);
-					exit(1);
-				}
-				section_buf_init(section_bufs[pid], DVB_MAX_SECTION_BYTES);
-			}
+void receive_section(void *arg, int pid, uint8_t *section, int len)
+{
+	parse_section(section, len, pid, (int) (long) arg);
+}
 
-			// process the payload data as a section
-			while(tsvals.payload_length) {
-				used = section_buf_add_transport_payload(section_bufs[pid],
-									 tsvals.payload,
-									 tsvals.payload_length,
-									 tspkt->payload_unit_start_indicator,
-									 &section_status);
-				tspkt->payload_unit_start_indicator = 0;
-				tsvals.payload_length -= used;
-				tsvals.payload += used;
-
-				if (section_status == 1) {
-					parse_section(section_buf_data(section_bufs[pid]),
-						      section_bufs[pid]->len, pid, data_type);
-					section_buf_reset(section_bufs[pid]);
-				} else if (section_status < 0) {
-					// some kind of error - just discard
-					fprintf(stderr, "XXXX bad section %04x %i\n",pid, section_status);
-					section_buf_reset(section_bufs[pid]);
-				}
-			}
-		}
+void receive_error(void *arg, int pid, enum transport_demux_error error)
+{
+	(void) arg;
+
+	switch(error) {
+	case transport_demux_error_sync:
+		fprintf(stderr, "XXXX Bad sync byte\n");
+		break;
+	case transport_demux_error_packet:
+		fprintf(stderr, "XXXX Bad packet received (pid:%04x)\n", pid);
+		break;
+	case transport_demux_error_continuity:
+		fprintf(stderr, "XXXX Continuity error (pid:%04x)\n", pid);
+		break;
+	case transport_demux_error_section:
+		fprintf(stderr, "XXXX bad section %04x\n", pid);
+		break;
+	case transport_demux_error_pes:
+		break;
 	}
 }
 
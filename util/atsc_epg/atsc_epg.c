@@ -29,6 +29,7 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/poll.h>
+#include <sys/epoll.h>
 #include <errno.h>
 #include <getopt.h>
 #include <stdarg.h>
@@ -45,9 +46,13 @@
 #define MESSAGE_BUFFER_LEN		(16 * 1024)
 #define MAX_NUM_CHANNELS		16
 #define MAX_NUM_EVENTS_PER_CHANNEL	(4 * 24 * 7)
+#define MAX_NUM_TABLE_FILTERS		(2 * MAX_NUM_EVENT_TABLES)
+#define SECTION_BUFFER_LEN		4096
 
 static int atsc_scan_table(int dmxfd, uint16_t pid, enum atsc_section_tag tag,
 	void **table_section);
+static int atsc_decode_table(unsigned char *sibuf, int size,
+	enum atsc_section_tag tag, void **table_section);
 
 static const char *program;
 static int adapter = 0;
@@ -83,9 +88,32 @@ struct atsc_eit_section_info {
 	struct atsc_event_info **events;
 };
 
+struct atsc_pending_ett {
+	struct atsc_pending_ett *next;
+	uint16_t event_id;
+	unsigned char *buf;	/* decoded copy of the ETT section */
+};
+
 struct atsc_eit_info {
 	int num_eit_sections;
 	struct atsc_eit_section_info *section;
+
+	/* decoded copies of the EIT sections while they are collected */
+	int num_raw_sections;	/* 0 until the first section arrives */
+	uint32_t raw_section_pattern;
+	unsigned char *raw_section[32];
+	/* ETTs which arrived before this EIT was complete */
+	struct atsc_pending_ett *pending_etts;
+};
+
+/* one demux filter per announced EIT/ETT PID; those the demux has no room for
+ * wait until the tables of running ones are complete */
+struct atsc_table_filter {
+	int fd;		/* -1 while waiting and once stopped */
+	int done;
+	uint16_t pid;
+	int index;
+	enum atsc_section_tag tag;
 };
 
 struct atsc_channel_info {
@@ -112,6 +140,12 @@ struct atsc_virtual_channels_info {
 	struct atsc_channel_info ch[MAX_NUM_CHANNELS];
 } guide;
 
+static struct atsc_table_filter table_filters[MAX_NUM_TABLE_FILTERS];
+static int num_table_filters;
+static int num_eits_processed;
+static int num_etms_expected;
+static int num_etms_received;
+
 struct mgt_table_name {
 	uint16_t range;
 	const char *string;
@@ -522,86 +556,97 @@ static int parse_message(struct atsc_channel_info *channel,
 	return 0;
 }
 
-static int parse_ett(int dmxfd, int index, uint16_t pid)
+/* returns 1 if the ETT filled in an event's message, 0 if not and -1 on error */
+static int apply_ett(struct atsc_channel_info *channel, int index,
+	struct atsc_ett_section *ett)
 {
 	uint8_t curr_index;
-	uint32_t section_pattern;
-	const enum atsc_section_tag tag = stag_atsc_extended_text;
-	struct atsc_eit_info *eit;
-	struct atsc_ett_section *ett;
-	struct atsc_channel_info *channel;
 	struct atsc_event_info *event;
 	struct atsc_eit_section_info *section;
-	uint16_t source_id, event_id;
-	int c, ret;
 
-	if(0xFFFF == guide.ett_pid[index]) {
+	event = NULL;
+	if(match_event(&channel->eit[index], ett->ETM_sub_id, &event,
+		&curr_index)) {
+		fprintf(stderr, "%s(): error calling match_event()\n",
+			__FUNCTION__);
+		return -1;
+	}
+	if(NULL == event || event->msg_len) {
+		/* unknown event, or the message has been filled */
 		return 0;
 	}
 
-	for(c = 0; c < guide.num_channels; c++) {
-		channel = &guide.ch[c];
-		eit = &channel->eit[index];
+	if(parse_message(channel, ett, event)) {
+		fprintf(stderr, "%s(): error calling parse_message()\n",
+			__FUNCTION__);
+		return -1;
+	}
+	section = &channel->eit[index].section[curr_index];
+	section->num_received_etms++;
+	num_etms_received++;
 
-		section_pattern = 0;
-		while(section_pattern !=
-			(uint32_t)((1 << eit->num_eit_sections) - 1)) {
-			if(ctrl_c) {
-				return 0;
-			}
-			ret = atsc_scan_table(dmxfd, pid, tag, (void **)&ett);
-			fprintf(stdout, ".");
-			fflush(stdout);
-			if(0 > ret) {
-				fprintf(stderr, "%s(): error calling "
-					"atsc_scan_table()\n", __FUNCTION__);
-				return -1;
-			}
-			if(0 == ret) {
-				fprintf(stdout, "no ETT %d in %d seconds\n",
-					index, TIMEOUT);
-				return 0;
-			}
+	return 1;
+}
 
-			source_id = ett->ETM_source_id;
-			event_id = ett->ETM_sub_id;
-			if(source_id != channel->src_id) {
-				continue;
-			}
+static int find_channel(uint16_t source_id)
+{
+	int k;
 
-			event = NULL;
-			if(match_event(eit, event_id, &event, &curr_index)) {
-				fprintf(stderr, "%s(): error calling "
-					"match_event()\n", __FUNCTION__);
-				return -1;
-			}
-			if(NULL == event) {
-				continue;
-			}
-			if(section_pattern & (1 << curr_index)) {
-				/* the section has been filled, so skip,
-				 * not consider version yet
-				 */
-				continue;
-			}
-			if(event->msg_len) {
-				/* the message has been filled */
-				continue;
-			}
+	for(k = 0; k < guide.num_channels; k++) {
+		if(source_id == guide.ch[k].src_id) {
+			return k;
+		}
+	}
+	return -1;
+}
 
-			if(parse_message(channel, ett, event)) {
-				fprintf(stderr, "%s(): error calling "
-					"parse_message()\n", __FUNCTION__);
-				return -1;
-			}
-			section = &eit->section[curr_index];
-			if(++section->num_received_etms == section->num_etms) {
-				section_pattern |= 1 << curr_index;
-			}
+/* returns 1 if the ETT was new, 0 if not and -1 on error */
+static int receive_ett(int index, unsigned char *sibuf, int size)
+{
+	struct atsc_ett_section *ett;
+	struct atsc_channel_info *channel;
+	struct atsc_eit_info *eit;
+	struct atsc_pending_ett *pending;
+	int c;
+
+	if(atsc_decode_table(sibuf, size, stag_atsc_extended_text,
+		(void **)&ett)) {
+		return 0;
+	}
+
+	if(0 > (c = find_channel(ett->ETM_source_id))) {
+		return 0;
+	}
+	channel = &guide.ch[c];
+	if(index >= channel->num_eits) {
+		return 0;
+	}
+	eit = &channel->eit[index];
+
+	/* the events are known once the EIT has been processed */
+	if(index < num_eits_processed) {
+		return apply_ett(channel, index, ett);
+	}
+
+	for(pending = eit->pending_etts; pending; pending = pending->next) {
+		if(pending->event_id == ett->ETM_sub_id) {
+			return 0;
 		}
 	}
+	if(NULL == (pending = calloc(1, sizeof(struct atsc_pending_ett))) ||
+		NULL == (pending->buf = malloc(size))) {
+		fprintf(stderr, "%s(): error calling malloc()\n", __FUNCTION__);
+		free(pending);
+		return -1;
+	}
+	/* the decoded section only refers to its own buffer, so a copy of
+	 * it remains valid */
+	memcpy(pending->buf, sibuf, size);
+	pending->event_id = ett->ETM_sub_id;
+	pending->next = eit->pending_etts;
+	eit->pending_etts = pending;
 
-	return 0;
+	return 1;
 }
 
 static int parse_events(struct atsc_channel_info *curr_info,
@@ -669,133 +714,111 @@ static int parse_events(struct atsc_channel_info *curr_info,
 	return 0;
 }
 
-static int parse_eit(int dmxfd, int index, uint16_t pid)
+/* returns 1 if the EIT section was new, 0 if not and -1 on error */
+static int receive_eit(int index, unsigned char *sibuf, int size)
 {
-	int num_sections;
-	uint8_t section_num;
-	uint8_t curr_channel_index;
-	uint32_t section_pattern;
-	const enum atsc_section_tag tag = stag_atsc_event_information;
 	struct atsc_eit_section *eit;
+	struct atsc_eit_info *eit_info;
+	uint8_t section_num;
+	int c;
+
+	if(atsc_decode_table(sibuf, size, stag_atsc_event_information,
+		(void **)&eit)) {
+		return 0;
+	}
+
+	if(0 > (c = find_channel(atsc_eit_section_source_id(eit)))) {
+		return 0;
+	}
+	if(index >= guide.ch[c].num_eits || index < num_eits_processed) {
+		return 0;
+	}
+	eit_info = &guide.ch[c].eit[index];
+
+	if(0 == eit_info->num_raw_sections) {
+		eit_info->num_raw_sections =
+			1 + eit->head.ext_head.last_section_number;
+		if(32 < eit_info->num_raw_sections) {
+			fprintf(stderr, "%s(): no support yet for tables "
+				"having more than 32 sections\n", __FUNCTION__);
+			return -1;
+		}
+	} else if(eit_info->num_raw_sections !=
+		1 + eit->head.ext_head.last_section_number) {
+		/* the table changed under us; keep the first version */
+		return 0;
+	}
+
+	section_num = eit->head.ext_head.section_number;
+	if(section_num >= eit_info->num_raw_sections ||
+		eit_info->raw_section_pattern & (1 << section_num)) {
+		return 0;
+	}
+
+	if(NULL == (eit_info->raw_section[section_num] = malloc(size))) {
+		fprintf(stderr, "%s(): error calling malloc()\n", __FUNCTION__);
+		return -1;
+	}
+	memcpy(eit_info->raw_section[section_num], sibuf, size);
+	eit_info->raw_section_pattern |= 1 << section_num;
+
+	return 1;
+}
+
+static int eit_complete(int index)
+{
+	int c;
+
+	for(c = 0; c < guide.num_channels; c++) {
+		struct atsc_eit_info *eit_info = &guide.ch[c].eit[index];
+
+		if(0 == eit_info->num_raw_sections || eit_info->raw_section_pattern
+			!= (uint32_t)((1ULL << eit_info->num_raw_sections) - 1)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Turn the collected sections of EIT-index into events, in temporal order.
+ * The EITs must be processed in index order so that events spanning two
+ * tables are only reported once.
+ */
+static int process_eit(int index)
+{
 	struct atsc_channel_info *curr_info;
 	struct atsc_eit_info *eit_info;
 	struct atsc_eit_section_info *section;
-	uint16_t source_id;
-	uint32_t eit_instance_pattern = 0;
-	int i, k, ret;
-
-	while(eit_instance_pattern !=
-		(uint32_t)((1 << guide.num_channels) - 1)) {
-		source_id = 0xFFFF;
-		section_pattern = 0;
-		num_sections = -1;
+	struct atsc_eit_section *eit;
+	struct atsc_pending_ett *pending;
+	int c, i, n;
 
-		do {
-			ret = atsc_scan_table(dmxfd, pid, tag, (void **)&eit);
-			fprintf(stdout, ".");
-			fflush(stdout);
-			if(0 > ret) {
-				fprintf(stderr, "%s(): error calling "
-					"atsc_scan_table()\n", __FUNCTION__);
-				return -1;
-			}
-			if(0 == ret) {
-				fprintf(stdout, "no EIT %d in %d seconds\n",
-					index, TIMEOUT);
-				return 0;
-			}
+	for(c = 0; c < guide.num_channels; c++) {
+		curr_info = &guide.ch[c];
+		eit_info = &curr_info->eit[index];
+		if(0 == index) {
+			curr_info->last_event = NULL;
+		}
+		if(0 == eit_info->raw_section_pattern) {
+			continue;
+		}
 
-			if(0xFFFF == source_id) {
-			source_id = atsc_eit_section_source_id(eit);
-			for(k = 0; k < guide.num_channels; k++) {
-				if(source_id == guide.ch[k].src_id) {
-					curr_info = &guide.ch[k];
-					curr_channel_index = k;
-					if(0 == index) {
-						curr_info->last_event = NULL;
-					}
-					break;
-				}
-			}
-			if(k == guide.num_channels) {
-				fprintf(stderr, "%s(): cannot find source_id "
-					"0x%04X in the EIT\n",
-					__FUNCTION__, source_id);
-				return -1;
-			}
-			} else {
-				if(source_id !=
-					atsc_eit_section_source_id(eit)) {
-					continue;
-				}
-			}
-			if(eit_instance_pattern & (1 << curr_channel_index)) {
-				/* we have received this instance,
-				 * so quit quick
-				 */
-				break;
-			}
+		if(NULL == (eit_info->section = calloc(eit_info->num_raw_sections,
+			sizeof(struct atsc_eit_section_info)))) {
+			fprintf(stderr, "%s(): error calling calloc()\n",
+				__FUNCTION__);
+			return -1;
+		}
 
-			if(-1 == num_sections) {
-				num_sections = 1 +
-					eit->head.ext_head.last_section_number;
-				if(32 < num_sections) {
-					fprintf(stderr,
-						"%s(): no support yet for "
-						"tables having more than "
-						"32 sections\n", __FUNCTION__);
-					return -1;
-				}
-			} else {
-				if(num_sections != 1 +
-					eit->head.ext_head.last_section_number) {
-					fprintf(stderr,
-						"%s(): last section number "
-						"does not match\n",
-						__FUNCTION__);
-					return -1;
-				}
-			}
-			if(section_pattern &
-				(1 << eit->head.ext_head.section_number)) {
+		n = 0;
+		for(i = 0; i < eit_info->num_raw_sections; i++) {
+			if(NULL == eit_info->raw_section[i]) {
 				continue;
 			}
-			section_pattern |= 1 << eit->head.ext_head.section_number;
+			eit = (struct atsc_eit_section *)eit_info->raw_section[i];
 
-			eit_info = &curr_info->eit[index];
-			if(NULL == (eit_info->section =
-				realloc(eit_info->section,
-				(eit_info->num_eit_sections + 1) *
-				sizeof(struct atsc_eit_section_info)))) {
-				fprintf(stderr,
-					"%s(): error calling realloc()\n",
-					__FUNCTION__);
-				return -1;
-			}
-			section_num = eit->head.ext_head.section_number;
-			if(0 == eit_info->num_eit_sections) {
-				eit_info->num_eit_sections = 1;
-				section = eit_info->section;
-			} else {
-				/* have to sort it into section order
-				 * (temporal order)
-				 */
-				for(i = 0; i < eit_info->num_eit_sections; i++) {
-					if(eit_info->section[i].section_num >
-						section_num) {
-						break;
-					}
-				}
-				memmove(&eit_info->section[i + 1],
-					&eit_info->section[i],
-					(eit_info->num_eit_sections - i) *
-					sizeof(struct atsc_eit_section_info));
-				section = &eit_info->section[i - 1];
-				section = &eit_info->section[i];
-				eit_info->num_eit_sections += 1;
-			}
-
-			section->section_num = section_num;
+			section = &eit_info->section[n++];
+			section->section_num = i;
 			section->num_events = eit->num_events_in_section;
 			section->num_etms = 0;
 			section->num_received_etms = 0;
@@ -805,17 +828,20 @@ static int parse_eit(int dmxfd, int index, uint16_t pid)
 					__FUNCTION__);
 				return -1;
 			}
+			eit_info->num_eit_sections = n;
 			if(parse_events(curr_info, eit, section)) {
 				fprintf(stderr, "%s(): error calling "
 					"parse_events()\n", __FUNCTION__);
 				return -1;
 			}
-		} while(section_pattern != (uint32_t)((1 << num_sections) - 1));
-		eit_instance_pattern |= 1 << curr_channel_index;
+			if(enable_ett && 0xFFFF != guide.ett_pid[index]) {
+				num_etms_expected += section->num_etms;
+			}
+		}
 	}
 
-	for(i = 0; i < guide.num_channels; i++) {
-		struct atsc_channel_info *channel = &guide.ch[i];
+	for(c = 0; c < guide.num_channels; c++) {
+		struct atsc_channel_info *channel = &guide.ch[c];
 		struct atsc_eit_info *ei = &channel->eit[index];
 		struct atsc_eit_section_info *s;
 
@@ -831,10 +857,281 @@ static int parse_eit(int dmxfd, int index, uint16_t pid)
 		}
 		channel->last_event = s->events[s->num_events - 1];
 	}
+	num_eits_processed = index + 1;
+
+	/* now the events are known, attach any ETTs which came early */
+	for(c = 0; c < guide.num_channels; c++) {
+		curr_info = &guide.ch[c];
+		eit_info = &curr_info->eit[index];
+
+		while((pending = eit_info->pending_etts)) {
+			eit_info->pending_etts = pending->next;
+			n = apply_ett(curr_info, index,
+				(struct atsc_ett_section *)pending->buf);
+			free(pending->buf);
+			free(pending);
+			if(0 > n) {
+				return -1;
+			}
+		}
+	}
 
 	return 0;
 }
 
+static int ett_complete(int index)
+{
+	int c, k;
+
+	for(c = 0; c < guide.num_channels; c++) {
+		struct atsc_eit_info *eit_info = &guide.ch[c].eit[index];
+
+		for(k = 0; k < eit_info->num_eit_sections; k++) {
+			struct atsc_eit_section_info *section =
+				&eit_info->section[k];
+
+			if(section->num_received_etms < section->num_etms) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static void add_table_filter(uint16_t pid, int index,
+	enum atsc_section_tag tag)
+{
+	struct atsc_table_filter *f = &table_filters[num_table_filters++];
+
+	f->fd = -1;
+	f->done = 0;
+	f->pid = pid;
+	f->index = index;
+	f->tag = tag;
+}
+
+/* returns -1 if the demux has no room for another filter */
+static int start_table_filter(int epfd, struct atsc_table_filter *f)
+{
+	struct epoll_event ev;
+	uint8_t filter[18];
+	uint8_t mask[18];
+	int fd;
+
+	if((fd = dvbdemux_open_demux(adapter, 0, 1)) < 0) {
+		return -1;
+	}
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	filter[0] = f->tag;
+	mask[0] = 0xFF;
+	if(dvbdemux_set_section_filter(fd, f->pid, filter, mask, 1, 1)) {
+		close(fd);
+		return -1;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLPRI;
+	ev.data.ptr = f;
+	if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)) {
+		dvbdemux_stop(fd);
+		close(fd);
+		return -1;
+	}
+	f->fd = fd;
+
+	return 0;
+}
+
+static void stop_table_filter(int epfd, struct atsc_table_filter *f)
+{
+	epoll_ctl(epfd, EPOLL_CTL_DEL, f->fd, NULL);
+	dvbdemux_stop(f->fd);
+	close(f->fd);
+	f->fd = -1;
+	f->done = 1;
+}
+
+/* Start waiting filters in order until the demux is full, and return how
+ * many are still left waiting.
+ */
+static int start_table_filters(int epfd)
+{
+	int i, waiting = 0;
+
+	for(i = 0; i < num_table_filters; i++) {
+		struct atsc_table_filter *f = &table_filters[i];
+
+		if(f->done || 0 <= f->fd) {
+			continue;
+		}
+		if(waiting || start_table_filter(epfd, f)) {
+			waiting++;
+		}
+	}
+	return waiting;
+}
+
+/* stop the filters whose tables are complete to make room for waiting ones */
+static void stop_finished_filters(int epfd)
+{
+	int i;
+
+	for(i = 0; i < num_table_filters; i++) {
+		struct atsc_table_filter *f = &table_filters[i];
+
+		if(0 > f->fd) {
+			continue;
+		}
+		if(stag_atsc_event_information == f->tag) {
+			if(f->index < num_eits_processed ||
+				eit_complete(f->index)) {
+				stop_table_filter(epfd, f);
+			}
+		} else if(f->index < num_eits_processed &&
+			ett_complete(f->index)) {
+			stop_table_filter(epfd, f);
+		}
+	}
+}
+
+static void close_table_filters(int epfd)
+{
+	int i;
+
+	for(i = 0; i < num_table_filters; i++) {
+		if(0 <= table_filters[i].fd) {
+			stop_table_filter(epfd, &table_filters[i]);
+		}
+	}
+	num_table_filters = 0;
+}
+
+/* Collect all EITs, and their ETTs if enabled, in one go: a filter is opened
+ * on every PID announced in the MGT, as many at once as the demux allows, and
+ * sections are stored as they arrive. EIT-n is turned into events as soon as
+ * it and all earlier EITs are complete, and ETTs are attached as soon as
+ * their events are known. Filters whose tables are complete are closed so
+ * that the waiting ones, EITs first, can be started.
+ */
+static int collect_guide(void)
+{
+	struct epoll_event events[32];
+	unsigned char sibuf[SECTION_BUFFER_LEN];
+	struct atsc_table_filter *f;
+	time_t last_progress;
+	int num_eits = guide.num_channels ? guide.ch[0].num_eits : 0;
+	int epfd;
+	int i, n, size, received, waiting, ret = -1;
+
+	if(0 == num_eits) {
+		return 0;
+	}
+
+	if(0 > (epfd = epoll_create(MAX_NUM_TABLE_FILTERS))) {
+		fprintf(stderr, "%s(): error calling epoll_create()\n",
+			__FUNCTION__);
+		return -1;
+	}
+
+	for(i = 0; i < num_eits; i++) {
+		add_table_filter(guide.eit_pid[i], i,
+			stag_atsc_event_information);
+	}
+	for(i = 0; enable_ett && i < num_eits; i++) {
+		if(0xFFFF != guide.ett_pid[i]) {
+			add_table_filter(guide.ett_pid[i], i,
+				stag_atsc_extended_text);
+		}
+	}
+	start_table_filters(epfd);
+	if(0 > table_filters[0].fd) {
+		fprintf(stderr, "%s(): error opening EIT filter\n",
+			__FUNCTION__);
+		goto exit;
+	}
+
+	time(&last_progress);
+	while(!ctrl_c) {
+		/* the EIT filters come first, so table_filters[n] is EIT-n's;
+		 * once that has stopped, use whatever has arrived of EIT-n */
+		while(num_eits_processed < num_eits &&
+			(eit_complete(num_eits_processed) ||
+			table_filters[num_eits_processed].done)) {
+			if(process_eit(num_eits_processed)) {
+				goto exit;
+			}
+		}
+		stop_finished_filters(epfd);
+		waiting = start_table_filters(epfd);
+		if(num_eits_processed == num_eits &&
+			num_etms_received >= num_etms_expected) {
+			break;
+		}
+		if(time(NULL) - last_progress > TIMEOUT) {
+			if(!waiting) {
+				fprintf(stdout, "\nno new EIT/ETT sections "
+					"in %d seconds", TIMEOUT);
+				break;
+			}
+			/* the running tables have stalled, give their
+			 * filters to the waiting ones */
+			for(i = 0; i < num_table_filters; i++) {
+				if(0 <= table_filters[i].fd) {
+					stop_table_filter(epfd,
+						&table_filters[i]);
+				}
+			}
+			start_table_filters(epfd);
+			time(&last_progress);
+		}
+
+		if(0 > (n = epoll_wait(epfd, events, 32, 1000))) {
+			if(EINTR == errno) {
+				continue;
+			}
+			fprintf(stderr, "%s(): error calling epoll_wait()\n",
+				__FUNCTION__);
+			goto exit;
+		}
+
+		for(i = 0; i < n; i++) {
+			f = events[i].data.ptr;
+			if(0 >= (size = read(f->fd, sibuf, sizeof(sibuf)))) {
+				continue;
+			}
+			fprintf(stdout, ".");
+			fflush(stdout);
+
+			if(stag_atsc_event_information == f->tag) {
+				received = receive_eit(f->index, sibuf, size);
+			} else {
+				received = receive_ett(f->index, sibuf, size);
+			}
+			if(0 > received) {
+				goto exit;
+			}
+			/* the carousel repeats sections, so only count new ones */
+			if(received) {
+				time(&last_progress);
+			}
+		}
+	}
+
+	/* use whatever has arrived of any tables which never completed */
+	while(num_eits_processed < num_eits) {
+		if(process_eit(num_eits_processed)) {
+			goto exit;
+		}
+	}
+	ret = 0;
+
+exit:
+	close_table_filters(epfd);
+	close(epfd);
+	return ret;
+}
+
 static int parse_mgt(int dmxfd)
 {
 	const enum atsc_section_tag tag = stag_atsc_master_guide;
@@ -903,7 +1200,16 @@ static int cleanup_guide(void)
 		}
 		for(j = 0; j < channel->num_eits; j++) {
 			struct atsc_eit_info *eit = &channel->eit[j];
+			struct atsc_pending_ett *pending;
 
+			for(k = 0; k < 32; k++) {
+				free(eit->raw_section[k]);
+			}
+			while((pending = eit->pending_etts)) {
+				eit->pending_etts = pending->next;
+				free(pending->buf);
+				free(pending);
+			}
 			for(k = 0; k < eit->num_eit_sections; k++) {
 				struct atsc_eit_section_info *section =
 					&eit->section[k];
@@ -1022,13 +1328,10 @@ static int atsc_scan_table(int dmxfd, uint16_t pid, enum atsc_section_tag tag,
 {
 	uint8_t filter[18];
 	uint8_t mask[18];
-	unsigned char sibuf[4096];
+	unsigned char sibuf[SECTION_BUFFER_LEN];
 	int size;
 	int ret;
 	struct pollfd pollfd;
-	struct section *section;
-	struct section_ext *section_ext;
-	struct atsc_section_psip *psip;
 
 	/* create a section filter for the table */
 	memset(filter, 0, sizeof(filter));
@@ -1062,6 +1365,20 @@ static int atsc_scan_table(int dmxfd, uint16_t pid, enum atsc_section_tag tag,
 		return -1;
 	}
 
+	if(atsc_decode_table(sibuf, size, tag, table_section)) {
+		return -1;
+	}
+
+	return 1;
+}
+
+static int atsc_decode_table(unsigned char *sibuf, int size,
+	enum atsc_section_tag tag, void **table_section)
+{
+	struct section *section;
+	struct section_ext *section_ext;
+	struct atsc_section_psip *psip;
+
 	/* parse section */
 	section = section_codec(sibuf, size);
 	if(NULL == section) {
@@ -1092,12 +1409,12 @@ static int atsc_scan_table(int dmxfd, uint16_t pid, enum atsc_section_tag tag,
 		return -1;
 	}
 
-	return 1;
+	return 0;
 }
 
 int main(int argc, char *argv[])
 {
-	int i, dmxfd;
+	int dmxfd;
 	struct dvbfe_handle *fe;
 
 	program = argv[0];
@@ -1194,33 +1511,14 @@ int main(int argc, char *argv[])
 	}
 #endif
 
-	fprintf(stdout, "receiving EIT ");
-	for(i = 0; i < guide.ch[0].num_eits; i++) {
-		if(parse_eit(dmxfd, i, guide.eit_pid[i])) {
-			fprintf(stderr, "%s(): error calling parse_eit()\n",
-				__FUNCTION__);
-			return -1;
-		}
-	}
-	fprintf(stdout, "\n");
-
 	old_handler = signal(SIGINT, int_handler);
-	if(enable_ett) {
-		fprintf(stdout, "receiving ETT ");
-		for(i = 0; i < guide.ch[0].num_eits; i++) {
-			if(0xFFFF != guide.ett_pid[i]) {
-				if(parse_ett(dmxfd, i, guide.ett_pid[i])) {
-					fprintf(stderr, "%s(): error calling "
-						"parse_eit()\n", __FUNCTION__);
-					return -1;
-				}
-			}
-			if(ctrl_c) {
-				break;
-			}
-		}
-		fprintf(stdout, "\n");
+	fprintf(stdout, enable_ett ? "receiving EIT and ETT " : "receiving EIT ");
+	if(collect_guide()) {
+		fprintf(stderr, "%s(): error calling collect_guide()\n",
+			__FUNCTION__);
+		return -1;
 	}
+	fprintf(stdout, "\n");
 	signal(SIGINT, old_handler);
 
 	if(print_guide()) {
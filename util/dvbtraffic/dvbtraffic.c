@@ -12,11 +12,69 @@
 #include <sys/time.h>
 #include <string.h>
 #include <limits.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <libdvbapi/dvbdemux.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/transport_sync.h>
 
-#define BSIZE 188
+#define DEFAULT_READ_SIZE (1024 * 1024)
+#define DVR_BUFFER_SIZE (8 * 1024 * 1024)
+#define RING_SLOTS 8
+#define MAX_PATTERNS 16
+#define PCR_HZ 27000000LL
 
-static int pidt[0x2001];
+/* the whole mux is counted in slot 0x2000 */
+#define ALL_PIDS 0x2000
+
+struct pid_stats {
+	int active;
+	unsigned int packets;
+	unsigned int cc_errors;
+	unsigned char continuity;
+
+	/* PCR tracking */
+	int has_pcr;
+	uint64_t last_pcr;
+	uint64_t last_pcr_pos;
+	double ticks_per_byte;
+	int64_t max_pcr_interval;
+	int64_t max_pcr_jitter;
+};
+
+/* buffers handed from the reader thread to the counting thread */
+struct ring_slot {
+	unsigned char *data;
+	int len;	/* 0 => end of stream */
+};
+
+static struct ring_slot ring[RING_SLOTS];
+static sem_t ring_filled;
+static sem_t ring_empty;
+static int read_size = DEFAULT_READ_SIZE;
+static int input_fd;
+
+static struct pid_stats pidt[ALL_PIDS + 1];
+static uint16_t active_pids[ALL_PIDS + 1];
+static int active_count;
+static uint64_t stream_pos;
+static unsigned char tail[TRANSPORT_SYNC_MIN_BUFFER];
+
+static char *patterns[MAX_PATTERNS];
+static int pattern_lens[MAX_PATTERNS];
+static int pattern_count;
+static unsigned char pattern_first[256];
+
+/* file input is timed using the PCRs on the first PCR PID seen, since it is
+ * read far faster than realtime. Until one is seen, it is timed as it is read. */
+static int file_input;
+static int report_interval = 1000;
+static int pcr_pid = -1;
+static uint64_t pcr_start;
+
+static void report(int diff);
 
 static void usage(FILE *output)
 {
@@ -25,126 +83,404 @@ static void usage(FILE *output)
 		"Options:\n"
 		"	-a N	use dvb adapter N\n"
 		"	-d N	use demux N\n"
-		"	-h	display this help\n");
+		"	-f FILE	read from a TS file instead of the dvr device\n"
+		"	-i MS	report interval in milliseconds (default 1000)\n"
+		"	-b KB	read size in kilobytes (default 1024)\n"
+		"	-s STR	only count packets containing STR (may be given %i times)\n"
+		"	-h	display this help\n", MAX_PATTERNS);
+}
+
+static void *reader_thread(void *arg)
+{
+	int slot = 0;
+	ssize_t r;
+
+	(void) arg;
+
+	while(1) {
+		sem_wait(&ring_empty);
+
+		r = read(input_fd, ring[slot].data, read_size);
+		if (r < 0) {
+			if (errno == EOVERFLOW) {
+				fprintf(stderr, "dvbtraffic: dvr overflow\n");
+				sem_post(&ring_empty);
+				continue;
+			}
+			if (errno == EINTR || errno == EAGAIN) {
+				sem_post(&ring_empty);
+				continue;
+			}
+			perror("read");
+			r = 0;
+		}
+
+		ring[slot].len = r;
+		sem_post(&ring_filled);
+		if (r == 0)
+			break;
+
+		slot = (slot + 1) % RING_SLOTS;
+	}
+
+	return NULL;
+}
+
+static void add_pattern(char *pattern)
+{
+	if (pattern_count == MAX_PATTERNS) {
+		fprintf(stderr, "dvbtraffic: too many search strings\n");
+		exit(1);
+	}
+	if (strlen(pattern) == 0 || strlen(pattern) > TRANSPORT_PACKET_LENGTH) {
+		fprintf(stderr, "dvbtraffic: invalid search string\n");
+		exit(1);
+	}
+
+	patterns[pattern_count] = pattern;
+	pattern_lens[pattern_count] = strlen(pattern);
+	pattern_first[(unsigned char) pattern[0]] = 1;
+	pattern_count++;
+}
+
+/* Only bytes which start one of the patterns need to be checked further,
+ * so the whole packet is scanned just once whatever the number of patterns. */
+static int match_patterns(unsigned char *pkt)
+{
+	int i, j;
+
+	for(i=0; i < TRANSPORT_PACKET_LENGTH; i++) {
+		if (!pattern_first[pkt[i]])
+			continue;
+
+		for(j=0; j < pattern_count; j++) {
+			if ((i + pattern_lens[j]) > TRANSPORT_PACKET_LENGTH)
+				continue;
+			if (!memcmp(pkt + i, patterns[j], pattern_lens[j]))
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void count_pcr(struct pid_stats *st, struct transport_packet *pkt, uint64_t pos)
+{
+	struct transport_values tsvals;
+	int64_t interval;
+	int64_t expected;
+	int64_t jitter;
+
+	if (transport_packet_values_extract(pkt, &tsvals, transport_value_pcr) < 0)
+		return;
+	if (!(tsvals.flags & transport_adaptation_flag_pcr))
+		return;
+
+	if (st->has_pcr && !(tsvals.flags & transport_adaptation_flag_discontinuity) &&
+	    (tsvals.pcr > st->last_pcr) && (pos > st->last_pcr_pos)) {
+		interval = tsvals.pcr - st->last_pcr;
+		if (interval > st->max_pcr_interval)
+			st->max_pcr_interval = interval;
+
+		/* the difference between the PCR and where it should be given
+		 * its position in the stream and the smoothed mux rate */
+		if (st->ticks_per_byte > 0) {
+			expected = (int64_t) ((pos - st->last_pcr_pos) * st->ticks_per_byte);
+			jitter = llabs(interval - expected);
+			if (jitter > st->max_pcr_jitter)
+				st->max_pcr_jitter = jitter;
+			st->ticks_per_byte = (st->ticks_per_byte * 15 +
+					      (double) interval / (pos - st->last_pcr_pos)) / 16;
+		} else {
+			st->ticks_per_byte = (double) interval / (pos - st->last_pcr_pos);
+		}
+	}
+
+	st->has_pcr = 1;
+	st->last_pcr = tsvals.pcr;
+	st->last_pcr_pos = pos;
+
+	if (file_input) {
+		if (pcr_pid < 0) {
+			pcr_pid = st - pidt;
+			pcr_start = tsvals.pcr;
+		} else if (st == &pidt[pcr_pid]) {
+			if (tsvals.pcr < pcr_start) {
+				pcr_start = tsvals.pcr;
+			} else if ((tsvals.pcr - pcr_start) * 1000 / PCR_HZ >= (uint64_t) report_interval) {
+				report((tsvals.pcr - pcr_start) * 1000 / PCR_HZ);
+				pcr_start = tsvals.pcr;
+			}
+		}
+	}
+}
+
+static void count_packet(struct transport_packet *pkt, uint64_t pos)
+{
+	int pid = transport_packet_pid(pkt);
+	struct pid_stats *st = &pidt[pid];
+	unsigned char *raw = (unsigned char *) pkt;
+	int flags = 0;
+
+	if (!st->active) {
+		active_pids[active_count++] = pid;
+		st->active = 1;
+	}
+
+	/* the contents of a packet the demodulator flagged as errored, its
+	 * continuity counter included, can't be trusted, so start checking
+	 * afresh from the next one */
+	if (pkt->transport_error_indicator) {
+		st->continuity = 0;
+	} else {
+		if ((pkt->adaptation_field_control & 2) && (raw[4] != 0))
+			flags = raw[5];
+
+		if (transport_packet_continuity_check(pkt,
+				(flags & transport_adaptation_flag_discontinuity) ? 1 : 0,
+				&st->continuity)) {
+			st->cc_errors++;
+			pidt[ALL_PIDS].cc_errors++;
+			st->continuity = 0;
+		}
+
+		if (flags & transport_adaptation_flag_pcr)
+			count_pcr(st, pkt, pos);
+	}
+
+	if (pattern_count) {
+		if ((pid == TRANSPORT_NULL_PID) || !match_patterns((unsigned char *) pkt))
+			return;
+	}
+
+	st->packets++;
+	pidt[ALL_PIDS].packets++;
+}
+
+/* milliseconds of stream since the last report when reading a file: up to the
+ * last PCR, plus the bytes since then at the rate the PCRs gave */
+static int file_elapsed(void)
+{
+	struct pid_stats *st;
+	double ticks;
+
+	if (pcr_pid < 0)
+		return 0;
+
+	st = &pidt[pcr_pid];
+	ticks = st->last_pcr - pcr_start;
+	if (st->ticks_per_byte > 0)
+		ticks += (stream_pos - st->last_pcr_pos) * st->ticks_per_byte;
+
+	return ticks * 1000 / PCR_HZ;
+}
+
+static int pid_compare(const void *a, const void *b)
+{
+	return *(const uint16_t *) a - *(const uint16_t *) b;
+}
+
+static void report(int diff)
+{
+	int i;
+	int pid;
+	struct pid_stats *st;
+
+	if (diff <= 0)
+		return;
+
+	qsort(active_pids, active_count, sizeof(uint16_t), pid_compare);
+	active_pids[active_count++] = ALL_PIDS;
+
+	for(i=0; i < active_count; i++) {
+		pid = active_pids[i];
+		st = &pidt[pid];
+		if ((st->packets == 0) && (st->cc_errors == 0))
+			goto next;
+
+		printf("%04x %5d p/s %5d kb/s %5d kbit %4d cc",
+		       pid,
+		       (int) ((int64_t) st->packets * 1000 / diff),
+		       (int) ((int64_t) st->packets * 1000 / diff * 188 / 1024),
+		       (int) ((int64_t) st->packets * 8 * 1000 / diff * 188 / 1000),
+		       st->cc_errors);
+		if (st->max_pcr_interval)
+			printf(" pcr %4dms %6dus",
+			       (int) (st->max_pcr_interval * 1000 / PCR_HZ),
+			       (int) (st->max_pcr_jitter * 1000000 / PCR_HZ));
+		printf("\n");
+
+next:
+		st->active = 0;
+		st->packets = 0;
+		st->cc_errors = 0;
+		st->max_pcr_interval = 0;
+		st->max_pcr_jitter = 0;
+	}
+	printf("-PID--FREQ-----BANDWIDTH-BANDWIDTH----CC-----PCR-INT-PCR-JITTER\n");
+	fflush(stdout);
+
+	active_count = 0;
 }
 
 int main(int argc, char **argv)
 {
 	struct timeval startt;
+	struct timeval now;
 	int adapter = 0, demux = 0;
-	char *search = NULL;
-	int fd, ffd, packets = 0;
+	char *filename = NULL;
+	int ffd = -1;
 	int opt;
+	int i;
+	int slot = 0;
+	int diff;
+	int used;
+	int pending = 0;
+	unsigned char *buf;
+	pthread_t reader;
+	struct transport_sync sync;
+	struct transport_sync_span span;
 
-	while ((opt = getopt(argc, argv, "a:d:hs:")) != -1) {
+	while ((opt = getopt(argc, argv, "a:b:d:f:hi:s:")) != -1) {
 		switch (opt) {
 		case 'a':
 			adapter = atoi(optarg);
 			break;
+		case 'b':
+			read_size = atoi(optarg) * 1024;
+			break;
 		case 'd':
 			demux = atoi(optarg);
 			break;
+		case 'f':
+			filename = optarg;
+			break;
 		case 'h':
 			usage(stdout);
 			exit(0);
+		case 'i':
+			report_interval = atoi(optarg);
+			break;
 		case 's':
-			search = strdup(optarg);
+			add_pattern(strdup(optarg));
 			break;
 		default:
 			usage(stderr);
 			exit(1);
 		}
 	}
-
-	// open the DVR device
-	fd = dvbdemux_open_dvr(adapter, demux, 1, 0);
-	if (fd < 0) {
- 		fprintf(stderr, "dvbtraffic: Could not open dvr device: %m\n");
+	if ((read_size < TRANSPORT_SYNC_MIN_BUFFER) || (report_interval <= 0)) {
+		usage(stderr);
 		exit(1);
 	}
-	dvbdemux_set_buffer(fd, 1024 * 1024);
 
-	ffd = dvbdemux_open_demux(adapter, demux, 0);
-	if (ffd < 0) {
-		fprintf(stderr, "dvbtraffic: Could not open demux device: %m\n");
-		exit(1);
+	if (filename) {
+		// read from a file
+		file_input = 1;
+		input_fd = open(filename, O_RDONLY);
+		if (input_fd < 0) {
+			fprintf(stderr, "dvbtraffic: Could not open %s: %m\n", filename);
+			exit(1);
+		}
+	} else {
+		// open the DVR device
+		input_fd = dvbdemux_open_dvr(adapter, demux, 1, 0);
+		if (input_fd < 0) {
+			fprintf(stderr, "dvbtraffic: Could not open dvr device: %m\n");
+			exit(1);
+		}
+		dvbdemux_set_buffer(input_fd, DVR_BUFFER_SIZE);
+
+		ffd = dvbdemux_open_demux(adapter, demux, 0);
+		if (ffd < 0) {
+			fprintf(stderr, "dvbtraffic: Could not open demux device: %m\n");
+			exit(1);
+		}
+
+		if (dvbdemux_set_pid_filter(ffd, -1, DVBDEMUX_INPUT_FRONTEND, DVBDEMUX_OUTPUT_DVR, 1)) {
+			perror("dvbdemux_set_pid_filter");
+			return -1;
+		}
 	}
 
-	if (dvbdemux_set_pid_filter(ffd, -1, DVBDEMUX_INPUT_FRONTEND, DVBDEMUX_OUTPUT_DVR, 1)) {
-		perror("dvbdemux_set_pid_filter");
-		return -1;
+	// setup the ring of buffers. Each has room in front of it for the
+	// unprocessed tail of the previous buffer.
+	for(i=0; i < RING_SLOTS; i++) {
+		ring[i].data = malloc(TRANSPORT_SYNC_MIN_BUFFER + read_size);
+		if (ring[i].data == NULL) {
+			fprintf(stderr, "dvbtraffic: Out of memory\n");
+			exit(1);
+		}
+		ring[i].data += TRANSPORT_SYNC_MIN_BUFFER;
+	}
+	sem_init(&ring_filled, 0, 0);
+	sem_init(&ring_empty, 0, RING_SLOTS);
+	transport_sync_init(&sync, 0);
+
+	if (pthread_create(&reader, NULL, reader_thread, NULL)) {
+		perror("pthread_create");
+		exit(1);
 	}
 
 	gettimeofday(&startt, 0);
 
 	while (1) {
-		unsigned char buffer[BSIZE];
-		int pid, ok;
-		ssize_t r;
-
-		if ((r = read(fd, buffer, BSIZE)) <= 0) {
-			perror("read");
+		sem_wait(&ring_filled);
+		if (ring[slot].len == 0)
 			break;
-		}
-		if (r != BSIZE) {
-			fprintf(stderr, "dvbtraffic: only read %zd bytes\n", r);
-			break;
-		}
-		if (buffer[0] != 0x47) {
-			continue;
-			printf("desync (%x)\n", buffer[0]);
-			while (buffer[0] != 0x47)
-				read(fd, buffer, 1);
-			continue;
-		}
-		ok = 1;
-		pid = ((((unsigned) buffer[1]) << 8) |
-		       ((unsigned) buffer[2])) & 0x1FFF;
-
-		if (search) {
-			int i, sl = strlen(search);
-			ok = 0;
-			if (pid != 0x1fff) {
-				for (i = 0; i < (188 - sl); ++i) {
-					if (!memcmp(buffer + i, search, sl))
-						ok = 1;
-				}
-			}
-		}
 
-		if (ok) {
-			pidt[pid]++;
-			pidt[0x2000]++;
+		// prepend whatever was left over from the previous buffer
+		buf = ring[slot].data - pending;
+		memcpy(buf, tail, pending);
+		pending += ring[slot].len;
+
+		while ((used = transport_sync_process(&sync, buf, pending, &span)) > 0) {
+			for(i=0; i < span.count; i++) {
+				struct transport_packet *pkt = (struct transport_packet *)
+					(span.packets + i * span.stride);
+
+				count_packet(pkt, stream_pos + (span.packets - buf) + i * span.stride);
+			}
+			stream_pos += used;
+			buf += used;
+			pending -= used;
 		}
 
-		packets++;
+		// keep the unprocessed tail, and hand the buffer back to the reader
+		memcpy(tail, buf, pending);
+		sem_post(&ring_empty);
 
-		if (!(packets & 0xFF)) {
-			struct timeval now;
-			int diff;
+		if (!file_input || (pcr_pid < 0)) {
 			gettimeofday(&now, 0);
-			diff =
-			    (now.tv_sec - startt.tv_sec) * 1000 +
-			    (now.tv_usec - startt.tv_usec) / 1000;
-			if (diff > 1000) {
-				int _pid = 0;
-				for (_pid = 0; _pid < 0x2001; _pid++) {
-					if (pidt[_pid]) {
-						printf("%04x %5d p/s %5d kb/s %5d kbit\n",
-						     _pid,
-						     pidt[_pid] * 1000 / diff,
-						     pidt[_pid] * 1000 / diff * 188 / 1024,
-						     pidt[_pid] * 8 * 1000 / diff * 188 / 1000);
-					}
-					pidt[_pid] = 0;
-				}
-				printf("-PID--FREQ-----BANDWIDTH-BANDWIDTH-\n");
+			diff = (now.tv_sec - startt.tv_sec) * 1000 +
+			       (now.tv_usec - startt.tv_usec) / 1000;
+			if (diff >= report_interval) {
+				report(diff);
 				startt = now;
 			}
 		}
+
+		slot = (slot + 1) % RING_SLOTS;
 	}
 
-	close(ffd);
-	close(fd);
+	// report whatever was counted since the last report, which for a short
+	// file may be everything
+	diff = 0;
+	if (file_input)
+		diff = file_elapsed();
+	if (diff <= 0) {
+		gettimeofday(&now, 0);
+		diff = (now.tv_sec - startt.tv_sec) * 1000 +
+		       (now.tv_usec - startt.tv_usec) / 1000;
+		if (diff <= 0)
+			diff = 1;
+	}
+	report(diff);
+
+	pthread_join(reader, NULL);
+
+	if (ffd >= 0)
+		close(ffd);
+	close(input_fd);
 	return 0;
 }
@@ -67,18 +67,28 @@ void usage(void)
 		"						Dual LO, H:5150MHz, V:5750MHz.\n"
 		"			 * One of the sec definitions from the secfile if supplied\n"
 		" -buffer <size>	Custom DVR buffer size\n"
+		" -ringsize <MiB>	Size of the recorder's buffer for file/stdout output (default 32)\n"
+		" -writesize <KiB>	Size of each write to the output file (default 1024)\n"
+		" -prealloc <MiB>	Preallocate the output file this far ahead of the writes\n"
+		" -directio		Write the output file with O_DIRECT\n"
+		" -userfilter		Select the service's PIDs in userspace from a single full\n"
+		"				transport stream filter (file/stdout/udp/rtp output)\n"
 		" -out decoder		Output to hardware decoder (default)\n"
 		"      decoderabypass	Output to hardware decoder using audio bypass\n"
 		"      dvr		Output stream to dvr device\n"
 		"      null		Do not output anything\n"
 		"      stdout		Output to stdout\n"
 		"      file <filename>	Output stream to file\n"
+		"      remux <pattern>	Record every service on the multiplex to its own file, with\n"
+		"				%i in the filename replaced by the service id\n"
 		"      udp <address> <port>			Output stream to address:port using udp\n"
 		"      udpif <address> <port> <interface> 	Output stream to address:port using udp\n"
 		"							forcing the specified interface\n"
 		"      rtp <address> <port>			Output stream to address:port using udp-rtp\n"
 		"      rtpif <address> <port> <interface> 	Output stream to address:port using udp-rtp\n"
 		"							forcing the specified interface\n"
+		" -pace			Pace udp/rtp output according to the stream's PCR\n"
+		" -services <id>[,<id>...]	Only record these services with -out remux\n"
 		" -timeout <secs>	Number of seconds to output channel for\n"
 		"				(0=>exit immediately after successful tuning, default is to output forever)\n"
 		" -cammenu		Show the CAM menu\n"
@@ -124,8 +134,21 @@ int main(int argc, char *argv[])
 	struct gnutv_dvb_params gnutv_dvb_params;
 	struct gnutv_ca_params gnutv_ca_params;
 	int ffaudiofd = -1;
-	int usertp = 0;
+	struct gnutv_stream_params gnutv_stream_params;
+	struct gnutv_remux_params gnutv_remux_params;
+	int ring_size_set = 0;
 	int buffer_size = 0;
+	int userfilter = 0;
+	struct gnutv_record_params gnutv_record_params;
+
+	gnutv_record_params.ring_size = GNUTV_RECORD_DEFAULT_RING_SIZE;
+	gnutv_record_params.write_size = GNUTV_RECORD_DEFAULT_WRITE_SIZE;
+	gnutv_record_params.direct_io = 0;
+	gnutv_record_params.prealloc_size = 0;
+	gnutv_stream_params.usertp = 0;
+	gnutv_stream_params.pace = 0;
+	memset(&gnutv_remux_params, 0, sizeof(gnutv_remux_params));
+	gnutv_remux_params.record_params = &gnutv_record_params;
 
 	while(argpos != argc) {
 		if (!strcmp(argv[argpos], "-h")) {
@@ -177,6 +200,68 @@ int main(int argc, char *argv[])
 			if (buffer_size < 0)
 				usage();
 			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-ringsize")) {
+			int tmp;
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &tmp) != 1)
+				usage();
+			if ((tmp <= 0) || (tmp > 1024))
+				usage();
+			gnutv_record_params.ring_size = tmp * 1024 * 1024;
+			ring_size_set = 1;
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-writesize")) {
+			int tmp;
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &tmp) != 1)
+				usage();
+			if ((tmp < 4) || (tmp > 65536))
+				usage();
+			gnutv_record_params.write_size = tmp * 1024;
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-prealloc")) {
+			int tmp;
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &tmp) != 1)
+				usage();
+			if ((tmp < 0) || (tmp > 1024))
+				usage();
+			gnutv_record_params.prealloc_size = tmp * 1024 * 1024;
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-services")) {
+			char *tmp;
+			if ((argc - argpos) < 2)
+				usage();
+			tmp = argv[argpos+1];
+			while(*tmp) {
+				int service_id;
+				int len;
+				if (gnutv_remux_params.service_count == GNUTV_REMUX_MAX_SERVICES)
+					usage();
+				if (sscanf(tmp, "%i%n", &service_id, &len) != 1)
+					usage();
+				if ((service_id <= 0) || (service_id > 0xffff))
+					usage();
+				gnutv_remux_params.service_ids[gnutv_remux_params.service_count++] = service_id;
+				tmp += len;
+				if (*tmp == ',')
+					tmp++;
+				else if (*tmp)
+					usage();
+			}
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-pace")) {
+			gnutv_stream_params.pace = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-userfilter")) {
+			userfilter = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-directio")) {
+			gnutv_record_params.direct_io = 1;
+			argpos++;
 		} else if (!strcmp(argv[argpos], "-out")) {
 			if ((argc - argpos) < 2)
 				usage();
@@ -196,6 +281,16 @@ int main(int argc, char *argv[])
 					usage();
 				outfile = argv[argpos+2];
 				argpos++;
+			} else if (!strcmp(argv[argpos+1], "remux")) {
+				output_type = OUTPUT_TYPE_REMUX;
+				if ((argc - argpos) < 3)
+					usage();
+				if (gnutv_remux_check_pattern(argv[argpos+2])) {
+					fprintf(stderr, "The remux filename must contain a single %%i\n");
+					exit(1);
+				}
+				gnutv_remux_params.pattern = argv[argpos+2];
+				argpos++;
 			} else if ((!strcmp(argv[argpos+1], "udp")) ||
 				   (!strcmp(argv[argpos+1], "rtp"))) {
 				output_type = OUTPUT_TYPE_UDP;
@@ -203,7 +298,7 @@ int main(int argc, char *argv[])
 					usage();
 
 				if (!strcmp(argv[argpos+1], "rtp"))
-					usertp = 1;
+					gnutv_stream_params.usertp = 1;
 				outhost = argv[argpos+2];
 				outport = argv[argpos+3];
 				argpos+=2;
@@ -214,7 +309,7 @@ int main(int argc, char *argv[])
 					usage();
 
 				if (!strcmp(argv[argpos+1], "rtpif"))
-					usertp = 1;
+					gnutv_stream_params.usertp = 1;
 				outhost = argv[argpos+2];
 				outport = argv[argpos+3];
 				outif = argv[argpos+4];
@@ -247,6 +342,10 @@ int main(int argc, char *argv[])
 	if ((channel_name == NULL) && (!cammenu))
 		usage();
 
+	// there is a recorder per service when remuxing
+	if ((output_type == OUTPUT_TYPE_REMUX) && !ring_size_set)
+		gnutv_record_params.ring_size = GNUTV_REMUX_DEFAULT_RING_SIZE;
+
 	// resolve host/port
 	if ((outhost != NULL) && (outport != NULL)) {
 		int res;
@@ -322,15 +421,16 @@ int main(int argc, char *argv[])
 			}
 		}
 
+		// start the data stuff. This must be ready before the DVB thread
+		// can deliver the PMT to it.
+		gnutv_data_start(output_type, ffaudiofd, adapter_id, demux_id, buffer_size, outfile, &gnutv_record_params, outif, outaddrs, &gnutv_stream_params, &gnutv_remux_params, userfilter);
+
 		// start the DVB stuff
 		gnutv_dvb_params.adapter_id = adapter_id;
 		gnutv_dvb_params.frontend_id = frontend_id;
 		gnutv_dvb_params.demux_id = demux_id;
 		gnutv_dvb_params.output_type = output_type;
 		gnutv_dvb_start(&gnutv_dvb_params);
-
-		// start the data stuff
-		gnutv_data_start(output_type, ffaudiofd, adapter_id, demux_id, buffer_size, outfile, outif, outaddrs, usertp);
 	}
 
 	// the UI
@@ -33,5 +33,6 @@
 #define OUTPUT_TYPE_FILE 4
 #define OUTPUT_TYPE_UDP 5
 #define OUTPUT_TYPE_STDOUT 6
+#define OUTPUT_TYPE_REMUX 7
 
 #endif
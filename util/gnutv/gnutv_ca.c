@@ -36,6 +36,9 @@
 #define MMI_STATE_ENQ 2
 #define MMI_STATE_MENU 3
 
+// longest the cam thread sleeps before checking for shutdown
+#define CAMTHREAD_MAX_WAIT_MS 100
+
 static int gnutv_ca_info_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint32_t ca_id_count, uint16_t *ca_ids);
 static int gnutv_ai_callback(void *arg, uint8_t slot_id, uint16_t session_number,
 			     uint8_t application_type, uint16_t application_manufacturer,
@@ -262,7 +265,7 @@ static void *camthread_func(void* arg)
 	int entered_menu = 0;
 
 	while(!camthread_shutdown) {
-		stdcam->poll(stdcam);
+		en50221_stdcam_wait(stdcam, CAMTHREAD_MAX_WAIT_MS);
 
 		if ((!entered_menu) && cammenu && ca_resource_connected && stdcam->mmi_resource) {
 			en50221_app_ai_entermenu(stdcam->ai_resource, stdcam->ai_session_number);
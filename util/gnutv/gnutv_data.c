@@ -39,19 +39,28 @@
 #include <libdvbapi/dvbdemux.h>
 #include <libdvbapi/dvbaudio.h>
 #include <libucsi/mpeg/section.h>
+#include <libucsi/transport_packet.h>
 #include "gnutv.h"
 #include "gnutv_dvb.h"
 #include "gnutv_ca.h"
 #include "gnutv_data.h"
+#include "gnutv_record.h"
+#include "gnutv_stream.h"
+#include "gnutv_remux.h"
+#include "gnutv_pidfilter.h"
 
 static void *fileoutputthread_func(void* arg);
 static void *udpoutputthread_func(void* arg);
+static void *remuxoutputthread_func(void* arg);
 
 static int gnutv_data_create_decoder_filter(int adapter, int demux, uint16_t pid, int pestype);
 static int gnutv_data_create_dvr_filter(int adapter, int demux, uint16_t pid);
+static void gnutv_data_create_userfilter(void);
+static int gnutv_data_read_dvr(uint8_t *buf, int len);
 
 static void gnutv_data_decoder_pmt(struct mpeg_pmt_section *pmt);
 static void gnutv_data_dvr_pmt(struct mpeg_pmt_section *pmt);
+static void gnutv_data_userfilter_pmt(struct mpeg_pmt_section *pmt);
 
 static void gnutv_data_append_pid_fd(int pid, int fd);
 static void gnutv_data_free_pid_fds(void);
@@ -61,9 +70,13 @@ static int outfd = -1;
 static int dvrfd = -1;
 static int pat_fd_dvrout = -1;
 static int pmt_fd_dvrout = -1;
+static int ts_fd_dvrout = -1;
 static int outputthread_shutdown = 0;
+static struct gnutv_record *recorder = NULL;
+static struct gnutv_stream *streamer = NULL;
+static struct gnutv_remux *remuxer = NULL;
+static struct gnutv_pidfilter *pidfilter = NULL;
 
-static int usertp = 0;
 static int adapter_id = -1;
 static int demux_id = -1;
 static int output_type = 0;
@@ -76,12 +89,18 @@ struct pid_fd {
 static struct pid_fd *pid_fds = NULL;
 static int pid_fds_count = 0;
 
+// PIDs selected by the userspace filter: the PAT, the PMT, then the streams
+#define USERFILTER_MAX_PIDS 256
+static uint16_t userfilter_pids[USERFILTER_MAX_PIDS];
+static int userfilter_pids_count = 0;
+
 void gnutv_data_start(int _output_type,
 		    int ffaudiofd, int _adapter_id, int _demux_id, int buffer_size,
-		    char *outfile,
-		    char* outif, struct addrinfo *_outaddrs, int _usertp)
+		    char *outfile, struct gnutv_record_params *record_params,
+		    char* outif, struct addrinfo *_outaddrs, struct gnutv_stream_params *stream_params,
+		    struct gnutv_remux_params *remux_params,
+		    int userfilter)
 {
-	usertp = _usertp;
 	demux_id = _demux_id;
 	adapter_id = _adapter_id;
 	output_type = _output_type;
@@ -98,13 +117,21 @@ void gnutv_data_start(int _output_type,
 	case OUTPUT_TYPE_FILE:
 		if (output_type == OUTPUT_TYPE_FILE) {
 			// open output file
-			outfd = open(outfile, O_WRONLY|O_CREAT|O_LARGEFILE|O_TRUNC, 0644);
+			outfd = gnutv_record_open(outfile, record_params);
 			if (outfd < 0) {
 				fprintf(stderr, "Failed to open output file\n");
 				exit(1);
 			}
 		} else {
 			outfd = STDOUT_FILENO;
+			record_params->direct_io = 0;
+		}
+
+		// start the recorder which writes out the data
+		recorder = gnutv_record_start(outfd, record_params);
+		if (recorder == NULL) {
+			fprintf(stderr, "Failed to start recorder\n");
+			exit(1);
 		}
 
 		// open dvr device
@@ -122,6 +149,9 @@ void gnutv_data_start(int _output_type,
 			}
 		}
 
+		if (userfilter)
+			gnutv_data_create_userfilter();
+
 		pthread_create(&outputthread, NULL, fileoutputthread_func, NULL);
 		break;
 
@@ -158,8 +188,50 @@ void gnutv_data_start(int _output_type,
 			}
 		}
 
+		// start the streamer which sends it
+		streamer = gnutv_stream_create(outfd, outaddrs, stream_params);
+		if (streamer == NULL) {
+			fprintf(stderr, "Failed to start streamer\n");
+			exit(1);
+		}
+
+		if (userfilter)
+			gnutv_data_create_userfilter();
+
 		pthread_create(&outputthread, NULL, udpoutputthread_func, NULL);
 		break;
+
+	case OUTPUT_TYPE_REMUX:
+		// open dvr device
+		dvrfd = dvbdemux_open_dvr(adapter_id, 0, 1, 0);
+		if (dvrfd < 0) {
+			fprintf(stderr, "Failed to open DVR device\n");
+			exit(1);
+		}
+
+		// optionally set dvr buffer size
+		if (buffer_size > 0) {
+			if (dvbdemux_set_buffer(dvrfd, buffer_size) != 0) {
+				fprintf(stderr, "Failed to set DVR buffer size\n");
+				exit(1);
+			}
+		}
+
+		// the remuxer picks the services out of the whole transport stream
+		ts_fd_dvrout = gnutv_data_create_dvr_filter(adapter_id, demux_id, 0x2000);
+		if (ts_fd_dvrout < 0) {
+			fprintf(stderr, "Failed to create full transport stream filter\n");
+			exit(1);
+		}
+
+		remuxer = gnutv_remux_create(remux_params);
+		if (remuxer == NULL) {
+			fprintf(stderr, "Failed to start remuxer\n");
+			exit(1);
+		}
+
+		pthread_create(&outputthread, NULL, remuxoutputthread_func, NULL);
+		break;
 	}
 
 	// output PAT to DVR if requested
@@ -168,7 +240,13 @@ void gnutv_data_start(int _output_type,
 	case OUTPUT_TYPE_FILE:
 	case OUTPUT_TYPE_STDOUT:
 	case OUTPUT_TYPE_UDP:
-		pat_fd_dvrout = gnutv_data_create_dvr_filter(adapter_id, demux_id, TRANSPORT_PAT_PID);
+		if (pidfilter != NULL) {
+			userfilter_pids[0] = TRANSPORT_PAT_PID;
+			userfilter_pids_count = 1;
+			gnutv_pidfilter_set(pidfilter, userfilter_pids, userfilter_pids_count);
+		} else {
+			pat_fd_dvrout = gnutv_data_create_dvr_filter(adapter_id, demux_id, TRANSPORT_PAT_PID);
+		}
 	}
 }
 
@@ -179,11 +257,29 @@ void gnutv_data_stop()
 		outputthread_shutdown = 1;
 		pthread_join(outputthread, NULL);
 	}
+	if (recorder != NULL) {
+		gnutv_record_stop(recorder);
+		recorder = NULL;
+	}
+	if (streamer != NULL) {
+		gnutv_stream_destroy(streamer);
+		streamer = NULL;
+	}
+	if (remuxer != NULL) {
+		gnutv_remux_destroy(remuxer);
+		remuxer = NULL;
+	}
+	if (pidfilter != NULL) {
+		gnutv_pidfilter_destroy(pidfilter);
+		pidfilter = NULL;
+	}
 	gnutv_data_free_pid_fds();
 	if (pat_fd_dvrout != -1)
 		close(pat_fd_dvrout);
 	if (pmt_fd_dvrout != -1)
 		close(pmt_fd_dvrout);
+	if (ts_fd_dvrout != -1)
+		close(ts_fd_dvrout);
 	if (outaddrs)
 		freeaddrinfo(outaddrs);
 }
@@ -196,6 +292,15 @@ void gnutv_data_new_pat(int pmt_pid)
 	case OUTPUT_TYPE_FILE:
 	case OUTPUT_TYPE_STDOUT:
 	case OUTPUT_TYPE_UDP:
+		if (pidfilter != NULL) {
+			// keep the old streams until the new PMT arrives, as with
+			// kernel filters
+			userfilter_pids[1] = pmt_pid;
+			if (userfilter_pids_count < 2)
+				userfilter_pids_count = 2;
+			gnutv_pidfilter_set(pidfilter, userfilter_pids, userfilter_pids_count);
+			break;
+		}
 		if (pmt_fd_dvrout != -1)
 			close(pmt_fd_dvrout);
 		pmt_fd_dvrout = gnutv_data_create_dvr_filter(adapter_id, demux_id, pmt_pid);
@@ -218,19 +323,28 @@ int gnutv_data_new_pmt(struct mpeg_pmt_section *pmt)
 	case OUTPUT_TYPE_FILE:
 	case OUTPUT_TYPE_STDOUT:
 	case OUTPUT_TYPE_UDP:
-		gnutv_data_dvr_pmt(pmt);
+		if (pidfilter != NULL)
+			gnutv_data_userfilter_pmt(pmt);
+		else
+			gnutv_data_dvr_pmt(pmt);
 		break;
 	}
 
 	return 1;
 }
 
+// most read from the DVR device in one go
+#define DVR_READ_SIZE (TRANSPORT_PACKET_LENGTH * 1024)
+
 static void *fileoutputthread_func(void* arg)
 {
 	(void)arg;
-	uint8_t buf[4096];
+	static uint8_t discard[DVR_READ_SIZE];
 	struct pollfd pollfd;
-	int written;
+	uint8_t *buf;
+	int len;
+	int packet_pos = 0;
+	int dropping = 0;
 
 	pollfd.fd = dvrfd;
 	pollfd.events = POLLIN|POLLPRI|POLLERR;
@@ -246,7 +360,30 @@ static void *fileoutputthread_func(void* arg)
 		if (pollfd.revents == 0)
 			continue;
 
-		int size = read(dvrfd, buf, sizeof(buf));
+		// read straight into the recorder's ring. If the output has fallen so
+		// far behind that it is full, the data has to be dropped; better
+		// that than letting the DVR buffer overflow.
+		buf = NULL;
+		if (!dropping) {
+			buf = gnutv_record_get_space(recorder, &len);
+
+			// only drop whole packets: the ring is full as far as we are
+			// concerned if it cannot take the rest of the current one
+			if ((buf != NULL) && (len < (TRANSPORT_PACKET_LENGTH - packet_pos)))
+				buf = NULL;
+		}
+		if (buf == NULL) {
+			buf = discard;
+			len = sizeof(discard);
+			dropping = 1;
+		}
+		if (len > DVR_READ_SIZE)
+			len = DVR_READ_SIZE;
+
+		// end reads on packet boundaries
+		len -= (packet_pos + len) % TRANSPORT_PACKET_LENGTH;
+
+		int size = gnutv_data_read_dvr(buf, len);
 		if (size < 0) {
 			if (errno == EINTR)
 				continue;
@@ -254,6 +391,7 @@ static void *fileoutputthread_func(void* arg)
 			if (errno == EOVERFLOW) {
 				// The error flag has been cleared, next read should succeed.
 				fprintf(stderr, "DVR overflow\n");
+				gnutv_record_dvr_overflow(recorder);
 				continue;
 			}
 
@@ -261,100 +399,112 @@ static void *fileoutputthread_func(void* arg)
 			return 0;
 		}
 
-		written = 0;
-		while(written < size) {
-			int tmp = write(outfd, buf + written, size - written);
-			if (tmp == -1) {
-				if (errno != EINTR) {
-					fprintf(stderr, "Write error: %m\n");
-					break;
-				}
-			} else {
-				written += tmp;
-			}
+		packet_pos = (packet_pos + size) % TRANSPORT_PACKET_LENGTH;
+		if (dropping) {
+			gnutv_record_drop(recorder, size);
+			if (packet_pos == 0)
+				dropping = 0;
+		} else {
+			gnutv_record_commit(recorder, size);
 		}
 	}
 
 	return 0;
 }
 
-#define TS_PAYLOAD_SIZE (188*7)
-
 static void *udpoutputthread_func(void* arg)
 {
 	(void)arg;
-	uint8_t buf[12 + TS_PAYLOAD_SIZE];
 	struct pollfd pollfd;
-	int bufsize = 0;
-	int bufbase = 0;
-	int readsize;
-	uint16_t rtpseq = 0;
+	uint8_t *buf;
+	int timeout;
+	int len;
 
 	pollfd.fd = dvrfd;
 	pollfd.events = POLLIN|POLLPRI|POLLERR;
 
-	if (usertp) {
-		srandom(time(NULL));
-		int ssrc = random();
-		rtpseq = random();
-		buf[0x0] = 0x80;
-		buf[0x1] = 0x21;
-		buf[0x4] = 0x00; // }
-		buf[0x5] = 0x00; // } FIXME: should really be a valid stamp
-		buf[0x6] = 0x00; // }
-		buf[0x7] = 0x00; // }
-		buf[0x8] = ssrc >> 24;
-		buf[0x9] = ssrc >> 16;
-		buf[0xa] = ssrc >> 8;
-		buf[0xb] = ssrc;
-		bufbase = 12;
-	}
-
 	while(!outputthread_shutdown) {
-		if (poll(&pollfd, 1, 1000) != 1)
-			continue;
-		if (pollfd.revents & POLLERR) {
+		// send anything due, and wake up again when the next datagram is due
+		timeout = gnutv_stream_send(streamer);
+		if ((timeout < 0) || (timeout > 1000))
+			timeout = 1000;
+
+		if (poll(&pollfd, 1, timeout) == -1) {
 			if (errno == EINTR)
 				continue;
-			fprintf(stderr, "DVR device read failure\n");
+			fprintf(stderr, "DVR device poll failure\n");
 			return 0;
 		}
 
-		readsize = TS_PAYLOAD_SIZE - bufsize;
-		readsize = read(dvrfd, buf + bufbase + bufsize, readsize);
-		if (readsize < 0) {
+		if (pollfd.revents == 0)
+			continue;
+
+		// if the buffer is full, sending will make room
+		if ((buf = gnutv_stream_get_space(streamer, &len)) == NULL)
+			continue;
+
+		int size = gnutv_data_read_dvr(buf, len);
+		if (size < 0) {
 			if (errno == EINTR)
 				continue;
+
+			if (errno == EOVERFLOW) {
+				// The error flag has been cleared, next read should succeed.
+				fprintf(stderr, "DVR overflow\n");
+				continue;
+			}
+
 			fprintf(stderr, "DVR device read failure\n");
 			return 0;
 		}
-		bufsize += readsize;
 
-		if (bufsize == TS_PAYLOAD_SIZE) {
-			if (usertp) {
-				buf[2] = rtpseq >> 8;
-				buf[3] = rtpseq;
-			}
-			if (sendto(outfd, buf, bufbase + bufsize, 0, outaddrs->ai_addr, outaddrs->ai_addrlen) < 0) {
-				if (errno != EINTR) {
-					fprintf(stderr, "Socket send failure: %m\n");
-					return 0;
-				}
-			}
-			rtpseq++;
-			bufsize = 0;
-		}
+		gnutv_stream_commit(streamer, size);
 	}
 
-	if (bufsize) {
-		if (usertp) {
-			buf[2] = rtpseq >> 8;
-			buf[3] = rtpseq;
+	return 0;
+}
+
+static void *remuxoutputthread_func(void* arg)
+{
+	(void)arg;
+	static uint8_t buf[DVR_READ_SIZE];
+	struct pollfd pollfd;
+	int used = 0;
+
+	pollfd.fd = dvrfd;
+	pollfd.events = POLLIN|POLLPRI|POLLERR;
+
+	while(!outputthread_shutdown) {
+		if (poll(&pollfd, 1, 1000) == -1) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "DVR device poll failure\n");
+			return 0;
 		}
-		if (sendto(outfd, buf, bufbase + bufsize, 0, outaddrs->ai_addr, outaddrs->ai_addrlen) < 0) {
-			if (errno != EINTR)
-				fprintf(stderr, "Socket send failure: %m\n");
+
+		if (pollfd.revents == 0)
+			continue;
+
+		int size = read(dvrfd, buf + used, sizeof(buf) - used);
+		if (size < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno == EOVERFLOW) {
+				// The error flag has been cleared, next read should succeed.
+				fprintf(stderr, "DVR overflow\n");
+				continue;
+			}
+
+			fprintf(stderr, "DVR device read failure\n");
+			return 0;
 		}
+		used += size;
+
+		// keep any partial packet for next time
+		int consumed = gnutv_remux_feed(remuxer, buf, used);
+		memmove(buf, buf + consumed, used - consumed);
+		used -= consumed;
 	}
 
 	return 0;
@@ -379,6 +529,51 @@ static int gnutv_data_create_decoder_filter(int adapter, int demux, uint16_t pid
 	return demux_fd;
 }
 
+static void gnutv_data_create_userfilter(void)
+{
+	pidfilter = gnutv_pidfilter_create();
+	if (pidfilter == NULL) {
+		fprintf(stderr, "Failed to create PID filter\n");
+		exit(1);
+	}
+
+	// PIDs are selected from the whole transport stream as it is read
+	ts_fd_dvrout = gnutv_data_create_dvr_filter(adapter_id, demux_id, 0x2000);
+	if (ts_fd_dvrout < 0) {
+		fprintf(stderr, "Failed to create full transport stream filter\n");
+		exit(1);
+	}
+}
+
+static int gnutv_data_read_dvr(uint8_t *buf, int len)
+{
+	int size;
+	int tmp;
+
+	if (pidfilter == NULL)
+		return read(dvrfd, buf, len);
+
+	// the userspace filter works on whole packets
+	len -= len % TRANSPORT_PACKET_LENGTH;
+	size = read(dvrfd, buf, len);
+	if (size <= 0)
+		return size;
+
+	// the rest of a partial packet will follow straight away
+	while(size % TRANSPORT_PACKET_LENGTH) {
+		tmp = read(dvrfd, buf + size, TRANSPORT_PACKET_LENGTH - (size % TRANSPORT_PACKET_LENGTH));
+		if ((tmp < 0) && (errno == EINTR))
+			continue;
+		if (tmp <= 0) {
+			size -= size % TRANSPORT_PACKET_LENGTH;
+			break;
+		}
+		size += tmp;
+	}
+
+	return gnutv_pidfilter_process(pidfilter, buf, size);
+}
+
 static int gnutv_data_create_dvr_filter(int adapter, int demux, uint16_t pid)
 {
 	int demux_fd = -1;
@@ -444,7 +639,10 @@ static void gnutv_data_decoder_pmt(struct mpeg_pmt_section *pmt)
 static void gnutv_data_dvr_pmt(struct mpeg_pmt_section *pmt)
 {
 	struct mpeg_pmt_stream *cur_stream;
+	int pcr_pid_found = 0;
 	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		if (cur_stream->pid == pmt->pcr_pid)
+			pcr_pid_found = 1;
 		int fd = gnutv_data_create_dvr_filter(adapter_id, demux_id, cur_stream->pid);
 		if (fd < 0) {
 			fprintf(stderr, "Unable to create dvr filter for PID %i\n", cur_stream->pid);
@@ -452,6 +650,39 @@ static void gnutv_data_dvr_pmt(struct mpeg_pmt_section *pmt)
 			gnutv_data_append_pid_fd(cur_stream->pid, fd);
 		}
 	}
+
+	// the PCR may be carried on a PID of its own
+	if (!pcr_pid_found && (pmt->pcr_pid != 0x1fff)) {
+		int fd = gnutv_data_create_dvr_filter(adapter_id, demux_id, pmt->pcr_pid);
+		if (fd < 0) {
+			fprintf(stderr, "Unable to create dvr filter for PID %i\n", pmt->pcr_pid);
+		} else {
+			gnutv_data_append_pid_fd(pmt->pcr_pid, fd);
+		}
+	}
+}
+
+static void gnutv_data_userfilter_pmt(struct mpeg_pmt_section *pmt)
+{
+	struct mpeg_pmt_stream *cur_stream;
+	int pcr_pid_found = 0;
+
+	// the whole new set replaces the old in one go, so streams present in
+	// both carry on uninterrupted
+	userfilter_pids_count = 2;
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		if (cur_stream->pid == pmt->pcr_pid)
+			pcr_pid_found = 1;
+		if (userfilter_pids_count < USERFILTER_MAX_PIDS)
+			userfilter_pids[userfilter_pids_count++] = cur_stream->pid;
+	}
+
+	// the PCR may be carried on a PID of its own
+	if (!pcr_pid_found && (pmt->pcr_pid != 0x1fff) &&
+	    (userfilter_pids_count < USERFILTER_MAX_PIDS))
+		userfilter_pids[userfilter_pids_count++] = pmt->pcr_pid;
+
+	gnutv_pidfilter_set(pidfilter, userfilter_pids, userfilter_pids_count);
 }
 
 static void gnutv_data_append_pid_fd(int pid, int fd)
@@ -24,11 +24,17 @@
 #define gnutv_DATA_H 1
 
 #include <netdb.h>
+#include "gnutv_record.h"
+#include "gnutv_stream.h"
+#include "gnutv_remux.h"
 
 extern void gnutv_data_start(int output_type,
 			   int ffaudiofd, int adapter_id, int demux_id, int buffer_size,
-			   char *outfile,
-			   char* outif, struct addrinfo *outaddrs, int usertp);
+			   char *outfile, struct gnutv_record_params *record_params,
+			   char* outif, struct addrinfo *outaddrs,
+			   struct gnutv_stream_params *stream_params,
+			   struct gnutv_remux_params *remux_params,
+			   int userfilter);
 extern void gnutv_data_stop(void);
 
 extern void gnutv_data_new_pat(int pmt_pid);
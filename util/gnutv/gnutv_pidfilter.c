@@ -0,0 +1,97 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2004, 2005 Manu Abraham <abraham.manu@gmail.com>
+	Copyright (C) 2006 Andrew de Quincey (adq_dvb@lidskialf.net)
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <libucsi/transport_packet.h>
+#include "gnutv_pidfilter.h"
+
+#define PIDFILTER_WORDS ((TRANSPORT_MAX_PIDS + 31) / 32)
+
+struct gnutv_pidfilter {
+	// held by the filtering thread for each buffer, and to swap in a new set
+	pthread_mutex_t lock;
+	uint32_t pids[PIDFILTER_WORDS];
+};
+
+struct gnutv_pidfilter *gnutv_pidfilter_create(void)
+{
+	struct gnutv_pidfilter *filter;
+
+	if ((filter = malloc(sizeof(struct gnutv_pidfilter))) == NULL)
+		return NULL;
+	memset(filter, 0, sizeof(struct gnutv_pidfilter));
+	pthread_mutex_init(&filter->lock, NULL);
+
+	return filter;
+}
+
+void gnutv_pidfilter_set(struct gnutv_pidfilter *filter, uint16_t *pids, int count)
+{
+	uint32_t next[PIDFILTER_WORDS];
+	int i;
+
+	// build the new set first so the filter is only held for the copy
+	memset(next, 0, sizeof(next));
+	for(i=0; i < count; i++) {
+		if (pids[i] < TRANSPORT_MAX_PIDS)
+			next[pids[i] >> 5] |= (uint32_t) 1 << (pids[i] & 31);
+	}
+
+	pthread_mutex_lock(&filter->lock);
+	memcpy(filter->pids, next, sizeof(next));
+	pthread_mutex_unlock(&filter->lock);
+}
+
+int gnutv_pidfilter_process(struct gnutv_pidfilter *filter, uint8_t *buf, int len)
+{
+	uint8_t *in = buf;
+	uint8_t *out = buf;
+	uint8_t *end = buf + len - (len % TRANSPORT_PACKET_LENGTH);
+	int pid;
+
+	pthread_mutex_lock(&filter->lock);
+	while(in < end) {
+		// the full stream filter delivers aligned packets: anything else is junk
+		if (in[0] == 0x47) {
+			pid = ((in[1] & 0x1f) << 8) | in[2];
+			if (filter->pids[pid >> 5] & ((uint32_t) 1 << (pid & 31))) {
+				// nothing has to move until a packet has been removed
+				if (out != in)
+					memcpy(out, in, TRANSPORT_PACKET_LENGTH);
+				out += TRANSPORT_PACKET_LENGTH;
+			}
+		}
+		in += TRANSPORT_PACKET_LENGTH;
+	}
+	pthread_mutex_unlock(&filter->lock);
+
+	return out - buf;
+}
+
+void gnutv_pidfilter_destroy(struct gnutv_pidfilter *filter)
+{
+	pthread_mutex_destroy(&filter->lock);
+	free(filter);
+}
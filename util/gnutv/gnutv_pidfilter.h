@@ -0,0 +1,61 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2004, 2005 Manu Abraham <abraham.manu@gmail.com>
+	Copyright (C) 2006 Andrew de Quincey (adq_dvb@lidskialf.net)
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_PIDFILTER_H
+#define gnutv_PIDFILTER_H 1
+
+#include <stdint.h>
+
+struct gnutv_pidfilter;
+
+/**
+ * A PID filter applied in userspace to the output of a single full transport
+ * stream demux filter, replacing a kernel filter per PID. Initially no PIDs
+ * are selected.
+ */
+extern struct gnutv_pidfilter *gnutv_pidfilter_create(void);
+
+/**
+ * Replace the set of selected PIDs. The new set takes effect as a whole
+ * between two buffers passed to gnutv_pidfilter_process(), so packets on PIDs
+ * common to the old and new sets are never lost. May be called from a thread
+ * other than the one filtering.
+ *
+ * @param pids The PIDs to select.
+ * @param count Number of PIDs.
+ */
+extern void gnutv_pidfilter_set(struct gnutv_pidfilter *filter, uint16_t *pids, int count);
+
+/**
+ * Filter a buffer of whole transport packets in place.
+ *
+ * @return Length of the buffer once the packets on unselected PIDs have been
+ * removed.
+ */
+extern int gnutv_pidfilter_process(struct gnutv_pidfilter *filter, uint8_t *buf, int len);
+
+/**
+ * Free the filter.
+ */
+extern void gnutv_pidfilter_destroy(struct gnutv_pidfilter *filter);
+
+#endif
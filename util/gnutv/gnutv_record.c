@@ -0,0 +1,364 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2004, 2005 Manu Abraham <abraham.manu@gmail.com>
+	Copyright (C) 2006 Andrew de Quincey (adq_dvb@lidskialf.net)
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE_SOURCE 1
+#define _LARGEFILE64_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "gnutv_record.h"
+
+// O_DIRECT requires buffers, offsets and lengths to be multiples of this
+#define RECORD_DIRECT_ALIGN 4096
+
+// most space handed to the reader in one go. The ring is followed by a spill
+// area of this size, so the space is always contiguous even across the wrap.
+#define RECORD_MAX_SPACE (1024 * 1024)
+
+// a partial chunk is written out if no full one has arrived for this long
+#define RECORD_FLUSH_MS 250
+
+// longest the writer sleeps before checking for shutdown
+#define RECORD_MAX_WAIT_MS 100
+
+struct gnutv_record_stats {
+	uint64_t bytes_written;
+	uint64_t ring_high_water;	// most bytes ever waiting in the ring
+	uint64_t ring_overflows;	// reads dropped because the ring was full
+	uint64_t ring_dropped_bytes;
+	uint64_t dvr_overflows;		// EOVERFLOW returned by the DVR device
+	uint64_t write_errors;
+};
+
+struct gnutv_record {
+	int outfd;
+	int direct_io;
+	uint8_t *ring;
+	uint64_t ring_size;
+	uint64_t write_size;
+	uint64_t prealloc_size;
+	uint64_t allocated;
+	uint64_t start_offset;	// file offset the recording starts at
+
+	// head is only written by the reader, tail only by the writer. Both
+	// count bytes since the start, so head - tail is the amount in the ring.
+	uint64_t head;
+	uint64_t tail;
+
+	int shutdown;
+	int writer_waiting;
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	struct gnutv_record_stats stats;
+};
+
+static void *gnutv_record_writer_func(void *arg);
+static uint64_t gnutv_record_write(struct gnutv_record *rec, uint64_t len);
+static uint64_t gnutv_record_now_ms(void);
+
+int gnutv_record_open(char *filename, struct gnutv_record_params *params)
+{
+	int flags = O_WRONLY|O_CREAT|O_LARGEFILE|O_TRUNC;
+	int fd;
+
+	if (params->direct_io)
+		flags |= O_DIRECT;
+	fd = open(filename, flags, 0644);
+	if ((fd < 0) && (errno == EINVAL) && params->direct_io) {
+		fprintf(stderr, "O_DIRECT not supported for output file, using buffered writes\n");
+		params->direct_io = 0;
+		fd = open(filename, flags & ~O_DIRECT, 0644);
+	}
+
+	return fd;
+}
+
+struct gnutv_record *gnutv_record_start(int outfd, struct gnutv_record_params *params)
+{
+	struct gnutv_record *rec;
+	void *ring;
+
+	// the write size must be aligned for O_DIRECT, and the ring a multiple
+	// of it so that full chunks never wrap
+	uint64_t write_size = params->write_size;
+	if (write_size < RECORD_DIRECT_ALIGN)
+		write_size = RECORD_DIRECT_ALIGN;
+	write_size -= write_size % RECORD_DIRECT_ALIGN;
+	uint64_t ring_size = params->ring_size;
+	if (ring_size < (write_size * 2))
+		ring_size = write_size * 2;
+	ring_size -= ring_size % write_size;
+
+	if ((rec = malloc(sizeof(struct gnutv_record))) == NULL)
+		return NULL;
+	memset(rec, 0, sizeof(struct gnutv_record));
+	if (posix_memalign(&ring, RECORD_DIRECT_ALIGN, ring_size + RECORD_MAX_SPACE)) {
+		free(rec);
+		return NULL;
+	}
+
+	rec->outfd = outfd;
+	rec->direct_io = params->direct_io;
+	rec->ring = ring;
+	rec->ring_size = ring_size;
+	rec->write_size = write_size;
+	if (params->prealloc_size > 0)
+		rec->prealloc_size = params->prealloc_size;
+
+	// preallocation and trimming work on file offsets, so they need to know
+	// where the recording starts. That is unknown if the output is appended
+	// to or cannot seek, e.g. a pipe, so don't preallocate at all then.
+	if (rec->prealloc_size) {
+		off_t pos = lseek(outfd, 0, SEEK_CUR);
+		int flags = fcntl(outfd, F_GETFL);
+		if ((pos == (off_t) -1) || (flags == -1) || (flags & O_APPEND))
+			rec->prealloc_size = 0;
+		else
+			rec->start_offset = pos;
+	}
+	pthread_mutex_init(&rec->lock, NULL);
+	pthread_cond_init(&rec->cond, NULL);
+
+	if (pthread_create(&rec->writer, NULL, gnutv_record_writer_func, rec)) {
+		pthread_cond_destroy(&rec->cond);
+		pthread_mutex_destroy(&rec->lock);
+		free(rec->ring);
+		free(rec);
+		return NULL;
+	}
+
+	return rec;
+}
+
+uint8_t *gnutv_record_get_space(struct gnutv_record *rec, int *len)
+{
+	uint64_t used = rec->head - __atomic_load_n(&rec->tail, __ATOMIC_ACQUIRE);
+	uint64_t offset = rec->head % rec->ring_size;
+	uint64_t space = rec->ring_size - used;
+
+	if (space == 0)
+		return NULL;
+	if (space > RECORD_MAX_SPACE)
+		space = RECORD_MAX_SPACE;
+
+	*len = space;
+	return rec->ring + offset;
+}
+
+void gnutv_record_commit(struct gnutv_record *rec, int len)
+{
+	uint64_t offset = rec->head % rec->ring_size;
+	uint64_t used;
+
+	// move anything which went into the spill area round to the start
+	if ((offset + len) > rec->ring_size)
+		memcpy(rec->ring, rec->ring + rec->ring_size, offset + len - rec->ring_size);
+
+	// publish the data, then check whether the writer needs waking. Both are
+	// sequentially consistent, pairing with the writer setting writer_waiting
+	// and then rechecking head, so a wakeup is never missed.
+	__atomic_store_n(&rec->head, rec->head + len, __ATOMIC_SEQ_CST);
+
+	used = rec->head - __atomic_load_n(&rec->tail, __ATOMIC_ACQUIRE);
+	if (used > rec->stats.ring_high_water)
+		rec->stats.ring_high_water = used;
+
+	if ((used >= rec->write_size) &&
+	    __atomic_load_n(&rec->writer_waiting, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&rec->lock);
+		pthread_cond_signal(&rec->cond);
+		pthread_mutex_unlock(&rec->lock);
+	}
+}
+
+void gnutv_record_drop(struct gnutv_record *rec, int len)
+{
+	rec->stats.ring_overflows++;
+	rec->stats.ring_dropped_bytes += len;
+}
+
+void gnutv_record_dvr_overflow(struct gnutv_record *rec)
+{
+	rec->stats.dvr_overflows++;
+}
+
+void gnutv_record_stop(struct gnutv_record *rec)
+{
+	pthread_mutex_lock(&rec->lock);
+	__atomic_store_n(&rec->shutdown, 1, __ATOMIC_SEQ_CST);
+	pthread_cond_signal(&rec->cond);
+	pthread_mutex_unlock(&rec->lock);
+	pthread_join(rec->writer, NULL);
+
+	// release any space preallocated beyond the end of the recording
+	if (rec->allocated > rec->stats.bytes_written) {
+		if (ftruncate(rec->outfd, rec->start_offset + rec->stats.bytes_written))
+			fprintf(stderr, "Failed to release preallocated space: %m\n");
+	}
+
+	fprintf(stderr, "Recorder: %llu bytes written, ring high water %llu/%llu bytes\n",
+		(unsigned long long) rec->stats.bytes_written,
+		(unsigned long long) rec->stats.ring_high_water,
+		(unsigned long long) rec->ring_size);
+	if (rec->stats.ring_overflows || rec->stats.dvr_overflows || rec->stats.write_errors)
+		fprintf(stderr, "Recorder: %llu ring overflows (%llu bytes dropped), %llu DVR overflows, %llu write errors\n",
+			(unsigned long long) rec->stats.ring_overflows,
+			(unsigned long long) rec->stats.ring_dropped_bytes,
+			(unsigned long long) rec->stats.dvr_overflows,
+			(unsigned long long) rec->stats.write_errors);
+
+	pthread_cond_destroy(&rec->cond);
+	pthread_mutex_destroy(&rec->lock);
+	free(rec->ring);
+	free(rec);
+}
+
+static void *gnutv_record_writer_func(void *arg)
+{
+	struct gnutv_record *rec = arg;
+	uint64_t last_write = gnutv_record_now_ms();
+
+	while(1) {
+		uint64_t used = __atomic_load_n(&rec->head, __ATOMIC_ACQUIRE) - rec->tail;
+		int shutdown = __atomic_load_n(&rec->shutdown, __ATOMIC_ACQUIRE);
+
+		if (used >= rec->write_size) {
+			gnutv_record_write(rec, rec->write_size);
+			last_write = gnutv_record_now_ms();
+			continue;
+		}
+		if (shutdown)
+			break;
+
+		// trickle out a partial chunk if the stream is slow, so output to
+		// pipes and low bitrate recordings does not lag too far behind
+		if (used && ((gnutv_record_now_ms() - last_write) >= RECORD_FLUSH_MS)) {
+			if (rec->direct_io)
+				used -= used % RECORD_DIRECT_ALIGN;
+			if (used) {
+				gnutv_record_write(rec, used);
+				last_write = gnutv_record_now_ms();
+				continue;
+			}
+		}
+
+		// sleep until the reader has a full chunk for us
+		struct timeval now;
+		struct timespec abstime;
+		gettimeofday(&now, NULL);
+		abstime.tv_sec = now.tv_sec;
+		abstime.tv_nsec = (now.tv_usec * 1000) + (RECORD_MAX_WAIT_MS * 1000000);
+		if (abstime.tv_nsec >= 1000000000) {
+			abstime.tv_sec++;
+			abstime.tv_nsec -= 1000000000;
+		}
+
+		pthread_mutex_lock(&rec->lock);
+		__atomic_store_n(&rec->writer_waiting, 1, __ATOMIC_SEQ_CST);
+		used = __atomic_load_n(&rec->head, __ATOMIC_SEQ_CST) - rec->tail;
+		if ((used < rec->write_size) && !__atomic_load_n(&rec->shutdown, __ATOMIC_ACQUIRE))
+			pthread_cond_timedwait(&rec->cond, &rec->lock, &abstime);
+		__atomic_store_n(&rec->writer_waiting, 0, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&rec->lock);
+	}
+
+	// the tail of the recording is unlikely to be aligned
+	if (rec->direct_io) {
+		fcntl(rec->outfd, F_SETFL, fcntl(rec->outfd, F_GETFL) & ~O_DIRECT);
+		rec->direct_io = 0;
+	}
+	uint64_t used = rec->head - rec->tail;
+	while(used) {
+		uint64_t len = rec->write_size;
+		if (len > used)
+			len = used;
+		used -= gnutv_record_write(rec, len);
+	}
+
+	return 0;
+}
+
+static uint64_t gnutv_record_write(struct gnutv_record *rec, uint64_t len)
+{
+	uint64_t offset = rec->tail % rec->ring_size;
+	uint64_t written = 0;
+
+	// full chunks never wrap, but partial ones may
+	if (len > (rec->ring_size - offset))
+		len = rec->ring_size - offset;
+
+	// keep the file allocated ahead of the writes, so the filesystem can lay
+	// it out contiguously and does not have to allocate on every write
+	if (rec->prealloc_size &&
+	    ((rec->stats.bytes_written + len) > rec->allocated)) {
+		if (fallocate(rec->outfd, FALLOC_FL_KEEP_SIZE,
+			      rec->start_offset + rec->stats.bytes_written,
+			      len + rec->prealloc_size) == 0) {
+			rec->allocated = rec->stats.bytes_written + len + rec->prealloc_size;
+		} else {
+			// not supported by the output (e.g. a pipe) - don't try again
+			rec->prealloc_size = 0;
+		}
+	}
+
+	while(written < len) {
+		ssize_t tmp = write(rec->outfd, rec->ring + offset + written, len - written);
+		if (tmp == -1) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EINVAL) && rec->direct_io) {
+				// the filesystem accepted O_DIRECT on open, but not the write
+				fprintf(stderr, "O_DIRECT write failed, falling back to buffered writes\n");
+				fcntl(rec->outfd, F_SETFL, fcntl(rec->outfd, F_GETFL) & ~O_DIRECT);
+				rec->direct_io = 0;
+				continue;
+			}
+			fprintf(stderr, "Write error: %m\n");
+			rec->stats.write_errors++;
+			break;
+		}
+		written += tmp;
+		rec->stats.bytes_written += tmp;
+	}
+
+	__atomic_store_n(&rec->tail, rec->tail + len, __ATOMIC_RELEASE);
+	return len;
+}
+
+static uint64_t gnutv_record_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
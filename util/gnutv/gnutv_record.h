@@ -0,0 +1,92 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2004, 2005 Manu Abraham <abraham.manu@gmail.com>
+	Copyright (C) 2006 Andrew de Quincey (adq_dvb@lidskialf.net)
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_RECORD_H
+#define gnutv_RECORD_H 1
+
+#include <stdint.h>
+
+#define GNUTV_RECORD_DEFAULT_RING_SIZE (32 * 1024 * 1024)
+#define GNUTV_RECORD_DEFAULT_WRITE_SIZE (1024 * 1024)
+
+struct gnutv_record_params {
+	int ring_size;		// size of the ring buffer in bytes
+	int write_size;		// size of each write in bytes
+	int direct_io;		// if 1, write with O_DIRECT
+	int prealloc_size;	// preallocate the file this far ahead of the writes (0 => never,
+				// also ignored if the output is appended to or cannot seek)
+};
+
+struct gnutv_record;
+
+/**
+ * Open a file for recording to, using O_DIRECT if requested and supported.
+ * If O_DIRECT is not supported, params->direct_io is cleared.
+ *
+ * @return The file descriptor, or -1 on failure.
+ */
+extern int gnutv_record_open(char *filename, struct gnutv_record_params *params);
+
+/**
+ * The recorder decouples reading the DVR device from writing the output. The
+ * reader deposits data directly into a ring buffer, and a separate writer
+ * thread drains it in large aligned chunks, so a stall on the output only
+ * fills the ring rather than overflowing the DVR buffer.
+ *
+ * The ring is single producer/single consumer: gnutv_record_get_space(),
+ * gnutv_record_commit() and gnutv_record_drop() must all be called from the
+ * same thread.
+ */
+extern struct gnutv_record *gnutv_record_start(int outfd, struct gnutv_record_params *params);
+
+/**
+ * Get the free space at the head of the ring. It is always contiguous, but
+ * may be limited to less than the total free space for very large rings.
+ *
+ * @param len Set to the number of bytes available.
+ * @return Pointer to the free space, or NULL if the ring is full.
+ */
+extern uint8_t *gnutv_record_get_space(struct gnutv_record *rec, int *len);
+
+/**
+ * Hand len bytes written to the space returned by gnutv_record_get_space()
+ * over to the writer thread.
+ */
+extern void gnutv_record_commit(struct gnutv_record *rec, int len);
+
+/**
+ * Account for len bytes which were discarded because the ring was full.
+ */
+extern void gnutv_record_drop(struct gnutv_record *rec, int len);
+
+/**
+ * Account for an overflow of the DVR device.
+ */
+extern void gnutv_record_dvr_overflow(struct gnutv_record *rec);
+
+/**
+ * Write out everything remaining in the ring, stop the writer thread, print
+ * the statistics to stderr and free the recorder.
+ */
+extern void gnutv_record_stop(struct gnutv_record *rec);
+
+#endif
@@ -0,0 +1,481 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2004, 2005 Manu Abraham <abraham.manu@gmail.com>
+	Copyright (C) 2006 Andrew de Quincey (adq_dvb@lidskialf.net)
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE_SOURCE 1
+#define _LARGEFILE64_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <libucsi/crc32.h>
+#include <libucsi/section.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/transport_demux.h>
+#include "gnutv_remux.h"
+
+// PAT and PMT sections are limited to this size
+#define REMUX_MAX_SECTION_SIZE 1024
+
+// size of the single programme PAT section generated for each output
+#define REMUX_PAT_SIZE 16
+
+struct remux_output {
+	int index;
+	uint16_t service_id;
+	int pmt_pid;
+	int pmt_version;
+	int outfd;
+	struct gnutv_record *recorder;
+	uint64_t packets;
+
+	// space obtained from the recorder but not yet committed
+	uint8_t *wbuf;
+	int wlen;
+	int wused;
+
+	int pat_version;
+	uint8_t pat[REMUX_PAT_SIZE];
+
+	// continuity counters of the PAT/PMT packets built here
+	uint8_t cc[TRANSPORT_MAX_PIDS];
+};
+
+struct gnutv_remux {
+	struct gnutv_remux_params params;
+	struct transport_demux *demux;
+	int transport_stream_id;
+
+	struct remux_output *outputs[GNUTV_REMUX_MAX_SERVICES];
+	int output_count;
+	int output_limit_warned;
+
+	// for each PID, a bit per output the packets are routed to
+	uint32_t pid_outputs[TRANSPORT_MAX_PIDS];
+
+	// PIDs on which PMT sections are being reassembled
+	uint8_t pmt_pids[TRANSPORT_MAX_PIDS];
+};
+
+static void remux_pat_callback(void *arg, int pid, uint8_t *data, int len);
+static void remux_pmt_callback(void *arg, int pid, uint8_t *data, int len);
+static void remux_update_pmt_pids(struct gnutv_remux *remux);
+static void remux_route_pmt(struct gnutv_remux *remux, struct remux_output *output,
+			    struct mpeg_pmt_section *pmt);
+static struct remux_output *remux_find_output(struct gnutv_remux *remux, uint16_t service_id);
+static struct remux_output *remux_create_output(struct gnutv_remux *remux, uint16_t service_id);
+static void remux_build_pat(struct gnutv_remux *remux, struct remux_output *output);
+static uint8_t *remux_output_space(struct remux_output *output);
+static void remux_output_packet(struct remux_output *output, uint8_t *pkt);
+static void remux_output_section(struct remux_output *output, int pid, uint8_t *section, int len);
+static void remux_output_flush(struct remux_output *output);
+
+struct gnutv_remux *gnutv_remux_create(struct gnutv_remux_params *params)
+{
+	struct gnutv_remux *remux;
+
+	if ((remux = malloc(sizeof(struct gnutv_remux))) == NULL)
+		return NULL;
+	memset(remux, 0, sizeof(struct gnutv_remux));
+	memcpy(&remux->params, params, sizeof(struct gnutv_remux_params));
+	remux->transport_stream_id = -1;
+
+	if ((remux->demux = transport_demux_create(NULL, NULL)) == NULL) {
+		free(remux);
+		return NULL;
+	}
+	if (transport_demux_set_section_pid(remux->demux, TRANSPORT_PAT_PID, REMUX_MAX_SECTION_SIZE,
+					    remux_pat_callback, remux)) {
+		transport_demux_destroy(remux->demux);
+		free(remux);
+		return NULL;
+	}
+
+	return remux;
+}
+
+int gnutv_remux_feed(struct gnutv_remux *remux, uint8_t *buf, int len)
+{
+	int pos = 0;
+	int i;
+
+	while((len - pos) >= TRANSPORT_PACKET_LENGTH) {
+		uint8_t *pkt = buf + pos;
+		int pid;
+
+		if (pkt[0] != TRANSPORT_PACKET_SYNC) {
+			pos++;
+			continue;
+		}
+		pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+
+		if ((pid == TRANSPORT_PAT_PID) || remux->pmt_pids[pid]) {
+			// the outputs get their own PAT and PMT, generated as the
+			// sections arrive
+			transport_demux_feed(remux->demux, pkt, TRANSPORT_PACKET_LENGTH);
+		} else {
+			uint32_t outputs = remux->pid_outputs[pid];
+			while(outputs) {
+				i = __builtin_ctz(outputs);
+				outputs &= outputs - 1;
+				remux_output_packet(remux->outputs[i], pkt);
+			}
+		}
+
+		pos += TRANSPORT_PACKET_LENGTH;
+	}
+
+	for(i=0; i < remux->output_count; i++)
+		remux_output_flush(remux->outputs[i]);
+
+	return pos;
+}
+
+void gnutv_remux_destroy(struct gnutv_remux *remux)
+{
+	int i;
+
+	for(i=0; i < remux->output_count; i++) {
+		struct remux_output *output = remux->outputs[i];
+
+		remux_output_flush(output);
+		fprintf(stderr, "Service %i: %llu packets\n", output->service_id,
+			(unsigned long long) output->packets);
+		gnutv_record_stop(output->recorder);
+		close(output->outfd);
+		free(output);
+	}
+
+	transport_demux_destroy(remux->demux);
+	free(remux);
+}
+
+int gnutv_remux_check_pattern(char *pattern)
+{
+	char *tmp = strchr(pattern, '%');
+
+	// exactly one %i (or %d), and nothing else printf would interpret
+	if ((tmp == NULL) || ((tmp[1] != 'i') && (tmp[1] != 'd')))
+		return -1;
+	if (strchr(tmp + 1, '%') != NULL)
+		return -1;
+
+	return 0;
+}
+
+static void remux_pat_callback(void *arg, int pid, uint8_t *data, int len)
+{
+	struct gnutv_remux *remux = (struct gnutv_remux *) arg;
+	struct mpeg_pat_program *cur_program;
+	struct remux_output *output;
+	int i;
+	(void) pid;
+
+	struct section *section = section_codec(data, len);
+	if (section == NULL)
+		return;
+	struct section_ext *section_ext = section_ext_decode(section, 1);
+	if (section_ext == NULL)
+		return;
+	struct mpeg_pat_section *pat = mpeg_pat_section_codec(section_ext);
+	if (pat == NULL)
+		return;
+
+	// a change of transport_stream_id changes every output's PAT
+	if (section_ext->table_id_ext != remux->transport_stream_id) {
+		remux->transport_stream_id = section_ext->table_id_ext;
+		for(i=0; i < remux->output_count; i++) {
+			if (remux->outputs[i]->pmt_pid != -1)
+				remux_build_pat(remux, remux->outputs[i]);
+		}
+	}
+
+	// find the services, and any changes to their PMT PIDs. This is cheap
+	// enough to do on every PAT, which also copes with multi-section PATs.
+	mpeg_pat_section_programs_for_each(pat, cur_program) {
+		if (cur_program->program_number == 0)
+			continue;
+
+		output = remux_find_output(remux, cur_program->program_number);
+		if (output == NULL)
+			output = remux_create_output(remux, cur_program->program_number);
+		if ((output == NULL) || (output->pmt_pid == cur_program->pid))
+			continue;
+
+		output->pmt_pid = cur_program->pid;
+		output->pmt_version = -1;
+		remux_build_pat(remux, output);
+		remux_update_pmt_pids(remux);
+	}
+
+	// each output gets its PAT at the same rate as the original, once per
+	// cycle of a multi-section PAT
+	if (section_ext->section_number != 0)
+		return;
+	for(i=0; i < remux->output_count; i++) {
+		output = remux->outputs[i];
+		if (output->pmt_pid != -1)
+			remux_output_section(output, TRANSPORT_PAT_PID, output->pat, REMUX_PAT_SIZE);
+	}
+}
+
+static void remux_pmt_callback(void *arg, int pid, uint8_t *data, int len)
+{
+	struct gnutv_remux *remux = (struct gnutv_remux *) arg;
+	struct remux_output *output;
+	uint8_t raw[REMUX_MAX_SECTION_SIZE];
+
+	// parsing happens in place, so keep the section as transmitted
+	if (len > REMUX_MAX_SECTION_SIZE)
+		return;
+	memcpy(raw, data, len);
+
+	struct section *section = section_codec(data, len);
+	if ((section == NULL) || (section->table_id != stag_mpeg_program_map))
+		return;
+	struct section_ext *section_ext = section_ext_decode(section, 1);
+	if (section_ext == NULL)
+		return;
+	struct mpeg_pmt_section *pmt = mpeg_pmt_section_codec(section_ext);
+	if (pmt == NULL)
+		return;
+
+	// several services may share a PMT PID; only pass each its own
+	output = remux_find_output(remux, section_ext->table_id_ext);
+	if ((output == NULL) || (output->pmt_pid != pid))
+		return;
+
+	if (section_ext->version_number != output->pmt_version) {
+		remux_route_pmt(remux, output, pmt);
+		output->pmt_version = section_ext->version_number;
+	}
+
+	remux_output_section(output, pid, raw, len);
+}
+
+static void remux_update_pmt_pids(struct gnutv_remux *remux)
+{
+	uint8_t wanted[TRANSPORT_MAX_PIDS];
+	int pid;
+	int i;
+
+	memset(wanted, 0, sizeof(wanted));
+	for(i=0; i < remux->output_count; i++) {
+		if (remux->outputs[i]->pmt_pid != -1)
+			wanted[remux->outputs[i]->pmt_pid] = 1;
+	}
+
+	for(pid=0; pid < TRANSPORT_MAX_PIDS; pid++) {
+		if (pid == TRANSPORT_PAT_PID)
+			continue;
+		if (wanted[pid] && !remux->pmt_pids[pid]) {
+			if (transport_demux_set_section_pid(remux->demux, pid, REMUX_MAX_SECTION_SIZE,
+							    remux_pmt_callback, remux) == 0)
+				remux->pmt_pids[pid] = 1;
+		} else if (!wanted[pid] && remux->pmt_pids[pid]) {
+			transport_demux_clear_pid(remux->demux, pid);
+			remux->pmt_pids[pid] = 0;
+		}
+	}
+}
+
+static void remux_route_pmt(struct gnutv_remux *remux, struct remux_output *output,
+			    struct mpeg_pmt_section *pmt)
+{
+	struct mpeg_pmt_stream *cur_stream;
+	uint32_t bit = (uint32_t) 1 << output->index;
+	int pid;
+
+	for(pid=0; pid < TRANSPORT_MAX_PIDS; pid++)
+		remux->pid_outputs[pid] &= ~bit;
+
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		remux->pid_outputs[cur_stream->pid] |= bit;
+	}
+	if (pmt->pcr_pid != 0x1fff)
+		remux->pid_outputs[pmt->pcr_pid] |= bit;
+}
+
+static struct remux_output *remux_find_output(struct gnutv_remux *remux, uint16_t service_id)
+{
+	int i;
+
+	for(i=0; i < remux->output_count; i++) {
+		if (remux->outputs[i]->service_id == service_id)
+			return remux->outputs[i];
+	}
+
+	return NULL;
+}
+
+static struct remux_output *remux_create_output(struct gnutv_remux *remux, uint16_t service_id)
+{
+	struct remux_output *output;
+	char filename[PATH_MAX];
+	int i;
+
+	// is it one of the services we're after?
+	if (remux->params.service_count) {
+		for(i=0; i < remux->params.service_count; i++) {
+			if (remux->params.service_ids[i] == service_id)
+				break;
+		}
+		if (i == remux->params.service_count)
+			return NULL;
+	}
+
+	if (remux->output_count == GNUTV_REMUX_MAX_SERVICES) {
+		if (!remux->output_limit_warned) {
+			fprintf(stderr, "Too many services, only recording the first %i\n",
+				GNUTV_REMUX_MAX_SERVICES);
+			remux->output_limit_warned = 1;
+		}
+		return NULL;
+	}
+
+	if ((output = malloc(sizeof(struct remux_output))) == NULL)
+		return NULL;
+	memset(output, 0, sizeof(struct remux_output));
+	output->index = remux->output_count;
+	output->service_id = service_id;
+	output->pmt_pid = -1;
+	output->pmt_version = -1;
+	output->pat_version = -1;
+
+	snprintf(filename, sizeof(filename), remux->params.pattern, service_id);
+	if ((output->outfd = gnutv_record_open(filename, remux->params.record_params)) < 0) {
+		fprintf(stderr, "Failed to open output file %s\n", filename);
+		free(output);
+		return NULL;
+	}
+	if ((output->recorder = gnutv_record_start(output->outfd, remux->params.record_params)) == NULL) {
+		fprintf(stderr, "Failed to start recorder for %s\n", filename);
+		close(output->outfd);
+		free(output);
+		return NULL;
+	}
+	fprintf(stderr, "Recording service %i to %s\n", service_id, filename);
+
+	remux->outputs[remux->output_count++] = output;
+	return output;
+}
+
+static void remux_build_pat(struct gnutv_remux *remux, struct remux_output *output)
+{
+	uint8_t *pat = output->pat;
+	uint32_t crc;
+
+	output->pat_version = (output->pat_version + 1) & 0x1f;
+
+	pat[0] = stag_mpeg_program_association;
+	pat[1] = 0xb0;
+	pat[2] = REMUX_PAT_SIZE - 3;
+	pat[3] = remux->transport_stream_id >> 8;
+	pat[4] = remux->transport_stream_id;
+	pat[5] = 0xc1 | (output->pat_version << 1);
+	pat[6] = 0;
+	pat[7] = 0;
+	pat[8] = output->service_id >> 8;
+	pat[9] = output->service_id;
+	pat[10] = 0xe0 | (output->pmt_pid >> 8);
+	pat[11] = output->pmt_pid;
+
+	crc = crc32(CRC32_INIT, pat, REMUX_PAT_SIZE - 4);
+	pat[12] = crc >> 24;
+	pat[13] = crc >> 16;
+	pat[14] = crc >> 8;
+	pat[15] = crc;
+}
+
+static uint8_t *remux_output_space(struct remux_output *output)
+{
+	uint8_t *space;
+
+	if ((output->wused + TRANSPORT_PACKET_LENGTH) > output->wlen) {
+		remux_output_flush(output);
+		output->wbuf = gnutv_record_get_space(output->recorder, &output->wlen);
+		if ((output->wbuf == NULL) || (output->wlen < TRANSPORT_PACKET_LENGTH)) {
+			output->wbuf = NULL;
+			output->wlen = 0;
+			gnutv_record_drop(output->recorder, TRANSPORT_PACKET_LENGTH);
+			return NULL;
+		}
+	}
+
+	space = output->wbuf + output->wused;
+	output->wused += TRANSPORT_PACKET_LENGTH;
+	output->packets++;
+	return space;
+}
+
+static void remux_output_packet(struct remux_output *output, uint8_t *pkt)
+{
+	uint8_t *dst;
+
+	// elementary stream packets go out untouched, so that their continuity
+	// counters still show anything lost on the way in
+	if ((dst = remux_output_space(output)) == NULL)
+		return;
+	memcpy(dst, pkt, TRANSPORT_PACKET_LENGTH);
+}
+
+static void remux_output_section(struct remux_output *output, int pid, uint8_t *section, int len)
+{
+	int pos = 0;
+	int offset;
+	int count;
+
+	while(pos < len) {
+		uint8_t *dst = remux_output_space(output);
+		if (dst == NULL)
+			return;
+
+		output->cc[pid] = (output->cc[pid] + 1) & 0x0f;
+		dst[0] = TRANSPORT_PACKET_SYNC;
+		dst[1] = ((pos == 0) ? 0x40 : 0) | (pid >> 8);
+		dst[2] = pid;
+		dst[3] = 0x10 | output->cc[pid];
+		offset = 4;
+		if (pos == 0)
+			dst[offset++] = 0; // pointer_field
+
+		count = TRANSPORT_PACKET_LENGTH - offset;
+		if (count > (len - pos))
+			count = len - pos;
+		memcpy(dst + offset, section + pos, count);
+		memset(dst + offset + count, 0xff, TRANSPORT_PACKET_LENGTH - offset - count);
+		pos += count;
+	}
+}
+
+static void remux_output_flush(struct remux_output *output)
+{
+	// the rest of the space must be fetched again after a commit, since it
+	// may have been in the recorder's spill area
+	if (output->wused)
+		gnutv_record_commit(output->recorder, output->wused);
+	output->wbuf = NULL;
+	output->wlen = 0;
+	output->wused = 0;
+}
@@ -0,0 +1,73 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2004, 2005 Manu Abraham <abraham.manu@gmail.com>
+	Copyright (C) 2006 Andrew de Quincey (adq_dvb@lidskialf.net)
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_REMUX_H
+#define gnutv_REMUX_H 1
+
+#include <stdint.h>
+#include "gnutv_record.h"
+
+#define GNUTV_REMUX_MAX_SERVICES 32
+
+// smaller than for a single recording, as there is one ring per service
+#define GNUTV_REMUX_DEFAULT_RING_SIZE (4 * 1024 * 1024)
+
+struct gnutv_remux_params {
+	char *pattern;		// output filename, with %i replaced by the service id
+	int service_count;	// 0 => every service in the PAT
+	uint16_t service_ids[GNUTV_REMUX_MAX_SERVICES];
+	struct gnutv_record_params *record_params;
+};
+
+struct gnutv_remux;
+
+/**
+ * The remuxer splits a full transport stream into a single programme
+ * transport stream per service, each written to its own file through a
+ * recorder. It follows the PAT and PMTs in the stream itself: each output gets
+ * a PAT listing only its service and only its own PMT sections, and the
+ * packets of its elementary streams are routed to it through a PID lookup
+ * table. Continuity counters are regenerated per output.
+ */
+extern struct gnutv_remux *gnutv_remux_create(struct gnutv_remux_params *params);
+
+/**
+ * Process a buffer of transport packets.
+ *
+ * @return Number of bytes consumed. Any trailing partial packet is not, and
+ * should be passed again with the next buffer.
+ */
+extern int gnutv_remux_feed(struct gnutv_remux *remux, uint8_t *buf, int len);
+
+/**
+ * Stop all the outputs, printing their statistics, and free the remuxer.
+ */
+extern void gnutv_remux_destroy(struct gnutv_remux *remux);
+
+/**
+ * Check an output filename pattern is usable.
+ *
+ * @return 0 if so, nonzero if not.
+ */
+extern int gnutv_remux_check_pattern(char *pattern);
+
+#endif
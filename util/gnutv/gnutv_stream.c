@@ -0,0 +1,386 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2004, 2005 Manu Abraham <abraham.manu@gmail.com>
+	Copyright (C) 2006 Andrew de Quincey (adq_dvb@lidskialf.net)
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <libucsi/transport_packet.h>
+#include "gnutv_stream.h"
+
+#define TS_PACKETS_PER_DATAGRAM 7
+#define TS_PAYLOAD_SIZE (TRANSPORT_PACKET_LENGTH * TS_PACKETS_PER_DATAGRAM)
+#define RTP_HEADER_SIZE 12
+
+// buffer size, in datagrams
+#define STREAM_BUFFER_DATAGRAMS 2048
+
+// most datagrams passed to one sendmmsg()
+#define STREAM_BATCH 64
+
+// when pacing, how long datagrams are held back to absorb bursts from the DVR
+#define STREAM_PACE_DELAY_MS 200
+
+// datagrams due this soon are sent in the same batch
+#define STREAM_PACE_SLACK_NS 1000000ULL
+
+// if pacing falls further behind than this, it is restarted
+#define STREAM_PACE_MAX_LAG_NS 500000000ULL
+
+// a PCR PID which has been silent this long is abandoned for another
+#define STREAM_PCR_TIMEOUT_NS 1000000000ULL
+
+#define PCR_HZ 27000000ULL
+#define PCR_WRAP ((1ULL << 33) * 300)
+
+// a larger jump between PCRs is treated as a discontinuity
+#define PCR_MAX_GAP PCR_HZ
+
+struct gnutv_stream {
+	int outfd;
+	struct addrinfo *outaddr;
+	int usertp;
+	int pace;
+	uint16_t rtpseq;
+	uint32_t ssrc;
+	uint32_t rtp_offset;
+
+	// [start, end) holds the queued data. Complete datagrams begin at start,
+	// followed by the packets of the datagram still being filled.
+	uint8_t *buf;
+	int buf_size;
+	int start;
+	int end;
+	int scanned;
+	int packets;
+
+	// the time of each complete datagram on the stream timeline, oldest first
+	uint64_t times[STREAM_BUFFER_DATAGRAMS];
+	int times_head;
+	int datagrams;
+
+	// the stream timeline is the PCR, in 27MHz ticks, unwrapped and with
+	// discontinuities removed. Between PCRs it is interpolated by byte position.
+	int pcr_pid;
+	int have_pcr;
+	uint64_t last_pcr;
+	uint64_t last_pcr_clock;
+	uint64_t timeline;
+	uint64_t bytes;
+	uint64_t pcr_bytes;
+	uint64_t rate_ticks;
+	uint64_t rate_bytes;
+	uint64_t start_clock;
+
+	// pacing maps the timeline onto the clock
+	int catchup;
+	int anchored;
+	uint64_t anchor_time;
+	uint64_t anchor_clock;
+
+	struct mmsghdr msgs[STREAM_BATCH];
+	struct iovec iov[STREAM_BATCH][2];
+	uint8_t rtp[STREAM_BATCH][RTP_HEADER_SIZE];
+};
+
+static void gnutv_stream_packet(struct gnutv_stream *stream, uint8_t *pkt);
+static uint64_t gnutv_stream_time(struct gnutv_stream *stream);
+static int gnutv_stream_sendmmsg(struct gnutv_stream *stream, int count);
+static void gnutv_stream_rtp_header(struct gnutv_stream *stream, uint8_t *hdr,
+				    uint16_t seq, uint64_t time);
+static uint64_t gnutv_stream_clock(void);
+
+struct gnutv_stream *gnutv_stream_create(int outfd, struct addrinfo *outaddr,
+					 struct gnutv_stream_params *params)
+{
+	struct gnutv_stream *stream;
+	int sndbuf;
+	int i;
+
+	if ((stream = malloc(sizeof(struct gnutv_stream))) == NULL)
+		return NULL;
+	memset(stream, 0, sizeof(struct gnutv_stream));
+	stream->buf_size = STREAM_BUFFER_DATAGRAMS * TS_PAYLOAD_SIZE;
+	if ((stream->buf = malloc(stream->buf_size)) == NULL) {
+		free(stream);
+		return NULL;
+	}
+
+	stream->outfd = outfd;
+	stream->outaddr = outaddr;
+	stream->usertp = params->usertp;
+	stream->pace = params->pace;
+	stream->pcr_pid = -1;
+	stream->start_clock = gnutv_stream_clock();
+
+	srandom(time(NULL));
+	stream->ssrc = random();
+	stream->rtpseq = random();
+	stream->rtp_offset = random();
+
+	// make room in the socket for a whole batch
+	sndbuf = STREAM_BATCH * (RTP_HEADER_SIZE + TS_PAYLOAD_SIZE) * 2;
+	setsockopt(outfd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+	for(i=0; i < STREAM_BATCH; i++) {
+		stream->msgs[i].msg_hdr.msg_name = outaddr->ai_addr;
+		stream->msgs[i].msg_hdr.msg_namelen = outaddr->ai_addrlen;
+		stream->msgs[i].msg_hdr.msg_iov = stream->iov[i];
+		if (stream->usertp) {
+			stream->iov[i][0].iov_base = stream->rtp[i];
+			stream->iov[i][0].iov_len = RTP_HEADER_SIZE;
+			stream->msgs[i].msg_hdr.msg_iovlen = 2;
+		} else {
+			stream->msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+	}
+
+	return stream;
+}
+
+uint8_t *gnutv_stream_get_space(struct gnutv_stream *stream, int *len)
+{
+	// move the queued data back to the start as the end approaches
+	if ((stream->start >= (stream->buf_size / 4)) &&
+	    ((stream->buf_size - stream->end) < (stream->buf_size / 4))) {
+		memmove(stream->buf, stream->buf + stream->start, stream->end - stream->start);
+		stream->end -= stream->start;
+		stream->scanned -= stream->start;
+		stream->start = 0;
+	}
+
+	if (stream->end == stream->buf_size)
+		return NULL;
+
+	*len = stream->buf_size - stream->end;
+	return stream->buf + stream->end;
+}
+
+void gnutv_stream_commit(struct gnutv_stream *stream, int len)
+{
+	stream->end += len;
+
+	while((stream->end - stream->scanned) >= TRANSPORT_PACKET_LENGTH) {
+		uint8_t *pkt = stream->buf + stream->scanned;
+
+		gnutv_stream_packet(stream, pkt);
+
+		// a datagram is stamped with the time of its first packet
+		if (stream->packets == 0) {
+			int idx = (stream->times_head + stream->datagrams) % STREAM_BUFFER_DATAGRAMS;
+			stream->times[idx] = gnutv_stream_time(stream);
+		}
+		if (++stream->packets == TS_PACKETS_PER_DATAGRAM) {
+			stream->datagrams++;
+			stream->packets = 0;
+		}
+
+		stream->scanned += TRANSPORT_PACKET_LENGTH;
+		stream->bytes += TRANSPORT_PACKET_LENGTH;
+	}
+}
+
+int gnutv_stream_send(struct gnutv_stream *stream)
+{
+	uint64_t now = gnutv_stream_clock();
+	uint64_t due = 0;
+
+	// if the buffer is filling up the stream is arriving faster than its
+	// PCR says it should, so send without pacing until it has drained
+	if ((stream->end - stream->start) > (stream->buf_size / 2))
+		stream->catchup = 1;
+	else if (stream->catchup && ((stream->end - stream->start) < (stream->buf_size / 4))) {
+		stream->catchup = 0;
+		stream->anchored = 0;
+	}
+
+	while(stream->datagrams) {
+		int count = 0;
+		while((count < STREAM_BATCH) && (count < stream->datagrams)) {
+			uint64_t time = stream->times[(stream->times_head + count) % STREAM_BUFFER_DATAGRAMS];
+
+			if (stream->pace && !stream->catchup) {
+				if (!stream->anchored || (time < stream->anchor_time)) {
+					stream->anchor_time = time;
+					stream->anchor_clock = now + (STREAM_PACE_DELAY_MS * 1000000ULL);
+					stream->anchored = 1;
+				}
+				due = stream->anchor_clock +
+					(((time - stream->anchor_time) * 1000) / (PCR_HZ / 1000000));
+				if ((due + STREAM_PACE_MAX_LAG_NS) < now) {
+					stream->anchored = 0;
+					continue;
+				}
+				if (due > (now + STREAM_PACE_SLACK_NS))
+					break;
+			}
+
+			stream->iov[count][stream->usertp].iov_base =
+				stream->buf + stream->start + (count * TS_PAYLOAD_SIZE);
+			stream->iov[count][stream->usertp].iov_len = TS_PAYLOAD_SIZE;
+			if (stream->usertp)
+				gnutv_stream_rtp_header(stream, stream->rtp[count],
+							stream->rtpseq + count, time);
+			count++;
+		}
+		if (count == 0)
+			break;
+
+		count = gnutv_stream_sendmmsg(stream, count);
+		stream->rtpseq += count;
+		stream->start += count * TS_PAYLOAD_SIZE;
+		stream->times_head = (stream->times_head + count) % STREAM_BUFFER_DATAGRAMS;
+		stream->datagrams -= count;
+		now = gnutv_stream_clock();
+	}
+
+	if (stream->datagrams == 0)
+		return -1;
+	if (due <= now)
+		return 0;
+	return ((due - now) + 999999) / 1000000;
+}
+
+void gnutv_stream_destroy(struct gnutv_stream *stream)
+{
+	// send everything now
+	stream->pace = 0;
+	gnutv_stream_send(stream);
+
+	// and the final partial datagram
+	if (stream->end > stream->start) {
+		uint64_t time = gnutv_stream_time(stream);
+
+		stream->iov[0][stream->usertp].iov_base = stream->buf + stream->start;
+		stream->iov[0][stream->usertp].iov_len = stream->end - stream->start;
+		if (stream->usertp)
+			gnutv_stream_rtp_header(stream, stream->rtp[0], stream->rtpseq, time);
+		gnutv_stream_sendmmsg(stream, 1);
+	}
+
+	free(stream->buf);
+	free(stream);
+}
+
+static void gnutv_stream_packet(struct gnutv_stream *stream, uint8_t *pkt)
+{
+	uint64_t pcr;
+	uint64_t delta;
+	uint64_t now;
+	int pid;
+
+	if ((pkt[0] != 0x47) || !(pkt[3] & 0x20) || (pkt[4] < 7) || !(pkt[5] & 0x10))
+		return;
+	pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+	now = gnutv_stream_clock();
+
+	// follow the first PID carrying a PCR, moving on only if it stops. The
+	// timeline carries on from wherever it had got to.
+	if (pid != stream->pcr_pid) {
+		if ((stream->pcr_pid != -1) && ((now - stream->last_pcr_clock) < STREAM_PCR_TIMEOUT_NS))
+			return;
+		stream->timeline = gnutv_stream_time(stream);
+		stream->pcr_pid = pid;
+		stream->have_pcr = 0;
+	}
+
+	pcr = ((uint64_t) pkt[6] << 25) | (pkt[7] << 17) | (pkt[8] << 9) | (pkt[9] << 1) | (pkt[10] >> 7);
+	pcr = (pcr * 300) + (((pkt[10] & 0x01) << 8) | pkt[11]);
+
+	if (!stream->have_pcr) {
+		stream->have_pcr = 1;
+	} else {
+		delta = (pcr + PCR_WRAP - stream->last_pcr) % PCR_WRAP;
+		if ((delta == 0) || (delta > PCR_MAX_GAP)) {
+			// discontinuity: bridge it by extrapolating
+			stream->timeline = gnutv_stream_time(stream);
+		} else {
+			stream->timeline += delta;
+			stream->rate_ticks = delta;
+			stream->rate_bytes = stream->bytes - stream->pcr_bytes;
+		}
+	}
+	stream->last_pcr = pcr;
+	stream->last_pcr_clock = now;
+	stream->pcr_bytes = stream->bytes;
+}
+
+static uint64_t gnutv_stream_time(struct gnutv_stream *stream)
+{
+	// before any PCR, the time the data arrived is the best there is
+	if (stream->pcr_pid == -1)
+		return ((gnutv_stream_clock() - stream->start_clock) * 27) / 1000;
+
+	if (stream->rate_bytes == 0)
+		return stream->timeline;
+	return stream->timeline +
+		(((stream->bytes - stream->pcr_bytes) * stream->rate_ticks) / stream->rate_bytes);
+}
+
+static int gnutv_stream_sendmmsg(struct gnutv_stream *stream, int count)
+{
+	int sent;
+
+	while(1) {
+		sent = sendmmsg(stream->outfd, stream->msgs, count, 0);
+		if (sent > 0)
+			return sent;
+		if ((sent < 0) && (errno == EINTR))
+			continue;
+
+		// skip the datagram which failed, so we don't get stuck on it
+		fprintf(stderr, "Socket send failure: %m\n");
+		return 1;
+	}
+}
+
+static void gnutv_stream_rtp_header(struct gnutv_stream *stream, uint8_t *hdr,
+				    uint16_t seq, uint64_t time)
+{
+	uint32_t timestamp = stream->rtp_offset + (uint32_t) (time / 300);
+
+	hdr[0x0] = 0x80;
+	hdr[0x1] = 0x21;
+	hdr[0x2] = seq >> 8;
+	hdr[0x3] = seq;
+	hdr[0x4] = timestamp >> 24;
+	hdr[0x5] = timestamp >> 16;
+	hdr[0x6] = timestamp >> 8;
+	hdr[0x7] = timestamp;
+	hdr[0x8] = stream->ssrc >> 24;
+	hdr[0x9] = stream->ssrc >> 16;
+	hdr[0xa] = stream->ssrc >> 8;
+	hdr[0xb] = stream->ssrc;
+}
+
+static uint64_t gnutv_stream_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
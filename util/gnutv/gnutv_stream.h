@@ -0,0 +1,77 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2004, 2005 Manu Abraham <abraham.manu@gmail.com>
+	Copyright (C) 2006 Andrew de Quincey (adq_dvb@lidskialf.net)
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_STREAM_H
+#define gnutv_STREAM_H 1
+
+#include <stdint.h>
+#include <netdb.h>
+
+struct gnutv_stream_params {
+	int usertp;		// if 1, prefix each datagram with an RTP header
+	int pace;		// if 1, pace output against the PCR
+};
+
+struct gnutv_stream;
+
+/**
+ * The streamer packs transport packets into UDP/RTP datagrams and sends them
+ * in batches with sendmmsg(). Each datagram is timestamped from the PCR, which
+ * provides the RTP timestamp and, if pacing is enabled, when it is sent, so
+ * bursts from the DVR device are smoothed out to the stream's own rate.
+ *
+ * As with the recorder, data is read straight into the streamer's buffer:
+ * call gnutv_stream_get_space(), read into it, then gnutv_stream_commit().
+ * gnutv_stream_send() then sends whatever is due. All calls must be made from
+ * the same thread.
+ */
+extern struct gnutv_stream *gnutv_stream_create(int outfd, struct addrinfo *outaddr,
+						struct gnutv_stream_params *params);
+
+/**
+ * Get the free space in the buffer.
+ *
+ * @param len Set to the number of bytes available.
+ * @return Pointer to the free space, or NULL if the buffer is full.
+ */
+extern uint8_t *gnutv_stream_get_space(struct gnutv_stream *stream, int *len);
+
+/**
+ * Queue len bytes read into the space returned by gnutv_stream_get_space().
+ */
+extern void gnutv_stream_commit(struct gnutv_stream *stream, int len);
+
+/**
+ * Send all datagrams which are due.
+ *
+ * @return Milliseconds until the next datagram is due, or -1 if there are none
+ * queued.
+ */
+extern int gnutv_stream_send(struct gnutv_stream *stream);
+
+/**
+ * Send everything still queued immediately, including any final partial
+ * datagram, and free the streamer.
+ */
+extern void gnutv_stream_destroy(struct gnutv_stream *stream);
+
+#endif
@@ -42,10 +42,10 @@ int diseqc_send_msg (int fd, fe_sec_voltage_t v, struct diseqc_cmd **cmd,
 {
 	int err;
 
-	if ((err = ioctl(fd, FE_SET_TONE, SEC_TONE_OFF)))
+	if ((err = dvb_ioctl(fd, FE_SET_TONE, (void *) (long) SEC_TONE_OFF)))
 		return err;
 
-	if ((err = ioctl(fd, FE_SET_VOLTAGE, v)))
+	if ((err = dvb_ioctl(fd, FE_SET_VOLTAGE, (void *) (long) v)))
 		return err;
 
 	msleep(15);
@@ -55,7 +55,7 @@ int diseqc_send_msg (int fd, fe_sec_voltage_t v, struct diseqc_cmd **cmd,
 		    (*cmd)->cmd.msg[2], (*cmd)->cmd.msg[3],
 		    (*cmd)->cmd.msg[4], (*cmd)->cmd.msg[5]);
 
-		if ((err = ioctl(fd, FE_DISEQC_SEND_MASTER_CMD, &(*cmd)->cmd)))
+		if ((err = dvb_ioctl(fd, FE_DISEQC_SEND_MASTER_CMD, &(*cmd)->cmd)))
 			return err;
 
 		msleep((*cmd)->wait);
@@ -73,12 +73,12 @@ int diseqc_send_msg (int fd, fe_sec_voltage_t v, struct diseqc_cmd **cmd,
 
 	msleep(15);
 
-	if ((err = ioctl(fd, FE_DISEQC_SEND_BURST, b)))
+	if ((err = dvb_ioctl(fd, FE_DISEQC_SEND_BURST, (void *) (long) b)))
 		return err;
 
 	msleep(15);
 
-	return ioctl(fd, FE_SET_TONE, t);
+	return dvb_ioctl(fd, FE_SET_TONE, (void *) (long) t);
 }
 
 
@@ -24,7 +24,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
-#include <sys/poll.h>
+#include <sys/epoll.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <time.h>
@@ -35,9 +35,13 @@
 #include <ctype.h>
 #include <iconv.h>
 #include <langinfo.h>
+#include <pthread.h>
 
 #include <linux/dvb/frontend.h>
 #include <linux/dvb/dmx.h>
+#include <libdvbapi/dvbfe.h>
+#include <libdvbapi/dvbdemux.h>
+#include <libdvbapi/dvbvirtual.h>
 
 #include "list.h"
 #include "diseqc.h"
@@ -48,12 +52,6 @@
 
 #include "atsc_psip_section.h"
 
-static char demux_devname[80];
-
-static struct dvb_frontend_info fe_info = {
-	.type = -1
-};
-
 int verbosity = 2;
 
 static int long_timeout;
@@ -66,8 +64,6 @@ static int scan_play_video = 1;
 
 static struct lnb_types_st lnb_type;
 
-static int rf_chan; 
-static int fe_fd; 
 static char description[25] = "Living room"; 
 
 char *default_charset = "ISO-6937";
@@ -131,8 +127,12 @@ struct service {
 	enum running_mode running;
 	void *priv;
 	int channel_num;
+	struct service *hash_next;	/* service_hash chain */
 };
 
+#define SERVICE_HASH_SIZE 64
+#define TP_ID_HASH_SIZE 256
+
 struct transponder {
 	struct list_head list;
 	struct list_head services;
@@ -150,12 +150,21 @@ struct transponder {
 	unsigned int wrong_frequency	  : 1;	/* DVB-T with other_frequency_flag */
 	int n_other_f;
 	uint32_t *other_f;			/* DVB-T freqeuency-list descriptor */
+	struct service *service_hash[SERVICE_HASH_SIZE];	/* by service_id */
+	struct transponder *id_next;		/* tp_id_hash chain */
 };
 
 
+enum filter_priority {
+	FILTER_PRIO_HIGH,	/* PAT, NIT, SDT, VCT */
+	FILTER_PRIO_NORMAL,	/* PMT */
+	FILTER_PRIO_LOW,	/* everything else, e.g. EIT */
+};
+
 struct section_buf {
 	struct list_head list;
-	const char *dmx_devname;
+	struct list_head timer;		/* entry in the adapter's timer wheel */
+	struct scan_adapter *adapter;
 	unsigned int run_once  : 1;
 	unsigned int segmented : 1;	/* segmented by table_id_ext */
 	int fd;
@@ -166,9 +175,11 @@ struct section_buf {
 	uint8_t section_done[32];
 	int sectionfilter_done;
 	unsigned char buf[1024];
-	time_t timeout;
-	time_t start_time;
-	time_t running_time;
+	enum filter_priority priority;
+	unsigned int timeout_ms;
+	uint64_t start_ms;		/* CLOCK_MONOTONIC */
+	uint64_t deadline_ms;
+	uint64_t running_ms;
 	struct section_buf *next_seg;	/* this is used to handle
 					 * segmented tables (like NIT-other)
 					 */
@@ -194,16 +205,60 @@ struct channel_info {
 	struct virtual_channels vc[16]; 
 };
 
+#define MAX_ADAPTERS 16
+
+/* Filter timeouts are kept in a hashed timer wheel: a filter expiring at
+ * time T lives in slot (T / TIMER_WHEEL_TICK) % TIMER_WHEEL_SLOTS, and only
+ * the slots passed since the last wakeup need to be looked at.
+ */
+#define TIMER_WHEEL_TICK	50	/* ms */
+#define TIMER_WHEEL_SLOTS	256
+#define MAX_EPOLL_EVENTS	32
+
+/* Each adapter is driven by its own thread, which takes transponders off
+ * new_transponders until there are none left and no other adapter is
+ * still scanning (and so might add more via the NIT).
+ */
+struct scan_adapter {
+	int adapter_num;
+	char frontend_devname[80];
+	char demux_devname[80];
+	int demux_num;
+	struct dvbfe_handle *fe;
+	int frontend_fd;
+	struct dvb_frontend_info fe_info;
+	struct transponder *current_tp;
+	int rf_chan;
+	int tuned;
+	struct list_head running_filters;
+	struct list_head waiting_filters;	/* sorted by priority */
+	int n_running;
+	int epoll_fd;
+	struct list_head timer_wheel[TIMER_WHEEL_SLOTS];
+	uint64_t wheel_tick;			/* last tick expired */
+	pthread_t thread;
+};
+
 static struct channel_info *pchan_info; 
 
+static struct scan_adapter adapters[MAX_ADAPTERS];
+static int n_adapters;
+
+/* scan_lock protects the transponder and service lists (and pchan_info),
+ * which are shared between all adapters. scan_cond is signalled whenever
+ * a transponder is queued or an adapter goes idle.
+ */
+static pthread_mutex_t scan_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scan_cond = PTHREAD_COND_INITIALIZER;
+static int busy_adapters;
+
 static LIST_HEAD(scanned_transponders);
 static LIST_HEAD(new_transponders);
-static struct transponder *current_tp;
 
 
 static void dump_dvb_parameters (FILE *f, struct transponder *t);
 
-static void setup_filter (struct section_buf* s, const char *dmx_devname,
+static void setup_filter (struct section_buf* s, struct scan_adapter *a,
 		          int pid, int tid, int tid_ext,
 			  int run_once, int segmented, int timeout);
 static void add_filter (struct section_buf *s);
@@ -224,6 +279,107 @@ static void save_channel_info_file(FILE *fd);
  * one satellite sometimes list the same TP with slightly different
  * frequencies, so we have to search within some bandwidth.
  */
+
+/* All known transponders (scanned or not), sorted by frequency, so that
+ * find_transponder() can binary search for the tolerance window instead
+ * of walking both lists.
+ */
+static struct transponder **tp_index;
+static int tp_index_count;
+static int tp_index_size;
+
+/* transponders hashed on (original_network_id, transport_stream_id) */
+static struct transponder *tp_id_hash[TP_ID_HASH_SIZE];
+
+#define TP_FREQ_TOLERANCE 2000
+
+/* position of the first transponder in tp_index with frequency >= f */
+static int tp_index_lower_bound(uint32_t f)
+{
+	int lo = 0, hi = tp_index_count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (tp_index[mid]->param.frequency < f)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void index_transponder(struct transponder *tp)
+{
+	int pos;
+
+	if (tp_index_count == tp_index_size) {
+		tp_index_size = tp_index_size ? tp_index_size * 2 : 64;
+		tp_index = realloc(tp_index, tp_index_size * sizeof(*tp_index));
+		if (!tp_index)
+			fatal("out of memory\n");
+	}
+
+	pos = tp_index_lower_bound(tp->param.frequency);
+	memmove(&tp_index[pos + 1], &tp_index[pos],
+		(tp_index_count - pos) * sizeof(*tp_index));
+	tp_index[pos] = tp;
+	tp_index_count++;
+}
+
+static void unindex_transponder(struct transponder *tp)
+{
+	int pos;
+
+	for (pos = tp_index_lower_bound(tp->param.frequency); pos < tp_index_count; pos++) {
+		if (tp_index[pos] == tp) {
+			tp_index_count--;
+			memmove(&tp_index[pos], &tp_index[pos + 1],
+				(tp_index_count - pos) * sizeof(*tp_index));
+			return;
+		}
+	}
+}
+
+/* must be used instead of assigning param.frequency directly once the
+ * transponder has been indexed
+ */
+static void set_transponder_frequency(struct transponder *tp, uint32_t frequency)
+{
+	if (tp->param.frequency == frequency)
+		return;
+
+	unindex_transponder(tp);
+	tp->param.frequency = frequency;
+	index_transponder(tp);
+}
+
+static unsigned int tp_id_hashfn(int onid, int tsid)
+{
+	return ((onid * 31) ^ tsid) & (TP_ID_HASH_SIZE - 1);
+}
+
+static void tp_id_hash_remove(struct transponder *tp)
+{
+	struct transponder **pp;
+
+	pp = &tp_id_hash[tp_id_hashfn(tp->original_network_id, tp->transport_stream_id)];
+	for (; *pp; pp = &(*pp)->id_next) {
+		if (*pp == tp) {
+			*pp = tp->id_next;
+			tp->id_next = NULL;
+			return;
+		}
+	}
+}
+
+static void tp_id_hash_add(struct transponder *tp)
+{
+	unsigned int h = tp_id_hashfn(tp->original_network_id, tp->transport_stream_id);
+
+	tp->id_next = tp_id_hash[h];
+	tp_id_hash[h] = tp;
+}
+
 static struct transponder *alloc_transponder(uint32_t frequency)
 {
 	struct transponder *tp = calloc(1, sizeof(*tp));
@@ -232,6 +388,10 @@ static struct transponder *alloc_transponder(uint32_t frequency)
 	INIT_LIST_HEAD(&tp->list);
 	INIT_LIST_HEAD(&tp->services);
 	list_add_tail(&tp->list, &new_transponders);
+	index_transponder(tp);
+	tp_id_hash_add(tp);
+	/* wake any idle adapters - callers hold scan_lock */
+	pthread_cond_broadcast(&scan_cond);
 	return tp;
 }
 
@@ -242,7 +402,7 @@ static int is_same_transponder(uint32_t f1, uint32_t f2)
 		return 1;
 	diff = (f1 > f2) ? (f1 - f2) : (f2 - f1);
 	//FIXME: use symbolrate etc. to estimate bandwidth
-	if (diff < 2000) {
+	if (diff < TP_FREQ_TOLERANCE) {
 		debug("f1 = %u is same TP as f2 = %u\n", f1, f2);
 		return 1;
 	}
@@ -251,19 +411,38 @@ static int is_same_transponder(uint32_t f1, uint32_t f2)
 
 static struct transponder *find_transponder(uint32_t frequency)
 {
-	struct list_head *pos;
-	struct transponder *tp;
+	struct transponder *tp, *best = NULL;
+	uint32_t low;
+	int pos;
 
-	list_for_each(pos, &scanned_transponders) {
-		tp = list_entry(pos, struct transponder, list);
-		if (current_tp_only)
-			return tp;
-		if (is_same_transponder(tp->param.frequency, frequency))
+	if (current_tp_only && !list_empty(&scanned_transponders))
+		return list_entry(scanned_transponders.next, struct transponder, list);
+
+	/* of the transponders within tolerance prefer one we already scanned,
+	 * as walking the scanned list first used to
+	 */
+	low = (frequency > TP_FREQ_TOLERANCE) ? frequency - (TP_FREQ_TOLERANCE - 1) : 0;
+	for (pos = tp_index_lower_bound(low); pos < tp_index_count; pos++) {
+		tp = tp_index[pos];
+		if (!is_same_transponder(tp->param.frequency, frequency))
+			break;
+		if (tp->scan_done)
 			return tp;
+		if (!best)
+			best = tp;
 	}
-	list_for_each(pos, &new_transponders) {
-		tp = list_entry(pos, struct transponder, list);
-		if (is_same_transponder(tp->param.frequency, frequency))
+	return best;
+}
+
+static struct transponder *find_transponder_by_id(int original_network_id,
+						  int transport_stream_id)
+{
+	struct transponder *tp;
+
+	tp = tp_id_hash[tp_id_hashfn(original_network_id, transport_stream_id)];
+	for (; tp; tp = tp->id_next) {
+		if (tp->original_network_id == original_network_id &&
+		    tp->transport_stream_id == transport_stream_id)
 			return tp;
 	}
 	return NULL;
@@ -282,10 +461,13 @@ static void copy_transponder(struct transponder *d, struct transponder *s)
 		}
 	}
 
+	tp_id_hash_remove(d);
 	d->network_id = s->network_id;
 	d->original_network_id = s->original_network_id;
 	d->transport_stream_id = s->transport_stream_id;
+	tp_id_hash_add(d);
 	d->type = s->type;
+	set_transponder_frequency(d, s->param.frequency);
 	memcpy(&d->param, &s->param, sizeof(d->param));
 	d->polarisation = s->polarisation;
 	d->orbital_pos = s->orbital_pos;
@@ -309,20 +491,23 @@ static void copy_transponder(struct transponder *d, struct transponder *s)
 static struct service *alloc_service(struct transponder *tp, int service_id)
 {
 	struct service *s = calloc(1, sizeof(*s));
+	unsigned int h = service_id & (SERVICE_HASH_SIZE - 1);
+
 	INIT_LIST_HEAD(&s->list);
 	s->service_id = service_id;
 	s->transport_stream_id = tp->transport_stream_id;
 	list_add_tail(&s->list, &tp->services);
+	s->hash_next = tp->service_hash[h];
+	tp->service_hash[h] = s;
 	return s;
 }
 
 static struct service *find_service(struct transponder *tp, int service_id)
 {
-	struct list_head *pos;
 	struct service *s;
 
-	list_for_each(pos, &tp->services) {
-		s = list_entry(pos, struct service, list);
+	s = tp->service_hash[service_id & (SERVICE_HASH_SIZE - 1)];
+	for (; s; s = s->hash_next) {
 		if (s->service_id == service_id)
 			return s;
 	}
@@ -384,7 +569,7 @@ static void parse_terrestrial_uk_channel_number (const unsigned char *buf, void
 	(void)dummy;
 
 	int i, n, channel_num, service_id;
-	struct list_head *p1, *p2;
+	struct list_head *p1;
 	struct transponder *t;
 	struct service *s;
 
@@ -401,11 +586,9 @@ static void parse_terrestrial_uk_channel_number (const unsigned char *buf, void
 		debug("Service ID 0x%x has channel number %d ", service_id, channel_num);
 		list_for_each(p1, &scanned_transponders) {
 			t = list_entry(p1, struct transponder, list);
-			list_for_each(p2, &t->services) {
-				s = list_entry(p2, struct service, list);
-				if (s->service_id == service_id)
-					s->channel_num = channel_num;
-			}
+			s = find_service(t, service_id);
+			if (s)
+				s->channel_num = channel_num;
 		}
 		buf += 4;
 	}
@@ -1128,7 +1311,7 @@ static void parse_descriptors(enum table_type t, const unsigned char *buf,
 }
 
 
-static void parse_pat(const unsigned char *buf, int section_length,
+static void parse_pat(struct scan_adapter *a, const unsigned char *buf, int section_length,
 		      int transport_stream_id)
 {
 	(void)transport_stream_id;
@@ -1141,13 +1324,13 @@ static void parse_pat(const unsigned char *buf, int section_length,
 			goto skip;	/* nit pid entry */
 
 		/* SDT might have been parsed first... */
-		s = find_service(current_tp, service_id);
+		s = find_service(a->current_tp, service_id);
 		if (!s)
-			s = alloc_service(current_tp, service_id);
+			s = alloc_service(a->current_tp, service_id);
 		s->pmt_pid = ((buf[2] & 0x1f) << 8) | buf[3];
 		if (!s->priv && s->pmt_pid) {
 			s->priv = malloc(sizeof(struct section_buf));
-			setup_filter(s->priv, demux_devname,
+			setup_filter(s->priv, a,
 				     s->pmt_pid, 0x02, s->service_id, 1, 0, 5);
 
 			add_filter (s->priv);
@@ -1160,7 +1343,7 @@ skip:
 }
 
 
-static void parse_pmt (const unsigned char *buf, int section_length, int service_id)
+static void parse_pmt (struct scan_adapter *a, const unsigned char *buf, int section_length, int service_id)
 {
 	int program_info_len;
 	struct service *s;
@@ -1168,7 +1351,7 @@ static void parse_pmt (const unsigned char *buf, int section_length, int service
         char *tmp;
         int i;
 
-	s = find_service (current_tp, service_id);
+	s = find_service (a->current_tp, service_id);
 	if (!s) {
 		error("PMT for serivce_id 0x%04x was not in PAT\n", service_id);
 		return;
@@ -1265,7 +1448,7 @@ static void parse_pmt (const unsigned char *buf, int section_length, int service
 }
 
 
-static void parse_nit (const unsigned char *buf, int section_length, int network_id)
+static void parse_nit (struct scan_adapter *a, const unsigned char *buf, int section_length, int network_id)
 {
 	int descriptors_loop_len = ((buf[0] & 0x0f) << 8) | buf[1];
 
@@ -1307,7 +1490,7 @@ static void parse_nit (const unsigned char *buf, int section_length, int network
 
 		parse_descriptors (NIT, buf + 6, descriptors_loop_len, &tn);
 
-		if (tn.type == fe_info.type) {
+		if (tn.type == a->fe_info.type) {
 			/* only add if develivery_descriptor matches FE type */
 			t = find_transponder(tn.param.frequency);
 			if (!t)
@@ -1321,10 +1504,18 @@ static void parse_nit (const unsigned char *buf, int section_length, int network
 }
 
 
-static void parse_sdt (const unsigned char *buf, int section_length,
-		int transport_stream_id)
+static void parse_sdt (struct scan_adapter *a, const unsigned char *buf, int section_length,
+		int table_id, int transport_stream_id)
 {
-	(void)transport_stream_id;
+	struct transponder *tp = a->current_tp;
+	int original_network_id = (buf[0] << 8) | buf[1];
+
+	if (table_id == 0x46) {
+		/* SDT other describes some other TS; only keep it if we know it */
+		tp = find_transponder_by_id(original_network_id, transport_stream_id);
+		if (!tp)
+			return;
+	}
 
 	buf += 3;	       /*  skip original network id + reserved field */
 
@@ -1342,10 +1533,10 @@ static void parse_sdt (const unsigned char *buf, int section_length,
 			break;
 		}
 
-		s = find_service(current_tp, service_id);
+		s = find_service(tp, service_id);
 		if (!s)
 			/* maybe PAT has not yet been parsed... */
-			s = alloc_service(current_tp, service_id);
+			s = alloc_service(tp, service_id);
 
 		s->running = (buf[3] >> 5) & 0x7;
 		s->scrambled = (buf[3] >> 4) & 1;
@@ -1443,7 +1634,7 @@ static void parse_psip_descriptors(struct service *s,const unsigned char *buf,in
 	}
 }
 
-static void parse_psip_vct (const unsigned char *buf, int section_length,
+static void parse_psip_vct (struct scan_adapter *a, const unsigned char *buf, int section_length,
 		int table_id, int transport_stream_id)
 {
 	(void)section_length;
@@ -1459,7 +1650,7 @@ static void parse_psip_vct (const unsigned char *buf, int section_length,
 	int16_t signal;
 	uint32_t ber, uncorrected_blocks;
 	fe_status_t status;
-	int idx = rf_chan - 2;
+	int idx = a->rf_chan - 2;
 
 	for (i = 0; i < num_channels_in_section; i++) {
 		struct service *s;
@@ -1480,9 +1671,9 @@ static void parse_psip_vct (const unsigned char *buf, int section_length,
 		if (ch.program_number == 0)
 			ch.program_number = --pseudo_id;
 
-		s = find_service(current_tp, ch.program_number);
+		s = find_service(a->current_tp, ch.program_number);
 		if (!s)
-			s = alloc_service(current_tp, ch.program_number);
+			s = alloc_service(a->current_tp, ch.program_number);
 
 		if (s->service_name)
 			free(s->service_name);
@@ -1512,27 +1703,27 @@ static void parse_psip_vct (const unsigned char *buf, int section_length,
 		if (save_channel_info) {
 			
 			if (i == 0) {
-				if (ioctl(fe_fd, FE_READ_STATUS, &status) == -1) {
+				if (dvb_ioctl(a->frontend_fd, FE_READ_STATUS, &status) == -1) {
 					errorn("FE_READ_STATUS failed");
 					return ;
 				}
 
 				verbose(">>> tuning status == 0x%02x\n", status);
 
-				if (ioctl(fe_fd, FE_READ_SIGNAL_STRENGTH, &signal) == -1)
+				if (dvb_ioctl(a->frontend_fd, FE_READ_SIGNAL_STRENGTH, &signal) == -1)
 					signal = -2;
 
-				if (ioctl(fe_fd, FE_READ_SNR, &snr) == -1)
+				if (dvb_ioctl(a->frontend_fd, FE_READ_SNR, &snr) == -1)
 					snr = -2;
 
-				if (ioctl(fe_fd, FE_READ_BER, &ber) == -1)
+				if (dvb_ioctl(a->frontend_fd, FE_READ_BER, &ber) == -1)
 					ber = -2;
 
-				if (ioctl(fe_fd, FE_READ_UNCORRECTED_BLOCKS, &uncorrected_blocks) == -1)
+				if (dvb_ioctl(a->frontend_fd, FE_READ_UNCORRECTED_BLOCKS, &uncorrected_blocks) == -1)
 					uncorrected_blocks = -2;
 			
-				pchan_info[idx].chan_num = rf_chan;
-				pchan_info[idx].chan_freq = atsc_chan_to_mhz(rf_chan);
+				pchan_info[idx].chan_num = a->rf_chan;
+				pchan_info[idx].chan_freq = atsc_chan_to_mhz(a->rf_chan);
 				pchan_info[idx].snr_dB = (float) (snr / 10);
 				pchan_info[idx].rssi_dBm = (int16_t) (signal / 100);
 				pchan_info[idx].ber = ber;
@@ -1579,6 +1770,7 @@ static void set_bit (uint8_t *bitfield, int bit)
  */
 static int parse_section (struct section_buf *s)
 {
+	struct scan_adapter *a = s->adapter;
 	const unsigned char *buf = s->buf;
 	int table_id;
 	int section_length;
@@ -1612,7 +1804,7 @@ static int parse_section (struct section_buf *s)
 			s->next_seg = calloc(1, sizeof(struct section_buf));
 			s->next_seg->segmented = s->segmented;
 			s->next_seg->run_once = s->run_once;
-			s->next_seg->timeout = s->timeout;
+			s->next_seg->timeout_ms = s->timeout_ms;
 			s = s->next_seg;
 			s->table_id = table_id;
 			s->table_id_ext = table_id_ext;
@@ -1655,31 +1847,31 @@ static int parse_section (struct section_buf *s)
 		switch (table_id) {
 		case 0x00:
 			verbose("PAT\n");
-			parse_pat (buf, section_length, table_id_ext);
+			parse_pat (a, buf, section_length, table_id_ext);
 			break;
 
 		case 0x02:
 			verbose("PMT 0x%04x for service 0x%04x\n", s->pid, table_id_ext);
-			parse_pmt (buf, section_length, table_id_ext);
+			parse_pmt (a, buf, section_length, table_id_ext);
 			break;
 
 		case 0x41:
 			verbose("////////////////////////////////////////////// NIT other\n");
 		case 0x40:
 			verbose("NIT (%s TS)\n", table_id == 0x40 ? "actual":"other");
-			parse_nit (buf, section_length, table_id_ext);
+			parse_nit (a, buf, section_length, table_id_ext);
 			break;
 
 		case 0x42:
 		case 0x46:
 			verbose("SDT (%s TS)\n", table_id == 0x42 ? "actual":"other");
-			parse_sdt (buf, section_length, table_id_ext);
+			parse_sdt (a, buf, section_length, table_id, table_id_ext);
 			break;
 
 		case 0xc8:
 		case 0xc9:
 			verbose("ATSC VCT\n");
-			parse_psip_vct(buf, section_length, table_id, table_id_ext);
+			parse_psip_vct(a, buf, section_length, table_id, table_id_ext);
 			break;
 		default:
 			;
@@ -1708,7 +1900,7 @@ static int parse_section (struct section_buf *s)
 
 static int read_sections (struct section_buf *s)
 {
-	int section_length, count;
+	int section_length, count, done;
 
 	if (s->sectionfilter_done && !s->segmented)
 		return 1;
@@ -1731,80 +1923,139 @@ static int read_sections (struct section_buf *s)
 	if (count != section_length + 3)
 		return -1;
 
-	if (parse_section(s) == 1)
+	/* the parsers update the transponder lists shared with other adapters */
+	pthread_mutex_lock(&scan_lock);
+	done = parse_section(s);
+	pthread_mutex_unlock(&scan_lock);
+
+	if (done == 1)
 		return 1;
 
 	return 0;
 }
 
 
-static LIST_HEAD(running_filters);
-static LIST_HEAD(waiting_filters);
-static int n_running;
-#define MAX_RUNNING 27
-static struct pollfd poll_fds[MAX_RUNNING];
-static struct section_buf* poll_section_bufs[MAX_RUNNING];
+/* Issue an ioctl on a frontend or demux fd, which may belong to a virtual
+ * adapter emulated by libdvbapi rather than a real device.
+ */
+int dvb_ioctl(int fd, unsigned long request, void *arg)
+{
+	int result;
 
+	if (dvbvirtual_ioctl(fd, request, arg, &result))
+		return result;
 
-static void setup_filter (struct section_buf* s, const char *dmx_devname,
+	return ioctl(fd, request, arg);
+}
+
+static uint64_t now_ms (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static enum filter_priority filter_priority (int table_id)
+{
+	switch (table_id) {
+	case 0x00:	/* PAT */
+	case 0x40:	/* NIT actual */
+	case 0x41:	/* NIT other */
+	case 0x42:	/* SDT actual */
+	case 0x46:	/* SDT other */
+	case 0xc8:	/* terrestrial VCT */
+	case 0xc9:	/* cable VCT */
+		return FILTER_PRIO_HIGH;
+	case 0x02:	/* PMT */
+		return FILTER_PRIO_NORMAL;
+	default:
+		return FILTER_PRIO_LOW;
+	}
+}
+
+static void setup_filter (struct section_buf* s, struct scan_adapter *a,
 			  int pid, int tid, int tid_ext,
 			  int run_once, int segmented, int timeout)
 {
 	memset (s, 0, sizeof(struct section_buf));
 
 	s->fd = -1;
-	s->dmx_devname = dmx_devname;
+	s->adapter = a;
 	s->pid = pid;
 	s->table_id = tid;
+	s->priority = filter_priority(tid);
 
 	s->run_once = run_once;
 	s->segmented = segmented;
 
 	if (long_timeout)
-		s->timeout = 5 * timeout;
+		s->timeout_ms = 5 * timeout * 1000;
 	else
-		s->timeout = timeout;
+		s->timeout_ms = timeout * 1000;
 
 	s->table_id_ext = tid_ext;
 	s->section_version_number = -1;
 
 	INIT_LIST_HEAD (&s->list);
+	INIT_LIST_HEAD (&s->timer);
 }
 
-static void update_poll_fds(void)
+static void timer_init (struct scan_adapter *a)
 {
-	struct list_head *p;
-	struct section_buf* s;
 	int i;
 
-	memset(poll_section_bufs, 0, sizeof(poll_section_bufs));
-	for (i = 0; i < MAX_RUNNING; i++)
-		poll_fds[i].fd = -1;
-	i = 0;
-	list_for_each (p, &running_filters) {
-		if (i >= MAX_RUNNING)
-			fatal("too many poll_fds\n");
-		s = list_entry (p, struct section_buf, list);
-		if (s->fd == -1)
-			fatal("s->fd == -1 on running_filters\n");
-		verbosedebug("poll fd %d\n", s->fd);
-		poll_fds[i].fd = s->fd;
-		poll_fds[i].events = POLLIN;
-		poll_fds[i].revents = 0;
-		poll_section_bufs[i] = s;
-		i++;
+	for (i = 0; i < TIMER_WHEEL_SLOTS; i++)
+		INIT_LIST_HEAD(&a->timer_wheel[i]);
+	a->wheel_tick = now_ms() / TIMER_WHEEL_TICK;
+}
+
+static void timer_add (struct section_buf *s, uint64_t deadline)
+{
+	struct scan_adapter *a = s->adapter;
+	uint64_t tick;
+
+	/* round up, so everything in a slot has expired once its tick is reached */
+	tick = (deadline + TIMER_WHEEL_TICK - 1) / TIMER_WHEEL_TICK;
+	if (tick <= a->wheel_tick)
+		tick = a->wheel_tick + 1;
+
+	s->deadline_ms = deadline;
+	list_add_tail(&s->timer, &a->timer_wheel[tick % TIMER_WHEEL_SLOTS]);
+}
+
+static void timer_del (struct section_buf *s)
+{
+	list_del_init(&s->timer);
+}
+
+/* ms until the next occupied slot comes due, or -1 if no timers are pending */
+static int timer_next_wait (struct scan_adapter *a, uint64_t now)
+{
+	uint64_t tick;
+	int i;
+
+	for (i = 1; i <= TIMER_WHEEL_SLOTS; i++) {
+		tick = a->wheel_tick + i;
+		if (list_empty(&a->timer_wheel[tick % TIMER_WHEEL_SLOTS]))
+			continue;
+		if (tick * TIMER_WHEEL_TICK <= now)
+			return 0;
+		return tick * TIMER_WHEEL_TICK - now;
 	}
-	if (i != n_running)
-		fatal("n_running is hosed\n");
+	return -1;
 }
 
 static int start_filter (struct section_buf* s)
 {
+	struct scan_adapter *a = s->adapter;
 	struct dmx_sct_filter_params f;
+	struct epoll_event ev;
 
-	if (n_running >= MAX_RUNNING)
-		goto err0;
-	if ((s->fd = open (s->dmx_devname, O_RDWR | O_NONBLOCK)) < 0)
+	/* there is no fixed limit on the number of running filters; if the
+	 * demux runs out, the open() or ioctl() fails and the filter waits
+	 */
+	if ((s->fd = dvbdemux_open_demux(a->adapter_num, a->demux_num, 1)) < 0)
 		goto err0;
 
 	verbosedebug("start filter pid 0x%04x table_id 0x%02x\n", s->pid, s->table_id);
@@ -1827,25 +2078,34 @@ static int start_filter (struct section_buf* s)
 	f.timeout = 0;
 	f.flags = DMX_IMMEDIATE_START | DMX_CHECK_CRC;
 
-	if (ioctl(s->fd, DMX_SET_FILTER, &f) == -1) {
+	if (dvb_ioctl(s->fd, DMX_SET_FILTER, &f) == -1) {
 		errorn ("ioctl DMX_SET_FILTER failed");
 		goto err1;
 	}
 
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = s;
+	if (epoll_ctl(a->epoll_fd, EPOLL_CTL_ADD, s->fd, &ev) == -1) {
+		errorn ("epoll_ctl failed");
+		goto err1;
+	}
+
 	s->sectionfilter_done = 0;
-	time(&s->start_time);
+	s->start_ms = now_ms();
+	timer_add(s, s->start_ms + s->timeout_ms);
 
 	list_del_init (&s->list);  /* might be in waiting filter list */
-	list_add (&s->list, &running_filters);
+	list_add (&s->list, &a->running_filters);
 
-	n_running++;
-	update_poll_fds();
+	a->n_running++;
 
 	return 0;
 
 err1:
-	ioctl (s->fd, DMX_STOP);
+	dvb_ioctl(s->fd, DMX_STOP, NULL);
 	close (s->fd);
+	s->fd = -1;
 err0:
 	return -1;
 }
@@ -1853,32 +2113,65 @@ err0:
 
 static void stop_filter (struct section_buf *s)
 {
+	struct scan_adapter *a = s->adapter;
+
 	verbosedebug("stop filter pid 0x%04x\n", s->pid);
-	ioctl (s->fd, DMX_STOP);
+	epoll_ctl(a->epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+	dvb_ioctl(s->fd, DMX_STOP, NULL);
 	close (s->fd);
 	s->fd = -1;
 	list_del (&s->list);
-	s->running_time += time(NULL) - s->start_time;
+	timer_del (s);
+	s->running_ms += now_ms() - s->start_ms;
+
+	a->n_running--;
+}
+
+
+/* queue a filter behind any waiting filters of the same or higher priority */
+static void wait_filter (struct section_buf *s)
+{
+	struct list_head *pos;
+	struct section_buf *w;
 
-	n_running--;
-	update_poll_fds();
+	list_for_each (pos, &s->adapter->waiting_filters) {
+		w = list_entry (pos, struct section_buf, list);
+		if (w->priority > s->priority)
+			break;
+	}
+	list_add_tail (&s->list, pos);
 }
 
 
 static void add_filter (struct section_buf *s)
 {
+	struct scan_adapter *a = s->adapter;
+	struct section_buf *w;
+
 	verbosedebug("add filter pid 0x%04x\n", s->pid);
+
+	/* don't overtake a waiting filter which should run first */
+	if (!list_empty(&a->waiting_filters)) {
+		w = list_entry (a->waiting_filters.next, struct section_buf, list);
+		if (w->priority <= s->priority) {
+			wait_filter (s);
+			return;
+		}
+	}
+
 	if (start_filter (s))
-		list_add_tail (&s->list, &waiting_filters);
+		wait_filter (s);
 }
 
 
 static void remove_filter (struct section_buf *s)
 {
+	struct scan_adapter *a = s->adapter;
+
 	verbosedebug("remove filter pid 0x%04x\n", s->pid);
 	stop_filter (s);
-	while (!list_empty(&waiting_filters)) {
-		struct list_head *next = waiting_filters.next;
+	while (!list_empty(&a->waiting_filters)) {
+		struct list_head *next = a->waiting_filters.next;
 		s = list_entry (next, struct section_buf, list);
 		if (start_filter (s))
 			break;
@@ -1886,33 +2179,69 @@ static void remove_filter (struct section_buf *s)
 }
 
 
-static void read_filters (void)
+static void filter_done (struct section_buf *s, int done)
 {
-	struct section_buf *s;
-	int i, n, done;
+	if (s->run_once) {
+		if (done)
+			verbosedebug("filter done pid 0x%04x\n", s->pid);
+		else
+			warning("filter timeout pid 0x%04x\n", s->pid);
+		remove_filter (s);
+	}
+	else if (!done) {
+		/* keep running, check again after another timeout */
+		timer_add (s, s->deadline_ms + s->timeout_ms);
+	}
+}
 
-	n = poll(poll_fds, n_running, 1000);
-	if (n == -1)
-		errorn("poll");
 
-	for (i = 0; i < n_running; i++) {
-		s = poll_section_bufs[i];
-		if (!s)
-			fatal("poll_section_bufs[%d] is NULL\n", i);
-		if (poll_fds[i].revents)
-			done = read_sections (s) == 1;
-		else
-			done = 0; /* timeout */
-		if (done || time(NULL) > s->start_time + s->timeout) {
-			if (s->run_once) {
-				if (done)
-					verbosedebug("filter done pid 0x%04x\n", s->pid);
-				else
-					warning("filter timeout pid 0x%04x\n", s->pid);
-				remove_filter (s);
-			}
+static void expire_timers (struct scan_adapter *a, uint64_t now)
+{
+	struct list_head *pos, *tmp, *slot;
+	struct section_buf *s;
+	uint64_t target = now / TIMER_WHEEL_TICK;
+	uint64_t ticks;
+
+	/* after a long sleep every slot needs looking at, but only once */
+	ticks = target - a->wheel_tick;
+	if (ticks > TIMER_WHEEL_SLOTS)
+		ticks = TIMER_WHEEL_SLOTS;
+
+	for (; ticks; ticks--) {
+		slot = &a->timer_wheel[(target - ticks + 1) % TIMER_WHEEL_SLOTS];
+		list_for_each_safe (pos, tmp, slot) {
+			s = list_entry (pos, struct section_buf, timer);
+			if (s->deadline_ms > now)
+				continue;	/* due on a later revolution */
+			timer_del (s);
+			filter_done (s, 0);
 		}
 	}
+	a->wheel_tick = target;
+}
+
+
+static void read_filters (struct scan_adapter *a)
+{
+	struct epoll_event events[MAX_EPOLL_EVENTS];
+	struct section_buf *s;
+	int i, n;
+
+	n = epoll_wait(a->epoll_fd, events, MAX_EPOLL_EVENTS,
+		       timer_next_wait(a, now_ms()));
+	if (n == -1 && errno != EINTR)
+		errorn("epoll_wait");
+
+	for (i = 0; i < n; i++) {
+		s = events[i].data.ptr;
+		/* may have been stopped while handling an earlier event */
+		if (s->fd == -1)
+			continue;
+		if (read_sections (s) == 1)
+			filter_done (s, 1);
+	}
+
+	expire_timers (a, now_ms());
 }
 
 
@@ -1932,39 +2261,44 @@ static int mem_is_zero (const void *mem, int size)
 
 static int switch_pos = 0;
 
-static int __tune_to_transponder (int frontend_fd, struct transponder *t)
+static int __tune_to_transponder (struct scan_adapter *a, struct transponder *t)
 {
+	int frontend_fd = a->frontend_fd;
 	struct dvb_frontend_parameters p;
 	fe_status_t s;
-	current_tp = t;
 	int i;
 
+	a->current_tp = t;
+
 	if (mem_is_zero (&t->param, sizeof(struct dvb_frontend_parameters)))
 		return -1;
 
 	memcpy (&p, &t->param, sizeof(struct dvb_frontend_parameters));
 
 	if (verbosity >= 1) {
-		dprintf(1, ">>> tune to: ");
+		if (n_adapters > 1)
+			dprintf(1, ">>> adapter %d tune to: ", a->adapter_num);
+		else
+			dprintf(1, ">>> tune to: ");
 		dump_dvb_parameters (stderr, t);
 		if (t->last_tuning_failed)
 			dprintf(1, " (tuning failed)");
 		dprintf(1, "\n");
 	}
 
-	if (ioctl(frontend_fd, FE_SET_FRONTEND, &p) == -1) {
+	if (dvb_ioctl(frontend_fd, FE_SET_FRONTEND, &p) == -1) {
 		errorn("Setting frontend parameters failed");
 		return -1;
 	}
 
-	rf_chan = atsc_mhz_to_chan(t->param.frequency/1000000);
-	if (rf_chan < 0)
+	a->rf_chan = atsc_mhz_to_chan(t->param.frequency/1000000);
+	if (a->rf_chan < 0)
 		info("Out of frequency Range: atsc_mhz_to_chan\n"); 
 	
 	for (i = 0; i < 10; i++) {
 		usleep (200000);
 
-		if (ioctl(frontend_fd, FE_READ_STATUS, &s) == -1) {
+		if (dvb_ioctl(frontend_fd, FE_READ_STATUS, &s) == -1) {
 			errorn("FE_READ_STATUS failed");
 			return -1;
 		}
@@ -1992,75 +2326,122 @@ static int set_delivery_system(int fd)
 	dvb_prop[0].u.data = SYS_ATSC;
 	props.num = 1;
 	props.props = dvb_prop;
-	if (ioctl(fd, FE_SET_PROPERTY, &props) >= 0)
+	if (dvb_ioctl(fd, FE_SET_PROPERTY, &props) >= 0)
 		return 0;
 	return errno;
 }
 
-static int tune_to_transponder (int frontend_fd, struct transponder *t)
+static int tune_to_transponder (struct scan_adapter *a, struct transponder *t)
 {
 	int rc;
 
-	/* move TP from "new" to "scanned" list */
-	list_del_init(&t->list);
-	list_add_tail(&t->list, &scanned_transponders);
-	t->scan_done = 1;
-
-	if (t->type != fe_info.type) {
-		rc = set_delivery_system(frontend_fd);
+	if (t->type != a->fe_info.type) {
+		rc = set_delivery_system(a->frontend_fd);
 		if (!rc)
-			fe_info.type = t->type;
+			a->fe_info.type = t->type;
 	}
 
-	if (t->type != fe_info.type) {
+	if (t->type != a->fe_info.type) {
 		warning("frontend type (%s) is not compatible with requested tuning type (%s)\n",
-				fe_type2str(fe_info.type),fe_type2str(t->type));
+				fe_type2str(a->fe_info.type),fe_type2str(t->type));
 		/* ignore cable descriptors in sat NIT and vice versa */
 		t->last_tuning_failed = 1;
 		return -1;
 	}
 
-	if (__tune_to_transponder (frontend_fd, t) == 0)
+	if (__tune_to_transponder (a, t) == 0)
 		return 0;
 
-	return __tune_to_transponder (frontend_fd, t);
+	return __tune_to_transponder (a, t);
+}
+
+
+/* Take the next transponder off the work queue, moving it to the "scanned"
+ * list so no other adapter picks it up. While the queue is empty but other
+ * adapters are busy we wait, since their NITs may yet add transponders.
+ * Returns NULL once there is nothing left to do.
+ */
+static struct transponder *get_next_transponder (void)
+{
+	struct transponder *t = NULL;
+
+	pthread_mutex_lock(&scan_lock);
+	while (list_empty(&new_transponders) && busy_adapters)
+		pthread_cond_wait(&scan_cond, &scan_lock);
+
+	if (!list_empty(&new_transponders)) {
+		t = list_entry (new_transponders.next, struct transponder, list);
+		list_del_init(&t->list);
+		list_add_tail(&t->list, &scanned_transponders);
+		t->scan_done = 1;
+		busy_adapters++;
+	}
+	pthread_mutex_unlock(&scan_lock);
+
+	return t;
 }
 
 
-static int tune_to_next_transponder (int frontend_fd)
+static void put_transponder (void)
 {
-	struct list_head *pos, *tmp;
-	struct transponder *t, *to;
+	pthread_mutex_lock(&scan_lock);
+	busy_adapters--;
+	pthread_cond_broadcast(&scan_cond);
+	pthread_mutex_unlock(&scan_lock);
+}
+
+
+/* switch a transponder which failed to tune to its next alternative
+ * frequency (DVB-T frequency_list_descriptor); returns -1 if there is none
+ */
+static int next_other_frequency (struct transponder *t)
+{
+	struct transponder *to;
 	uint32_t freq;
 
-	list_for_each_safe(pos, tmp, &new_transponders) {
-		
-		t = list_entry (pos, struct transponder, list);
-retry:
-		if (tune_to_transponder (frontend_fd, t) == 0)
-			return 0;
-next:
-		if (t->other_frequency_flag && t->other_f && t->n_other_f) {
-			printf("\n insdie the if loop \n");
-			/* check if the alternate freqeuncy is really new to us */
-			freq = t->other_f[t->n_other_f - 1];
-			t->n_other_f--;
-			if (find_transponder(freq))
-				goto next;
-
-			/* remember tuning to the old frequency failed */
-			to = calloc(1, sizeof(*to));
-			to->param.frequency = t->param.frequency;
-			to->wrong_frequency = 1;
-			INIT_LIST_HEAD(&to->list);
-			INIT_LIST_HEAD(&to->services);
-			list_add_tail(&to->list, &scanned_transponders);
-			copy_transponder(to, t);
-
-			t->param.frequency = freq;
-			info("retrying with f=%d\n", t->param.frequency);
-			goto retry;
-		}
+	pthread_mutex_lock(&scan_lock);
+	while (t->other_frequency_flag && t->other_f && t->n_other_f) {
+		/* check if the alternate freqeuncy is really new to us */
+		freq = t->other_f[t->n_other_f - 1];
+		t->n_other_f--;
+		if (find_transponder(freq))
+			continue;
+
+		/* remember tuning to the old frequency failed */
+		to = calloc(1, sizeof(*to));
+		to->param.frequency = t->param.frequency;
+		to->wrong_frequency = 1;
+		INIT_LIST_HEAD(&to->list);
+		INIT_LIST_HEAD(&to->services);
+		list_add_tail(&to->list, &scanned_transponders);
+		index_transponder(to);
+		copy_transponder(to, t);
+
+		set_transponder_frequency(t, freq);
+		info("retrying with f=%d\n", t->param.frequency);
+		pthread_mutex_unlock(&scan_lock);
+		return 0;
+	}
+	pthread_mutex_unlock(&scan_lock);
+
+	return -1;
+}
+
+
+/* on success the adapter remains busy until put_transponder() is called */
+static int tune_to_next_transponder (struct scan_adapter *a)
+{
+	struct transponder *t;
+
+	while ((t = get_next_transponder()) != NULL) {
+		do {
+			if (tune_to_transponder (a, t) == 0) {
+				a->tuned++;
+				return 0;
+			}
+		} while (next_other_frequency(t) == 0);
+
+		put_transponder();
 	}
 	return -1;
 }
@@ -2094,7 +2475,7 @@ static const char * fe_type2str(fe_type_t t)
 	return enum2str(t, typetab, "UNK");
 }
 
-static int tune_initial (int frontend_fd)
+static void add_initial_transponders (void)
 {
 	struct transponder *t;
 	
@@ -2104,9 +2485,6 @@ static int tune_initial (int frontend_fd)
 		t->type = FE_ATSC;
 		t->param.u.vsb.modulation = VSB_8;
 	}
-
-	return tune_to_next_transponder(frontend_fd);
-	//return 0; 
 }
 
 static int atsc_chan_to_mhz(int chan)
@@ -2147,42 +2525,63 @@ static int atsc_mhz_to_chan(int freq_mhz)
 	return -1;
 }
 
-static void scan_tp_atsc(void)
+static void scan_tp_atsc(struct scan_adapter *a)
 {
 	struct section_buf s0,s1,s2;
 
 	if (no_ATSC_PSIP) {
-		setup_filter(&s0, demux_devname, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
+		setup_filter(&s0, a, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
 		add_filter(&s0);
 	} else {
 		if (ATSC_type & 0x1) {
-			setup_filter(&s0, demux_devname, 0x1ffb, 0xc8, -1, 1, 0, 5); /* terrestrial VCT */
+			setup_filter(&s0, a, 0x1ffb, 0xc8, -1, 1, 0, 5); /* terrestrial VCT */
 			add_filter(&s0);
 		}
 		if (ATSC_type & 0x2) {
-			setup_filter(&s1, demux_devname, 0x1ffb, 0xc9, -1, 1, 0, 5); /* cable VCT */
+			setup_filter(&s1, a, 0x1ffb, 0xc9, -1, 1, 0, 5); /* cable VCT */
 			add_filter(&s1);
 		}
-		setup_filter(&s2, demux_devname, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
+		setup_filter(&s2, a, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
 		add_filter(&s2);
 	}
 
 	do {
-		read_filters ();
-	} while (!(list_empty(&running_filters) &&
-		   list_empty(&waiting_filters)));
+		read_filters (a);
+	} while (!(list_empty(&a->running_filters) &&
+		   list_empty(&a->waiting_filters)));
 }
 
-static void scan_network (int frontend_fd)
+static void *scan_thread (void *arg)
 {
-	if (tune_initial (frontend_fd) < 0) {
-		error("initial tuning failed\n");
-		return;
+	struct scan_adapter *a = arg;
+
+	while (tune_to_next_transponder(a) == 0) {
+		scan_tp_atsc(a);
+		put_transponder();
 	}
 
-	do {
-		scan_tp_atsc();
-	} while (tune_to_next_transponder(frontend_fd) == 0);
+	return NULL;
+}
+
+static void scan_network (void)
+{
+	int tuned = 0;
+	int i;
+
+	add_initial_transponders();
+
+	for (i = 0; i < n_adapters; i++) {
+		if (pthread_create(&adapters[i].thread, NULL, scan_thread, &adapters[i]))
+			fatal("failed to create scan thread: %d %m\n", errno);
+	}
+
+	for (i = 0; i < n_adapters; i++) {
+		pthread_join(adapters[i].thread, NULL);
+		tuned += adapters[i].tuned;
+	}
+
+	if (!tuned)
+		error("initial tuning failed\n");
 }
 
 static char sat_polarisation (struct transponder *t)
@@ -2226,6 +2625,8 @@ static const char *usage = "\n"
 	"	tuning data for at least one transponder/channel.\n"
 	"	-c	scan on currently tuned transponder only\n"
 	"	-a N	use DVB /dev/dvb/adapterN/\n"
+	"		(repeat, or give a list such as 0,1,2, to scan in parallel\n"
+	"		 using several adapters)\n"
 	"	-f N	use DVB /dev/dvb/adapter?/frontendN\n"
 	"	-d N	use DVB /dev/dvb/adapter?/demuxN\n"
 	"	-5	multiply all filter timeouts by factor 5\n"
@@ -2271,12 +2672,10 @@ bad_usage(char *pname, int problem)
 
 int main (int argc, char **argv)
 {
-	char frontend_devname [80]; // memset this buffer
-	int adapter = 0, frontend = 0, demux = 0;
-	int opt, i;
-	int frontend_fd;
-	int fe_open_mode;
-	char *charset;
+	int frontend = 0, demux = 0;
+	int opt, i, j;
+	struct scan_adapter *a;
+	char *charset, *p;
 	FILE * chinfo_fd;
 
 	/*
@@ -2304,7 +2703,12 @@ int main (int argc, char **argv)
 	while ((opt = getopt(argc, argv, "a:c:d:f:5:u:P:A:s:v:l:")) != -1) {
 		switch (opt) {
 		case 'a':
-			adapter = strtoul(optarg, NULL, 0);
+			p = optarg;
+			do {
+				if (n_adapters >= MAX_ADAPTERS)
+					fatal("too many adapters (max %d)\n", MAX_ADAPTERS);
+				adapters[n_adapters++].adapter_num = strtoul(p, &p, 0);
+			} while (*p++ == ',');
 			break;
 		case 'c':
 			current_tp_only = 1;
@@ -2355,28 +2759,48 @@ int main (int argc, char **argv)
 
 	info("scanning \n");
 
-	snprintf (frontend_devname, sizeof(frontend_devname),
-		  "/dev/dvb/adapter%i/frontend%i", adapter, frontend);
-
-	snprintf (demux_devname, sizeof(demux_devname),
-		  "/dev/dvb/adapter%i/demux%i", adapter, demux);
-	info("using '%s' and '%s'\n", frontend_devname, demux_devname);
-
-	for (i = 0; i < MAX_RUNNING; i++)
-		poll_fds[i].fd = -1;
-
-	fe_open_mode = current_tp_only ? O_RDONLY : O_RDWR;
-	if ((frontend_fd = open (frontend_devname, fe_open_mode)) < 0)
-		fatal("failed to open '%s': %d %m\n", frontend_devname, errno);
-	/* determine FE type and caps */
-	if (ioctl(frontend_fd, FE_GET_INFO, &fe_info) == -1)
-		fatal("FE_GET_INFO failed: %d %m\n", errno);
-
-	if ((spectral_inversion == INVERSION_AUTO ) &&
-	    !(fe_info.caps & FE_CAN_INVERSION_AUTO)) {
-		info("Frontend can not do INVERSION_AUTO, trying INVERSION_OFF instead\n");
-		spectral_inversion = INVERSION_OFF;
-	}	
+	if (n_adapters == 0)
+		n_adapters = 1;		/* adapter0 */
+
+	/* only one tuner can scan the currently tuned transponder */
+	if (current_tp_only)
+		n_adapters = 1;
+
+	for (i = 0; i < n_adapters; i++) {
+		a = &adapters[i];
+
+		for (j = 0; j < i; j++)
+			if (adapters[j].adapter_num == a->adapter_num)
+				fatal("adapter %d given more than once\n", a->adapter_num);
+
+		snprintf (a->frontend_devname, sizeof(a->frontend_devname),
+			  "/dev/dvb/adapter%i/frontend%i", a->adapter_num, frontend);
+
+		snprintf (a->demux_devname, sizeof(a->demux_devname),
+			  "/dev/dvb/adapter%i/demux%i", a->adapter_num, demux);
+		a->demux_num = demux;
+		info("using '%s' and '%s'\n", a->frontend_devname, a->demux_devname);
+
+		INIT_LIST_HEAD(&a->running_filters);
+		INIT_LIST_HEAD(&a->waiting_filters);
+		timer_init(a);
+		if ((a->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+			fatal("epoll_create1 failed: %d %m\n", errno);
+
+		/* go through libdvbapi, so virtual adapters can be scanned too */
+		if ((a->fe = dvbfe_open(a->adapter_num, frontend, current_tp_only)) == NULL)
+			fatal("failed to open '%s': %d %m\n", a->frontend_devname, errno);
+		a->frontend_fd = dvbfe_get_pollfd(a->fe);
+		/* determine FE type and caps */
+		if (dvb_ioctl(a->frontend_fd, FE_GET_INFO, &a->fe_info) == -1)
+			fatal("FE_GET_INFO failed: %d %m\n", errno);
+
+		if ((spectral_inversion == INVERSION_AUTO ) &&
+		    !(a->fe_info.caps & FE_CAN_INVERSION_AUTO)) {
+			info("Frontend can not do INVERSION_AUTO, trying INVERSION_OFF instead\n");
+			spectral_inversion = INVERSION_OFF;
+		}
+	}
 
 	if (save_channel_info) {	
 
@@ -2396,20 +2820,19 @@ int main (int argc, char **argv)
 			printf("MEMEORY NOT ALLOCATED: pchan_info \n");
 			return -1;
 		}
-
-		fe_fd = frontend_fd;
 	}
 
 	if (current_tp_only) {
-		current_tp = alloc_transponder(0); /* dummy */
+		a = &adapters[0];
+		a->current_tp = alloc_transponder(0); /* dummy */
 		/* move TP from "new" to "scanned" list */
-		list_del_init(&current_tp->list);
-		list_add_tail(&current_tp->list, &scanned_transponders);
-		current_tp->scan_done = 1;
-		scan_tp_atsc();
+		list_del_init(&a->current_tp->list);
+		list_add_tail(&a->current_tp->list, &scanned_transponders);
+		a->current_tp->scan_done = 1;
+		scan_tp_atsc(a);
 	}
 	else {
-		scan_network (frontend_fd);
+		scan_network ();
 	}
 
 	if (save_channel_info) {
@@ -2421,7 +2844,10 @@ int main (int argc, char **argv)
 				
 	}
 
-	close (frontend_fd);
+	for (i = 0; i < n_adapters; i++) {
+		close (adapters[i].epoll_fd);
+		dvbfe_close(adapters[i].fe);
+	}
 	
 	cleanup();
 
@@ -25,4 +25,6 @@ extern int verbosity;
 #define debug(msg...) dpprintf(5, msg)
 #define verbosedebug(msg...) dpprintf(6, msg)
 
+extern int dvb_ioctl(int fd, unsigned long request, void *arg);
+
 #endif
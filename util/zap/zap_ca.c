@@ -27,6 +27,9 @@
 #include <libdvben50221/en50221_stdcam.h>
 #include "zap_ca.h"
 
+// longest the cam thread sleeps before checking for shutdown
+#define CAMTHREAD_MAX_WAIT_MS 100
+
 
 static int zap_ca_info_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint32_t ca_id_count, uint16_t *ca_ids);
 static int zap_ai_callback(void *arg, uint8_t slot_id, uint16_t session_number,
@@ -159,7 +162,7 @@ static void *camthread_func(void* arg)
 	(void) arg;
 
 	while(!camthread_shutdown) {
-		stdcam->poll(stdcam);
+		en50221_stdcam_wait(stdcam, CAMTHREAD_MAX_WAIT_MS);
 	}
 
 	return 0;